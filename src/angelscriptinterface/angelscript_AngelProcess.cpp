@@ -5,10 +5,14 @@
 #include <string>
 #include <angelscript.h>
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
 #include "logging/log_Logger.h"
 #include "text/text_StringConversion.h"
 
 #include "osinterface/osinterface_OsTypes.h"
+#include "osinterface/osinterface_ThreadUtils.h"
 #include "utilities/memory_MemHeapState.h"
 
 #include "dbinterface/dbinterface_DatabaseAccess.h"
@@ -31,11 +35,20 @@
 #include "angelscript_ScriptUtilities.h"
 #include "angelscript_AngelProcess.h"
 #include "angelscript_CompiledBytecodeStream.h"
+#include "angelscript_ModuleCache.h"
 #include "angelscript_AString.h"
 
 namespace
 {
-    const std::string SCRIPT_MODULE_NAME = "mutgos_script";
+    // TODO make data driven
+
+    /** How many lines execute between checks of the thread CPU time.
+        Reading the CPU clock is a system call, so not every line. */
+    const MG_VeryLongUnsignedInt SLICE_CHECK_LINES = 16;
+
+    /** Most lines to execute in one timeslice, in case the thread CPU
+        clock is not available or a single line takes a long time */
+    const MG_VeryLongUnsignedInt MAX_SLICE_LINES = 5000;
 }
 
 namespace mutgos
@@ -58,10 +71,13 @@ namespace angelscript
           overallocated(false),
           total_instructions_executed(0),
           slice_instructions_executed(0),
+          slice_end_cpu_time_us(0),
           output_channel_ptr(output_channel),
           input_channel_ptr(input_channel),
           engine_ptr(engine),
-          context_ptr(context)
+          context_ptr(context),
+          module_ptr(0),
+          module_generation(0)
     {
         if ((not security_context) or (not engine) or (not context))
         {
@@ -76,8 +92,6 @@ namespace angelscript
         heap_state.set_max_mem(1024 * 1024); // 1 meg
         my_context.set_output_channel(output_channel);
 
-        ScriptUtilities::set_my_script_context(engine, &my_context);
-
         // Should always be valid
         dbinterface::EntityRef program_ref =
             dbinterface::DatabaseAccess::instance()->get_entity(
@@ -108,13 +122,33 @@ namespace angelscript
     // ----------------------------------------------------------------------
     AngelProcess::~AngelProcess()
     {
-        // Cleanup the stuff we did in this class
+        // Cleanup the stuff we did in this class.  Aborting can run script
+        // destructors, so they need the script context.
         //
+        ScriptUtilities::set_my_script_context(&my_context);
         context_ptr->ClearLineCallback();
         context_ptr->Abort();
         context_ptr->Unprepare();
-        ScriptUtilities::cleanup_my_script_context(engine_ptr);
-        engine_ptr->DiscardModule(SCRIPT_MODULE_NAME.c_str());
+        ScriptUtilities::cleanup_my_script_context();
+
+        // The module goes back in the engine's cache for the next time the
+        // script runs.
+        //
+        if (module_ptr)
+        {
+            ModuleCache * const cache_ptr =
+                ModuleCache::get_module_cache(engine_ptr);
+
+            if (cache_ptr)
+            {
+                cache_ptr->return_module(
+                    my_context.get_security_context().get_program(),
+                    module_generation,
+                    module_ptr);
+            }
+
+            module_ptr = 0;
+        }
 
         // Return the engine and context back to the holder, generally in the
         // same condition we found it.
@@ -152,7 +186,7 @@ namespace angelscript
         const executor::PID pid,
         executor::ProcessServices &services)
     {
-        return run_script();
+        return run_script(services);
     }
 
     // ----------------------------------------------------------------------
@@ -196,13 +230,13 @@ namespace angelscript
                 }
                 else
                 {
-                    status = run_script();
+                    status = run_script(services);
                 }
             }
         }
         else
         {
-            status = run_script();
+            status = run_script(services);
         }
 
         return status;
@@ -242,9 +276,10 @@ namespace angelscript
     }
 
     // ----------------------------------------------------------------------
-    // TODO Hardcoded values for timeslicing
     void AngelProcess::debug_line_callback(asIScriptContext *ctx, void *dbg)
     {
+        bool slice_expired = false;
+
         ++slice_instructions_executed;
 
         if (slice_instructions_executed % 10)
@@ -253,7 +288,15 @@ namespace angelscript
                 memory::ThreadVirtualHeapManager::check_overallocation(false);
         }
 
-        if ((slice_instructions_executed > 50) || overallocated)
+        if (not (slice_instructions_executed % SLICE_CHECK_LINES))
+        {
+            slice_expired =
+                (osinterface::ThreadUtils::get_thread_cpu_time_us() >=
+                    slice_end_cpu_time_us) or
+                (slice_instructions_executed >= MAX_SLICE_LINES);
+        }
+
+        if (slice_expired || overallocated)
         {
             // Time to pause temporarily and let someone else execute,
             // or abort if overallocated.
@@ -281,58 +324,125 @@ namespace angelscript
         }
         else
         {
-            // Compile as needed
+            const dbtype::Id &program_id = program_ref.id();
+            ModuleCache * const cache_ptr =
+                ModuleCache::get_module_cache(engine_ptr);
+
+            // Get the generation before the bytecode, so a change in between
+            // makes the cached module out of date rather than mislabelled.
             //
-            char *bytecode = 0;
-            size_t bytecode_size = 0;
-
-            if (not AngelScriptAccess::instance()->compile_script(
-                program_ref,
-                *engine_ptr,
-                output_channel_ptr,
-                true,
-                bytecode,
-                bytecode_size))
+            const MG_UnsignedInt generation =
+                AngelScriptAccess::instance()->get_program_generation(
+                    program_id);
+
+            // Loading and initializing globals are not charged to the
+            // script, just as compiling is not.
+            //
+            const memory::MemHeapState current_heap =
+                memory::ThreadVirtualHeapManager::get_thread_heap_state();
+            const memory::MemHeapState load_heap;
+            memory::ThreadVirtualHeapManager::set_thread_heap_state(load_heap);
+
+            module_ptr = cache_ptr ?
+                cache_ptr->take_module(program_id, generation) : 0;
+            module_generation = generation;
+
+            if (not cache_ptr)
             {
-                LOG(info, "angelscript", "add_script",
-                    "Failed to compile script " +
-                    my_context.get_security_context().get_program().to_string(true));
+                LOG(error, "angelscript", "add_script",
+                    "Engine has no module cache.");
 
-                error_messages.push_back("Script failed to compile.");
+                error_messages.push_back(
+                    "Internal error (no module cache).");
             }
-            else
+            else if (module_ptr)
             {
-                CompiledBytecodeStream bytecode_stream(bytecode, bytecode_size);
-                bytecode = 0;
-
-                // Set up engine with script specifics
+                // Already loaded.  Put the globals back the way a fresh load
+                // would have them.
                 //
-                asIScriptModule * const mod_ptr = engine_ptr->GetModule(
-                    SCRIPT_MODULE_NAME.c_str(),
-                    asGM_ALWAYS_CREATE);
+                const int rc = module_ptr->ResetGlobalVars();
 
-                if (not mod_ptr)
+                if (rc < 0)
                 {
                     LOG(error, "angelscript", "add_script",
-                        "Could not get module.");
+                        "Could not reset globals for script " +
+                        program_id.to_string(true) + ", error code " +
+                        text::to_string(rc));
 
                     error_messages.push_back(
-                        "Internal error (could not get module).");
+                        "Internal error (could not reset globals).");
+                    cache_ptr->discard_module(module_ptr);
+                    module_ptr = 0;
                 }
                 else
                 {
-                    const int rc = mod_ptr->LoadByteCode(&bytecode_stream);
+                    success = true;
+                }
+            }
+            else
+            {
+                // Compile as needed
+                //
+                char *bytecode = 0;
+                size_t bytecode_size = 0;
+
+                if (not AngelScriptAccess::instance()->compile_script(
+                    program_ref,
+                    *engine_ptr,
+                    output_channel_ptr,
+                    true,
+                    bytecode,
+                    bytecode_size))
+                {
+                    LOG(info, "angelscript", "add_script",
+                        "Failed to compile script " +
+                        program_id.to_string(true));
 
-                    if (rc < 0)
+                    error_messages.push_back("Script failed to compile.");
+                }
+                else
+                {
+                    CompiledBytecodeStream bytecode_stream(
+                        bytecode,
+                        bytecode_size);
+                    bytecode = 0;
+
+                    // Set up engine with script specifics
+                    //
+                    int rc = 0;
+
+                    // Scope for lock
+                    {
+                        boost::lock_guard<boost::mutex> build_guard(
+                            cache_ptr->get_build_lock());
+
+                        module_ptr = cache_ptr->make_module();
+
+                        if (module_ptr)
+                        {
+                            rc = module_ptr->LoadByteCode(&bytecode_stream);
+                        }
+                    }
+
+                    if (not module_ptr)
+                    {
+                        LOG(error, "angelscript", "add_script",
+                            "Could not get module.");
+
+                        error_messages.push_back(
+                            "Internal error (could not get module).");
+                    }
+                    else if (rc < 0)
                     {
                         // Failed to load byte code for some reason
                         LOG(error, "angelscript", "add_script",
                             "Could not load bytecode for script " +
-                            my_context.get_security_context().get_program().
-                                to_string(true) + ", error code " +
-                            text::to_string(rc));
+                            program_id.to_string(true) +
+                            ", error code " + text::to_string(rc));
 
                         error_messages.push_back("Bytecode corrupt.");
+                        cache_ptr->discard_module(module_ptr);
+                        module_ptr = 0;
                     }
                     else
                     {
@@ -340,13 +450,33 @@ namespace angelscript
                     }
                 }
             }
+
+            memory::ThreadVirtualHeapManager::set_thread_heap_state(
+                current_heap);
         }
 
         return success;
     }
 
     // ----------------------------------------------------------------------
-    AngelProcess::ProcessStatus AngelProcess::run_script(void)
+    AngelProcess::ProcessStatus AngelProcess::run_script(
+        executor::ProcessServices &services)
+    {
+        // The engine is shared with other scripts, so the functions the
+        // script calls find its context through the thread running it.
+        //
+        ScriptUtilities::set_my_script_context(&my_context);
+
+        const ProcessStatus status = run_timeslice(services);
+
+        ScriptUtilities::cleanup_my_script_context();
+
+        return status;
+    }
+
+    // ----------------------------------------------------------------------
+    AngelProcess::ProcessStatus AngelProcess::run_timeslice(
+        executor::ProcessServices &services)
     {
         ProcessStatus status = PROCESS_STATUS_ERROR;
         bool first_run = false;
@@ -374,18 +504,14 @@ namespace angelscript
                 // Need to get the method to execute, prepare the context,
                 // and set the argument(s).
                 //
-                asIScriptModule * const mod_ptr = engine_ptr->GetModule(
-                    SCRIPT_MODULE_NAME.c_str(),
-                    asGM_ONLY_IF_EXISTS);
-
-                if (not mod_ptr)
+                if (not module_ptr)
                 {
                     LOG(error, "angelscript", "run_script", "module is null!");
                     error_messages.push_back("Internal error (can't get module).");
                     return status;
                 }
 
-                asIScriptFunction * const func_ptr = mod_ptr->GetFunctionByDecl(
+                asIScriptFunction * const func_ptr = module_ptr->GetFunctionByDecl(
                     "void main(const string &in)");
 
                 if (not func_ptr)
@@ -437,9 +563,20 @@ namespace angelscript
                 arguments.shrink_to_fit();
             }
 
-            // Execute the time slice
+            // Execute the time slice, which ends once the thread has used
+            // up its CPU time.
+            //
+            slice_instructions_executed = 0;
+            slice_end_cpu_time_us =
+                osinterface::ThreadUtils::get_thread_cpu_time_us()
+                    + services.get_time_slice_us();
+
             const int execute_rc = context_ptr->Execute();
-            engine_ptr->GarbageCollect();
+
+            // The engine is shared, so only do an incremental step here.
+            // Full cycles are done now and then when contexts are returned.
+            //
+            engine_ptr->GarbageCollect(asGC_ONE_STEP);
 
             switch (execute_rc)
             {
@@ -179,17 +179,18 @@ namespace angelscript
 
         /**
          * Called by AngelScript's debugger functionality, this is used to
-         * monitor how many lines have been executed in order to do timeslices,
-         * kill long running processes, and kill processes that have used too
-         * much memory.
+         * monitor how much thread CPU time has been used in order to do
+         * timeslices, kill long running processes, and kill processes that
+         * have used too much memory.
          * @param ctx[in] Script context.
          * @param dbg[in] User-provided pointer (not used).
          */
         void debug_line_callback(asIScriptContext *ctx, void *dbg);
 
         /**
-         * Compiles the script into bytecode (if needed), and adds the bytecode
-         * to the engine.
+         * Takes the script's module from the engine's module cache, or if not
+         * cached, compiles the script into bytecode (if needed) and loads the
+         * bytecode into a new cached module.
          * @return True if success.
          */
         bool add_script(void);
@@ -197,9 +198,21 @@ namespace angelscript
         /**
          * Common code that compiles a script (as needed) and runs it for
          * a timeslice, or runs the next timeslice if already started.
+         * Makes the script context available while the script runs.
+         * @param services[in] Services for the process, used to get the
+         * length of the timeslice.
          * @return The process status code to return back to the scheduler.
          */
-        ProcessStatus run_script(void);
+        ProcessStatus run_script(executor::ProcessServices &services);
+
+        /**
+         * Does the work of run_script(), once the script context is
+         * available.
+         * @param services[in] Services for the process, used to get the
+         * length of the timeslice.
+         * @return The process status code to return back to the scheduler.
+         */
+        ProcessStatus run_timeslice(executor::ProcessServices &services);
 
         ScriptContext my_context; ///< The AngelScript and security context
         memory::MemHeapState heap_state; ///< 'Virtual' heap state storage between timeslices (allocation, etc).
@@ -210,6 +223,7 @@ namespace angelscript
         bool overallocated; ///< True if process has allocated memory beyond what is allowed
         MG_VeryLongUnsignedInt total_instructions_executed; ///< How many lines (instructions) executed in total for this process
         MG_VeryLongUnsignedInt slice_instructions_executed; ///< How many lines (instructions) executed this timeslice for this process
+        MG_LongUnsignedInt slice_end_cpu_time_us; ///< Thread CPU time when this timeslice is up
 
         std::string process_name; ///< Name of the process, for logging and ps.
         ErrorMessageText error_messages; ///< Any error messages to be returned if process in an error state.
@@ -219,6 +233,8 @@ namespace angelscript
 
         asIScriptEngine * const engine_ptr; ///< Pointer to script engine
         asIScriptContext * const context_ptr; ///< Pointer to script context
+        asIScriptModule *module_ptr; ///< Pointer to script module, taken from the engine's module cache
+        MG_UnsignedInt module_generation; ///< Generation of the bytecode loaded in the module
     };
 }
 }
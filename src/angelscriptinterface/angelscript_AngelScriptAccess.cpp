@@ -2,7 +2,10 @@
  * angelscript_AngelScriptAccess.cpp
  */
 
+#include <string.h>
 #include <string>
+#include <map>
+#include <vector>
 #include <angelscript.h>
 
 #include "logging/log_Logger.h"
@@ -11,12 +14,17 @@
 #include "text/text_ExternalPlainText.h"
 #include "channels/events_TextChannel.h"
 
-#include "concurrency/concurrency_WriterLockToken.h"
 
 #include "dbinterface/dbinterface_EntityRef.h"
 #include "dbinterface/dbinterface_DatabaseAccess.h"
 #include "dbtypes/dbtype_Program.h"
 #include "dbtypes/dbtype_DocumentProperty.h"
+#include "dbtypes/dbtype_EntityType.h"
+
+#include "events/events_EntityChangedSubscriptionParams.h"
+#include "events/events_SubscriptionCallback.h"
+#include "events/events_EventAccess.h"
+#include "events/events_EntityChangedEvent.h"
 
 #include "softcode/softcode_SoftcodeAccess.h"
 
@@ -30,6 +38,8 @@
 #include "angelscript_MovementOps.h"
 #include "angelscript_SystemOps.h"
 #include "angelscript_CompiledBytecodeStream.h"
+#include "angelscript_ModuleCache.h"
+#include "angelscript_CompileService.h"
 #include "angelscript_AngelScriptAccess.h"
 #include "angelscript_AngelProcess.h"
 
@@ -44,7 +54,13 @@ namespace
     const std::string SCRIPT_MODULE_NAME = "mutgos_script";
 
     // TODO make data driven
-    const size_t ENGINE_POOL_MAX_SIZE = 4;
+    /** How many engines are shared by all scripts */
+    const size_t ENGINE_COUNT = 4;
+    /** Most program modules each engine keeps loaded */
+    const size_t MODULE_CACHE_MAX_SIZE = 64;
+    /** Least time between full garbage collection cycles of an engine */
+    const boost::posix_time::time_duration FULL_GC_INTERVAL =
+        boost::posix_time::seconds(60);
 }
 
 namespace mutgos
@@ -78,18 +94,34 @@ namespace angelscript
     {
         bool success = true;
 
-        boost::lock_guard<boost::mutex> guard(mutex);
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
 
-        const memory::MemHeapState create_engine_heap;
-        memory::ThreadVirtualHeapManager::set_thread_heap_state(
-            create_engine_heap);
+            const memory::MemHeapState create_engine_heap;
+            memory::ThreadVirtualHeapManager::set_thread_heap_state(
+                create_engine_heap);
 
-        asSetGlobalMemoryFunctions(
-            memory::ThreadVirtualHeapManager::mem_alloc_nofail,
-            memory::ThreadVirtualHeapManager::mem_free);
-        asPrepareMultithread();
+            asSetGlobalMemoryFunctions(
+                memory::ThreadVirtualHeapManager::mem_alloc_nofail,
+                memory::ThreadVirtualHeapManager::mem_free);
+            asPrepareMultithread();
+
+            softcode::SoftcodeAccess::instance()->register_language(this);
+        }
 
-        softcode::SoftcodeAccess::instance()->register_language(this);
+        // Compile everything now, rather than when first run.  The service
+        // compiles through this class, so it is started without the lock.
+        //
+        if (not compile_service_ptr)
+        {
+            compile_service_ptr = new CompileService(*this);
+        }
+
+        compile_service_ptr->startup();
+
+        // Events call back into this class, so subscribe without the lock.
+        subscribe();
 
         return success;
     }
@@ -99,6 +131,16 @@ namespace angelscript
     {
         bool success = true;
 
+        // The service compiles through this class, so it must be stopped
+        // before the lock is taken.
+        //
+        if (compile_service_ptr)
+        {
+            compile_service_ptr->shutdown();
+        }
+
+        unsubscribe();
+
         boost::lock_guard<boost::mutex> guard(mutex);
 
         softcode::SoftcodeAccess::instance()->unregister_language(this);
@@ -109,25 +151,27 @@ namespace angelscript
         memory::ThreadVirtualHeapManager::set_thread_heap_state(
             delete_engine_heap);
 
-        for (size_t index = 0; index < engines_avail.size(); ++index)
+        for (size_t index = 0; index < engines.size(); ++index)
         {
-            EngineContextState &engine_state =
-                engines_avail[index];
-
-            engine_state.engine_ptr->ReturnContext(engine_state.context_ptr);
-            engine_state.engine_ptr->ShutDownAndRelease();
-            delete engine_state.string_factory_ptr;
-        }
-
-        engines_avail.clear();
+            EngineState &engine_state = engines[index];
 
-        if (not engines_used.empty())
-        {
-            LOG(fatal, "angelscript", "shutdown",
-                "There are " + text::to_string(engines_used.size())
-                + " engines still in use!");
+            if (engine_state.contexts_in_use)
+            {
+                LOG(fatal, "angelscript", "shutdown",
+                    "There are "
+                    + text::to_string(engine_state.contexts_in_use)
+                    + " contexts still in use on engine "
+                    + text::to_string(index) + "!");
 
-            success = false;
+                success = false;
+            }
+            else if (engine_state.engine_ptr)
+            {
+                delete engine_state.module_cache_ptr;
+                engine_state.engine_ptr->ShutDownAndRelease();
+                delete engine_state.string_factory_ptr;
+                engine_state = EngineState();
+            }
         }
 
         // Deinitialize AngelScript
@@ -167,7 +211,10 @@ namespace angelscript
 
         // Get engine, make the process, and add it to the Executor.
         //
-        if (not get_available_engine(engine_ptr, context_ptr))
+        if (not get_available_engine(
+            security_context_ptr->get_program(),
+            engine_ptr,
+            context_ptr))
         {
             LOG(error, "angelscript", "make_process",
                 "Unable to get an Engine; cannot run.");
@@ -209,7 +256,7 @@ namespace angelscript
         char *bytecode_ptr = 0;
         size_t bytecode_size = 0;
 
-        if (not get_available_engine(engine_ptr, context_ptr))
+        if (not get_available_engine(program_id, engine_ptr, context_ptr))
         {
             LOG(error, "angelscript", "compile",
                 "Unable to get an Engine; cannot compile.");
@@ -264,7 +311,18 @@ namespace angelscript
 
         if (program_ptr)
         {
-            success = program_ptr->set_compiled_code(0, 0);
+            next_program_generation(program_ref.id());
+
+            // Bytecode is no longer kept in the Entity, but older databases
+            // may still have some.
+            //
+            success = (not program_ptr->has_compiled_code()) or
+                program_ptr->set_compiled_code(0, 0);
+
+            if (compile_service_ptr)
+            {
+                compile_service_ptr->queue_program(program_ref.id());
+            }
         }
 
         return success;
@@ -290,6 +348,8 @@ namespace angelscript
         dbtype::Program * const program_ptr = program_ref.valid() ?
             dynamic_cast<dbtype::Program *>(program_ref.get())
             : 0;
+        ModuleCache * const cache_ptr =
+            ModuleCache::get_module_cache(&engine);
 
         if (not program_ptr)
         {
@@ -297,20 +357,50 @@ namespace angelscript
                 "Not a program: " + (program_ref.valid() ?
                     program_ref.id().to_string(true) : "<INVALID>"));
         }
+        else if (not cache_ptr)
+        {
+            LOG(error, "angelscript", "compile_script",
+                "Engine has no module cache.");
+        }
         else
         {
-            concurrency::WriterLockToken token(*program_ptr);
+            // Get the generation before the source code, so a change in
+            // between leaves the new bytecode unstored rather than
+            // mislabelled.
+            //
+            const dbtype::Id &program_id = program_ref.id();
+            const MG_UnsignedInt generation =
+                get_program_generation(program_id);
+
+            success = get_stored_bytecode(
+                program_id,
+                generation,
+                want_bytecode,
+                bytecode_ptr,
+                bytecode_size);
 
-            if (not program_ptr->has_compiled_code(token))
+            if (not success)
             {
-                // Currently not compiled, so compilation required.
+                // Currently not compiled, so compilation required, unless
+                // the database has bytecode from this exact source (such as
+                // from before a restart).
                 // Set up virtual heap to be unlimited, since we are just
-                // compiling.
+                // compiling.  The engine is shared, so other modules must
+                // not be built while this one is.
                 //
-                LOG(info, "angelscript", "compile_script", "Compiling script "
-                  + program_ref.id().to_string(true));
+                const std::string source_code =
+                    program_ptr->get_source_code().get_as_string();
+                std::string saved_bytecode;
+
+                dbinterface::DatabaseAccess::instance()->get_program_bytecode(
+                    program_id,
+                    source_code,
+                    saved_bytecode);
 
-                engine.GarbageCollect();
+                boost::lock_guard<boost::mutex> build_guard(
+                    cache_ptr->get_build_lock());
+
+                engine.GarbageCollect(asGC_ONE_STEP);
                 const memory::MemHeapState current_heap =
                     memory::ThreadVirtualHeapManager::get_thread_heap_state();
                 const memory::MemHeapState compile_heap;
@@ -319,7 +409,7 @@ namespace angelscript
 
                 int rc = 0;
                 MessageCallbackWrapper messageCallback(
-                    program_ref.id(),
+                    program_id,
                     output_channel_ptr);
 
                 if (engine.SetMessageCallback(
@@ -332,23 +422,72 @@ namespace angelscript
                         "No compiler messages will be seen.");
                 }
 
-                asIScriptModule * const mod_ptr = engine.GetModule(
+                asIScriptModule *mod_ptr = engine.GetModule(
                     SCRIPT_MODULE_NAME.c_str(),
                     asGM_ALWAYS_CREATE);
 
+                if (mod_ptr and (not saved_bytecode.empty()))
+                {
+                    // Loading the saved bytecode is what validates it, since
+                    // the engine or registered API may have changed since.
+                    //
+                    char * const saved_ptr = new char[saved_bytecode.size()];
+                    memcpy(
+                        saved_ptr,
+                        saved_bytecode.data(),
+                        saved_bytecode.size());
+                    CompiledBytecodeStream saved_stream(
+                        saved_ptr,
+                        saved_bytecode.size());
+
+                    if (mod_ptr->LoadByteCode(&saved_stream) >= 0)
+                    {
+                        success = true;
+
+                        store_bytecode(
+                            program_id,
+                            generation,
+                            saved_bytecode.data(),
+                            saved_bytecode.size());
+
+                        if (want_bytecode)
+                        {
+                            bytecode_ptr = new char[saved_bytecode.size()];
+                            bytecode_size = saved_bytecode.size();
+                            memcpy(
+                                bytecode_ptr,
+                                saved_bytecode.data(),
+                                saved_bytecode.size());
+                        }
+                    }
+                    else
+                    {
+                        LOG(info, "angelscript", "compile_script",
+                            "Saved bytecode did not load, recompiling "
+                            + program_id.to_string(true));
+
+                        // Start over with an empty module.
+                        //
+                        mod_ptr = engine.GetModule(
+                            SCRIPT_MODULE_NAME.c_str(),
+                            asGM_ALWAYS_CREATE);
+                    }
+                }
+
                 if (not mod_ptr)
                 {
                     LOG(error, "angelscript", "compile_script",
                         "Could not get module.");
                 }
-                else
+                else if (not success)
                 {
+                    LOG(info, "angelscript", "compile_script",
+                        "Compiling script " + program_id.to_string(true));
+
                     success = true;
 
                     // Add the source code to the module.
                     //
-                    const std::string source_code =
-                        program_ptr->get_source_code(token).get_as_string();
                     rc = mod_ptr->AddScriptSection(
                         "script",
                         source_code.c_str(),
@@ -365,7 +504,7 @@ namespace angelscript
 
                     if (success)
                     {
-                        // Save the binary data off in the Program
+                        // Save the binary data off for the next run
                         //
                         CompiledBytecodeStream bytecode;
                         rc = mod_ptr->SaveByteCode(&bytecode, false);
@@ -382,10 +521,28 @@ namespace angelscript
 
                             if (success)
                             {
-                                success = program_ptr->set_compiled_code(
+                                store_bytecode(
+                                    program_id,
+                                    generation,
                                     raw_bytecode_ptr,
-                                    raw_bytecode_size,
-                                    token);
+                                    raw_bytecode_size);
+
+                                dbinterface::DatabaseAccess::instance()->
+                                    save_program_bytecode(
+                                        program_id,
+                                        source_code,
+                                        raw_bytecode_ptr,
+                                        raw_bytecode_size);
+
+                                if (want_bytecode)
+                                {
+                                    bytecode_ptr = new char[raw_bytecode_size];
+                                    bytecode_size = raw_bytecode_size;
+                                    memcpy(
+                                        bytecode_ptr,
+                                        raw_bytecode_ptr,
+                                        raw_bytecode_size);
+                                }
                             }
                         }
                     }
@@ -394,23 +551,92 @@ namespace angelscript
                 engine.DiscardModule(SCRIPT_MODULE_NAME.c_str());
                 engine.ClearMessageCallback();
 
-                // Go back to the original heap
+                // Go back to the original heap.  Only an incremental step
+                // is done since the build lock is held.
                 //
-                engine.GarbageCollect();
+                engine.GarbageCollect(asGC_ONE_STEP);
                 memory::ThreadVirtualHeapManager::set_thread_heap_state(
                     current_heap);
             }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt AngelScriptAccess::get_program_generation(
+        const dbtype::Id &program_id)
+    {
+        MG_UnsignedInt generation = 0;
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        ProgramGenerations::const_iterator generation_iter =
+            program_generations.find(program_id);
 
-            if (want_bytecode and program_ptr->has_compiled_code(token))
+        if (generation_iter != program_generations.end())
+        {
+            generation = generation_iter->second;
+        }
+
+        return generation;
+    }
+
+    // ----------------------------------------------------------------------
+    CompileStats AngelScriptAccess::get_compile_stats(void)
+    {
+        CompileStats stats;
+
+        if (compile_service_ptr)
+        {
+            stats = compile_service_ptr->get_stats();
+        }
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::subscribed_event_matched(
+        const events::SubscriptionId id,
+        events::Event &event)
+    {
+        if ((id == program_deletion_subscription_id) and
+            (event.get_event_type() == events::Event::EVENT_ENTITY_CHANGED))
+        {
+            events::EntityChangedEvent * const entity_event_ptr =
+                static_cast<events::EntityChangedEvent *>(&event);
+
+            forget_program(entity_event_ptr->get_entity_id());
+        }
+        else
+        {
+            LOG(warning, "angelscript", "subscribed_event_matched",
+                "Got an unknown subscribed event!");
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::subscription_deleted(
+        const events::SubscriptionIdList &ids_deleted)
+    {
+        // The subscription doesn't refer to specific entities, so this
+        // should never happen.  Log it and resubscribe.
+        //
+        for (events::SubscriptionIdList::const_iterator id_iter =
+                ids_deleted.begin();
+             id_iter != ids_deleted.end();
+             ++id_iter)
+        {
+            if (*id_iter == program_deletion_subscription_id)
             {
-                success = program_ptr->get_compiled_code(
-                    bytecode_ptr,
-                    bytecode_size,
-                    token);
+                LOG(error, "angelscript", "subscription_deleted",
+                    "Program deletion subscription was unexpectedly deleted!  "
+                    "Resubscribing...");
+
+                program_deletion_subscription_id = 0;
             }
         }
 
-        return success;
+        subscribe();
     }
 
     // ----------------------------------------------------------------------
@@ -420,11 +646,6 @@ namespace angelscript
           : prog_id(id),
             output_channel_ptr(channel_ptr)
     {
-        if (not channel_ptr)
-        {
-            LOG(error, "angelscript", "MessageCallbackWrapper",
-                "Null channel pointer passed in!");
-        }
     }
 
     // ----------------------------------------------------------------------
@@ -530,6 +751,9 @@ namespace angelscript
 
     // ----------------------------------------------------------------------
     AngelScriptAccess::AngelScriptAccess(void)
+      : engines(ENGINE_COUNT),
+        compile_service_ptr(0),
+        program_deletion_subscription_id(0)
     {
     }
 
@@ -537,10 +761,14 @@ namespace angelscript
     AngelScriptAccess::~AngelScriptAccess()
     {
         shutdown();
+
+        delete compile_service_ptr;
+        compile_service_ptr = 0;
     }
 
     // ----------------------------------------------------------------------
     bool AngelScriptAccess::get_available_engine(
+        const dbtype::Id &program_id,
         asIScriptEngine *&engine_ptr,
         asIScriptContext *&context_ptr)
     {
@@ -548,86 +776,103 @@ namespace angelscript
 
         boost::lock_guard<boost::mutex> guard(mutex);
 
-        if (not engines_avail.empty())
-        {
-            // An engine is available.  Mark it in use and return.
-            //
-            engine_ptr = engines_avail.back().engine_ptr;
-            context_ptr = engines_avail.back().context_ptr;
+        EngineState &engine_state = engines[
+            ((size_t) program_id.get_site_id() * 31 +
+                (size_t) program_id.get_entity_id()) % engines.size()];
 
-            engines_used.push_back(engines_avail.back());
-            engines_avail.pop_back();
-            status = true;
-        }
-        else
+        if (engine_state.engine_ptr or create_engine(engine_state))
         {
-            // No engines currently available.  Make a new one.
-            // Start by registering all MUTGOS-specific classes with it.
-            // Give it an unlimited, separate heap so base registrations won't
-            // count against a running script.
+            // Contexts are pooled by the engine, so this is cheap.
             //
-            const memory::MemHeapState create_engine_heap;
-            memory::ThreadVirtualHeapManager::set_thread_heap_state(
-                create_engine_heap);
-
-            int rc = 0;
-            bool register_success = true;
-            asIScriptEngine * const new_engine = asCreateScriptEngine();
-            StringFactory  * const string_factory =
-                new StringFactory(new_engine);
-
-            register_success = AString::register_methods(*new_engine)
-                and register_success;
-            rc = new_engine->RegisterStringFactory("string", string_factory);
-
-            CScriptArray::SetMemoryFunctions(
-                memory::ThreadVirtualHeapManager::mem_alloc,
-                memory::ThreadVirtualHeapManager::mem_free);
-            RegisterScriptArray(new_engine, true);
+            asIScriptContext * const new_context =
+                engine_state.engine_ptr->RequestContext();
 
-            if (rc < 0)
+            if (not new_context)
             {
-                register_success = false;
                 LOG(error, "angelscript", "get_available_engine",
-                    "Failed to register string factory with AngelScript.  "
-                    "rc = " + text::to_string(rc));
+                    "Failed to get a context.");
             }
-
-            // Order is important here as there are dependencies!!
-            register_success = register_success and
-                AEntity::register_methods(*new_engine) and
-                OnlineStatEntry::register_methods(*new_engine) and
-                DatabaseOps::register_methods(*new_engine) and
-                InputOutputOps::register_methods(*new_engine) and
-                MovementOps::register_methods(*new_engine) and
-                SystemOps::register_methods(*new_engine);
-
-            asIScriptContext * const new_context = new_engine->RequestContext();
-
-            if (register_success and new_context)
+            else
             {
-                // Successfully created engine and context.  Save off and
-                // return.
-                //
-                engines_used.push_back(EngineContextState(
-                    new_engine,
-                    new_context,
-                    string_factory));
-
-                engine_ptr = new_engine;
+                ++engine_state.contexts_in_use;
+                engine_ptr = engine_state.engine_ptr;
                 context_ptr = new_context;
                 status = true;
             }
-            else
-            {
-                LOG(error, "angelscript", "get_available_engine",
-                    "Failed to create engine and context.");
-            }
         }
 
         return status;
     }
 
+    // ----------------------------------------------------------------------
+    bool AngelScriptAccess::create_engine(EngineState &engine_state)
+    {
+        // Start by registering all MUTGOS-specific classes with it.
+        // Give it an unlimited, separate heap so base registrations won't
+        // count against a running script.
+        //
+        const memory::MemHeapState current_heap =
+            memory::ThreadVirtualHeapManager::get_thread_heap_state();
+        const memory::MemHeapState create_engine_heap;
+        memory::ThreadVirtualHeapManager::set_thread_heap_state(
+            create_engine_heap);
+
+        int rc = 0;
+        bool register_success = true;
+        asIScriptEngine * const new_engine = asCreateScriptEngine();
+        StringFactory  * const string_factory =
+            new StringFactory(new_engine);
+
+        register_success = AString::register_methods(*new_engine)
+            and register_success;
+        rc = new_engine->RegisterStringFactory("string", string_factory);
+
+        CScriptArray::SetMemoryFunctions(
+            memory::ThreadVirtualHeapManager::mem_alloc,
+            memory::ThreadVirtualHeapManager::mem_free);
+        RegisterScriptArray(new_engine, true);
+
+        if (rc < 0)
+        {
+            register_success = false;
+            LOG(error, "angelscript", "create_engine",
+                "Failed to register string factory with AngelScript.  "
+                "rc = " + text::to_string(rc));
+        }
+
+        // Order is important here as there are dependencies!!
+        register_success = register_success and
+            AEntity::register_methods(*new_engine) and
+            OnlineStatEntry::register_methods(*new_engine) and
+            DatabaseOps::register_methods(*new_engine) and
+            InputOutputOps::register_methods(*new_engine) and
+            MovementOps::register_methods(*new_engine) and
+            SystemOps::register_methods(*new_engine);
+
+        if (register_success)
+        {
+            // Successfully created engine.  Save off.
+            //
+            engine_state.engine_ptr = new_engine;
+            engine_state.string_factory_ptr = string_factory;
+            engine_state.module_cache_ptr =
+                new ModuleCache(*new_engine, MODULE_CACHE_MAX_SIZE);
+            engine_state.contexts_in_use = 0;
+        }
+        else
+        {
+            LOG(error, "angelscript", "create_engine",
+                "Failed to create engine.");
+
+            new_engine->ShutDownAndRelease();
+            delete string_factory;
+        }
+
+        memory::ThreadVirtualHeapManager::set_thread_heap_state(current_heap);
+
+        return register_success;
+    }
+
     // ----------------------------------------------------------------------
     void AngelScriptAccess::return_used_engine(
         asIScriptEngine * const engine_ptr,
@@ -635,109 +880,75 @@ namespace angelscript
     {
         if (engine_ptr and context_ptr)
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
-
+            const memory::MemHeapState current_heap =
+                memory::ThreadVirtualHeapManager::get_thread_heap_state();
             const memory::MemHeapState delete_engine_heap;
             memory::ThreadVirtualHeapManager::set_thread_heap_state(
                 delete_engine_heap);
 
+            // Program modules are left loaded in the engine's module cache
+            // for the next process to use.
+            //
             context_ptr->Abort();
             context_ptr->Unprepare();
-            engine_ptr->DiscardModule(SCRIPT_MODULE_NAME.c_str());
-            engine_ptr->GarbageCollect();
 
-            // Remove from 'in use' and put in 'avail' if pool size is less
-            // than max.
-            //
-            if (engines_avail.size() > ENGINE_POOL_MAX_SIZE)
+            const boost::posix_time::ptime now =
+                boost::posix_time::microsec_clock::universal_time();
+            bool full_gc = false;
+
+            // Scope for lock
             {
-                // Enough engines are in the pool; free this one and
-                // remove from list.
-                //
-                engine_ptr->ReturnContext(context_ptr);
-                engine_ptr->ShutDownAndRelease();
+                boost::lock_guard<boost::mutex> guard(mutex);
+                bool found = false;
 
-                if (engines_used.empty())
-                {
-                    LOG(error, "angelscript", "return_used_engine",
-                        "No used engines stored!");
-                }
-                else
+                for (size_t index = 0;
+                     (index < engines.size()) and (not found);
+                     ++index)
                 {
-                    for (size_t used_index = 0;
-                         used_index < engines_used.size();
-                         ++used_index)
+                    EngineState &engine_state = engines[index];
+
+                    if (engine_state.engine_ptr == engine_ptr)
                     {
-                        if (engines_used[used_index].engine_ptr == engine_ptr)
-                        {
-                            // Found it!  Delete string factory and remove.
-                            //
-                            delete engines_used[used_index].string_factory_ptr;
+                        found = true;
+                        engine_ptr->ReturnContext(context_ptr);
 
-                            if (used_index == (engines_used.size() - 1))
-                            {
-                                // Last one, just pop it.
-                                engines_used.pop_back();
-                            }
-                            else
-                            {
-                                // Shift the last one on top of this one for
-                                // a more efficient delete.
-                                //
-                                engines_used[used_index] = engines_used.back();
-                                engines_used.pop_back();
-                            }
+                        if (engine_state.contexts_in_use)
+                        {
+                            --engine_state.contexts_in_use;
+                        }
 
-                            break;
+                        // Claim the next full cycle, so only this thread
+                        // does it.
+                        //
+                        if (engine_state.last_full_gc_time.is_not_a_date_time())
+                        {
+                            engine_state.last_full_gc_time = now;
+                        }
+                        else if ((now - engine_state.last_full_gc_time) >=
+                            FULL_GC_INTERVAL)
+                        {
+                            engine_state.last_full_gc_time = now;
+                            full_gc = true;
                         }
                     }
                 }
-            }
-            else
-            {
-                // Keep this engine for future reuse.  Find it from the
-                // array of used engines and put it back in available engines.
-                //
-                if (engines_used.empty())
+
+                if (not found)
                 {
                     LOG(error, "angelscript", "return_used_engine",
-                        "No used engines stored!  Deleting this engine.");
-
-                    engine_ptr->ReturnContext(context_ptr);
-                    engine_ptr->ShutDownAndRelease();
+                        "Engine not found!  Cannot return context.");
                 }
-                else
-                {
-                    for (size_t used_index = 0;
-                         used_index < engines_used.size();
-                         ++used_index)
-                    {
-                        if (engines_used[used_index].engine_ptr == engine_ptr)
-                        {
-                            // Found it!  Move into available engines and
-                            // remove from used engines.
-                            //
-                            engines_avail.push_back(engines_used[used_index]);
+            }
 
-                            if (used_index == (engines_used.size() - 1))
-                            {
-                                // Last one, just pop it.
-                                engines_used.pop_back();
-                            }
-                            else
-                            {
-                                // Shift the last one on top of this one for
-                                // a more efficient delete.
-                                //
-                                engines_used[used_index] = engines_used.back();
-                                engines_used.pop_back();
-                            }
+            // Other scripts are using the engine, so a full cycle could take
+            // a while.  Do an incremental step instead, except for a full
+            // cycle every FULL_GC_INTERVAL to get anything the steps missed.
+            //
+            engine_ptr->GarbageCollect(
+                full_gc ? asGC_FULL_CYCLE : asGC_ONE_STEP);
 
-                            break;
-                        }
-                    }
-                }
-            }
+            memory::ThreadVirtualHeapManager::set_thread_heap_state(
+                current_heap);
         }
         else
         {
@@ -763,5 +974,139 @@ namespace angelscript
                 + text::to_string(line));
         }
     }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::next_program_generation(
+        const dbtype::Id &program_id)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        ++program_generations[program_id];
+        program_bytecodes.erase(program_id);
+    }
+
+    // ----------------------------------------------------------------------
+    bool AngelScriptAccess::get_stored_bytecode(
+        const dbtype::Id &program_id,
+        const MG_UnsignedInt generation,
+        const bool want_bytecode,
+        char *&bytecode_ptr,
+        size_t &bytecode_size)
+    {
+        bool found = false;
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        ProgramBytecodes::const_iterator bytecode_iter =
+            program_bytecodes.find(program_id);
+
+        if ((bytecode_iter != program_bytecodes.end()) and
+            (bytecode_iter->second.generation == generation))
+        {
+            found = true;
+
+            if (want_bytecode)
+            {
+                const std::string &bytecode = bytecode_iter->second.bytecode;
+
+                bytecode_ptr = new char[bytecode.size()];
+                bytecode_size = bytecode.size();
+                memcpy(bytecode_ptr, bytecode.data(), bytecode.size());
+            }
+        }
+
+        return found;
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::store_bytecode(
+        const dbtype::Id &program_id,
+        const MG_UnsignedInt generation,
+        const char * const bytecode_ptr,
+        const size_t bytecode_size)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+        ProgramGenerations::const_iterator generation_iter =
+            program_generations.find(program_id);
+        const MG_UnsignedInt current_generation =
+            (generation_iter == program_generations.end()) ?
+                0 : generation_iter->second;
+
+        if (generation == current_generation)
+        {
+            StoredBytecode &stored = program_bytecodes[program_id];
+
+            stored.generation = generation;
+            stored.bytecode.assign(bytecode_ptr, bytecode_size);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::forget_program(const dbtype::Id &program_id)
+    {
+        std::vector<ModuleCache *> module_caches;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            program_generations.erase(program_id);
+            program_bytecodes.erase(program_id);
+
+            for (size_t index = 0; index < engines.size(); ++index)
+            {
+                if (engines[index].module_cache_ptr)
+                {
+                    module_caches.push_back(engines[index].module_cache_ptr);
+                }
+            }
+        }
+
+        // A module left cached would otherwise be used if the ID is reused
+        // by a new Program, since its generation starts over.  Discarding
+        // takes the build lock, which must not be taken under ours.
+        //
+        for (size_t index = 0; index < module_caches.size(); ++index)
+        {
+            module_caches[index]->discard_program(program_id);
+        }
+
+        executor::ExecutorAccess::instance()->forget_program_times(program_id);
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::subscribe(void)
+    {
+        if (not program_deletion_subscription_id)
+        {
+            events::EntityChangedSubscriptionParams entity_sub;
+
+            entity_sub.add_entity_action(
+                events::EntityChangedEvent::ENTITY_DELETED);
+            entity_sub.add_entity_type(dbtype::ENTITYTYPE_program);
+
+            program_deletion_subscription_id =
+                events::EventAccess::instance()->subscribe(
+                    entity_sub,
+                    events::SubscriptionCallback(this));
+
+            if (not program_deletion_subscription_id)
+            {
+                LOG(error, "angelscript", "subscribe",
+                    "Could not subscribe to Program deletions!");
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void AngelScriptAccess::unsubscribe(void)
+    {
+        if (program_deletion_subscription_id)
+        {
+            events::EventAccess::instance()->unsubscribe(
+                program_deletion_subscription_id);
+
+            program_deletion_subscription_id = 0;
+        }
+    }
+}
 }
-}
\ No newline at end of file
@@ -9,10 +9,17 @@
 #include <map>
 #include <angelscript.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
 #include "dbinterface/dbinterface_EntityRef.h"
 
+#include "events/events_EventListener.h"
+#include "events/events_CommonTypes.h"
+
 #include "angelscript_StringFactory.h"
+#include "angelscript_CompileService.h"
 
 #include "softcode/softcode_Interpreter.h"
 
@@ -27,13 +34,28 @@ namespace events
 
 namespace angelscript
 {
+    // Forward declarations
+    //
+    class ModuleCache;
+
     /**
      * Provides methods to start and manage AngelScript processes, scripts,
      * and the AngelScript engines and contexts.
+     * A few engines, each with everything MUTGOS-specific registered, are
+     * shared by all scripts.  Each running script only gets its own
+     * (lightweight) context, and is charged for its memory through the
+     * virtual heap of the thread running it.
+     * Programs are compiled in the background (see CompileService) at
+     * startup and after being edited.  Their bytecode is kept here, by
+     * program and generation, rather than in the Program Entity, and
+     * forgotten when the Program is deleted.  It is also saved in the
+     * database (apart from the Program Entity) keyed by the source, so a
+     * restart only recompiles Programs whose saved bytecode no longer loads.
      * Also implements the Interpreter interface which allows the Softcode
      * module to launch AngelScript processes.
      */
-    class AngelScriptAccess : public softcode::Interpreter
+    class AngelScriptAccess
+        : public softcode::Interpreter, public events::EventListener
     {
     public:
         /**
@@ -131,17 +153,17 @@ namespace angelscript
         virtual bool uncompile(const dbtype::Id &program_id);
 
         /**
-         * Returns the given engine and context to the pool for reuse or
-         * destruction.
-         * @param engine[in] The engine being returned.
-         * @param context[in] The associated context being returned.
+         * Returns the given context to its engine for reuse.
+         * @param engine[in] The engine the context came from.
+         * @param context[in] The context being returned.
          */
         void release_engine_context(
             asIScriptEngine * const engine,
             asIScriptContext * const context);
 
         /**
-         * Removes the compiled (binary) script data.
+         * Removes the compiled (binary) script data, and queues the program
+         * to be compiled again in the background.
          * @param program_ref[in] The program Entity to remove the compiled
          * data from.
          * @return True if Entity passed in is a program, is an AngelScript,
@@ -150,8 +172,8 @@ namespace angelscript
         bool uncompile_script(dbinterface::EntityRef &program_ref);
 
         /**
-         * Compiles the given script if not already compiled.  If the script
-         * is already compiled, the existing copy of the bytecode will be
+         * Compiles the given script if there is no bytecode for its current
+         * generation.  If there is, the existing copy of the bytecode will be
          * returned if specified.
          * @param program_ref[in] The program Entity to compile.
          * @param engine[in] The configured engine that will be doing the
@@ -178,43 +200,64 @@ namespace angelscript
             char *&bytecode_ptr,
             size_t &bytecode_size);
 
+        /**
+         * Gets the generation of a program's bytecode, which changes every
+         * time the program is uncompiled (its source has changed).  Used to
+         * tell if bytecode, or a module loaded from it, is out of date.
+         * To avoid labelling old bytecode with a new generation, get the
+         * generation before getting the bytecode.
+         * @param program_id[in] The program to get the generation of.
+         * @return The generation of the program's bytecode.
+         */
+        MG_UnsignedInt get_program_generation(const dbtype::Id &program_id);
+
+        /**
+         * @return Statistics about the programs compiled in the background.
+         */
+        CompileStats get_compile_stats(void);
+
+        /**
+         * Called when a Program is deleted, to forget its bytecode.
+         * @param id[in] The subscription ID that matched.
+         * @param event[in] The event that matched.
+         */
+        virtual void subscribed_event_matched(
+            const events::SubscriptionId id,
+            events::Event &event);
+
+        /**
+         * Called when a subscription is deleted by the infrastructure.
+         * This should never happen, so it logs and resubscribes.
+         * @param ids_deleted[in] The subscription IDs being deleted.
+         */
+        virtual void subscription_deleted(
+            const events::SubscriptionIdList &ids_deleted);
+
     private:
 
         /**
-         * Simple container class to hold an engine and its associated context.
+         * Simple container class to hold a shared engine and what goes
+         * with it.
          */
-        class EngineContextState
+        class EngineState
         {
         public:
             /**
              * Default constructor to initialize everything.
              */
-            EngineContextState(void)
+            EngineState(void)
               : engine_ptr(0),
-                context_ptr(0),
-                string_factory_ptr(0)
-            {
-            }
-
-            /**
-             * Constructor that sets all attributes.
-             * @param engine[in] Engine pointer.
-             * @param context[in] Context pointer.
-             * @param string_factory[in] Pointer to engine's string factory.
-             */
-            EngineContextState(
-                asIScriptEngine * const engine,
-                asIScriptContext * const context,
-                StringFactory * const string_factory)
-                : engine_ptr(engine),
-                  context_ptr(context),
-                  string_factory_ptr(string_factory)
+                string_factory_ptr(0),
+                module_cache_ptr(0),
+                contexts_in_use(0)
             {
             }
 
-            asIScriptEngine *engine_ptr; ///< The AngelScript engine.
-            asIScriptContext *context_ptr; ///< The AngelScript context associated with the engine.
+            asIScriptEngine *engine_ptr; ///< The AngelScript engine, or null if not yet created.
             StringFactory *string_factory_ptr; ///< The associated string factory for the engine
+            ModuleCache *module_cache_ptr; ///< The loaded program modules for the engine
+            size_t contexts_in_use; ///< How many contexts have been handed out and not returned
+            boost::posix_time::ptime last_full_gc_time; ///< When the last full garbage collection cycle was done
         };
 
         /**
@@ -252,7 +295,23 @@ namespace angelscript
         };
 
 
-        typedef std::vector<EngineContextState> Engines;
+        /**
+         * The bytecode of a program, and the generation it was compiled
+         * from.
+         */
+        struct StoredBytecode
+        {
+            StoredBytecode(void)
+              : generation(0)
+            { }
+
+            MG_UnsignedInt generation; ///< Generation compiled from
+            std::string bytecode; ///< The bytecode
+        };
+
+        typedef std::vector<EngineState> Engines;
+        typedef std::map<dbtype::Id, MG_UnsignedInt> ProgramGenerations;
+        typedef std::map<dbtype::Id, StoredBytecode> ProgramBytecodes;
 
         /**
          * Private singleton constructor.
@@ -266,27 +325,38 @@ namespace angelscript
 
 
         /**
-         * Finds the next available (unused) engine, marks it in use, and
-         * returns the engine info to the caller.
-         * @param engine_ptr[out] The pointer to the newly reserved engine.
-         * Do not delete this pointer!
+         * Picks the shared engine a program runs on, creating it if needed,
+         * and gets a context from it.  A program always runs on the same
+         * engine, so its module stays cached there.
+         * @param program_id[in] The program that will be run or compiled.
+         * @param engine_ptr[out] The pointer to the engine.  Do not delete
+         * this pointer!
          * @param context_ptr[out] The pointer to the newly reserved engine
          * context.  Do not delete this pointer!
-         * @return True if successfully returned an available engine, or false
-         * if no engines available and creation is impossible.
+         * @return True if successfully returned an engine and context, or
+         * false if the engine could not be created.
          */
         bool get_available_engine(
+            const dbtype::Id &program_id,
             asIScriptEngine *&engine_ptr,
             asIScriptContext *&context_ptr);
 
         /**
-         * Prepares the given engine and context for reuse and puts it back in
-         * the pool of available engines or deletes it if too many are
-         * available.
-         * @param engine_ptr[in] The engine being returned.  After this call
+         * Creates an engine and registers all MUTGOS-specific classes with
+         * it.  Lock must be held.
+         * @param engine_state[out] Where to put the new engine and what
+         * goes with it.
+         * @return True if success.
+         */
+        bool create_engine(EngineState &engine_state);
+
+        /**
+         * Prepares the given context for reuse and returns it to its engine.
+         * The engine stays up for other scripts.  Garbage is collected a
+         * step at a time, with a full cycle at most once a minute.
+         * @param engine_ptr[in] The engine the context came from.
+         * @param context_ptr[in] The context being returned.  After this call
          * returns, the pointer cannot be used.
-         * @param context_ptr[in] The associated context being returned.
-         * After this call returns, the pointer cannot be used.
          */
         void return_used_engine(
             asIScriptEngine * const engine_ptr,
@@ -305,6 +375,67 @@ namespace angelscript
             const size_t line,
             bool &current_result);
 
+        /**
+         * Moves a program to its next bytecode generation and removes its
+         * bytecode, so modules loaded from the old bytecode are no longer
+         * used.  Call whenever the source code changes.
+         * @param program_id[in] The program whose source changed.
+         */
+        void next_program_generation(const dbtype::Id &program_id);
+
+        /**
+         * Gets a copy of a program's bytecode, if it has been compiled from
+         * the given generation.
+         * @param program_id[in] The program to get the bytecode of.
+         * @param generation[in] The generation the bytecode must be from.
+         * @param want_bytecode[in] True to copy the bytecode.  If false,
+         * only checks if there is any.
+         * @param bytecode_ptr[out] If want_bytecode is true, a copy of the
+         * bytecode.  Caller must manage the pointer!
+         * @param bytecode_size[out] The size of the data pointed to by
+         * bytecode_ptr.
+         * @return True if there is bytecode for the generation.
+         */
+        bool get_stored_bytecode(
+            const dbtype::Id &program_id,
+            const MG_UnsignedInt generation,
+            const bool want_bytecode,
+            char *&bytecode_ptr,
+            size_t &bytecode_size);
+
+        /**
+         * Keeps a program's bytecode, unless the program has moved on to
+         * a newer generation while it was compiling.
+         * @param program_id[in] The program compiled.
+         * @param generation[in] The generation compiled from.
+         * @param bytecode_ptr[in] The bytecode.  It will be copied.
+         * @param bytecode_size[in] The size of bytecode_ptr.
+         */
+        void store_bytecode(
+            const dbtype::Id &program_id,
+            const MG_UnsignedInt generation,
+            const char * const bytecode_ptr,
+            const size_t bytecode_size);
+
+        /**
+         * Removes everything kept about a deleted program: its generation,
+         * bytecode, any cached modules, and its execution time statistics.
+         * Its ID may be reused.
+         * Lock must not be held.
+         * @param program_id[in] The program deleted.
+         */
+        void forget_program(const dbtype::Id &program_id);
+
+        /**
+         * Subscribes to Program deletions, if not already subscribed.
+         */
+        void subscribe(void);
+
+        /**
+         * Unsubscribes to events that were subscribed to in subscribe().
+         */
+        void unsubscribe(void);
+
         // No copying
         //
         AngelScriptAccess &operator=(const AngelScriptAccess &rhs);
@@ -313,8 +444,11 @@ namespace angelscript
         static AngelScriptAccess *singleton_ptr; ///< Singleton pointer
 
         boost::mutex mutex; ///< Enforces single access at a time.
-        Engines engines_avail; ///< AngelScript engines that are available for use
-        Engines engines_used; ///< AngelScript engines that are currently in use
+        Engines engines; ///< The shared AngelScript engines
+        ProgramGenerations program_generations; ///< Bytecode generation of programs that have changed
+        ProgramBytecodes program_bytecodes; ///< Compiled programs
+        CompileService *compile_service_ptr; ///< Compiles in the background
+        events::SubscriptionId program_deletion_subscription_id; ///< Subscription to watch for deleted Programs
     };
 }
 }
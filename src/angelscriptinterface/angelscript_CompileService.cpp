@@ -0,0 +1,334 @@
+/*
+ * angelscript_CompileService.cpp
+ */
+
+#include <string>
+#include <deque>
+#include <set>
+#include <angelscript.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbinterface/dbinterface_EntityRef.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+
+#include "utilities/memory_ThreadVirtualHeapManager.h"
+#include "utilities/memory_MemHeapState.h"
+
+#include "angelscript_AngelScriptAccess.h"
+#include "angelscript_CompileService.h"
+
+namespace mutgos
+{
+namespace angelscript
+{
+    // ----------------------------------------------------------------------
+    CompileService::CompileService(AngelScriptAccess &access)
+      : angelscript_access(access),
+        thread_ptr(0),
+        shutdown_flag(false)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    CompileService::~CompileService()
+    {
+        shutdown();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::operator()()
+    {
+        thread_main();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::startup(void)
+    {
+        if (not thread_ptr)
+        {
+            LOG(info, "angelscript", "startup",
+                "Starting background compiles...");
+
+            // Scope for lock
+            {
+                boost::lock_guard<boost::mutex> guard(mutex);
+                shutdown_flag = false;
+            }
+
+            thread_ptr = new boost::thread(boost::ref(*this));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::shutdown(void)
+    {
+        if (thread_ptr)
+        {
+            LOG(info, "angelscript", "shutdown",
+                "Stopping background compiles...");
+
+            // Scope for lock
+            {
+                // Set while locked so the thread cannot miss the wakeup.
+                //
+                boost::lock_guard<boost::mutex> guard(mutex);
+                shutdown_flag = true;
+            }
+
+            queue_condition.notify_one();
+
+            thread_ptr->join();
+            delete thread_ptr;
+            thread_ptr = 0;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::queue_program(const dbtype::Id &program_id)
+    {
+        bool queued = false;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            if (queued_programs.insert(program_id).second)
+            {
+                program_queue.push_back(program_id);
+                queued = true;
+            }
+        }
+
+        if (queued)
+        {
+            queue_condition.notify_one();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    CompileStats CompileService::get_stats(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+        CompileStats current_stats = stats;
+
+        current_stats.programs_pending = program_queue.size();
+        current_stats.failed_programs.assign(
+            failed_programs.begin(),
+            failed_programs.end());
+
+        return current_stats;
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::thread_main(void)
+    {
+        bool do_shutdown = false;
+        dbtype::Id program_id;
+
+        memory::ThreadVirtualHeapManager::add_thread();
+
+        queue_all_programs();
+
+        while (not do_shutdown)
+        {
+            // Scope for lock
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+
+                while (program_queue.empty() and (not shutdown_flag))
+                {
+                    queue_condition.wait(lock);
+                }
+
+                do_shutdown = shutdown_flag;
+
+                if (not do_shutdown)
+                {
+                    program_id = program_queue.front();
+                    program_queue.pop_front();
+                    queued_programs.erase(program_id);
+                }
+            }
+
+            if (not do_shutdown)
+            {
+                bool compiled = false;
+                const boost::posix_time::ptime start_time =
+                    boost::posix_time::microsec_clock::universal_time();
+                const bool success = compile_program(program_id, compiled);
+                const MG_LongUnsignedInt compile_us =
+                    (boost::posix_time::microsec_clock::universal_time() -
+                        start_time).total_microseconds();
+
+                boost::lock_guard<boost::mutex> guard(mutex);
+
+                if (compiled)
+                {
+                    if (success)
+                    {
+                        ++stats.programs_compiled;
+                        ++batch_stats.programs_compiled;
+                        failed_programs.erase(program_id);
+                    }
+                    else
+                    {
+                        ++stats.programs_failed;
+                        ++batch_stats.programs_failed;
+                        batch_stats.failed_programs.push_back(program_id);
+                        failed_programs.insert(program_id);
+                    }
+
+                    stats.total_compile_us += compile_us;
+                    batch_stats.total_compile_us += compile_us;
+
+                    if (compile_us > stats.max_compile_us)
+                    {
+                        stats.max_compile_us = compile_us;
+                        stats.max_compile_program = program_id;
+                    }
+
+                    if (compile_us > batch_stats.max_compile_us)
+                    {
+                        batch_stats.max_compile_us = compile_us;
+                        batch_stats.max_compile_program = program_id;
+                    }
+                }
+
+                if (program_queue.empty())
+                {
+                    report_batch();
+                }
+            }
+        }
+
+        memory::ThreadVirtualHeapManager::delete_thread();
+        asThreadCleanup();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::queue_all_programs(void)
+    {
+        dbinterface::DatabaseAccess * const db_ptr =
+            dbinterface::DatabaseAccess::instance();
+        const dbtype::Id::SiteIdVector site_ids = db_ptr->get_all_site_ids();
+        bool stopping = false;
+        size_t program_count = 0;
+
+        for (dbtype::Id::SiteIdVector::const_iterator site_iter =
+                site_ids.begin();
+            (site_iter != site_ids.end()) and (not stopping);
+            ++site_iter)
+        {
+            const dbtype::Entity::IdVector program_ids =
+                db_ptr->find(*site_iter, dbtype::ENTITYTYPE_program);
+
+            for (dbtype::Entity::IdVector::const_iterator program_iter =
+                    program_ids.begin();
+                program_iter != program_ids.end();
+                ++program_iter)
+            {
+                queue_program(*program_iter);
+                ++program_count;
+            }
+
+            boost::lock_guard<boost::mutex> guard(mutex);
+            stopping = shutdown_flag;
+        }
+
+        LOG(info, "angelscript", "queue_all_programs",
+            "Queued " + text::to_string(program_count)
+            + " programs to compile.");
+    }
+
+    // ----------------------------------------------------------------------
+    bool CompileService::compile_program(
+        const dbtype::Id &program_id,
+        bool &compiled)
+    {
+        bool success = true;
+        dbinterface::EntityRef program_ref =
+            dbinterface::DatabaseAccess::instance()->get_entity(program_id);
+        dbtype::Program * const program_ptr = program_ref.valid() ?
+            dynamic_cast<dbtype::Program *>(program_ref.get())
+            : 0;
+
+        compiled = false;
+
+        // Programs in other languages, deleted, or with no source yet are
+        // skipped.
+        //
+        if (program_ptr and
+            (program_ptr->get_program_language() ==
+                angelscript_access.get_language_name()) and
+            program_ptr->get_source_code().get_number_lines())
+        {
+            const memory::MemHeapState compile_heap;
+            memory::ThreadVirtualHeapManager::set_thread_heap_state(
+                compile_heap);
+
+            compiled = true;
+            success = angelscript_access.compile(program_id, 0);
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void CompileService::report_batch(void)
+    {
+        const MG_LongUnsignedInt batch_size =
+            batch_stats.programs_compiled + batch_stats.programs_failed;
+
+        if (batch_size)
+        {
+            LOG(info, "angelscript", "report_batch",
+                "Compiled " + text::to_string(batch_size)
+                + " programs in "
+                + text::to_string(batch_stats.total_compile_us / 1000)
+                + " ms.  Slowest was "
+                + batch_stats.max_compile_program.to_string(true)
+                + " at "
+                + text::to_string(batch_stats.max_compile_us / 1000)
+                + " ms.");
+
+            if (batch_stats.programs_failed)
+            {
+                std::string failed_list;
+
+                for (dbtype::Entity::IdVector::const_iterator failed_iter =
+                        batch_stats.failed_programs.begin();
+                    failed_iter != batch_stats.failed_programs.end();
+                    ++failed_iter)
+                {
+                    if (not failed_list.empty())
+                    {
+                        failed_list += ", ";
+                    }
+
+                    failed_list += failed_iter->to_string(true);
+                }
+
+                LOG(warning, "angelscript", "report_batch",
+                    text::to_string(batch_stats.programs_failed)
+                    + " programs failed to compile: " + failed_list);
+            }
+        }
+
+        batch_stats = CompileStats();
+    }
+}
+}
@@ -0,0 +1,160 @@
+/*
+ * angelscript_CompileService.h
+ */
+
+#ifndef MUTGOS_ANGELSCRIPT_COMPILESERVICE_H
+#define MUTGOS_ANGELSCRIPT_COMPILESERVICE_H
+
+#include <deque>
+#include <set>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_Entity.h"
+
+namespace mutgos
+{
+namespace angelscript
+{
+    // Forward declarations
+    //
+    class AngelScriptAccess;
+
+    /**
+     * Statistics about the programs compiled in the background.
+     */
+    struct CompileStats
+    {
+        CompileStats(void)
+          : programs_compiled(0),
+            programs_failed(0),
+            total_compile_us(0),
+            max_compile_us(0),
+            programs_pending(0)
+        { }
+
+        MG_LongUnsignedInt programs_compiled; ///< Compiles that succeeded
+        MG_LongUnsignedInt programs_failed; ///< Compiles that failed
+        MG_LongUnsignedInt total_compile_us; ///< Sum of compile times, in us
+        MG_LongUnsignedInt max_compile_us; ///< Longest compile, in us
+        dbtype::Id max_compile_program; ///< The program that took longest
+        MG_LongUnsignedInt programs_pending; ///< Programs waiting to compile
+        /** Programs whose latest compile failed, in ID order */
+        dbtype::Entity::IdVector failed_programs;
+    };
+
+    /**
+     * Compiles AngelScript programs on a thread of its own, so the first
+     * user to run a program after startup or after it has been edited does
+     * not have to wait for it to compile.  At startup it compiles every
+     * AngelScript program that has source code.  After that, it compiles
+     * programs as they are queued, which happens when they are uncompiled.
+     *
+     * The bytecode is kept by AngelScriptAccess, which also compiles on the
+     * spot anything run before the service gets to it.
+     *
+     * Compiler messages are logged as usual.  Once the queue empties, one
+     * summary of how many programs were compiled, how long it took, and
+     * which ones failed is logged for the whole batch.
+     *
+     * This class is thread safe.
+     */
+    class CompileService
+    {
+    public:
+        /**
+         * Constructor.
+         * @param access[in] What does the compiling.  It must outlive this
+         * class.
+         */
+        CompileService(AngelScriptAccess &access);
+
+        /**
+         * Destructor.  Calls shutdown() if needed.
+         */
+        ~CompileService();
+
+        /**
+         * Used by Boost threads to start our threaded code.
+         */
+        void operator()();
+
+        /**
+         * Starts the thread, which queues every AngelScript program in the
+         * database before compiling them.
+         */
+        void startup(void);
+
+        /**
+         * Stops the thread.  Programs still queued are left for
+         * AngelScriptAccess to compile when they are run.
+         */
+        void shutdown(void);
+
+        /**
+         * Queues a program to be compiled.  Does nothing if it is already
+         * queued.
+         * @param program_id[in] The program to compile.
+         */
+        void queue_program(const dbtype::Id &program_id);
+
+        /**
+         * @return Statistics about everything compiled so far.
+         */
+        CompileStats get_stats(void);
+
+        /**
+         * Main loop of the compile thread.
+         */
+        void thread_main(void);
+
+    private:
+        typedef std::deque<dbtype::Id> ProgramQueue;
+        typedef std::set<dbtype::Id> ProgramSet;
+
+        /**
+         * Queues every AngelScript program with source code in the
+         * database.  Stops early if shutting down.
+         */
+        void queue_all_programs(void);
+
+        /**
+         * Checks that a program is still an AngelScript program with source
+         * code, and if so compiles it.
+         * @param program_id[in] The program to compile.
+         * @param compiled[out] True if a compile was attempted.
+         * @return True if compiled, or if there was nothing to compile.
+         */
+        bool compile_program(const dbtype::Id &program_id, bool &compiled);
+
+        /**
+         * Logs a summary of the batch just finished, and starts a new one.
+         * Lock must be held.
+         */
+        void report_batch(void);
+
+        // No copying
+        //
+        CompileService &operator=(const CompileService &rhs);
+        CompileService(const CompileService &rhs);
+
+        AngelScriptAccess &angelscript_access; ///< Does the compiling
+        boost::thread *thread_ptr; ///< The compile thread, or null if stopped
+
+        boost::mutex mutex; ///< Lock for everything below
+        boost::condition_variable queue_condition; ///< Signals queue or shutdown
+        bool shutdown_flag; ///< True if the thread should stop
+        ProgramQueue program_queue; ///< Programs waiting to compile, in order
+        ProgramSet queued_programs; ///< Programs in program_queue
+        ProgramSet failed_programs; ///< Programs whose latest compile failed
+        CompileStats stats; ///< Everything compiled since startup
+        CompileStats batch_stats; ///< Everything compiled since the last report
+    };
+}
+}
+
+#endif //MUTGOS_ANGELSCRIPT_COMPILESERVICE_H
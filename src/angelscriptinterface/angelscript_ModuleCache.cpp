@@ -0,0 +1,254 @@
+/*
+ * angelscript_ModuleCache.cpp
+ */
+
+#include <stddef.h>
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <angelscript.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
+#include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+
+#include "angelscript_ModuleCache.h"
+
+namespace
+{
+    /** Engine user data type the cache is attached with */
+    const asPWORD MUTGOS_USER_DATA_MODULE_CACHE_TYPE = 2;
+    const std::string MODULE_NAME_PREFIX = "mutgos_cached_";
+}
+
+namespace mutgos
+{
+namespace angelscript
+{
+    // ----------------------------------------------------------------------
+    ModuleCache::ModuleCache(
+        asIScriptEngine &engine_ref,
+        const size_t max_modules)
+      : engine(engine_ref),
+        max_size(max_modules ? max_modules : 1),
+        next_module_number(0),
+        hits(0),
+        misses(0)
+    {
+        engine.SetUserData(this, MUTGOS_USER_DATA_MODULE_CACHE_TYPE);
+    }
+
+    // ----------------------------------------------------------------------
+    ModuleCache::~ModuleCache()
+    {
+        engine.SetUserData(0, MUTGOS_USER_DATA_MODULE_CACHE_TYPE);
+    }
+
+    // ----------------------------------------------------------------------
+    ModuleCache *ModuleCache::get_module_cache(asIScriptEngine *const engine)
+    {
+        ModuleCache *cache_ptr = 0;
+
+        if (not engine)
+        {
+            LOG(error, "angelscript", "get_module_cache",
+                "Provided engine is null!");
+        }
+        else
+        {
+            cache_ptr = reinterpret_cast<ModuleCache *>(
+                engine->GetUserData(MUTGOS_USER_DATA_MODULE_CACHE_TYPE));
+        }
+
+        return cache_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    asIScriptModule *ModuleCache::take_module(
+        const dbtype::Id &program_id,
+        const MG_UnsignedInt generation)
+    {
+        asIScriptModule *module_ptr = 0;
+        Modules stale_modules;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(cache_lock);
+            ModuleMap::iterator module_iter = module_map.find(program_id);
+
+            if (module_iter != module_map.end())
+            {
+                if (module_iter->second->generation != generation)
+                {
+                    // Program has changed since it was loaded.
+                    stale_modules.push_back(module_iter->second->module_ptr);
+                }
+                else
+                {
+                    module_ptr = module_iter->second->module_ptr;
+                }
+
+                module_list.erase(module_iter->second);
+                module_map.erase(module_iter);
+            }
+
+            if (module_ptr)
+            {
+                ++hits;
+            }
+            else
+            {
+                ++misses;
+            }
+        }
+
+        discard_modules(stale_modules);
+
+        return module_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    asIScriptModule *ModuleCache::make_module(void)
+    {
+        std::string module_name = MODULE_NAME_PREFIX;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(cache_lock);
+            module_name += text::to_string(next_module_number++);
+        }
+
+        asIScriptModule * const module_ptr = engine.GetModule(
+            module_name.c_str(),
+            asGM_ALWAYS_CREATE);
+
+        if (not module_ptr)
+        {
+            LOG(error, "angelscript", "make_module",
+                "Could not create module " + module_name);
+        }
+
+        return module_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void ModuleCache::return_module(
+        const dbtype::Id &program_id,
+        const MG_UnsignedInt generation,
+        asIScriptModule *const module_ptr)
+    {
+        Modules discarded_modules;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(cache_lock);
+            ModuleMap::iterator module_iter = module_map.find(program_id);
+
+            if (module_iter == module_map.end())
+            {
+                module_list.push_front(
+                    CachedModule(program_id, generation, module_ptr));
+                module_map[program_id] = module_list.begin();
+            }
+            else if (module_iter->second->generation >= generation)
+            {
+                // Another run of the program got back first, with bytecode
+                // at least as new.
+                discarded_modules.push_back(module_ptr);
+            }
+            else
+            {
+                discarded_modules.push_back(module_iter->second->module_ptr);
+                module_iter->second->generation = generation;
+                module_iter->second->module_ptr = module_ptr;
+                module_list.splice(
+                    module_list.begin(),
+                    module_list,
+                    module_iter->second);
+            }
+
+            while (module_map.size() > max_size)
+            {
+                discarded_modules.push_back(module_list.back().module_ptr);
+                module_map.erase(module_list.back().program_id);
+                module_list.pop_back();
+            }
+        }
+
+        discard_modules(discarded_modules);
+    }
+
+    // ----------------------------------------------------------------------
+    void ModuleCache::discard_module(asIScriptModule *const module_ptr)
+    {
+        if (module_ptr)
+        {
+            boost::lock_guard<boost::mutex> guard(build_lock);
+            module_ptr->Discard();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void ModuleCache::discard_program(const dbtype::Id &program_id)
+    {
+        Modules discarded_modules;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(cache_lock);
+            ModuleMap::iterator module_iter = module_map.find(program_id);
+
+            if (module_iter != module_map.end())
+            {
+                discarded_modules.push_back(module_iter->second->module_ptr);
+                module_list.erase(module_iter->second);
+                module_map.erase(module_iter);
+            }
+        }
+
+        discard_modules(discarded_modules);
+    }
+
+    // ----------------------------------------------------------------------
+    size_t ModuleCache::size(void)
+    {
+        boost::lock_guard<boost::mutex> guard(cache_lock);
+        return module_map.size();
+    }
+
+    // ----------------------------------------------------------------------
+    MG_LongUnsignedInt ModuleCache::get_hits(void)
+    {
+        boost::lock_guard<boost::mutex> guard(cache_lock);
+        return hits;
+    }
+
+    // ----------------------------------------------------------------------
+    MG_LongUnsignedInt ModuleCache::get_misses(void)
+    {
+        boost::lock_guard<boost::mutex> guard(cache_lock);
+        return misses;
+    }
+
+    // ----------------------------------------------------------------------
+    void ModuleCache::discard_modules(const Modules &modules)
+    {
+        if (not modules.empty())
+        {
+            boost::lock_guard<boost::mutex> guard(build_lock);
+
+            for (Modules::const_iterator module_iter = modules.begin();
+                module_iter != modules.end();
+                ++module_iter)
+            {
+                (*module_iter)->Discard();
+            }
+        }
+    }
+}
+}
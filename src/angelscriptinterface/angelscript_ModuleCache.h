@@ -0,0 +1,188 @@
+/*
+ * angelscript_ModuleCache.h
+ */
+
+#ifndef MUTGOS_ANGELSCRIPT_MODULECACHE_H
+#define MUTGOS_ANGELSCRIPT_MODULECACHE_H
+
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <vector>
+#include <angelscript.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
+
+namespace mutgos
+{
+namespace angelscript
+{
+    /**
+     * Keeps the modules of recently run programs loaded in an engine, so
+     * running the same program again does not have to load its bytecode.
+     *
+     * Each program is cached along with the generation of its bytecode
+     * (see AngelScriptAccess::get_program_generation()).  A module whose
+     * generation is out of date is discarded rather than returned.  When
+     * the cache is full, the least recently used module is discarded.
+     *
+     * An engine runs many scripts at once, and a module's globals can't be
+     * shared between two runs of a program.  A process therefore takes
+     * the module out of the cache while it runs, and returns it when done.
+     * If the program is run again in the meantime, a second module is
+     * loaded for it.
+     *
+     * There is one cache per engine, attached to the engine as user data.
+     * This class is thread safe.
+     */
+    class ModuleCache
+    {
+    public:
+        /**
+         * Constructor.  Attaches the cache to the engine.
+         * @param engine[in] The engine whose modules are cached.  The
+         * engine must outlive this class.
+         * @param max_modules[in] Most idle modules to keep loaded.
+         */
+        ModuleCache(asIScriptEngine &engine, const size_t max_modules);
+
+        /**
+         * Destructor.  Detaches the cache from the engine.  The modules
+         * are left for the engine to clean up.
+         */
+        ~ModuleCache();
+
+        /**
+         * @param engine[in] The engine to get the cache of.
+         * @return The cache attached to the engine, or null if none.
+         */
+        static ModuleCache *get_module_cache(asIScriptEngine * const engine);
+
+        /**
+         * AngelScript fails if asked to build or load two modules at once on
+         * the same engine, so this lock must be held while doing either.
+         * It is also held while discarding modules.
+         * @return The lock for building modules on the engine.
+         */
+        boost::mutex &get_build_lock(void)
+        { return build_lock; }
+
+        /**
+         * Takes the cached module for a program out of the cache.  The
+         * caller must return it with return_module() when done.
+         * @param program_id[in] The program to get the module of.
+         * @param generation[in] The current generation of the program's
+         * bytecode.  A module loaded from any other generation is discarded.
+         * @return The module, or null if not cached.
+         */
+        asIScriptModule *take_module(
+            const dbtype::Id &program_id,
+            const MG_UnsignedInt generation);
+
+        /**
+         * Creates a new, empty module for the caller to load.  The build
+         * lock must be held.  The caller must return the module with
+         * return_module() or discard_module() when done.
+         * @return The new module, or null if error.
+         */
+        asIScriptModule *make_module(void);
+
+        /**
+         * Puts a module back in the cache once its program has finished.
+         * If the cache already has a module for the program, the one from
+         * the older generation is discarded.  The least recently used
+         * modules are discarded if the cache is full.
+         * @param program_id[in] The program loaded in the module.
+         * @param generation[in] The generation of the bytecode loaded.
+         * @param module_ptr[in] The module being returned.
+         */
+        void return_module(
+            const dbtype::Id &program_id,
+            const MG_UnsignedInt generation,
+            asIScriptModule * const module_ptr);
+
+        /**
+         * Discards a module that is not in the cache, such as one that
+         * failed to load.  Do not hold the build lock.
+         * @param module_ptr[in] The module to discard.
+         */
+        void discard_module(asIScriptModule * const module_ptr);
+
+        /**
+         * Discards the cached module for a program, if any, such as when
+         * the program has been deleted.  Do not hold the build lock.
+         * @param program_id[in] The program to discard the module of.
+         */
+        void discard_program(const dbtype::Id &program_id);
+
+        /**
+         * @return How many idle modules are cached.
+         */
+        size_t size(void);
+
+        /**
+         * @return How many times take_module() found a current module.
+         */
+        MG_LongUnsignedInt get_hits(void);
+
+        /**
+         * @return How many times take_module() did not find a current
+         * module.
+         */
+        MG_LongUnsignedInt get_misses(void);
+
+    private:
+        /**
+         * A module loaded for a program.
+         */
+        struct CachedModule
+        {
+            CachedModule(
+                const dbtype::Id &id,
+                const MG_UnsignedInt gen,
+                asIScriptModule * const module)
+              : program_id(id),
+                generation(gen),
+                module_ptr(module)
+            { }
+
+            dbtype::Id program_id; ///< The program loaded in the module
+            MG_UnsignedInt generation; ///< Generation of the bytecode loaded
+            asIScriptModule *module_ptr; ///< The module.  Owned by the engine
+        };
+
+        /** Most recently used first */
+        typedef std::list<CachedModule> ModuleList;
+        typedef std::map<dbtype::Id, ModuleList::iterator> ModuleMap;
+        typedef std::vector<asIScriptModule *> Modules;
+
+        /**
+         * Discards modules taken out of the cache.  The cache lock must not
+         * be held.
+         * @param modules[in] The modules to discard.
+         */
+        void discard_modules(const Modules &modules);
+
+        // No copying
+        //
+        ModuleCache &operator=(const ModuleCache &rhs);
+        ModuleCache(const ModuleCache &rhs);
+
+        asIScriptEngine &engine; ///< The engine whose modules are cached
+        const size_t max_size; ///< Most idle modules to keep loaded
+        boost::mutex build_lock; ///< Held while building modules on engine
+
+        boost::mutex cache_lock; ///< Lock for everything below
+        MG_LongUnsignedInt next_module_number; ///< For unique module names
+        ModuleList module_list; ///< Idle modules, most recently used first
+        ModuleMap module_map; ///< Program ID to its idle module
+        MG_LongUnsignedInt hits; ///< Lookups that found a current module
+        MG_LongUnsignedInt misses; ///< Lookups that did not
+    };
+}
+}
+
+#endif //MUTGOS_ANGELSCRIPT_MODULECACHE_H
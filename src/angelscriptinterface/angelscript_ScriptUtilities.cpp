@@ -5,6 +5,8 @@
 #include <string>
 #include <angelscript.h>
 
+#include <boost/thread/tss.hpp>
+
 #include "logging/log_Logger.h"
 
 #include "angelscript_AngelException.h"
@@ -16,8 +18,19 @@
 
 namespace
 {
-    const asPWORD MUTGOS_USER_DATA_CONTEXT_TYPE = 1;
     const size_t AS_ARRAY_MAX_SIZE = 4096;
+
+    /**
+     * Used by current_script_context when a thread exits.  Does nothing,
+     * since the context belongs to the process.
+     */
+    void script_context_cleanup(mutgos::angelscript::ScriptContext *context)
+    {
+    }
+
+    /** The context of the script running on each thread */
+    boost::thread_specific_ptr<mutgos::angelscript::ScriptContext>
+        current_script_context(&script_context_cleanup);
 }
 
 namespace mutgos
@@ -25,31 +38,23 @@ namespace mutgos
 namespace angelscript
 {
     // ----------------------------------------------------------------------
-    void ScriptUtilities::set_my_script_context(
-        asIScriptEngine *const engine,
-        mutgos::angelscript::ScriptContext *context)
+    void ScriptUtilities::set_my_script_context(ScriptContext *context)
     {
-        if (not engine)
-        {
-            LOG(fatal, "angelscript", "set_my_script_context",
-                "Provided engine is null!");
-        }
-        else if (not context)
+        if (not context)
         {
             LOG(fatal, "angelscript", "set_my_script_context",
                 "Provided context is null!");
         }
         else
         {
-            engine->SetUserData(context, MUTGOS_USER_DATA_CONTEXT_TYPE);
+            current_script_context.reset(context);
         }
     }
 
     // ----------------------------------------------------------------------
-    void ScriptUtilities::cleanup_my_script_context(
-        asIScriptEngine *const engine)
+    void ScriptUtilities::cleanup_my_script_context(void)
     {
-        engine->SetUserData(0, MUTGOS_USER_DATA_CONTEXT_TYPE);
+        current_script_context.reset();
     }
 
     // ----------------------------------------------------------------------
@@ -65,14 +70,9 @@ namespace angelscript
         }
         else
         {
-            void *context_raw_ptr =
-                engine->GetUserData(MUTGOS_USER_DATA_CONTEXT_TYPE);
+            context = current_script_context.get();
 
-            if (context_raw_ptr)
-            {
-                context = reinterpret_cast<ScriptContext *>(context_raw_ptr);
-            }
-            else
+            if (not context)
             {
                 LOG(fatal, "angelscript", "get_my_script_context",
                     "Context is null!");
@@ -29,26 +29,24 @@ namespace angelscript
     public:
 
         /**
-         * Used to set the script context on the engine running this script.
+         * Used to set the script context of the script about to run on this
+         * thread.  Engines are shared by many scripts at once, so the
+         * context is kept per thread rather than on the engine.
          * Only the code that manages AngelScript's execution should call this.
-         * @param engine[in,out] The engine running this script.
-         * @param context[in] The context to set on the engine.
+         * @param context[in] The context of the script about to run.
          */
-        static void set_my_script_context(
-            asIScriptEngine * const engine,
-            ScriptContext *context);
+        static void set_my_script_context(ScriptContext *context);
 
         /**
-         * Used to delete the script context on the engine running this
-         * script.  Only the code that manages AngelScript's execution should
-         * call this.
-         * @param engine[in,out] The engine running this script.
+         * Used to remove the script context once the script has stopped
+         * running on this thread.  Only the code that manages AngelScript's
+         * execution should call this.
          */
-        static void cleanup_my_script_context(asIScriptEngine * const engine);
+        static void cleanup_my_script_context(void);
 
         /**
          * @param engine[in] The engine running this script.
-         * @return The current ScriptContext.
+         * @return The ScriptContext of the script running on this thread.
          */
         static ScriptContext *get_my_script_context(
             asIScriptEngine * const engine);
@@ -99,6 +99,12 @@ namespace comm
         return router.get_session_stats(entity_id);
     }
 
+    // ----------------------------------------------------------------------
+    ServiceLatencyStats CommAccess::get_service_latency_stats(void)
+    {
+        return router.get_service_latency_stats();
+    }
+
     // ----------------------------------------------------------------------
     CommAccess::CommAccess(void)
     {
@@ -156,6 +156,12 @@ namespace comm
          */
         SessionStats get_session_stats(const dbtype::Id &entity_id);
 
+        /**
+         * @return Statistics on how long sessions wait to be serviced by
+         * the router.
+         */
+        ServiceLatencyStats get_service_latency_stats(void);
+
     private:
 
         /**
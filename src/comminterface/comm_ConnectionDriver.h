@@ -68,6 +68,12 @@ namespace comm
          * It is safe to do so because drivers will never be in do_work() AND
          * have a ClientConnection method called at the same time.
          *
+         * Drivers must do their IO on the router's io_context (see
+         * RouterSessionManager::get_io_context()).  The router waits in it
+         * between calls, so socket activity wakes the router up.  Anything
+         * queued for this method outside of it must call
+         * RouterSessionManager::wakeup(), or it may wait a while.
+         *
          * Drivers should do as much work as is immediately available to them,
          * and then return.  They may be given the opportunity to be called
          * back immediately if they think more work will be available shortly.
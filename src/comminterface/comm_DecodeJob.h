@@ -0,0 +1,66 @@
+/*
+ * comm_DecodeJob.h
+ */
+
+#ifndef MUTGOS_COMM_DECODEJOB_H
+#define MUTGOS_COMM_DECODEJOB_H
+
+namespace mutgos
+{
+namespace comm
+{
+    // Forward declarations
+    //
+    class DecodePool;
+
+    /**
+     * An interface class for input from a client that needs to be decoded
+     * (parsed, converted, etc) before it can be acted on.  Decoding is
+     * done by a DecodePool, usually on a thread of its own, and then the
+     * results are handed back to the router thread.
+     *
+     * Implementations should own copies of everything decode() uses, since
+     * decode() may run at the same time as anything else, including the
+     * ClientConnection the input came from.
+     */
+    class DecodeJob
+    {
+    public:
+        /**
+         * Constructor.
+         */
+        DecodeJob(void)
+          : next_decoded_ptr(0)
+          { }
+
+        /**
+         * Required 'interface' virtual destructor.  Must clean up anything
+         * decoded but never handed off by decoded().  Every job submitted
+         * to a DecodePool is called back before it is deleted.
+         */
+        virtual ~DecodeJob()
+          { }
+
+        /**
+         * Called on a decode thread to do the decoding.  It must not touch
+         * anything the job does not own.
+         */
+        virtual void decode(void) =0;
+
+        /**
+         * Called on the router thread after decode(), to act on the
+         * results.  Jobs submitted to the same shard are called back in
+         * the order they were submitted.  The job is deleted when this
+         * returns.
+         */
+        virtual void decoded(void) =0;
+
+    private:
+        friend class DecodePool;
+
+        DecodeJob *next_decoded_ptr; ///< Next job in DecodePool's decoded list
+    };
+}
+}
+
+#endif //MUTGOS_COMM_DECODEJOB_H
@@ -0,0 +1,246 @@
+/*
+ * comm_DecodePool.cpp
+ */
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+
+#include "comminterface/comm_DecodePool.h"
+#include "comminterface/comm_DecodeJob.h"
+#include "comminterface/comm_RouterSessionManager.h"
+
+namespace
+{
+    // TODO make data driven
+
+    /** Most decode threads to start when picking the count automatically */
+    const unsigned int MAX_AUTO_DECODE_THREADS = 4;
+}
+
+namespace mutgos
+{
+namespace comm
+{
+    // ----------------------------------------------------------------------
+    DecodePool::DecodePool(RouterSessionManager *router)
+      : router_ptr(router),
+        next_shard(0),
+        decoded_head_ptr(0)
+    {
+        if (not router_ptr)
+        {
+            LOG(fatal, "comm", "DecodePool", "router is null!");
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    DecodePool::~DecodePool()
+    {
+        stop();
+
+        // Jobs hold a reference to their connection until called back, so
+        // they can't simply be deleted.
+        //
+        deliver_decoded();
+    }
+
+    // ----------------------------------------------------------------------
+    void DecodePool::start(const unsigned int thread_count)
+    {
+        if (shards.empty())
+        {
+            unsigned int shard_count = thread_count;
+
+            if (not shard_count)
+            {
+                // Leave a core for the router thread.
+                const unsigned int cores =
+                    boost::thread::hardware_concurrency();
+
+                shard_count = (cores > 1) ?
+                    std::min(cores - 1, MAX_AUTO_DECODE_THREADS) : 0;
+            }
+
+            LOG(info, "comm", "start",
+                "Starting " + text::to_string(shard_count)
+                + " decode threads.");
+
+            for (unsigned int index = 0; index < shard_count; ++index)
+            {
+                Shard * const shard_ptr = new Shard();
+
+                shard_ptr->thread_ptr = new boost::thread(
+                    &DecodePool::thread_main,
+                    this,
+                    shard_ptr);
+                shards.push_back(shard_ptr);
+            }
+
+            next_shard = 0;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void DecodePool::stop(void)
+    {
+        // Tell all the threads first, so they finish up at the same time.
+        //
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            // Scope for lock
+            {
+                boost::lock_guard<boost::mutex> guard((*shard_iter)->lock);
+                (*shard_iter)->shutdown_flag = true;
+            }
+
+            (*shard_iter)->condition.notify_one();
+        }
+
+        for (Shards::iterator shard_iter = shards.begin();
+            shard_iter != shards.end();
+            ++shard_iter)
+        {
+            (*shard_iter)->thread_ptr->join();
+            delete (*shard_iter)->thread_ptr;
+            delete *shard_iter;
+        }
+
+        shards.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt DecodePool::assign_shard(void)
+    {
+        return next_shard++;
+    }
+
+    // ----------------------------------------------------------------------
+    void DecodePool::submit(const MG_UnsignedInt shard, DecodeJob *job_ptr)
+    {
+        if (not job_ptr)
+        {
+            LOG(error, "comm", "submit", "job_ptr is null!");
+        }
+        else if (shards.empty())
+        {
+            // No threads, so do it all right now.
+            //
+            job_ptr->decode();
+            job_ptr->decoded();
+            delete job_ptr;
+        }
+        else
+        {
+            Shard * const shard_ptr = shards[shard % shards.size()];
+
+            // Scope for lock
+            {
+                boost::lock_guard<boost::mutex> guard(shard_ptr->lock);
+                shard_ptr->jobs.push_back(job_ptr);
+            }
+
+            shard_ptr->condition.notify_one();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool DecodePool::deliver_decoded(void)
+    {
+        DecodeJob *job_ptr = decoded_head_ptr.exchange(0);
+        DecodeJob *oldest_ptr = 0;
+
+        // The list is newest first; reverse it to call back in order.
+        //
+        while (job_ptr)
+        {
+            DecodeJob * const next_ptr = job_ptr->next_decoded_ptr;
+
+            job_ptr->next_decoded_ptr = oldest_ptr;
+            oldest_ptr = job_ptr;
+            job_ptr = next_ptr;
+        }
+
+        const bool delivered = oldest_ptr;
+
+        while (oldest_ptr)
+        {
+            DecodeJob * const next_ptr = oldest_ptr->next_decoded_ptr;
+
+            oldest_ptr->decoded();
+            delete oldest_ptr;
+            oldest_ptr = next_ptr;
+        }
+
+        return delivered;
+    }
+
+    // ----------------------------------------------------------------------
+    void DecodePool::thread_main(Shard *shard_ptr)
+    {
+        bool do_shutdown = false;
+        JobQueue jobs;
+
+        while (not do_shutdown)
+        {
+            // Scope for lock
+            {
+                boost::unique_lock<boost::mutex> lock(shard_ptr->lock);
+
+                while (shard_ptr->jobs.empty() and
+                    (not shard_ptr->shutdown_flag))
+                {
+                    shard_ptr->condition.wait(lock);
+                }
+
+                // Only stop once everything queued is done.
+                do_shutdown = shard_ptr->jobs.empty();
+                jobs.swap(shard_ptr->jobs);
+            }
+
+            while (not jobs.empty())
+            {
+                jobs.front()->decode();
+                add_decoded(jobs.front());
+                jobs.pop_front();
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void DecodePool::add_decoded(DecodeJob *job_ptr)
+    {
+        // Once added, the router may call back and delete the job at any
+        // time, so only the local copy of the old head is used afterwards.
+        //
+        DecodeJob *head_ptr = decoded_head_ptr.load();
+
+        do
+        {
+            job_ptr->next_decoded_ptr = head_ptr;
+        }
+        while (not decoded_head_ptr.compare_exchange_weak(head_ptr, job_ptr));
+
+        // If others were already waiting, the router has been woken for
+        // them and will collect this one at the same time.
+        //
+        if (not head_ptr)
+        {
+            router_ptr->wakeup();
+        }
+    }
+}
+}
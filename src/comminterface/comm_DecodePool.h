@@ -0,0 +1,157 @@
+/*
+ * comm_DecodePool.h
+ */
+
+#ifndef MUTGOS_COMM_DECODEPOOL_H
+#define MUTGOS_COMM_DECODEPOOL_H
+
+#include <deque>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "comminterface/comm_DecodeJob.h"
+
+namespace mutgos
+{
+namespace comm
+{
+    // Forward declarations
+    //
+    class RouterSessionManager;
+
+    /**
+     * A pool of threads that decode client input for a ConnectionDriver,
+     * so the parsing for many connections can use more than one core while
+     * everything else about the connections stays on the router thread.
+     *
+     * Each thread is a shard with its own queue of DecodeJobs.  A
+     * connection is pinned to one shard when it is accepted, so its input
+     * is always decoded in order.  Decoded jobs are handed back to the
+     * router through a lock-free list, and the router is woken to call
+     * them back.  Since each shard hands back its jobs in order, a
+     * connection's input is called back in order too.
+     *
+     * If the pool has no threads (one core, or stopped), jobs are decoded
+     * and called back on the spot, on the router thread.
+     *
+     * Other than how decode() is run, this class is NOT thread safe; only
+     * the router thread may call it.
+     */
+    class DecodePool
+    {
+    public:
+        /**
+         * Constructor.
+         * @param router[in] The router to wake up when input is decoded.
+         * It must outlive this class.
+         */
+        DecodePool(RouterSessionManager *router);
+
+        /**
+         * Destructor.  Calls stop() if needed, and then calls back any jobs
+         * decoded but not yet called back, so whatever they reference is
+         * released.  Owners should do this themselves first if the
+         * callbacks use anything destructed before this.
+         */
+        ~DecodePool();
+
+        /**
+         * Starts the decode threads.  Does nothing if already started.
+         * @param thread_count[in] How many decode threads (shards) to
+         * start, or 0 to use one less than the number of cores.
+         */
+        void start(const unsigned int thread_count);
+
+        /**
+         * Waits for the decode threads to finish the jobs already queued,
+         * and then stops them.  Decoded jobs still need to be called back
+         * by deliver_decoded().  Jobs submitted after this are decoded on
+         * the spot.
+         */
+        void stop(void);
+
+        /**
+         * Picks a shard for a new connection, spreading connections
+         * evenly over the threads.
+         * @return The shard the connection should submit all its jobs to.
+         */
+        MG_UnsignedInt assign_shard(void);
+
+        /**
+         * Queues a job to be decoded.
+         * @param shard[in] The shard from assign_shard().
+         * @param job_ptr[in] The job.  Control of the pointer passes to
+         * this method.  It may be called back before this returns.
+         */
+        void submit(const MG_UnsignedInt shard, DecodeJob *job_ptr);
+
+        /**
+         * Calls back (DecodeJob::decoded()) and deletes every job that has
+         * been decoded so far.  The driver calls this from do_work().
+         * @return True if any jobs were called back.
+         */
+        bool deliver_decoded(void);
+
+        /**
+         * @return How many decode threads are running.
+         */
+        MG_UnsignedInt get_thread_count(void) const
+          { return shards.size(); }
+
+    private:
+        typedef std::deque<DecodeJob *> JobQueue;
+
+        /**
+         * One decode thread and its queue.
+         */
+        struct Shard
+        {
+            Shard(void)
+              : shutdown_flag(false),
+                thread_ptr(0)
+            { }
+
+            boost::mutex lock; ///< Lock for jobs and shutdown_flag
+            boost::condition_variable condition; ///< Signals jobs or shutdown
+            JobQueue jobs; ///< Jobs waiting to be decoded, in order
+            bool shutdown_flag; ///< True if the thread should stop when idle
+            boost::thread *thread_ptr; ///< The decode thread
+        };
+
+        typedef std::vector<Shard *> Shards;
+
+        /**
+         * Main loop of a decode thread.
+         * @param shard_ptr[in] The shard the thread serves.
+         */
+        void thread_main(Shard *shard_ptr);
+
+        /**
+         * Adds a decoded job to the lock-free list, and wakes up the router
+         * if the list was empty.
+         * @param job_ptr[in] The decoded job.
+         */
+        void add_decoded(DecodeJob *job_ptr);
+
+        // No copying
+        //
+        DecodePool &operator=(const DecodePool &rhs);
+        DecodePool(const DecodePool &rhs);
+
+        RouterSessionManager * const router_ptr; ///< Router to wake up
+        Shards shards; ///< The decode threads.  Empty if stopped.
+        MG_UnsignedInt next_shard; ///< Shard for the next connection
+
+        /** Decoded jobs, newest first, linked by next_decoded_ptr */
+        boost::atomic<DecodeJob *> decoded_head_ptr;
+    };
+}
+}
+
+#endif //MUTGOS_COMM_DECODEPOOL_H
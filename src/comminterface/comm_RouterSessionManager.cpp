@@ -12,14 +12,17 @@
 #include <stdlib.h>
 
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/bind.hpp>
 
 #include "osinterface/osinterface_TimeUtils.h"
-#include "osinterface/osinterface_ThreadUtils.h"
 
 #include "logging/log_Logger.h"
 
 #include "text/text_ExternalText.h"
+#include "text/text_StringConversion.h"
 
 #include "comminterface/comm_RouterSessionManager.h"
 #include "comminterface/comm_ConnectionDriver.h"
@@ -35,9 +38,9 @@
 
 // Defines
 //
-#define DEFAULT_SLEEP_TIME_MICROSEC 250000
-#define DEFAULT_SLEEP_TIME_NANOSEC 250000000
+#define DEFAULT_MAX_WAIT_SEC 10
 #define DEFAULT_IDLE_CHECK_SEC 60
+#define DEFAULT_LATENCY_SAMPLES 4096
 #define DEFAULT_INACTIVITY_SEC 3600
 #define DEFAULT_RECONNECT_INACTIVITY_SEC 300
 
@@ -48,8 +51,13 @@ namespace comm
     // ----------------------------------------------------------------------
     RouterSessionManager::RouterSessionManager(void)
         : thread_ptr(0),
-          shutdown_thread_flag(false)
+          shutdown_thread_flag(false),
+          io_context(1),
+          io_work_guard_ptr(0),
+          wakeup_posted(false),
+          next_latency_sample(0)
     {
+        latency_samples.reserve(DEFAULT_LATENCY_SAMPLES);
     }
 
     // ----------------------------------------------------------------------
@@ -75,6 +83,12 @@ namespace comm
         {
             LOG(info, "comm", "startup", "Starting up...");
 
+            // Keep the thread waiting in the io_context even when no driver
+            // has IO outstanding.
+            //
+            io_context.restart();
+            io_work_guard_ptr = new IoWorkGuard(io_context.get_executor());
+
             for (ConnectionDrivers::iterator driver_iter =
                 connection_drivers.begin();
                  driver_iter != connection_drivers.end();
@@ -98,6 +112,7 @@ namespace comm
             LOG(info, "comm", "shutdown", "Shutting down...");
 
             shutdown_thread_flag.store(true);
+            wakeup();
 
             thread_ptr->join();
             delete thread_ptr;
@@ -129,6 +144,10 @@ namespace comm
             {
                 (*driver_iter)->stop(this);
             }
+
+            delete io_work_guard_ptr;
+            io_work_guard_ptr = 0;
+            io_context.stop();
         }
     }
 
@@ -665,14 +684,71 @@ namespace comm
     void RouterSessionManager::session_has_pending_actions(
         ClientSession *session_ptr)
     {
-        boost::lock_guard<boost::recursive_mutex> write_lock(router_lock);
-
         if (session_ptr)
         {
-            pending_actions.push_back(session_ptr);
+            PendingSession pending_session;
+            pending_session.session_ptr = session_ptr;
+            clock_gettime(CLOCK_MONOTONIC, &pending_session.request_time);
+
+            // Scope for lock
+            {
+                boost::lock_guard<boost::recursive_mutex> write_lock(
+                    router_lock);
+                pending_actions.push_back(pending_session);
+            }
+
+            wakeup();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void RouterSessionManager::wakeup(void)
+    {
+        // Only one wakeup needs to be queued at a time.  Anything requested
+        // before it runs will be serviced after it runs.
+        //
+        if (not wakeup_posted.exchange(true))
+        {
+            boost::asio::post(
+                io_context,
+                boost::bind(&RouterSessionManager::wakeup_handler, this));
         }
     }
 
+    // ----------------------------------------------------------------------
+    ServiceLatencyStats RouterSessionManager::get_service_latency_stats(void)
+    {
+        ServiceLatencyStats stats;
+        LatencySamples samples;
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(latency_lock);
+            stats = latency_stats;
+            samples = latency_samples;
+        }
+
+        if (not samples.empty())
+        {
+            const size_t p50_index = samples.size() / 2;
+            const size_t p99_index = (samples.size() * 99) / 100;
+
+            std::nth_element(
+                samples.begin(),
+                samples.begin() + p99_index,
+                samples.end());
+            stats.p99_us = samples[p99_index];
+
+            std::nth_element(
+                samples.begin(),
+                samples.begin() + p50_index,
+                samples.begin() + p99_index);
+            stats.p50_us = samples[p50_index];
+        }
+
+        return stats;
+    }
+
     // ----------------------------------------------------------------------
     void RouterSessionManager::release_connection(
         ClientConnection *connection_ptr)
@@ -697,37 +773,19 @@ namespace comm
         bool more_work = false;
         timeval current_idle_check_time;
         timeval prev_idle_check_time;
-        timespec start_time;
-        timespec end_time;
-        timespec time_diff;
-        timespec time_to_wait;
 
-        time_to_wait.tv_sec = 0;
-        time_to_wait.tv_nsec = 0;
         prev_idle_check_time.tv_sec = 0;
         prev_idle_check_time.tv_usec = 0;
 
-        if (clock_gettime(CLOCK_MONOTONIC, &start_time))
-        {
-            LOG(fatal, "comm", "thread_main",
-                "clock_gettime(CLOCK_MONOTONIC) not supported!  "
-                "Cannot service connections.");
-            return;
-        }
-
-        // The main loop basically services all drivers and connections that
-        // need it, and then sleeps for some nanoseconds.  The idea is to
-        // loop at a constant rate per second, regardless of how long the loop
-        // may take each time.
+        // The main loop services all drivers and sessions that need it, and
+        // then waits in the io_context until a socket has something to do,
+        // a session or driver calls wakeup(), or it's time to check for
+        // idle sessions.  If a driver ran anything, whatever it ran may have
+        // queued more work, so go around again without waiting.
         //
 
         while (not do_shutdown)
         {
-            if (not more_work)
-            {
-                clock_gettime(CLOCK_MONOTONIC, &start_time);
-            }
-
             more_work = false;
 
             // Call everything with pending actions
@@ -813,42 +871,26 @@ namespace comm
                         disconnect_session(*id_iter);
                     }
                 }
+
+                const ServiceLatencyStats current_latency =
+                    get_service_latency_stats();
+
+                LOG(debug, "comm", "thread_main",
+                    "Session service latency: p50 "
+                    + text::to_string(current_latency.p50_us) + " us, p99 "
+                    + text::to_string(current_latency.p99_us) + " us, max "
+                    + text::to_string(current_latency.max_us) + " us, over "
+                    + text::to_string(current_latency.requests_serviced)
+                    + " requests.");
             }
 
             if (not more_work)
             {
-                clock_gettime(CLOCK_MONOTONIC, &end_time);
-
-                // Determine how much more time to wait based on how long the
-                // last calls took.  This cannot be negative due to the clock
-                // type we are using.
-                //
-                osinterface::TimeUtils::timespec_substract(
-                    end_time,
-                    start_time,
-                    time_diff);
-
-                if ((not time_diff.tv_sec) and
-                    (time_diff.tv_nsec < DEFAULT_SLEEP_TIME_NANOSEC))
-                {
-                    // Did not take more time than the periodic sleep, so
-                    // calculate how long to sleep and then do the sleep.
-                    //
-                    time_to_wait.tv_nsec =
-                        DEFAULT_SLEEP_TIME_NANOSEC - time_diff.tv_nsec;
-
-                    nanosleep(&time_to_wait, 0);
-                }
-                else
-                {
-                    // We're running late, but should let others get in
-                    // so we don't starve other threads needing locks
-                    //
-                    osinterface::ThreadUtils::yield();
-                }
-
-                do_shutdown = shutdown_thread_flag.load();
+                io_context.run_one_for(
+                    boost::asio::chrono::seconds(DEFAULT_MAX_WAIT_SEC));
             }
+
+            do_shutdown = shutdown_thread_flag.load();
         }
     }
 
@@ -899,13 +941,55 @@ namespace comm
             sessions.swap(pending_actions);
         }
 
+        timespec now_time;
+        timespec wait_time;
+
         while (not sessions.empty())
         {
-            sessions.front()->process_pending();
+            clock_gettime(CLOCK_MONOTONIC, &now_time);
+            osinterface::TimeUtils::timespec_substract(
+                now_time,
+                sessions.front().request_time,
+                wait_time);
+            add_service_latency(
+                (wait_time.tv_sec * 1000000) + (wait_time.tv_nsec / 1000));
+
+            sessions.front().session_ptr->process_pending();
             sessions.pop_front();
         }
     }
 
+    // ----------------------------------------------------------------------
+    void RouterSessionManager::wakeup_handler(void)
+    {
+        wakeup_posted.store(false);
+    }
+
+    // ----------------------------------------------------------------------
+    void RouterSessionManager::add_service_latency(
+        const MG_LongUnsignedInt latency_us)
+    {
+        boost::lock_guard<boost::mutex> guard(latency_lock);
+
+        if (latency_samples.size() < DEFAULT_LATENCY_SAMPLES)
+        {
+            latency_samples.push_back(latency_us);
+        }
+        else
+        {
+            latency_samples[next_latency_sample] = latency_us;
+        }
+
+        next_latency_sample = (next_latency_sample + 1) %
+            DEFAULT_LATENCY_SAMPLES;
+        ++latency_stats.requests_serviced;
+
+        if (latency_us > latency_stats.max_us)
+        {
+            latency_stats.max_us = latency_us;
+        }
+    }
+
     // ----------------------------------------------------------------------
     dbtype::Id RouterSessionManager::check_password(
         const dbtype::Id::SiteIdType site_id,
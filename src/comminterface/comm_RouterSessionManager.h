@@ -9,9 +9,13 @@
 #include <map>
 #include <vector>
 #include <deque>
+#include <time.h>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/atomic/atomic.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 
 #include "osinterface/osinterface_OsTypes.h"
 
@@ -46,6 +50,25 @@ namespace comm
     // TODO Websocket driver could accept batches of output instead of one line at a time
     // TODO Add ping functionality if no recent activity
 
+    /**
+     * How long sessions wait between asking to be serviced (having output
+     * to send, etc) and the router calling them back.
+     */
+    struct ServiceLatencyStats
+    {
+        ServiceLatencyStats(void)
+          : requests_serviced(0),
+            p50_us(0),
+            p99_us(0),
+            max_us(0)
+        { }
+
+        MG_LongUnsignedInt requests_serviced; ///< Requests since startup
+        MG_LongUnsignedInt p50_us; ///< Median of recent requests, in us
+        MG_LongUnsignedInt p99_us; ///< 99th percentile of recent requests, in us
+        MG_LongUnsignedInt max_us; ///< Longest wait since startup, in us
+    };
+
     /**
      * This class is both the Router, and Session Manager due to heavily
      * intertwined data.
@@ -54,9 +77,10 @@ namespace comm
      * ClientConnection (socket, websocket, etc).  It has code common to
      * all connection types, such as authentication.
      *
-     * It also services all connection types on a single thread, however it
-     * has to use frequent polling for this.
-     * TODO Figure out a more efficient mechanism without frequent polling
+     * It also services all connection types on a single thread.  The
+     * drivers do their socket IO on an io_context owned by this class, and
+     * the thread sleeps in that io_context until a socket is ready, or until
+     * woken by a session or driver that has something pending.
      *
      * This class also keeps track of and manages what ClientSession is
      * associated with what Player, and also contains various algorithms related
@@ -337,6 +361,28 @@ namespace comm
          */
         void session_has_pending_actions(ClientSession *session_ptr);
 
+        /**
+         * Wakes up the router thread if it is waiting for IO, so it will
+         * call the drivers and sessions again soon.  Drivers call this
+         * when they have work queued up outside of do_work().
+         * This can be called at any time, from any thread.
+         */
+        void wakeup(void);
+
+        /**
+         * Drivers must do all their IO on this context, which is only run
+         * by the router thread (within do_work() and while waiting for
+         * work).  It is valid for as long as this class is.
+         * @return The IO context shared by all drivers.
+         */
+        boost::asio::io_context &get_io_context(void)
+          { return io_context; }
+
+        /**
+         * @return Statistics on how long sessions wait to be serviced.
+         */
+        ServiceLatencyStats get_service_latency_stats(void);
+
         /**
          * Called by ClientSession when it is done with a ClientConnection.
          * Note this may be called when a ClientSession is being destructed.
@@ -373,6 +419,19 @@ namespace comm
          */
         void service_sessions(void);
 
+        /**
+         * Posted to the io_context by wakeup().  Does nothing other than
+         * allow another wakeup to be posted, since running it is what wakes
+         * up the thread.
+         */
+        void wakeup_handler(void);
+
+        /**
+         * Adds a measurement of how long a session waited to be serviced.
+         * @param latency_us[in] How long the session waited, in us.
+         */
+        void add_service_latency(const MG_LongUnsignedInt latency_us);
+
         /**
          * Removes an existing session.  If the session is currently connected,
          * it will be disconnected and all Channels closed.  This is the only
@@ -437,7 +496,20 @@ namespace comm
         typedef std::map<dbtype::Id, ClientSession *> EntitySessionMap;
         typedef std::map<dbtype::Id::SiteIdType, EntitySessionMap> SiteSessionsMap;
 
-        typedef std::deque<ClientSession *> SessionQueue;
+        /**
+         * A session waiting to be serviced.
+         */
+        struct PendingSession
+        {
+            ClientSession *session_ptr; ///< The session to call back
+            timespec request_time; ///< When it asked, from CLOCK_MONOTONIC
+        };
+
+        typedef boost::asio::executor_work_guard<
+            boost::asio::io_context::executor_type> IoWorkGuard;
+
+        typedef std::deque<PendingSession> SessionQueue;
+        typedef std::vector<MG_LongUnsignedInt> LatencySamples;
         typedef std::vector<ClientSession *> SessionVector;
 
         ConnectionDrivers connection_drivers; ///< Connection drivers to poll
@@ -452,6 +524,15 @@ namespace comm
         boost::recursive_mutex callback_lock; ///< Lock for when calling back ClientSessions. Lock before router_lock if using.
         boost::recursive_mutex router_lock; ///< Lock for class instance
         boost::atomic<bool> shutdown_thread_flag; ///< True if thread should shutdown
+
+        boost::asio::io_context io_context; ///< Shared by all drivers for IO
+        IoWorkGuard *io_work_guard_ptr; ///< Keeps io_context from running out of work while started
+        boost::atomic<bool> wakeup_posted; ///< True if wakeup_handler() is queued and has not run yet
+
+        boost::mutex latency_lock; ///< Lock for the latency statistics
+        LatencySamples latency_samples; ///< Recent latencies, used as a ring
+        size_t next_latency_sample; ///< Where in latency_samples to add next
+        ServiceLatencyStats latency_stats; ///< Totals; percentiles not filled in
     };
 }
 }
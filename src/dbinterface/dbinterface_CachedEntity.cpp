@@ -18,7 +18,9 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     CachedEntity::CachedEntity(dbtype::Entity *entity)
       : ref_count(0),
-        entity_ptr(entity)
+        entity_ptr(entity),
+        recently_used(true),
+        mem_used(0)
     {
         if (not entity_ptr)
         {
@@ -1,7 +1,9 @@
 #ifndef MUTGOS_DBINTERFACE_CACHEDENTITY_H
 #define MUTGOS_DBINTERFACE_CACHEDENTITY_H
 
+#include <stddef.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbtypes/dbtype_Entity.h"
 #include "dbtypes/dbtype_Id.h"
@@ -68,10 +70,43 @@ namespace dbinterface
          */
         const dbtype::Id &get_id(void) const;
 
+        /**
+         * For SiteCache use only.
+         * @return True if the Entity has been gotten from the cache since
+         * the last eviction pass looked at it.
+         */
+        bool is_recently_used(void) const
+            { return recently_used.load(); }
+
+        /**
+         * For SiteCache use only.  Safe to call while the SiteCache is
+         * only read locked.
+         * @param used[in] True if the Entity has been gotten from the cache.
+         */
+        void set_recently_used(const bool used)
+            { recently_used = used; }
+
+        /**
+         * For SiteCache use only; the SiteCache mutex protects this.
+         * @return The memory used by the Entity, in bytes, as of the last
+         * time it was measured.
+         */
+        size_t get_mem_used(void) const
+            { return mem_used; }
+
+        /**
+         * For SiteCache use only; the SiteCache mutex protects this.
+         * @param bytes[in] The memory used by the Entity, in bytes.
+         */
+        void set_mem_used(const size_t bytes)
+            { mem_used = bytes; }
+
     private:
         boost::mutex mutex; ///< Enforces single access at a time.
         unsigned int ref_count; ///< How many references to Entity exist
         dbtype::Entity *entity_ptr; ///< Pointer to cached Entity.
+        boost::atomic<bool> recently_used; ///< Eviction CLOCK bit, set when gotten
+        size_t mem_used; ///< Last measured memory used by Entity
 
         // No copying
         //
@@ -0,0 +1,360 @@
+/*
+ * dbinterface_CompactArchive.cpp
+ */
+
+#include <stddef.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <streambuf>
+
+#include "dbinterface_CompactArchive.h"
+
+namespace
+{
+    /** Most bytes a 64 bit varint can take */
+    const size_t MAX_VARINT_BYTES = 10;
+}
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    // ----------------------------------------------------------------------
+    CompactOArchive::CompactOArchive(std::streambuf &buffer)
+      : output(buffer),
+        failed(false)
+    {
+        save_bytes(COMPACT_ARCHIVE_MAGIC, sizeof(COMPACT_ARCHIVE_MAGIC));
+        save_bytes(&COMPACT_ARCHIVE_VERSION, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const bool value)
+    {
+        const unsigned char byte = value ? 1 : 0;
+        save_bytes(&byte, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const char value)
+    {
+        save_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const signed char value)
+    {
+        save_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const unsigned char value)
+    {
+        save_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const short value)
+    {
+        save_signed(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const unsigned short value)
+    {
+        save_varint(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const int value)
+    {
+        save_signed(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const unsigned int value)
+    {
+        save_varint(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const long value)
+    {
+        save_signed(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const unsigned long value)
+    {
+        save_varint(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const long long value)
+    {
+        save_signed(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const unsigned long long value)
+    {
+        save_varint(value);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const float value)
+    {
+        save_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const double value)
+    {
+        save_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const long double value)
+    {
+        save_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save(const std::string &value)
+    {
+        save_varint(value.size());
+        save_bytes(value.data(), value.size());
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save_varint(std::uint64_t value)
+    {
+        unsigned char bytes[MAX_VARINT_BYTES];
+        size_t size = 0;
+
+        do
+        {
+            bytes[size] = (unsigned char) (value & 0x7F);
+            value >>= 7;
+
+            if (value)
+            {
+                bytes[size] |= 0x80;
+            }
+
+            ++size;
+        }
+        while (value);
+
+        save_bytes(bytes, size);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save_signed(const std::int64_t value)
+    {
+        save_varint(
+            ((std::uint64_t) value << 1) ^ (std::uint64_t) (value >> 63));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactOArchive::save_bytes(const void *data_ptr, const size_t size)
+    {
+        if (size and
+            (output.sputn((const char *) data_ptr, size) != (std::streamsize) size))
+        {
+            failed = true;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool CompactIArchive::is_compact(
+        const void *data_ptr,
+        const size_t data_size)
+    {
+        return data_ptr and (data_size > sizeof(COMPACT_ARCHIVE_MAGIC)) and
+            (memcmp(
+                data_ptr,
+                COMPACT_ARCHIVE_MAGIC,
+                sizeof(COMPACT_ARCHIVE_MAGIC)) == 0);
+    }
+
+    // ----------------------------------------------------------------------
+    CompactIArchive::CompactIArchive(std::streambuf &buffer)
+      : input(buffer),
+        failed(false),
+        format_version(0)
+    {
+        char magic[sizeof(COMPACT_ARCHIVE_MAGIC)];
+
+        load_bytes(magic, sizeof(magic));
+        load_bytes(&format_version, 1);
+
+        if (memcmp(magic, COMPACT_ARCHIVE_MAGIC, sizeof(magic)) or
+            (format_version < 1) or
+            (format_version > COMPACT_ARCHIVE_VERSION))
+        {
+            failed = true;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(bool &value)
+    {
+        unsigned char byte = 0;
+        load_bytes(&byte, 1);
+        value = byte;
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(char &value)
+    {
+        load_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(signed char &value)
+    {
+        load_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(unsigned char &value)
+    {
+        load_bytes(&value, 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(short &value)
+    {
+        value = (short) load_signed();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(unsigned short &value)
+    {
+        value = (unsigned short) load_varint();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(int &value)
+    {
+        value = (int) load_signed();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(unsigned int &value)
+    {
+        value = (unsigned int) load_varint();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(long &value)
+    {
+        value = (long) load_signed();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(unsigned long &value)
+    {
+        value = (unsigned long) load_varint();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(long long &value)
+    {
+        value = (long long) load_signed();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(unsigned long long &value)
+    {
+        value = (unsigned long long) load_varint();
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(float &value)
+    {
+        load_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(double &value)
+    {
+        load_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(long double &value)
+    {
+        load_bytes(&value, sizeof(value));
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load(std::string &value)
+    {
+        const size_t size = load_count();
+
+        value.resize(size);
+
+        if (size)
+        {
+            load_bytes(&value[0], size);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    size_t CompactIArchive::load_count(void)
+    {
+        std::uint64_t count = load_varint();
+        const std::streamsize remaining = input.in_avail();
+
+        // Every element takes at least one byte.
+        //
+        if (failed or (remaining < 0) or
+            (count > (std::uint64_t) remaining))
+        {
+            failed = true;
+            count = 0;
+        }
+
+        return (size_t) count;
+    }
+
+    // ----------------------------------------------------------------------
+    std::uint64_t CompactIArchive::load_varint(void)
+    {
+        std::uint64_t value = 0;
+        unsigned char byte = 0x80;
+
+        for (size_t index = 0;
+            (index < MAX_VARINT_BYTES) and (byte & 0x80) and (not failed);
+            ++index)
+        {
+            load_bytes(&byte, 1);
+            value |= (std::uint64_t) (byte & 0x7F) << (7 * index);
+        }
+
+        return failed ? 0 : value;
+    }
+
+    // ----------------------------------------------------------------------
+    std::int64_t CompactIArchive::load_signed(void)
+    {
+        const std::uint64_t value = load_varint();
+
+        return (std::int64_t) (value >> 1) ^ -(std::int64_t) (value & 1);
+    }
+
+    // ----------------------------------------------------------------------
+    void CompactIArchive::load_bytes(void *data_ptr, const size_t size)
+    {
+        if (failed or
+            (input.sgetn((char *) data_ptr, size) != (std::streamsize) size))
+        {
+            failed = true;
+            memset(data_ptr, 0, size);
+        }
+    }
+}
+}
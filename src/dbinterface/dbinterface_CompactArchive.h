@@ -0,0 +1,515 @@
+/*
+ * dbinterface_CompactArchive.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_COMPACTARCHIVE_H
+#define MUTGOS_DBINTERFACE_COMPACTARCHIVE_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <bitset>
+#include <streambuf>
+#include <type_traits>
+
+#include <boost/mpl/bool.hpp>
+#include <boost/serialization/serialization.hpp>
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Identifies a blob written by CompactOArchive.  A boost binary archive
+     * starts with the length of its signature string, so it can never start
+     * with these bytes.
+     */
+    const char COMPACT_ARCHIVE_MAGIC[] = { 'M', 'G', 'E' };
+
+    /** Version of the compact format written by CompactOArchive */
+    const unsigned char COMPACT_ARCHIVE_VERSION = 1;
+
+    /**
+     * A minimal output archive for the save() methods the dbtypes already
+     * have for boost serialization, used instead of binary_oarchive for
+     * Entities.
+     *
+     * The output is a magic header and format version, followed by the
+     * fields in order with nothing in between: no class IDs, versions, or
+     * object tracking.  Integers and enums are variable length (small
+     * values take one byte), strings and containers are prefixed with their
+     * length, and floating point is stored as raw bytes.
+     *
+     * Objects are written by value only.  Pointers are not supported, which
+     * matches how the dbtypes serialize themselves.
+     */
+    class CompactOArchive
+    {
+    public:
+        typedef boost::mpl::bool_<true> is_saving;
+        typedef boost::mpl::bool_<false> is_loading;
+
+        /**
+         * Creates the archive and writes the header.
+         * @param buffer[out] Where the serialized data goes.
+         */
+        CompactOArchive(std::streambuf &buffer);
+
+        /**
+         * Serializes the given value.
+         * @param value[in] The value to serialize.
+         * @return This archive.
+         */
+        template<class T>
+        CompactOArchive &operator&(const T &value)
+          { save(value); return *this; }
+
+        /**
+         * Serializes the given value.
+         * @param value[in] The value to serialize.
+         * @return This archive.
+         */
+        template<class T>
+        CompactOArchive &operator<<(const T &value)
+          { save(value); return *this; }
+
+        /**
+         * @return True if everything so far was written successfully.
+         */
+        bool good(void) const
+          { return not failed; }
+
+    private:
+        void save(const bool value);
+        void save(const char value);
+        void save(const signed char value);
+        void save(const unsigned char value);
+        void save(const short value);
+        void save(const unsigned short value);
+        void save(const int value);
+        void save(const unsigned int value);
+        void save(const long value);
+        void save(const unsigned long value);
+        void save(const long long value);
+        void save(const unsigned long long value);
+        void save(const float value);
+        void save(const double value);
+        void save(const long double value);
+        void save(const std::string &value);
+
+        template<class T, class A>
+        void save(const std::vector<T, A> &value);
+
+        template<class T, class A>
+        void save(const std::list<T, A> &value);
+
+        template<class K, class C, class A>
+        void save(const std::set<K, C, A> &value);
+
+        template<class K, class V, class C, class A>
+        void save(const std::map<K, V, C, A> &value);
+
+        template<class F, class S>
+        void save(const std::pair<F, S> &value);
+
+        template<size_t N>
+        void save(const std::bitset<N> &value);
+
+        /**
+         * Serializes an enum or a class with boost serialize() or
+         * save()/load() methods.
+         */
+        template<class T>
+        void save(const T &value);
+
+        template<class T>
+        void save_object(const T &value, const std::true_type is_enum);
+
+        template<class T>
+        void save_object(const T &value, const std::false_type is_enum);
+
+        /**
+         * Serializes the elements of a container, preceded by the count.
+         */
+        template<class Iter>
+        void save_range(const size_t count, Iter begin, const Iter end);
+
+        /**
+         * Writes an unsigned integer, 7 bits per byte, low bits first.
+         */
+        void save_varint(std::uint64_t value);
+
+        /**
+         * Writes a signed integer using save_varint(), zigzag encoded so
+         * small negative numbers are also short.
+         */
+        void save_signed(const std::int64_t value);
+
+        /**
+         * Writes raw bytes.
+         */
+        void save_bytes(const void *data_ptr, const size_t size);
+
+        std::streambuf &output; ///< Where the data goes
+        bool failed; ///< True if a write failed
+    };
+
+    /**
+     * The input archive matching CompactOArchive, for the dbtypes' load()
+     * methods.  Rather than throwing when the data is truncated or
+     * corrupt, reads after an error return zeros and good() returns false.
+     */
+    class CompactIArchive
+    {
+    public:
+        typedef boost::mpl::bool_<false> is_saving;
+        typedef boost::mpl::bool_<true> is_loading;
+
+        /**
+         * Determines if the given data was written by CompactOArchive.
+         * @param data_ptr[in] The serialized data.
+         * @param data_size[in] The size of the data in bytes.
+         * @return True if the data has the compact header.
+         */
+        static bool is_compact(const void *data_ptr, const size_t data_size);
+
+        /**
+         * Creates the archive and reads the header.
+         * @param buffer[in] The serialized data.
+         */
+        CompactIArchive(std::streambuf &buffer);
+
+        /**
+         * Deserializes into the given value.
+         * @param value[out] The value to deserialize into.
+         * @return This archive.
+         */
+        template<class T>
+        CompactIArchive &operator&(T &value)
+          { load(value); return *this; }
+
+        /**
+         * Deserializes into the given value.
+         * @param value[out] The value to deserialize into.
+         * @return This archive.
+         */
+        template<class T>
+        CompactIArchive &operator>>(T &value)
+          { load(value); return *this; }
+
+        /**
+         * @return True if the header was valid and everything so far was
+         * read successfully.
+         */
+        bool good(void) const
+          { return not failed; }
+
+        /**
+         * @return The format version from the header.
+         */
+        unsigned char get_format_version(void) const
+          { return format_version; }
+
+    private:
+        void load(bool &value);
+        void load(char &value);
+        void load(signed char &value);
+        void load(unsigned char &value);
+        void load(short &value);
+        void load(unsigned short &value);
+        void load(int &value);
+        void load(unsigned int &value);
+        void load(long &value);
+        void load(unsigned long &value);
+        void load(long long &value);
+        void load(unsigned long long &value);
+        void load(float &value);
+        void load(double &value);
+        void load(long double &value);
+        void load(std::string &value);
+
+        template<class T, class A>
+        void load(std::vector<T, A> &value);
+
+        template<class T, class A>
+        void load(std::list<T, A> &value);
+
+        template<class K, class C, class A>
+        void load(std::set<K, C, A> &value);
+
+        template<class K, class V, class C, class A>
+        void load(std::map<K, V, C, A> &value);
+
+        template<class F, class S>
+        void load(std::pair<F, S> &value);
+
+        template<size_t N>
+        void load(std::bitset<N> &value);
+
+        /**
+         * Deserializes an enum or a class with boost serialize() or
+         * save()/load() methods.
+         */
+        template<class T>
+        void load(T &value);
+
+        template<class T>
+        void load_object(T &value, const std::true_type is_enum);
+
+        template<class T>
+        void load_object(T &value, const std::false_type is_enum);
+
+        /**
+         * Reads a container element count.  The count is sanity checked
+         * against how much data is left, so corrupt data cannot cause a
+         * huge allocation.
+         * @return The count, or 0 if error.
+         */
+        size_t load_count(void);
+
+        /**
+         * Reads an integer written by save_varint().
+         */
+        std::uint64_t load_varint(void);
+
+        /**
+         * Reads an integer written by save_signed().
+         */
+        std::int64_t load_signed(void);
+
+        /**
+         * Reads raw bytes.  On error, the bytes are zeroed.
+         */
+        void load_bytes(void *data_ptr, const size_t size);
+
+        std::streambuf &input; ///< Where the data comes from
+        bool failed; ///< True if header was bad or a read failed
+        unsigned char format_version; ///< Version from the header
+    };
+
+    // ----------------------------------------------------------------------
+    template<class T, class A>
+    void CompactOArchive::save(const std::vector<T, A> &value)
+    {
+        save_range(value.size(), value.begin(), value.end());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T, class A>
+    void CompactOArchive::save(const std::list<T, A> &value)
+    {
+        save_range(value.size(), value.begin(), value.end());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class K, class C, class A>
+    void CompactOArchive::save(const std::set<K, C, A> &value)
+    {
+        save_range(value.size(), value.begin(), value.end());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class K, class V, class C, class A>
+    void CompactOArchive::save(const std::map<K, V, C, A> &value)
+    {
+        save_range(value.size(), value.begin(), value.end());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class F, class S>
+    void CompactOArchive::save(const std::pair<F, S> &value)
+    {
+        save(value.first);
+        save(value.second);
+    }
+
+    // ----------------------------------------------------------------------
+    template<size_t N>
+    void CompactOArchive::save(const std::bitset<N> &value)
+    {
+        unsigned char packed = 0;
+
+        for (size_t bit = 0; bit < N; ++bit)
+        {
+            if (value.test(bit))
+            {
+                packed |= (unsigned char) (1 << (bit % 8));
+            }
+
+            if (((bit % 8) == 7) or (bit == (N - 1)))
+            {
+                save_bytes(&packed, 1);
+                packed = 0;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactOArchive::save(const T &value)
+    {
+        save_object(value, typename std::is_enum<T>::type());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactOArchive::save_object(
+        const T &value,
+        const std::true_type is_enum)
+    {
+        save_signed((std::int64_t) value);
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactOArchive::save_object(
+        const T &value,
+        const std::false_type is_enum)
+    {
+        // Same as what boost does; save() will not modify it.
+        boost::serialization::serialize_adl(*this, const_cast<T &>(value), 0);
+    }
+
+    // ----------------------------------------------------------------------
+    template<class Iter>
+    void CompactOArchive::save_range(
+        const size_t count,
+        Iter begin,
+        const Iter end)
+    {
+        save_varint(count);
+
+        for (; begin != end; ++begin)
+        {
+            save(*begin);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T, class A>
+    void CompactIArchive::load(std::vector<T, A> &value)
+    {
+        const size_t count = load_count();
+
+        value.clear();
+        value.resize(count);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            load(value[index]);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T, class A>
+    void CompactIArchive::load(std::list<T, A> &value)
+    {
+        const size_t count = load_count();
+
+        value.clear();
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            value.push_back(T());
+            load(value.back());
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class K, class C, class A>
+    void CompactIArchive::load(std::set<K, C, A> &value)
+    {
+        const size_t count = load_count();
+
+        value.clear();
+
+        // Saved in order, so always insert at the end.
+        //
+        for (size_t index = 0; index < count; ++index)
+        {
+            K key;
+            load(key);
+            value.insert(value.end(), key);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class K, class V, class C, class A>
+    void CompactIArchive::load(std::map<K, V, C, A> &value)
+    {
+        const size_t count = load_count();
+
+        value.clear();
+
+        // Saved in order, so always insert at the end.
+        //
+        for (size_t index = 0; index < count; ++index)
+        {
+            K key;
+            load(key);
+
+            typename std::map<K, V, C, A>::iterator inserted_iter =
+                value.insert(value.end(), std::make_pair(key, V()));
+            load(inserted_iter->second);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class F, class S>
+    void CompactIArchive::load(std::pair<F, S> &value)
+    {
+        load(value.first);
+        load(value.second);
+    }
+
+    // ----------------------------------------------------------------------
+    template<size_t N>
+    void CompactIArchive::load(std::bitset<N> &value)
+    {
+        unsigned char packed = 0;
+
+        value.reset();
+
+        for (size_t bit = 0; bit < N; ++bit)
+        {
+            if ((bit % 8) == 0)
+            {
+                load_bytes(&packed, 1);
+            }
+
+            if (packed & (1 << (bit % 8)))
+            {
+                value.set(bit);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactIArchive::load(T &value)
+    {
+        load_object(value, typename std::is_enum<T>::type());
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactIArchive::load_object(T &value, const std::true_type is_enum)
+    {
+        value = (T) load_signed();
+    }
+
+    // ----------------------------------------------------------------------
+    template<class T>
+    void CompactIArchive::load_object(T &value, const std::false_type is_enum)
+    {
+        boost::serialization::serialize_adl(*this, value, 0);
+    }
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_COMPACTARCHIVE_H
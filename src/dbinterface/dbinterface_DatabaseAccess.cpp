@@ -1,10 +1,13 @@
 #include <deque>
+#include <map>
+#include <vector>
 
 #include "dbinterface_DatabaseAccess.h"
 #include "dbinterface_UpdateManager.h"
 #include "sqliteinterface/sqliteinterface_SqliteBackend.h"
 
 #include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
 
 #include "concurrency/concurrency_WriterLockToken.h"
 #include "concurrency/concurrency_ReaderLockToken.h"
@@ -13,6 +16,17 @@
 
 #include "logging/log_Logger.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace
+{
+    // TODO make data driven
+    /** If true, caches are preloaded at startup */
+    const bool PRELOAD_ENABLED = true;
+    /** Most recently accessed Entities to preload per site, of any type */
+    const size_t PRELOAD_RECENT_ENTITIES = 2000;
+}
+
 namespace mutgos
 {
 namespace dbinterface
@@ -66,6 +80,11 @@ namespace dbinterface
                     db_backend_ptr->get_site_ids_in_db();
 
                 valid_site_ids.insert(site_ids.begin(), site_ids.end());
+
+                if (PRELOAD_ENABLED)
+                {
+                    preload_caches();
+                }
             }
         }
 
@@ -165,6 +184,71 @@ namespace dbinterface
         return ref;
     }
 
+    // ----------------------------------------------------------------------
+    EntityRefVector DatabaseAccess::get_entities(
+        const dbtype::Entity::IdVector &ids)
+    {
+        typedef std::map<dbtype::Id::SiteIdType, std::vector<size_t> >
+            SiteIndicesMap;
+
+        EntityRefVector refs(ids.size());
+        SiteIndicesMap site_indices;
+
+        // Group by site so each site cache is asked only once.
+        //
+        for (size_t index = 0; index < ids.size(); ++index)
+        {
+            if (not ids[index].is_default())
+            {
+                site_indices[ids[index].get_site_id()].push_back(index);
+            }
+        }
+
+        for (SiteIndicesMap::const_iterator site_iter = site_indices.begin();
+            site_iter != site_indices.end();
+            ++site_iter)
+        {
+            SiteCache *cache_ptr = get_site_cache(site_iter->first);
+
+            if (not cache_ptr)
+            {
+                LOG(error, "dbinterface", "get_entities",
+                    "Could not get site cache for site "
+                    + text::to_string(site_iter->first));
+            }
+            else
+            {
+                dbtype::Entity::IdVector site_ids;
+                EntityRefVector site_refs;
+
+                site_ids.reserve(site_iter->second.size());
+
+                for (std::vector<size_t>::const_iterator index_iter =
+                        site_iter->second.begin();
+                    index_iter != site_iter->second.end();
+                    ++index_iter)
+                {
+                    site_ids.push_back(ids[*index_iter]);
+                }
+
+                cache_ptr->get_entity_refs(site_ids, site_refs);
+
+                for (size_t index = 0; index < site_refs.size(); ++index)
+                {
+                    // Filter out Entities in the process of being deleted.
+                    //
+                    if (site_refs[index].valid() and
+                        (not site_refs[index].is_delete_pending()))
+                    {
+                        refs[site_iter->second[index]] = site_refs[index];
+                    }
+                }
+            }
+        }
+
+        return refs;
+    }
+
     // ----------------------------------------------------------------------
     EntityRef DatabaseAccess::get_entity_deleted(const dbtype::Id &id)
     {
@@ -464,6 +548,40 @@ namespace dbinterface
         return db_backend_ptr->find_in_db(site_id);
     }
 
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector DatabaseAccess::find(
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::EntityType type)
+    {
+        return db_backend_ptr->find_in_db(site_id, type);
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::get_program_bytecode(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        std::string &bytecode)
+    {
+        return db_backend_ptr->get_program_bytecode_db(
+            id,
+            source_code,
+            bytecode);
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::save_program_bytecode(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        const char * const bytecode_ptr,
+        const size_t bytecode_size)
+    {
+        return db_backend_ptr->save_program_bytecode_db(
+            id,
+            source_code,
+            bytecode_ptr,
+            bytecode_size);
+    }
+
     // ----------------------------------------------------------------------
     dbtype::Id::SiteIdVector DatabaseAccess::get_all_site_ids(void)
     {
@@ -493,6 +611,8 @@ namespace dbinterface
     DbResultCode DatabaseAccess::delete_site(
         const dbtype::Id::SiteIdType site_id)
     {
+        // The site cache may be deleted, so wait for any eviction pass.
+        boost::lock_guard<boost::mutex> evict_guard(evict_mutex);
         boost::lock_guard<boost::mutex> guard(mutex);
 
         DbResultCode rc = DBRESULTCODE_OK;
@@ -547,6 +667,23 @@ namespace dbinterface
         return rc;
     }
 
+    // ----------------------------------------------------------------------
+    SiteCache::CacheStats DatabaseAccess::get_cache_stats(void)
+    {
+        SiteCache::CacheStats stats;
+
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        for (CacheMap::iterator cache_iter = entity_cache.begin();
+             cache_iter != entity_cache.end();
+             ++cache_iter)
+        {
+            stats += cache_iter->second->get_stats();
+        }
+
+        return stats;
+    }
+
     // ----------------------------------------------------------------------
     bool DatabaseAccess::internal_commit_entity(EntityRef entity)
     {
@@ -600,6 +737,72 @@ namespace dbinterface
         return rc;
     }
 
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_begin_batch(void)
+    {
+        return db_backend_ptr and db_backend_ptr->begin_batch();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DatabaseAccess::internal_commit_batch(void)
+    {
+        return db_backend_ptr and db_backend_ptr->commit_batch();
+    }
+
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::internal_evict_cache(void)
+    {
+        size_t evicted = 0;
+        SiteCache::CacheStats stats;
+        dbtype::Entity::IdSet pending_ids;
+        std::vector<SiteCache *> caches;
+
+        // Taken once for the whole pass rather than per Entity.  Anything
+        // queued afterwards was changed after the snapshot, so it is
+        // still dirty (only this thread saves) or already out of the cache.
+        //
+        if (UpdateManager::instance())
+        {
+            UpdateManager::instance()->get_pending_ids(pending_ids);
+        }
+
+        // Held the whole time so no site cache can be deleted while
+        // evicting from it, without blocking anything else.
+        //
+        boost::lock_guard<boost::mutex> evict_guard(evict_mutex);
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            for (CacheMap::iterator cache_iter = entity_cache.begin();
+                 cache_iter != entity_cache.end();
+                 ++cache_iter)
+            {
+                caches.push_back(cache_iter->second);
+            }
+        }
+
+        const size_t total_bytes = SiteCache::get_total_resident_bytes();
+
+        for (size_t index = 0; index < caches.size(); ++index)
+        {
+            evicted += caches[index]->evict(total_bytes, pending_ids);
+            stats += caches[index]->get_stats();
+        }
+
+        const MG_LongUnsignedInt gets = stats.hits + stats.misses;
+
+        LOG(info, "dbinterface", "internal_evict_cache",
+            "Evicted " + text::to_string(evicted)
+            + " Entities.  Resident: "
+            + text::to_string(stats.resident_entities)
+            + " Entities, " + text::to_string(stats.resident_bytes)
+            + " bytes.  Hit rate: "
+            + text::to_string(gets ? (stats.hits * 100) / gets : 0)
+            + "%  Total evictions: " + text::to_string(stats.evictions));
+    }
+
     // ----------------------------------------------------------------------
     DatabaseAccess::DatabaseAccess(void)
       : db_backend_ptr(0)
@@ -699,5 +902,78 @@ namespace dbinterface
 
         return site_ptr;
     }
+
+    // ----------------------------------------------------------------------
+    void DatabaseAccess::preload_caches(void)
+    {
+        DbBackend::EntityTypeVector types;
+        DbBackend::EntityPtrVector entities;
+        ValidSiteIdsSet site_ids;
+        size_t total_preloaded = 0;
+        const boost::posix_time::ptime start_time =
+            boost::posix_time::microsec_clock::universal_time();
+
+        types.push_back(dbtype::ENTITYTYPE_region);
+        types.push_back(dbtype::ENTITYTYPE_room);
+        types.push_back(dbtype::ENTITYTYPE_program);
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+            site_ids = valid_site_ids;
+        }
+
+        LOG(info, "dbinterface", "preload_caches",
+            "Preloading caches for " + text::to_string(site_ids.size())
+            + " sites...");
+
+        for (ValidSiteIdsSet::const_iterator site_iter =
+                site_ids.begin();
+            site_iter != site_ids.end();
+            ++site_iter)
+        {
+            SiteCache * const cache_ptr = get_site_cache(*site_iter);
+
+            if (cache_ptr)
+            {
+                const boost::posix_time::ptime site_start_time =
+                    boost::posix_time::microsec_clock::universal_time();
+
+                db_backend_ptr->get_preload_entities_db(
+                    *site_iter,
+                    types,
+                    PRELOAD_RECENT_ENTITIES,
+                    cache_ptr->get_preload_budget(),
+                    entities);
+
+                const size_t preloaded =
+                    cache_ptr->add_preloaded_entities(entities);
+
+                total_preloaded += preloaded;
+
+                LOG(info, "dbinterface", "preload_caches",
+                    "Preloaded site " + text::to_string(*site_iter)
+                    + ": " + text::to_string(preloaded) + " of "
+                    + text::to_string(entities.size())
+                    + " Entities read in "
+                    + text::to_string(
+                        (boost::posix_time::microsec_clock::universal_time()
+                            - site_start_time).total_milliseconds())
+                    + " ms.");
+
+                entities.clear();
+            }
+        }
+
+        LOG(info, "dbinterface", "preload_caches",
+            "Preloaded " + text::to_string(total_preloaded)
+            + " Entities in "
+            + text::to_string(
+                (boost::posix_time::microsec_clock::universal_time()
+                    - start_time).total_milliseconds())
+            + " ms.  Cache using "
+            + text::to_string(SiteCache::get_total_resident_bytes())
+            + " bytes.");
+    }
 }
 }
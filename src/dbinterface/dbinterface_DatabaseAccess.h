@@ -102,6 +102,19 @@ namespace dbinterface
          */
         EntityRef get_entity(const dbtype::Id &id);
 
+        /**
+         * Gets the Entities for the given IDs from the database and returns
+         * them.  This is faster than calling get_entity() for each ID
+         * because Entities not already cached are loaded together.
+         * NOTE: This will not return any Entities that are marked as deleted.
+         * @param ids[in] The IDs of the Entities to get.  They may be from
+         * different sites.
+         * @return References to the Entities, in the same order as ids.  A
+         * reference is not valid if its ID is defaulted, not found, marked as
+         * deleted, or has an error.
+         */
+        EntityRefVector get_entities(const dbtype::Entity::IdVector &ids);
+
         /**
          * Gets the Entity for the given ID from the database and returns it,
          * even if the Entity is marked for deletion.
@@ -200,6 +213,16 @@ namespace dbinterface
         dbtype::Entity::IdVector find(
             const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * @param site_id[in] The site ID to get the IDs for.
+         * @param type[in] The type of entity to get the IDs of.
+         * @return All valid Entity IDs of the given type for the given site,
+         * or empty if none or site doesn't exist.
+         */
+        dbtype::Entity::IdVector find(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type);
+
         /**
          * @return A list of all known site IDs in the database.
          */
@@ -229,6 +252,40 @@ namespace dbinterface
          */
         DbResultCode delete_site(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Gets the bytecode saved for a Program, if it was compiled from
+         * the given source code.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The Program's current source code.
+         * @param bytecode[out] The bytecode, if found.
+         * @return True if bytecode compiled from source_code was found.
+         */
+        bool get_program_bytecode(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            std::string &bytecode);
+
+        /**
+         * Saves the bytecode for a Program, replacing any saved before, so
+         * it does not need to be compiled again after a restart.  It is
+         * deleted along with the Program.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The source code that was compiled.
+         * @param bytecode_ptr[in] The bytecode.
+         * @param bytecode_size[in] The size of bytecode_ptr.
+         * @return True if saved.
+         */
+        bool save_program_bytecode(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            const char * const bytecode_ptr,
+            const size_t bytecode_size);
+
+        /**
+         * @return Statistics for the Entity cache, summed across all sites.
+         */
+        SiteCache::CacheStats get_cache_stats(void);
+
         /**
          * ** Internal namespace use only **
          * Commits an Entity's changes to the actual database backend.
@@ -249,6 +306,31 @@ namespace dbinterface
          */
         DbResultCode internal_delete_entity(const dbtype::Id entity_id);
 
+        /**
+         * ** Internal namespace use only **
+         * Starts a batch of writes to the database backend.  All commits and
+         * deletes until internal_commit_batch() is called are written
+         * together.
+         * @return True if success.
+         */
+        bool internal_begin_batch(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Commits the batch of writes started by internal_begin_batch().
+         * @return True if success, false if the batch failed and nothing in
+         * it was written.
+         */
+        bool internal_commit_batch(void);
+
+        /**
+         * ** Internal namespace use only **
+         * Evicts unused Entities from each site's cache until the caches are
+         * within their memory budget.  Only the UpdateManager thread may
+         * call this, when it has no uncommitted writes.
+         */
+        void internal_evict_cache(void);
+
     private:
         /**
          * Private singleton constructor.
@@ -285,6 +367,14 @@ namespace dbinterface
             const dbtype::Id::SiteIdType site_id,
             const bool include_delete_pending = false);
 
+        /**
+         * Called during startup to load each site's Entities that are likely
+         * to be needed soon into its cache: all Regions, Rooms and Programs,
+         * and the most recently accessed Entities.
+         * This avoids a flood of individual loads when players log in.
+         */
+        void preload_caches(void);
+
         typedef std::map<dbtype::Id::SiteIdType, SiteCache *> CacheMap;
         typedef std::set<dbtype::Id::SiteIdType> ValidSiteIdsSet;
         typedef std::vector<DatabaseEntityListener *> EntityListenerList;
@@ -295,6 +385,7 @@ namespace dbinterface
         CacheMap entity_cache; ///< Cache of entities, organized by site.
         ValidSiteIdsSet valid_site_ids; ///< Set of valid site IDs
         boost::mutex mutex; ///< Enforces single access at a time.
+        boost::mutex evict_mutex; ///< Held while evicting or deleting a site.  Taken before mutex
     };
 }
 }
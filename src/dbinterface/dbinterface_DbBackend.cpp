@@ -9,8 +9,7 @@
 #include "dbtypes/dbtype_Id.h"
 #include "concurrency/concurrency_WriterLockToken.h"
 
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
+#include "dbinterface_EntityCodec.h"
 
 #include "dbtypes/dbtype_Group.h"
 #include "dbtypes/dbtype_Capability.h"
@@ -54,6 +53,65 @@ namespace dbinterface
         return true;
     }
 
+    // ----------------------------------------------------------------------
+    void DbBackend::get_entities_db(
+        const dbtype::Entity::IdVector &ids,
+        EntityPtrVector &entities)
+    {
+        entities.clear();
+        entities.reserve(ids.size());
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            entities.push_back(get_entity_db(*id_iter));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void DbBackend::get_preload_entities_db(
+        const dbtype::Id::SiteIdType site_id,
+        const EntityTypeVector &types,
+        const size_t recent_count,
+        const size_t max_bytes,
+        EntityPtrVector &entities)
+    {
+        entities.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::begin_batch(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::commit_batch(void)
+    {
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::get_program_bytecode_db(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        std::string &bytecode)
+    {
+        bytecode.clear();
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool DbBackend::save_program_bytecode_db(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        const char * const bytecode_ptr,
+        const size_t bytecode_size)
+    {
+        return true;
+    }
+
     // ----------------------------------------------------------------------
     bool DbBackend::added_mem_owned(dbtype::Entity *entity_ptr)
     {
@@ -308,142 +366,10 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     dbtype::Entity* DbBackend::make_deserialize_entity(
         const dbtype::EntityType type,
-        utility::MemoryBuffer &buffer)
+        const void *data_ptr,
+        const size_t data_size)
     {
-        dbtype::Entity *entity_ptr = 0;
-        boost::archive::binary_iarchive archive(buffer);
-
-        switch (type)
-        {
-            case dbtype::ENTITYTYPE_group:
-            {
-                dbtype::Group *group_ptr = new dbtype::Group();
-                archive >> *group_ptr;
-
-                entity_ptr = group_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_capability:
-            {
-                dbtype::Capability *capability_ptr = new dbtype::Capability();
-                archive >> *capability_ptr;
-
-                entity_ptr = capability_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_container_property_entity:
-            {
-                dbtype::ContainerPropertyEntity *containerprop_ptr =
-                    new dbtype::ContainerPropertyEntity();
-                archive >> *containerprop_ptr;
-
-                entity_ptr = containerprop_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_region:
-            {
-                dbtype::Region *region_ptr = new dbtype::Region();
-                archive >> *region_ptr;
-
-                entity_ptr = region_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_room:
-            {
-                dbtype::Room *room_ptr = new dbtype::Room();
-                archive >> *room_ptr;
-
-                entity_ptr = room_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_player:
-            {
-                dbtype::Player *player_ptr = new dbtype::Player();
-                archive >> *player_ptr;
-
-                entity_ptr = player_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_guest:
-            {
-                dbtype::Guest *guest_ptr = new dbtype::Guest();
-                archive >> *guest_ptr;
-
-                entity_ptr = guest_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_thing:
-            {
-                dbtype::Thing *thing_ptr = new dbtype::Thing();
-                archive >> *thing_ptr;
-
-                entity_ptr = thing_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_puppet:
-            {
-                dbtype::Puppet *puppet_ptr = new dbtype::Puppet();
-                archive >> *puppet_ptr;
-
-                entity_ptr = puppet_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_vehicle:
-            {
-                dbtype::Vehicle *vehicle_ptr = new dbtype::Vehicle();
-                archive >> *vehicle_ptr;
-
-                entity_ptr = vehicle_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_program:
-            {
-                dbtype::Program *program_ptr = new dbtype::Program();
-                archive >> *program_ptr;
-
-                entity_ptr = program_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_exit:
-            {
-                dbtype::Exit *exit_ptr = new dbtype::Exit();
-                archive >> *exit_ptr;
-
-                entity_ptr = exit_ptr;
-                break;
-            }
-
-            case dbtype::ENTITYTYPE_command:
-            {
-                dbtype::Command *command_ptr = new dbtype::Command();
-                archive >> *command_ptr;
-
-                entity_ptr = command_ptr;
-                break;
-            }
-
-            default:
-            {
-            }
-        }
-
-        if (entity_ptr)
-        {
-            entity_ptr->restore_complete();
-        }
-
-        return entity_ptr;
+        return EntityCodec::deserialize(type, data_ptr, data_size);
     }
 
     // ----------------------------------------------------------------------
@@ -451,245 +377,7 @@ namespace dbinterface
         dbtype::Entity *entity_ptr,
         utility::MemoryBuffer &buffer)
     {
-        bool success = entity_ptr;
-
-        if (success)
-        {
-            boost::archive::binary_oarchive archive(buffer);
-
-            switch (entity_ptr->get_entity_type())
-            {
-                case dbtype::ENTITYTYPE_group:
-                {
-                    dbtype::Group *group_ptr =
-                        dynamic_cast<dbtype::Group *>(entity_ptr);
-
-                    if (group_ptr)
-                    {
-                        archive << (*group_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_capability:
-                {
-                    dbtype::Capability *capability_ptr =
-                        dynamic_cast<dbtype::Capability *>(entity_ptr);
-
-                    if (capability_ptr)
-                    {
-                        archive << (*capability_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_container_property_entity:
-                {
-                    dbtype::ContainerPropertyEntity *contprop_ptr =
-                        dynamic_cast<dbtype::ContainerPropertyEntity *>(
-                            entity_ptr);
-
-                    if (contprop_ptr)
-                    {
-                        archive << (*contprop_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_region:
-                {
-                    dbtype::Region *region_ptr =
-                        dynamic_cast<dbtype::Region *>(entity_ptr);
-
-                    if (region_ptr)
-                    {
-                        archive << (*region_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_room:
-                {
-                    dbtype::Room *room_ptr =
-                        dynamic_cast<dbtype::Room *>(entity_ptr);
-
-                    if (room_ptr)
-                    {
-                        archive << (*room_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_player:
-                {
-                    dbtype::Player *player_ptr =
-                        dynamic_cast<dbtype::Player *>(entity_ptr);
-
-                    if (player_ptr)
-                    {
-                        archive << (*player_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_guest:
-                {
-                    dbtype::Guest *guest_ptr =
-                        dynamic_cast<dbtype::Guest *>(entity_ptr);
-
-                    if (guest_ptr)
-                    {
-                        archive << (*guest_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_thing:
-                {
-                    dbtype::Thing *thing_ptr =
-                        dynamic_cast<dbtype::Thing *>(entity_ptr);
-
-                    if (thing_ptr)
-                    {
-                        archive << (*thing_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_puppet:
-                {
-                    dbtype::Puppet *puppet_ptr =
-                        dynamic_cast<dbtype::Puppet *>(entity_ptr);
-
-                    if (puppet_ptr)
-                    {
-                        archive << (*puppet_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_vehicle:
-                {
-                    dbtype::Vehicle *vehicle_ptr =
-                        dynamic_cast<dbtype::Vehicle *>(entity_ptr);
-
-                    if (vehicle_ptr)
-                    {
-                        archive << (*vehicle_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_program:
-                {
-                    dbtype::Program *program_ptr =
-                        dynamic_cast<dbtype::Program *>(entity_ptr);
-
-                    if (program_ptr)
-                    {
-                        archive << (*program_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_exit:
-                {
-                    dbtype::Exit *exit_ptr =
-                        dynamic_cast<dbtype::Exit *>(entity_ptr);
-
-                    if (exit_ptr)
-                    {
-                        archive << (*exit_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                case dbtype::ENTITYTYPE_command:
-                {
-                    dbtype::Command *command_ptr =
-                        dynamic_cast<dbtype::Command *>(entity_ptr);
-
-                    if (command_ptr)
-                    {
-                        archive << (*command_ptr);
-                    }
-                    else
-                    {
-                        success = false;
-                    }
-
-                    break;
-                }
-
-                default:
-                {
-                    // Not a type we can serialize.
-                    success = false;
-                }
-            }
-        }
-
-        return success;
+        return EntityCodec::serialize(entity_ptr, buffer);
     }
 }
 }
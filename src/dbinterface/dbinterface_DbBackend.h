@@ -47,6 +47,9 @@ namespace dbinterface
     class DbBackend
     {
     public:
+        typedef std::vector<dbtype::Entity *> EntityPtrVector;
+        typedef std::vector<dbtype::EntityType> EntityTypeVector;
+
         /**
          * Default.
          */
@@ -120,6 +123,46 @@ namespace dbinterface
          */
         virtual dbtype::Entity *get_entity_db(const dbtype::Id &id) =0;
 
+        /**
+         * Gets several Entities in the same site from the database.  Any
+         * already present in memory are provided as the existing pointer.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * The default implementation calls get_entity_db() for each ID.
+         * @param ids[in] The IDs of the Entities to retrieve.  All must be in
+         * the same site.
+         * @param entities[out] Pointers to the Entities retrieved, in the
+         * same order as ids.  A pointer is null if not found.
+         */
+        virtual void get_entities_db(
+            const dbtype::Entity::IdVector &ids,
+            EntityPtrVector &entities);
+
+        /**
+         * Gets the Entities in a site that are likely to be used soon, so
+         * they can be preloaded into the cache at startup.  Any already
+         * present in memory are provided as the existing pointer.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * The default implementation gets nothing.
+         * @param site_id[in] The site to get Entities from.
+         * @param types[in] All Entities of these types are gotten.
+         * @param recent_count[in] Up to this many of the most recently
+         * accessed Entities, of any type, are also gotten.
+         * @param max_bytes[in] Stop getting Entities once this many bytes of
+         * serialized data have been read.  Entities take more memory than
+         * their serialized form, so this bounds the work done when only
+         * that much memory is left to fill.
+         * @param entities[out] Pointers to the Entities retrieved, most
+         * recently accessed first.  None will be null.
+         */
+        virtual void get_preload_entities_db(
+            const dbtype::Id::SiteIdType site_id,
+            const EntityTypeVector &types,
+            const size_t recent_count,
+            const size_t max_bytes,
+            EntityPtrVector &entities);
+
         /**
          * Saves the given Entity to the database.  Existing Entity data for
          * that ID and version are overwritten.
@@ -181,6 +224,16 @@ namespace dbinterface
         virtual dbtype::Entity::IdVector find_in_db(
             const dbtype::Id::SiteIdType site_id) =0;
 
+        /**
+         * @param site_id[in] The site ID to get the IDs for.
+         * @param type[in] The type of entity to get the IDs of.
+         * @return All valid Entity IDs of the given type for the given site,
+         * or empty if none or site doesn't exist.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type) =0;
+
         /**
          * @return A list of all known site IDs in the database.
          */
@@ -202,6 +255,59 @@ namespace dbinterface
          */
         virtual bool delete_site_in_db(const dbtype::Id::SiteIdType site_id) =0;
 
+        /**
+         * Starts a batch of database writes.  All saves and deletes of
+         * Entities made until commit_batch() is called are grouped
+         * together and committed as a unit, if the backend supports it.
+         * Other writes, such as new Entities and sites, must not be
+         * rolled back with a failed batch.  Batches do not nest.
+         * The default implementation does nothing.
+         * @return True if success (or batches not supported).
+         */
+        virtual bool begin_batch(void);
+
+        /**
+         * Commits the batch started by begin_batch().  If no batch was
+         * started, this does nothing.
+         * The default implementation does nothing.
+         * @return True if the batch was committed (or batches not
+         * supported), false if the batch failed and its writes have been
+         * rolled back.
+         */
+        virtual bool commit_batch(void);
+
+        /**
+         * Gets the bytecode saved for a Program, if it was compiled from
+         * the given source code.  Bytecode is kept apart from the Program
+         * Entity, so it isn't rewritten every time the Entity is saved.
+         * The default implementation never has any.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The Program's current source code.
+         * @param bytecode[out] The bytecode, if found.
+         * @return True if bytecode compiled from source_code was found.
+         */
+        virtual bool get_program_bytecode_db(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            std::string &bytecode);
+
+        /**
+         * Saves the bytecode for a Program, replacing any saved before.  It
+         * is deleted along with the Program.  Losing it is harmless, since
+         * the Program will just be compiled again.
+         * The default implementation does nothing.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The source code that was compiled.
+         * @param bytecode_ptr[in] The bytecode.
+         * @param bytecode_size[in] The size of bytecode_ptr.
+         * @return True if saved (or not supported).
+         */
+        virtual bool save_program_bytecode_db(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            const char * const bytecode_ptr,
+            const size_t bytecode_size);
+
     protected:
         /**
          * Adds an entity pointer as being owned by this DbBackend.
@@ -262,17 +368,18 @@ namespace dbinterface
 
         /**
          * Given a type, creates a corresponding new Entity in memory only, and
-         * deserializes it.
+         * deserializes it.  The data may be in any format EntityCodec reads.
          * Caller must manage the pointer.
          * @param type[in] The type of Entity to deserialize.
-         * @param_type[in,out] The buffer of data to be deserialized.  The
-         * position within the buffer is modified.
+         * @param data_ptr[in] The serialized Entity.
+         * @param data_size[in] The size of data_ptr, in bytes.
          * @return The pointer to the newly created and deserialized entity,
          * or null if error or invalid type.
          */
         dbtype::Entity *make_deserialize_entity(
             const dbtype::EntityType type,
-            utility::MemoryBuffer &buffer);
+            const void *data_ptr,
+            const size_t data_size);
 
         /**
          * Given an Entity, serialize it and place the result into the buffer.
@@ -0,0 +1,494 @@
+/*
+ * dbinterface_EntityCodec.cpp
+ */
+
+#include <stddef.h>
+
+#include "dbinterface_EntityCodec.h"
+#include "dbinterface_CompactArchive.h"
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include "dbtypes/dbtype_Group.h"
+#include "dbtypes/dbtype_Capability.h"
+#include "dbtypes/dbtype_ContainerPropertyEntity.h"
+#include "dbtypes/dbtype_Region.h"
+#include "dbtypes/dbtype_Room.h"
+#include "dbtypes/dbtype_Player.h"
+#include "dbtypes/dbtype_Guest.h"
+#include "dbtypes/dbtype_Thing.h"
+#include "dbtypes/dbtype_Puppet.h"
+#include "dbtypes/dbtype_Vehicle.h"
+#include "dbtypes/dbtype_Program.h"
+#include "dbtypes/dbtype_Command.h"
+#include "dbtypes/dbtype_Exit.h"
+
+#include "utilities/utility_MemoryBuffer.h"
+
+#include "logging/log_Logger.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    // ----------------------------------------------------------------------
+    bool EntityCodec::serialize(
+        dbtype::Entity *entity_ptr,
+        utility::MemoryBuffer &buffer,
+        const Format format)
+    {
+        bool success = false;
+
+        if (format == FORMAT_COMPACT)
+        {
+            CompactOArchive archive(buffer);
+            success = serialize_archive(entity_ptr, archive) and
+                archive.good();
+        }
+        else
+        {
+            boost::archive::binary_oarchive archive(buffer);
+            success = serialize_archive(entity_ptr, archive);
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *EntityCodec::deserialize(
+        const dbtype::EntityType type,
+        const void *data_ptr,
+        const size_t data_size)
+    {
+        dbtype::Entity *entity_ptr = 0;
+        utility::MemoryBuffer buffer(data_ptr, data_size);
+
+        if (get_format(data_ptr, data_size) == FORMAT_COMPACT)
+        {
+            CompactIArchive archive(buffer);
+
+            if (archive.good())
+            {
+                entity_ptr = deserialize_archive(type, archive);
+            }
+
+            if (entity_ptr and (not archive.good()))
+            {
+                LOG(error, "dbinterface", "deserialize",
+                    "Truncated or corrupt data for Entity "
+                    + entity_ptr->get_entity_id().to_string(true));
+
+                delete entity_ptr;
+                entity_ptr = 0;
+            }
+        }
+        else
+        {
+            boost::archive::binary_iarchive archive(buffer);
+            entity_ptr = deserialize_archive(type, archive);
+        }
+
+        if (entity_ptr)
+        {
+            entity_ptr->restore_complete();
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    EntityCodec::Format EntityCodec::get_format(
+        const void *data_ptr,
+        const size_t data_size)
+    {
+        return CompactIArchive::is_compact(data_ptr, data_size) ?
+            FORMAT_COMPACT : FORMAT_LEGACY_BOOST;
+    }
+
+    // ----------------------------------------------------------------------
+    template<class Archive>
+    dbtype::Entity *EntityCodec::deserialize_archive(
+        const dbtype::EntityType type,
+        Archive &archive)
+    {
+        dbtype::Entity *entity_ptr = 0;
+
+        switch (type)
+        {
+            case dbtype::ENTITYTYPE_group:
+            {
+                dbtype::Group *group_ptr = new dbtype::Group();
+                archive >> *group_ptr;
+
+                entity_ptr = group_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_capability:
+            {
+                dbtype::Capability *capability_ptr = new dbtype::Capability();
+                archive >> *capability_ptr;
+
+                entity_ptr = capability_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_container_property_entity:
+            {
+                dbtype::ContainerPropertyEntity *containerprop_ptr =
+                    new dbtype::ContainerPropertyEntity();
+                archive >> *containerprop_ptr;
+
+                entity_ptr = containerprop_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_region:
+            {
+                dbtype::Region *region_ptr = new dbtype::Region();
+                archive >> *region_ptr;
+
+                entity_ptr = region_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_room:
+            {
+                dbtype::Room *room_ptr = new dbtype::Room();
+                archive >> *room_ptr;
+
+                entity_ptr = room_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_player:
+            {
+                dbtype::Player *player_ptr = new dbtype::Player();
+                archive >> *player_ptr;
+
+                entity_ptr = player_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_guest:
+            {
+                dbtype::Guest *guest_ptr = new dbtype::Guest();
+                archive >> *guest_ptr;
+
+                entity_ptr = guest_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_thing:
+            {
+                dbtype::Thing *thing_ptr = new dbtype::Thing();
+                archive >> *thing_ptr;
+
+                entity_ptr = thing_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_puppet:
+            {
+                dbtype::Puppet *puppet_ptr = new dbtype::Puppet();
+                archive >> *puppet_ptr;
+
+                entity_ptr = puppet_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_vehicle:
+            {
+                dbtype::Vehicle *vehicle_ptr = new dbtype::Vehicle();
+                archive >> *vehicle_ptr;
+
+                entity_ptr = vehicle_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_program:
+            {
+                dbtype::Program *program_ptr = new dbtype::Program();
+                archive >> *program_ptr;
+
+                entity_ptr = program_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_exit:
+            {
+                dbtype::Exit *exit_ptr = new dbtype::Exit();
+                archive >> *exit_ptr;
+
+                entity_ptr = exit_ptr;
+                break;
+            }
+
+            case dbtype::ENTITYTYPE_command:
+            {
+                dbtype::Command *command_ptr = new dbtype::Command();
+                archive >> *command_ptr;
+
+                entity_ptr = command_ptr;
+                break;
+            }
+
+            default:
+            {
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    template<class Archive>
+    bool EntityCodec::serialize_archive(
+        dbtype::Entity *entity_ptr,
+        Archive &archive)
+    {
+        bool success = entity_ptr;
+
+        if (success)
+        {
+            switch (entity_ptr->get_entity_type())
+            {
+                case dbtype::ENTITYTYPE_group:
+                {
+                    dbtype::Group *group_ptr =
+                        dynamic_cast<dbtype::Group *>(entity_ptr);
+
+                    if (group_ptr)
+                    {
+                        archive << (*group_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_capability:
+                {
+                    dbtype::Capability *capability_ptr =
+                        dynamic_cast<dbtype::Capability *>(entity_ptr);
+
+                    if (capability_ptr)
+                    {
+                        archive << (*capability_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_container_property_entity:
+                {
+                    dbtype::ContainerPropertyEntity *contprop_ptr =
+                        dynamic_cast<dbtype::ContainerPropertyEntity *>(
+                            entity_ptr);
+
+                    if (contprop_ptr)
+                    {
+                        archive << (*contprop_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_region:
+                {
+                    dbtype::Region *region_ptr =
+                        dynamic_cast<dbtype::Region *>(entity_ptr);
+
+                    if (region_ptr)
+                    {
+                        archive << (*region_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_room:
+                {
+                    dbtype::Room *room_ptr =
+                        dynamic_cast<dbtype::Room *>(entity_ptr);
+
+                    if (room_ptr)
+                    {
+                        archive << (*room_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_player:
+                {
+                    dbtype::Player *player_ptr =
+                        dynamic_cast<dbtype::Player *>(entity_ptr);
+
+                    if (player_ptr)
+                    {
+                        archive << (*player_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_guest:
+                {
+                    dbtype::Guest *guest_ptr =
+                        dynamic_cast<dbtype::Guest *>(entity_ptr);
+
+                    if (guest_ptr)
+                    {
+                        archive << (*guest_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_thing:
+                {
+                    dbtype::Thing *thing_ptr =
+                        dynamic_cast<dbtype::Thing *>(entity_ptr);
+
+                    if (thing_ptr)
+                    {
+                        archive << (*thing_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_puppet:
+                {
+                    dbtype::Puppet *puppet_ptr =
+                        dynamic_cast<dbtype::Puppet *>(entity_ptr);
+
+                    if (puppet_ptr)
+                    {
+                        archive << (*puppet_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_vehicle:
+                {
+                    dbtype::Vehicle *vehicle_ptr =
+                        dynamic_cast<dbtype::Vehicle *>(entity_ptr);
+
+                    if (vehicle_ptr)
+                    {
+                        archive << (*vehicle_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_program:
+                {
+                    dbtype::Program *program_ptr =
+                        dynamic_cast<dbtype::Program *>(entity_ptr);
+
+                    if (program_ptr)
+                    {
+                        archive << (*program_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_exit:
+                {
+                    dbtype::Exit *exit_ptr =
+                        dynamic_cast<dbtype::Exit *>(entity_ptr);
+
+                    if (exit_ptr)
+                    {
+                        archive << (*exit_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                case dbtype::ENTITYTYPE_command:
+                {
+                    dbtype::Command *command_ptr =
+                        dynamic_cast<dbtype::Command *>(entity_ptr);
+
+                    if (command_ptr)
+                    {
+                        archive << (*command_ptr);
+                    }
+                    else
+                    {
+                        success = false;
+                    }
+
+                    break;
+                }
+
+                default:
+                {
+                    // Not a type we can serialize.
+                    success = false;
+                }
+            }
+        }
+
+        return success;
+    }
+}
+}
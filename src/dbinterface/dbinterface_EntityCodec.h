@@ -0,0 +1,106 @@
+/*
+ * dbinterface_EntityCodec.h
+ */
+
+#ifndef MUTGOS_DBINTERFACE_ENTITYCODEC_H
+#define MUTGOS_DBINTERFACE_ENTITYCODEC_H
+
+#include <stddef.h>
+
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_EntityType.h"
+
+#include "utilities/utility_MemoryBuffer.h"
+
+namespace mutgos
+{
+namespace dbinterface
+{
+    /**
+     * Static methods to convert Entities to and from the binary form stored
+     * by the database backend.
+     *
+     * Entities are always written in the compact format (see
+     * CompactOArchive).  They can be read in either the compact format or
+     * the boost binary_oarchive format used before it, so existing
+     * databases are converted as each Entity is next saved.
+     */
+    class EntityCodec
+    {
+    public:
+        /** The binary formats an Entity can be in */
+        enum Format
+        {
+            /** boost binary_oarchive; read only except for comparisons */
+            FORMAT_LEGACY_BOOST,
+            /** CompactOArchive */
+            FORMAT_COMPACT
+        };
+
+        /**
+         * Serializes an Entity.  The Entity must be locked.
+         * @param entity_ptr[in] The Entity to serialize.
+         * @param buffer[out] The serialized Entity.
+         * @param format[in] The format to write.  Only benchmarks or tests
+         * should write anything but the default.
+         * @return True if success, false if error.
+         */
+        static bool serialize(
+            dbtype::Entity *entity_ptr,
+            utility::MemoryBuffer &buffer,
+            const Format format = FORMAT_COMPACT);
+
+        /**
+         * Given a type, creates a corresponding new Entity in memory only,
+         * and deserializes it.  The format is detected automatically.
+         * Caller must manage the pointer.
+         * @param type[in] The type of Entity to deserialize.
+         * @param data_ptr[in] The serialized Entity.
+         * @param data_size[in] The size of data_ptr, in bytes.
+         * @return The pointer to the newly created and deserialized Entity,
+         * or null if error or invalid type.
+         */
+        static dbtype::Entity *deserialize(
+            const dbtype::EntityType type,
+            const void *data_ptr,
+            const size_t data_size);
+
+        /**
+         * @param data_ptr[in] A serialized Entity.
+         * @param data_size[in] The size of data_ptr, in bytes.
+         * @return The format the Entity is in.
+         */
+        static Format get_format(const void *data_ptr, const size_t data_size);
+
+    private:
+        /**
+         * Creates an Entity of the given type and deserializes it from an
+         * archive.
+         * @param type[in] The type of Entity to deserialize.
+         * @param archive[in] The archive to deserialize from.
+         * @return The new Entity, or null if invalid type.
+         */
+        template<class Archive>
+        static dbtype::Entity *deserialize_archive(
+            const dbtype::EntityType type,
+            Archive &archive);
+
+        /**
+         * Serializes an Entity to an archive.
+         * @param entity_ptr[in] The Entity to serialize.
+         * @param archive[out] The archive to serialize to.
+         * @return True if success, false if unknown type.
+         */
+        template<class Archive>
+        static bool serialize_archive(
+            dbtype::Entity *entity_ptr,
+            Archive &archive);
+
+        // Static only
+        EntityCodec(void);
+        ~EntityCodec();
+    };
+}
+}
+
+#endif //MUTGOS_DBINTERFACE_ENTITYCODEC_H
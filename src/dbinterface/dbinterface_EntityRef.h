@@ -1,6 +1,8 @@
 #ifndef MUTGOS_DBINTERFACE_ENTITYREF_H
 #define MUTGOS_DBINTERFACE_ENTITYREF_H
 
+#include <vector>
+
 #include "dbtypes/dbtype_Entity.h"
 
 #include "dbinterface_EntityRefCounter.h"
@@ -163,6 +165,8 @@ namespace dbinterface
         //
         EntityRef *operator&();
     };
+
+    typedef std::vector<EntityRef> EntityRefVector;
 }
 }
 #endif //MUTGOS_DBINTERFACE_ENTITYREF_H
@@ -1,29 +1,56 @@
+#include <stddef.h>
+#include <algorithm>
+
 #include "dbinterface_SiteCache.h"
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/atomic/atomic.hpp>
 
 #include "dbtypes/dbtype_Id.h"
 
 #include "dbinterface_CachedEntity.h"
 #include "dbinterface_DbBackend.h"
 #include "dbinterface_DbResultCode.h"
+#include "dbinterface_UpdateManager.h"
 
 #include "text/text_StringConversion.h"
 
 #include "logging/log_Logger.h"
 
+namespace
+{
+    // TODO make data driven
+    /** Approximate memory a single site's cache may use, in bytes */
+    const size_t SITE_CACHE_MAX_BYTES = 256 * 1024 * 1024;
+    /** Approximate memory all site caches together may use, in bytes */
+    const size_t CACHE_MAX_BYTES = 1024 * 1024 * 1024;
+    /** When evicting, shrink to this percentage of the budget */
+    const size_t EVICTION_TARGET_PERCENT = 90;
+}
+
 namespace mutgos
 {
 namespace dbinterface
 {
+    // Statics
+    //
+    boost::atomic<size_t> SiteCache::total_resident_bytes(0);
+
     // ----------------------------------------------------------------------
     SiteCache::SiteCache(
         DbBackend *db_backend,
         const dbtype::Id::SiteIdType site)
       : db_backend_ptr(db_backend),
         site_id(site),
-        delete_pending(false)
+        delete_pending(false),
+        resident_bytes(0),
+        clock_hand(0),
+        hits(0),
+        misses(0),
+        evictions(0)
     {
         LOG(debug, "dbinterface", "SiteCache()",
             "Constructing site cache for site ID "
@@ -45,21 +72,12 @@ namespace dbinterface
 
         // Scope for mutex
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
 
-            for (EntityCacheMap::iterator iter = cached_entities.begin();
-                iter != cached_entities.end();
-                ++iter)
+            while (not cached_entities.empty())
             {
-                dbtype::Entity * const entity_temp_ptr =
-                    iter->second->get_entity();
-                // Delete first because it references the Entity pointer
-                delete iter->second;
-                // All references are now gone.  Delete actual Entity
-                db_backend_ptr->delete_entity_mem(entity_temp_ptr);
+                remove_cached(cached_entities.begin());
             }
-
-            cached_entities.clear();
         }
 
         LOG(debug, "dbinterface", "~SiteCache()",
@@ -76,14 +94,14 @@ namespace dbinterface
     // ----------------------------------------------------------------------
     void SiteCache::set_delete_pending(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
         delete_pending = true;
     }
 
     // ----------------------------------------------------------------------
     bool SiteCache::is_delete_pending(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
         return delete_pending;
     }
 
@@ -91,6 +109,7 @@ namespace dbinterface
     DbResultCode SiteCache::get_entity_ref(const dbtype::Id &id, EntityRef &ref)
     {
         DbResultCode return_code = DBRESULTCODE_OK;
+        bool over_budget = false;
 
         ref.clear();
 
@@ -98,71 +117,281 @@ namespace dbinterface
         {
             return_code = DBRESULTCODE_BAD_SITE_ID;
         }
-        else
+        else if (not get_cached_reference(id.get_entity_id(), ref))
         {
-            boost::lock_guard<boost::mutex> guard(mutex);
+            bool found = false;
 
-            // See if it's already cached
-            //
-            EntityCacheMap::iterator find_iter =
-                cached_entities.find(id.get_entity_id());
-
-            if (find_iter != cached_entities.end())
+            // Scope for loading mutex
             {
-                // Found it in the cache
+                boost::unique_lock<boost::mutex> loading_lock(loading_mutex);
+
+                // If another thread is loading it, wait for them to finish
+                // and use theirs.
                 //
-                find_iter->second->get_reference(ref);
+                while (loading_entities.find(id.get_entity_id()) !=
+                    loading_entities.end())
+                {
+                    loading_condition.wait(loading_lock);
+                }
+
+                found = get_cached_reference(id.get_entity_id(), ref);
+
+                if (not found)
+                {
+                    loading_entities.insert(id.get_entity_id());
+                }
             }
-            else
+
+            if (not found)
             {
-                // Not cached, so load it
+                // Not cached, so load it.  No locks are held so other
+                // Entities in the site can be gotten at the same time.
                 //
                 dbtype::Entity *entity_ptr = db_backend_ptr->get_entity_db(id);
 
+                ++misses;
+
                 if (not entity_ptr)
                 {
                     return_code = DBRESULTCODE_BAD_ENTITY_ID;
                 }
                 else
                 {
-                    // Make a new cache entry and get a reference
-                    //
-                    CachedEntity *cached_ptr = new CachedEntity(entity_ptr);
-                    cached_ptr->get_reference(ref);
-                    cached_entities[id.get_entity_id()] = cached_ptr;
-
-                    entity_ptr->set_entity_accessed_timestamp();
+                    over_budget = add_loaded_entity(entity_ptr, ref);
                 }
+
+                finished_loading(dbtype::Entity::IdVector(1, id));
             }
         }
 
+        if (over_budget and UpdateManager::instance())
+        {
+            UpdateManager::instance()->cache_eviction_requested();
+        }
+
         return return_code;
     }
 
     // ----------------------------------------------------------------------
-    bool SiteCache::delete_entity_cache(const dbtype::Id &id)
+    void SiteCache::get_entity_refs(
+        const dbtype::Entity::IdVector &ids,
+        EntityRefVector &refs)
     {
-        bool deleted = true;
+        std::vector<size_t> missing_indices;
+        std::vector<size_t> retry_indices;
+        std::vector<size_t> load_indices;
+        dbtype::Entity::IdVector load_ids;
+        bool over_budget = false;
+
+        refs.clear();
+        refs.resize(ids.size());
+
+        // Get everything already cached under a single lock.
+        //
+        {
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            for (size_t index = 0; index < ids.size(); ++index)
+            {
+                if (ids[index].get_site_id() == site_id)
+                {
+                    EntityCacheMap::iterator find_iter =
+                        cached_entities.find(ids[index].get_entity_id());
+
+                    if (find_iter != cached_entities.end())
+                    {
+                        find_iter->second->get_reference(refs[index]);
+                        find_iter->second->set_recently_used(true);
+                        ++hits;
+                    }
+                    else
+                    {
+                        missing_indices.push_back(index);
+                    }
+                }
+            }
+        }
+
+        if (not missing_indices.empty())
+        {
+            // Claim what is missing.  Anything another thread is loading
+            // (or a duplicate ID) is gotten individually afterwards, which
+            // waits for that load.
+            //
+            boost::lock_guard<boost::mutex> guard(loading_mutex);
+            boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+            for (std::vector<size_t>::const_iterator index_iter =
+                    missing_indices.begin();
+                index_iter != missing_indices.end();
+                ++index_iter)
+            {
+                const dbtype::Id::EntityIdType entity_id =
+                    ids[*index_iter].get_entity_id();
+                EntityCacheMap::iterator find_iter =
+                    cached_entities.find(entity_id);
+
+                if (find_iter != cached_entities.end())
+                {
+                    // Finished loading since we last looked.
+                    find_iter->second->get_reference(refs[*index_iter]);
+                    find_iter->second->set_recently_used(true);
+                    ++hits;
+                }
+                else if (loading_entities.insert(entity_id).second)
+                {
+                    load_ids.push_back(ids[*index_iter]);
+                    load_indices.push_back(*index_iter);
+                }
+                else
+                {
+                    retry_indices.push_back(*index_iter);
+                }
+            }
+        }
 
-        boost::lock_guard<boost::mutex> guard(mutex);
+        if (not load_ids.empty())
+        {
+            // Load all the misses at once, without holding any locks.
+            //
+            DbBackend::EntityPtrVector entities;
+            db_backend_ptr->get_entities_db(load_ids, entities);
 
-        EntityCacheMap::iterator find_iter =
-            cached_entities.find(id.get_entity_id());
+            misses += load_ids.size();
 
-        if (find_iter != cached_entities.end())
+            for (size_t index = 0; index < entities.size(); ++index)
+            {
+                if (entities[index] and
+                    add_loaded_entity(
+                        entities[index],
+                        refs[load_indices[index]]))
+                {
+                    over_budget = true;
+                }
+            }
+
+            finished_loading(load_ids);
+        }
+
+        for (std::vector<size_t>::const_iterator index_iter =
+                retry_indices.begin();
+            index_iter != retry_indices.end();
+            ++index_iter)
         {
-            // Found it in the cache.  Check if dirty or in use.
+            get_entity_ref(ids[*index_iter], refs[*index_iter]);
+        }
+
+        if (over_budget and UpdateManager::instance())
+        {
+            UpdateManager::instance()->cache_eviction_requested();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    size_t SiteCache::add_preloaded_entities(
+        const DbBackend::EntityPtrVector &entities)
+    {
+        size_t added = 0;
+        bool full = false;
+        EntityRef ref;
+
+        for (DbBackend::EntityPtrVector::const_iterator entity_iter =
+                entities.begin();
+            entity_iter != entities.end();
+            ++entity_iter)
+        {
+            dbtype::Entity * const entity_ptr = *entity_iter;
+            const dbtype::Id entity_id = entity_ptr->get_entity_id();
+            bool claimed = false;
+
+            // Claim it the same way a load would, so nobody else can be
+            // using it if it ends up freed.
             //
-            deleted = (not find_iter->second->is_referenced()) and
-                (not find_iter->second->get_entity()->is_dirty());
+            if (entity_id.get_site_id() == site_id)
+            {
+                boost::lock_guard<boost::mutex> guard(loading_mutex);
+                boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+                claimed = (cached_entities.find(entity_id.get_entity_id()) ==
+                        cached_entities.end()) and
+                    loading_entities.insert(entity_id.get_entity_id()).second;
+            }
 
-            if (deleted)
+            if (claimed)
             {
-                // Can be deleted.  No one is using it and it's not dirty.
-                db_backend_ptr->delete_entity_mem(
-                    find_iter->second->get_entity());
-                delete find_iter->second;
-                cached_entities.erase(find_iter);
+                if (full)
+                {
+                    db_backend_ptr->delete_entity_mem(entity_ptr);
+                }
+                else
+                {
+                    full = add_loaded_entity(entity_ptr, ref, true);
+                    ref.clear();
+                    ++added;
+                }
+
+                finished_loading(dbtype::Entity::IdVector(1, entity_id));
+            }
+        }
+
+        return added;
+    }
+
+    // ----------------------------------------------------------------------
+    size_t SiteCache::get_preload_budget(void)
+    {
+        const size_t site_target_bytes =
+            (SITE_CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT;
+        const size_t total_target_bytes =
+            (CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT;
+        const size_t total_bytes = total_resident_bytes.load();
+        size_t budget = 0;
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        if ((resident_bytes < site_target_bytes) and
+            (total_bytes < total_target_bytes))
+        {
+            budget = std::min(
+                site_target_bytes - resident_bytes,
+                total_target_bytes - total_bytes);
+        }
+
+        return budget;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteCache::delete_entity_cache(const dbtype::Id &id)
+    {
+        bool deleted = true;
+
+        boost::lock_guard<boost::mutex> guard(loading_mutex);
+
+        if (loading_entities.find(id.get_entity_id()) !=
+            loading_entities.end())
+        {
+            // Still being loaded, so it's about to be in use.
+            deleted = false;
+        }
+        else
+        {
+            boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+            EntityCacheMap::iterator find_iter =
+                cached_entities.find(id.get_entity_id());
+
+            if (find_iter != cached_entities.end())
+            {
+                // Found it in the cache.  Check if dirty or in use.
+                //
+                deleted = (not find_iter->second->is_referenced()) and
+                    (not find_iter->second->get_entity()->is_dirty());
+
+                if (deleted)
+                {
+                    // Can be deleted.  No one is using it and it's not dirty.
+                    remove_cached(find_iter);
+                }
             }
         }
 
@@ -174,7 +403,7 @@ namespace dbinterface
     {
         bool referenced = false;
 
-        boost::lock_guard<boost::mutex> guard(mutex);
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
 
         for (EntityCacheMap::iterator iter = cached_entities.begin();
              iter != cached_entities.end();
@@ -190,5 +419,204 @@ namespace dbinterface
 
         return referenced;
     }
+
+    // ----------------------------------------------------------------------
+    size_t SiteCache::evict(
+        const size_t total_bytes,
+        const dbtype::Entity::IdSet &pending_ids)
+    {
+        size_t evicted = 0;
+
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        size_t target_bytes =
+            (SITE_CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT;
+
+        if (total_bytes > CACHE_MAX_BYTES)
+        {
+            // Every site shrinks in proportion to its size.
+            //
+            const double total_target_bytes =
+                (CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT;
+
+            target_bytes = std::min(
+                target_bytes,
+                (size_t) (resident_bytes * (total_target_bytes / total_bytes)));
+        }
+
+        if ((resident_bytes > target_bytes) and (not cached_entities.empty()))
+        {
+            // CLOCK:  Each Entity used since the hand last passed it gets a
+            // second chance.  Two trips around covers everything.
+            //
+            EntityCacheMap::iterator iter =
+                cached_entities.lower_bound(clock_hand);
+            size_t visits_left = cached_entities.size() * 2;
+
+            while ((resident_bytes > target_bytes) and visits_left
+                and (not cached_entities.empty()))
+            {
+                --visits_left;
+
+                if (iter == cached_entities.end())
+                {
+                    iter = cached_entities.begin();
+                }
+
+                CachedEntity * const cached_ptr = iter->second;
+                const dbtype::Id &id = cached_ptr->get_id();
+
+                // Check if referenced first, since nothing else can
+                // lock an Entity that isn't referenced.
+                //
+                if (cached_ptr->is_referenced() or
+                    cached_ptr->get_entity()->is_dirty() or
+                    (pending_ids.find(id) != pending_ids.end()))
+                {
+                    // In use or has changes not yet in the database.
+                    ++iter;
+                }
+                else if (cached_ptr->is_recently_used())
+                {
+                    // Second chance.  Update its size while here, since it
+                    // may have changed since it was loaded.
+                    //
+                    const size_t mem_used = cached_ptr->get_entity()->mem_used();
+
+                    resident_bytes =
+                        resident_bytes - cached_ptr->get_mem_used() + mem_used;
+                    total_resident_bytes += mem_used;
+                    total_resident_bytes -= cached_ptr->get_mem_used();
+                    cached_ptr->set_mem_used(mem_used);
+                    cached_ptr->set_recently_used(false);
+                    ++iter;
+                }
+                else
+                {
+                    remove_cached(iter++);
+                    ++evicted;
+                }
+            }
+
+            clock_hand =
+                (iter == cached_entities.end() ? 0 : iter->first);
+        }
+
+        evictions += evicted;
+
+        return evicted;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteCache::get_cached_reference(
+        const dbtype::Id::EntityIdType entity_id,
+        EntityRef &ref)
+    {
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        EntityCacheMap::iterator find_iter = cached_entities.find(entity_id);
+        const bool found = (find_iter != cached_entities.end());
+
+        if (found)
+        {
+            find_iter->second->get_reference(ref);
+            find_iter->second->set_recently_used(true);
+            ++hits;
+        }
+
+        return found;
+    }
+
+    // ----------------------------------------------------------------------
+    SiteCache::CacheStats SiteCache::get_stats(void)
+    {
+        CacheStats stats;
+
+        boost::shared_lock<boost::shared_mutex> read_lock(mutex);
+
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.evictions = evictions;
+        stats.resident_entities = cached_entities.size();
+        stats.resident_bytes = resident_bytes;
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SiteCache::add_loaded_entity(
+        dbtype::Entity *entity_ptr,
+        EntityRef &ref,
+        const bool preloaded)
+    {
+        // Make a new cache entry and get a reference
+        //
+        CachedEntity *cached_ptr = new CachedEntity(entity_ptr);
+        const size_t mem_used = entity_ptr->mem_used();
+
+        cached_ptr->set_mem_used(mem_used);
+        cached_ptr->get_reference(ref);
+
+        if (not preloaded)
+        {
+            entity_ptr->set_entity_accessed_timestamp();
+        }
+
+        boost::unique_lock<boost::shared_mutex> write_lock(mutex);
+
+        cached_entities[entity_ptr->get_entity_id().get_entity_id()] =
+            cached_ptr;
+
+        resident_bytes += mem_used;
+        const size_t total_bytes = (total_resident_bytes += mem_used);
+
+        if (preloaded)
+        {
+            return (resident_bytes >=
+                    (SITE_CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT) or
+                (total_bytes >=
+                    (CACHE_MAX_BYTES / 100) * EVICTION_TARGET_PERCENT);
+        }
+        else
+        {
+            return (resident_bytes > SITE_CACHE_MAX_BYTES) or
+                (total_bytes > CACHE_MAX_BYTES);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::finished_loading(const dbtype::Entity::IdVector &ids)
+    {
+        {
+            boost::lock_guard<boost::mutex> guard(loading_mutex);
+
+            for (dbtype::Entity::IdVector::const_iterator id_iter =
+                    ids.begin();
+                id_iter != ids.end();
+                ++id_iter)
+            {
+                loading_entities.erase(id_iter->get_entity_id());
+            }
+        }
+
+        // Wake up anyone waiting on them.
+        loading_condition.notify_all();
+    }
+
+    // ----------------------------------------------------------------------
+    void SiteCache::remove_cached(EntityCacheMap::iterator iter)
+    {
+        CachedEntity * const cached_ptr = iter->second;
+        dbtype::Entity * const entity_ptr = cached_ptr->get_entity();
+
+        resident_bytes -= cached_ptr->get_mem_used();
+        total_resident_bytes -= cached_ptr->get_mem_used();
+        cached_entities.erase(iter);
+
+        // Delete first because it references the Entity pointer
+        delete cached_ptr;
+        // All references are now gone.  Delete actual Entity
+        db_backend_ptr->delete_entity_mem(entity_ptr);
+    }
 }
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 #define MUTGOS_DBINTERFACE_SITE_CACHE_H
 
 #include <map>
+#include <set>
+#include <stddef.h>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic/atomic.hpp>
 
+#include "osinterface/osinterface_OsTypes.h"
 #include "dbtypes/dbtype_Id.h"
 
 #include "dbinterface_CachedEntity.h"
@@ -16,13 +22,67 @@ namespace mutgos
 namespace dbinterface
 {
     /**
-     * This class manages the cache for a specific site.  Right now the cache
-     * is very simple - it doesn't evict old Entities.  This is an area
-     * that will need significant work post-demo.
+     * This class manages the cache for a specific site.
+     *
+     * The cache has a memory budget, both per site and across all sites,
+     * based on Entity::mem_used().  When a load goes over budget, the
+     * UpdateManager is asked to run an eviction pass.  evict() uses the CLOCK
+     * algorithm to remove Entities that are not referenced, not dirty, and
+     * have no pending database update or delete.
+     *
+     * Cache hits only take a shared lock.  A cache miss loads the Entity
+     * without holding the cache lock, so other Entities in the site can be
+     * gotten in the meantime.  Anyone else wanting the Entity being loaded
+     * waits for that load rather than starting another.
      */
     class SiteCache
     {
     public:
+        /**
+         * Statistics about a cache.
+         */
+        struct CacheStats
+        {
+            /**
+             * Constructor.
+             */
+            CacheStats(void)
+              : hits(0),
+                misses(0),
+                evictions(0),
+                resident_entities(0),
+                resident_bytes(0)
+            { }
+
+            /**
+             * Adds the stats from another cache to this one.
+             * @param rhs[in] The stats to add.
+             * @return This.
+             */
+            CacheStats &operator+=(const CacheStats &rhs)
+            {
+                hits += rhs.hits;
+                misses += rhs.misses;
+                evictions += rhs.evictions;
+                resident_entities += rhs.resident_entities;
+                resident_bytes += rhs.resident_bytes;
+                return *this;
+            }
+
+            MG_LongUnsignedInt hits; ///< Gets satisfied by the cache
+            MG_LongUnsignedInt misses; ///< Gets that loaded from the database
+            MG_LongUnsignedInt evictions; ///< Entities evicted
+            size_t resident_entities; ///< Entities currently cached
+            size_t resident_bytes; ///< Approximate memory used by cached
+        };
+
+        /**
+         * @return Approximate memory used by Entities in all site caches,
+         * in bytes.
+         */
+        static size_t get_total_resident_bytes(void)
+          { return total_resident_bytes.load(); }
+
         /**
          * Constructs a SiteCache.  Provide the database and site ID.
          * @param db_backend[in] The database to get or set data from.  Must not
@@ -68,6 +128,37 @@ namespace dbinterface
          */
         DbResultCode get_entity_ref(const dbtype::Id &id, EntityRef &ref);
 
+        /**
+         * Gets references to several Entities, loading any not cached from
+         * the database together.
+         * @param ids[in] The IDs of the Entities to get.  IDs not in this
+         * site are ignored.
+         * @param refs[out] References to the Entities, in the same order as
+         * ids.  A reference is invalid if its Entity was not found.
+         */
+        void get_entity_refs(
+            const dbtype::Entity::IdVector &ids,
+            EntityRefVector &refs);
+
+        /**
+         * Adds Entities preloaded from the database to the cache, stopping
+         * once the cache reaches the size eviction would shrink it to.
+         * Preloading does not count as accessing an Entity.
+         * @param entities[in] The preloaded Entities, most important first.
+         * Any not added to the cache are freed, unless already cached or
+         * being loaded by someone else.
+         * @return How many Entities were added.
+         */
+        size_t add_preloaded_entities(
+            const DbBackend::EntityPtrVector &entities);
+
+        /**
+         * @return How many more bytes of Entities can be preloaded before
+         * the cache reaches the size eviction would shrink it to, or 0 if
+         * already there.
+         */
+        size_t get_preload_budget(void);
+
         /**
          * Removes the given Entity from the cache.
          * @param id[in] The ID of the Entity to remove from the cache.
@@ -83,14 +174,88 @@ namespace dbinterface
          */
         bool is_anything_referenced(void);
 
+        /**
+         * Evicts Entities from the cache that are not referenced, not dirty,
+         * and have no database update or delete pending, until the cache is
+         * within its budget.  This must only be called when the
+         * UpdateManager has no uncommitted writes.
+         * @param total_bytes[in] The memory used by all site caches.  If
+         * over the total budget, this cache will shrink by its share.
+         * @param pending_ids[in] The Entities with a database update or
+         * delete pending, from UpdateManager::get_pending_ids().
+         * @return How many Entities were evicted.
+         */
+        size_t evict(
+            const size_t total_bytes,
+            const dbtype::Entity::IdSet &pending_ids);
+
+        /**
+         * @return Statistics about this cache.
+         */
+        CacheStats get_stats(void);
+
     private:
         typedef std::map<dbtype::Id::EntityIdType, CachedEntity *> EntityCacheMap;
+        typedef std::set<dbtype::Id::EntityIdType> LoadingEntitySet;
+
+        /**
+         * If cached, gets a reference to the Entity and counts a hit.
+         * The mutex is assumed to be UNLOCKED.
+         * @param entity_id[in] The ID of the Entity to get.
+         * @param ref[out] Set to reference the Entity, if found.  Unchanged
+         * if not found.
+         * @return True if found in the cache.
+         */
+        bool get_cached_reference(
+            const dbtype::Id::EntityIdType entity_id,
+            EntityRef &ref);
+
+        /**
+         * Adds a newly loaded Entity to the cache and gets a reference to it.
+         * The mutex is assumed to be UNLOCKED.
+         * @param entity_ptr[in] The Entity loaded.  Must not be null.
+         * @param ref[out] Set to reference the Entity.
+         * @param preloaded[in] True if the Entity is being preloaded rather
+         * than accessed.
+         * @return True if the cache is now over its memory budget, or if
+         * preloaded, at or over the size eviction would shrink it to.
+         */
+        bool add_loaded_entity(
+            dbtype::Entity *entity_ptr,
+            EntityRef &ref,
+            const bool preloaded = false);
+
+        /**
+         * Removes Entities from the set being loaded and wakes up anyone
+         * waiting for them.
+         * @param ids[in] The IDs of the Entities that are done loading.
+         */
+        void finished_loading(const dbtype::Entity::IdVector &ids);
+
+        /**
+         * Removes a cache entry and frees its Entity.  The Entity must not
+         * be referenced.
+         * The mutex is assumed to be LOCKED.
+         * @param iter[in] The cache entry to remove.
+         */
+        void remove_cached(EntityCacheMap::iterator iter);
+
+        static boost::atomic<size_t> total_resident_bytes; ///< In all caches
 
         DbBackend *db_backend_ptr; ///< Database backend so we can load Entities
         const dbtype::Id::SiteIdType site_id; ///< Site ID this cache manages
-        boost::mutex mutex; ///< Enforces single access at a time.
+        boost::shared_mutex mutex; ///< Enforces single writer at a time.
         bool delete_pending; ///< True if Site scheduled to be deleted from the database
         EntityCacheMap cached_entities; ///< The entity cache, lookup by Entity ID.
+        size_t resident_bytes; ///< Approximate memory used by cached_entities
+        dbtype::Id::EntityIdType clock_hand; ///< Where next eviction starts
+        boost::atomic<MG_LongUnsignedInt> hits; ///< Gets satisfied by the cache
+        boost::atomic<MG_LongUnsignedInt> misses; ///< Gets that loaded from the database
+        MG_LongUnsignedInt evictions; ///< Entities evicted
+
+        boost::mutex loading_mutex; ///< Protects loading_entities
+        boost::condition_variable loading_condition; ///< Signals a load done
+        LoadingEntitySet loading_entities; ///< Entities being loaded now
     };
 }
 }
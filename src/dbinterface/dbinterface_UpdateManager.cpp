@@ -1,6 +1,5 @@
 
 #include <list>
-#include <unistd.h>
 
 #include "dbinterface_UpdateManager.h"
 
@@ -11,6 +10,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/locks.hpp>
 
 #include "dbtypes/dbtype_Vehicle.h"
 #include "dbtypes/dbtype_Program.h"
@@ -27,8 +27,34 @@
 #include "concurrency/concurrency_WriterLockToken.h"
 #include "concurrency/concurrency_ReaderLockToken.h"
 
+#include "text/text_StringConversion.h"
+
 #include "logging/log_Logger.h"
 
+namespace
+{
+    // TODO make data driven
+    /** Maximum rows written in a single batch before it is committed */
+    const size_t MAX_BATCH_ROWS = 1000;
+    /** Maximum time a batch is kept open before it is committed */
+    const boost::posix_time::time_duration MAX_BATCH_LATENCY =
+        boost::posix_time::milliseconds(500);
+    /** Number of pending updates and deletes that causes an immediate flush */
+    const size_t FLUSH_HIGH_WATER_MARK = 500;
+    /** Maximum time a pending change waits before it is flushed */
+    const boost::posix_time::time_duration FLUSH_MAX_AGE =
+        boost::posix_time::seconds(2);
+    /** How long to wait before retrying after a batch first fails */
+    const boost::posix_time::time_duration FLUSH_RETRY_MIN_DELAY =
+        boost::posix_time::milliseconds(250);
+    /** Longest wait before retrying, as failures keep doubling the wait */
+    const boost::posix_time::time_duration FLUSH_RETRY_MAX_DELAY =
+        boost::posix_time::seconds(30);
+    /** Minimum time between cache eviction passes */
+    const boost::posix_time::time_duration EVICTION_MIN_INTERVAL =
+        boost::posix_time::seconds(1);
+}
+
 namespace mutgos
 {
 namespace dbinterface
@@ -80,7 +106,21 @@ namespace dbinterface
 
         if (thread_ptr)
         {
-            shutdown_thread_flag.store(true);
+            {
+                // Set while locked so the thread cannot miss the wakeup.
+                // Anything pending is flushed right away.
+                //
+                boost::lock_guard<boost::mutex> guard(mutex);
+                shutdown_thread_flag.store(true);
+
+                if (not flush_deadline.is_not_a_date_time())
+                {
+                    flush_deadline =
+                        boost::posix_time::microsec_clock::universal_time();
+                }
+            }
+
+            flush_condition.notify_one();
 
             thread_ptr->join();
             delete thread_ptr;
@@ -134,6 +174,8 @@ namespace dbinterface
                     flags_changed,
                     ids_changed);
             }
+
+            flush_requested();
         }
     }
 
@@ -142,6 +184,7 @@ namespace dbinterface
     {
         boost::lock_guard<boost::mutex> guard(mutex);
         pending_deletes.insert(entities.begin(), entities.end());
+        flush_requested();
     }
 
     // ----------------------------------------------------------------------
@@ -152,18 +195,73 @@ namespace dbinterface
         return (pending_deletes.find(entity_id) != pending_deletes.end());
     }
 
+    // ----------------------------------------------------------------------
+    bool UpdateManager::is_entity_update_pending(const dbtype::Id &entity_id)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        return (pending_updates.find(entity_id) != pending_updates.end());
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::get_pending_ids(dbtype::Entity::IdSet &ids)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        ids = pending_deletes;
+
+        for (PendingUpdatesMap::const_iterator update_iter =
+                pending_updates.begin();
+            update_iter != pending_updates.end();
+            ++update_iter)
+        {
+            ids.insert(ids.end(), update_iter->first);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::cache_eviction_requested(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        if (not eviction_requested)
+        {
+            eviction_requested = true;
+
+            const boost::posix_time::ptime now =
+                boost::posix_time::microsec_clock::universal_time();
+            boost::posix_time::ptime eviction_time = now;
+
+            if ((not last_eviction_time.is_not_a_date_time()) and
+                ((last_eviction_time + EVICTION_MIN_INTERVAL) > now))
+            {
+                eviction_time = last_eviction_time + EVICTION_MIN_INTERVAL;
+            }
+
+            if (flush_deadline.is_not_a_date_time() or
+                (eviction_time < flush_deadline))
+            {
+                flush_deadline = eviction_time;
+                flush_condition.notify_one();
+            }
+        }
+    }
+
     // ----------------------------------------------------------------------
     void UpdateManager::site_deleted(const dbtype::Id::SiteIdType site_id)
     {
         boost::lock_guard<boost::mutex> guard(mutex);
 
         pending_site_deletes.push_back(site_id);
+        flush_requested();
     }
 
     // ----------------------------------------------------------------------
     void UpdateManager::thread_main(void)
     {
         bool do_shutdown = false;
+        bool made_progress = false;
+        bool do_eviction = false;
         PendingUpdatesMap updates_copy;
         dbtype::Entity::IdSet deletes_copy;
         dbtype::Id::SiteIdVector site_deletes_copy;
@@ -172,15 +270,47 @@ namespace dbinterface
         {
             // TODO Figure out how to update immediately for changed 'contains'.
             // TODO Deleted entities need deleted flag set and saved in case of crash
-            sleep(3);
 
             DatabaseAccess *db = DatabaseAccess::instance();
 
             {
+                boost::unique_lock<boost::mutex> lock(mutex);
+
+                // Sleep until there is enough to do, or the oldest pending
+                // change has waited long enough.
+                //
+                while (not flush_due(made_progress))
+                {
+                    // Don't wake up before a failed batch may be retried.
+                    //
+                    boost::posix_time::ptime wakeup_time = flush_deadline;
+
+                    if ((not retry_deadline.is_not_a_date_time()) and
+                        (wakeup_time.is_not_a_date_time() or
+                            (retry_deadline > wakeup_time)))
+                    {
+                        wakeup_time = retry_deadline;
+                    }
+
+                    if (wakeup_time.is_not_a_date_time())
+                    {
+                        flush_condition.wait(lock);
+                    }
+                    else
+                    {
+                        flush_condition.timed_wait(lock, wakeup_time);
+                    }
+                }
+
+                // Only shutdown if the pending updates are all finished
+                //
+                do_shutdown = pending_updates.empty()
+                  and pending_deletes.empty()
+                  and shutdown_thread_flag.load();
+
                 // Grab the stuff to update and delete en masse to avoid
                 // locking the data structures for too long.
                 //
-                boost::lock_guard<boost::mutex> guard(mutex);
                 updates_copy = pending_updates;
                 deletes_copy = pending_deletes;
                 site_deletes_copy = pending_site_deletes;
@@ -188,6 +318,18 @@ namespace dbinterface
                 pending_updates.clear();
                 pending_deletes.clear();
                 pending_site_deletes.clear();
+                flush_deadline = boost::posix_time::ptime();
+                high_water_notified = false;
+
+                do_eviction = eviction_requested;
+                eviction_requested = false;
+            }
+
+            made_progress = false;
+
+            if (not (updates_copy.empty() and deletes_copy.empty()))
+            {
+                begin_batch();
             }
 
             for (PendingUpdatesMap::iterator update_iter = updates_copy.begin();
@@ -215,6 +357,11 @@ namespace dbinterface
                             + update_iter->first.to_string(true)
                             + " to database.");
                     }
+                    else
+                    {
+                        made_progress = true;
+                        batch_row_written(update_iter->first, false);
+                    }
                 }
             }
 
@@ -259,14 +406,27 @@ namespace dbinterface
                 // Attempt to do the actual deletion.  If it fails, reinsert
                 // to try again later.
                 //
-                if (db->internal_delete_entity(*deleted_id_iter) ==
-                    DBRESULTCODE_ERROR_ENTITY_IN_USE)
+                const DbResultCode delete_rc =
+                    db->internal_delete_entity(*deleted_id_iter);
+
+                if (delete_rc == DBRESULTCODE_ERROR_ENTITY_IN_USE)
                 {
                     boost::lock_guard<boost::mutex> guard(mutex);
                     pending_deletes.insert(*deleted_id_iter);
+                    flush_requested();
+                }
+                else if (delete_rc == DBRESULTCODE_OK)
+                {
+                    made_progress = true;
+                    batch_row_written(*deleted_id_iter, true);
                 }
             }
 
+            // Site deletes cannot be requeued if a batch fails, so make sure
+            // everything else is committed before doing them.
+            //
+            commit_batch();
+
             // Process site deletes.  Simply call DatabaseAccess again.  If it
             // succeeds, then we're done, otherwise the ID has been automatically
             // reinserted into the delete list to try again later.
@@ -279,6 +439,18 @@ namespace dbinterface
                 db->delete_site(*site_iter);
             }
 
+            // Everything written above is committed or requeued, so the
+            // cache can now safely evict anything no longer dirty.
+            //
+            if (do_eviction and (not do_shutdown))
+            {
+                db->internal_evict_cache();
+
+                boost::lock_guard<boost::mutex> guard(mutex);
+                last_eviction_time =
+                    boost::posix_time::microsec_clock::universal_time();
+            }
+
             // Clear the temporary holds for the next use
             //
             for (PendingUpdatesMap::iterator update_iter = updates_copy.begin();
@@ -291,15 +463,6 @@ namespace dbinterface
             updates_copy.clear();
             deletes_copy.clear();
             site_deletes_copy.clear();
-
-            // Only shutdown if the pending updates are all finished
-            //
-            {
-                boost::lock_guard<boost::mutex> guard(mutex);
-                do_shutdown = pending_updates.empty()
-                  and pending_deletes.empty()
-                  and shutdown_thread_flag.load();
-            }
         }
     }
 
@@ -798,10 +961,228 @@ namespace dbinterface
         }
     }
 
+    // ----------------------------------------------------------------------
+    void UpdateManager::flush_requested(void)
+    {
+        if (flush_deadline.is_not_a_date_time())
+        {
+            // First change since the last flush.  Wake up the thread so it
+            // knows when the flush is due.
+            //
+            flush_deadline = boost::posix_time::microsec_clock::universal_time()
+                + FLUSH_MAX_AGE;
+            flush_condition.notify_one();
+        }
+        else if ((not high_water_notified) and
+            ((pending_updates.size() + pending_deletes.size()) >=
+                FLUSH_HIGH_WATER_MARK))
+        {
+            // Only wake it once; it flushes everything when it gets to it.
+            high_water_notified = true;
+            flush_condition.notify_one();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool UpdateManager::flush_due(const bool made_progress)
+    {
+        if (pending_updates.empty() and pending_deletes.empty() and
+            pending_site_deletes.empty() and (not eviction_requested))
+        {
+            // Nothing to do unless it's time to exit.
+            return shutdown_thread_flag.load();
+        }
+
+        if ((not retry_deadline.is_not_a_date_time()) and
+            (boost::posix_time::microsec_clock::universal_time() <
+                retry_deadline))
+        {
+            // A batch failed recently.  Give the database time to recover
+            // rather than retrying in a tight loop.
+            return false;
+        }
+
+        if (shutdown_thread_flag.load() and made_progress)
+        {
+            // Keep flushing as fast as possible while shutting down, as long
+            // as things are getting written.  Anything that cannot be written
+            // yet (such as an Entity still in use) waits for the deadline.
+            return true;
+        }
+
+        if ((pending_updates.size() + pending_deletes.size()) >=
+            FLUSH_HIGH_WATER_MARK)
+        {
+            return true;
+        }
+
+        return (flush_deadline.is_not_a_date_time() or
+            (boost::posix_time::microsec_clock::universal_time() >=
+                flush_deadline));
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::begin_batch(void)
+    {
+        batch_updated_ids.clear();
+        batch_deleted_ids.clear();
+        batch_start_time = boost::posix_time::microsec_clock::universal_time();
+
+        batch_open = DatabaseAccess::instance()->internal_begin_batch();
+
+        if (not batch_open)
+        {
+            LOG(error, "dbinterface", "begin_batch",
+                "Could not begin batch.  Writes will not be batched.");
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::batch_row_written(
+        const dbtype::Id &id,
+        const bool deleted)
+    {
+        if (batch_open)
+        {
+            if (deleted)
+            {
+                batch_deleted_ids.push_back(id);
+            }
+            else
+            {
+                batch_updated_ids.push_back(id);
+            }
+
+            const size_t rows =
+                batch_updated_ids.size() + batch_deleted_ids.size();
+
+            if ((rows >= MAX_BATCH_ROWS) or
+                ((boost::posix_time::microsec_clock::universal_time() -
+                    batch_start_time) >= MAX_BATCH_LATENCY))
+            {
+                // Batch is full or has been open too long.  Commit what we
+                // have so far and keep going in a new batch.
+                //
+                commit_batch();
+                begin_batch();
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void UpdateManager::commit_batch(void)
+    {
+        if (batch_open)
+        {
+            batch_open = false;
+
+            DatabaseAccess * const db = DatabaseAccess::instance();
+            const bool success = db->internal_commit_batch();
+            const boost::posix_time::time_duration wall_time =
+                boost::posix_time::microsec_clock::universal_time() -
+                    batch_start_time;
+
+            ++batch_count;
+
+            if (success)
+            {
+                // Scope for lock
+                {
+                    boost::lock_guard<boost::mutex> guard(mutex);
+                    retry_deadline = boost::posix_time::ptime();
+                    retry_delay = FLUSH_RETRY_MIN_DELAY;
+                }
+
+                if (not (batch_updated_ids.empty() and
+                    batch_deleted_ids.empty()))
+                {
+                    LOG(info, "dbinterface", "commit_batch",
+                        "Batch " + text::to_string(batch_count)
+                        + " committed.  Updated: "
+                        + text::to_string(batch_updated_ids.size())
+                        + "  Deleted: "
+                        + text::to_string(batch_deleted_ids.size())
+                        + "  Wall time (ms): "
+                        + text::to_string(wall_time.total_milliseconds()));
+                }
+            }
+            else
+            {
+                LOG(error, "dbinterface", "commit_batch",
+                    "Batch " + text::to_string(batch_count)
+                    + " failed and will be retried.  Updated: "
+                    + text::to_string(batch_updated_ids.size())
+                    + "  Deleted: "
+                    + text::to_string(batch_deleted_ids.size())
+                    + "  Wall time (ms): "
+                    + text::to_string(wall_time.total_milliseconds()));
+
+                // Nothing in the batch made it to the database.  Requeue
+                // it all so it can be tried again.
+                //
+                for (dbtype::Entity::IdVector::const_iterator id_iter =
+                        batch_updated_ids.begin();
+                    id_iter != batch_updated_ids.end();
+                    ++id_iter)
+                {
+                    EntityRef entity = db->get_entity_deleted(*id_iter);
+
+                    if (entity.valid())
+                    {
+                        boost::lock_guard<boost::mutex> guard(mutex);
+
+                        if (pending_updates.find(*id_iter) ==
+                            pending_updates.end())
+                        {
+                            pending_updates.insert(std::make_pair(
+                                *id_iter,
+                                new EntityUpdate(entity.get())));
+                            flush_requested();
+                        }
+                    }
+                }
+
+                boost::lock_guard<boost::mutex> guard(mutex);
+                pending_deletes.insert(
+                    batch_deleted_ids.begin(),
+                    batch_deleted_ids.end());
+                flush_requested();
+
+                // Back off before retrying, waiting longer each time it
+                // keeps failing.
+                //
+                retry_deadline =
+                    boost::posix_time::microsec_clock::universal_time()
+                        + retry_delay;
+
+                if (flush_deadline.is_not_a_date_time() or
+                    (flush_deadline < retry_deadline))
+                {
+                    flush_deadline = retry_deadline;
+                }
+
+                retry_delay = retry_delay * 2;
+
+                if (retry_delay > FLUSH_RETRY_MAX_DELAY)
+                {
+                    retry_delay = FLUSH_RETRY_MAX_DELAY;
+                }
+            }
+
+            batch_updated_ids.clear();
+            batch_deleted_ids.clear();
+        }
+    }
+
     // ----------------------------------------------------------------------
     UpdateManager::UpdateManager(void)
       : thread_ptr(0),
-        shutdown_thread_flag(false)
+        shutdown_thread_flag(false),
+        eviction_requested(false),
+        high_water_notified(false),
+        retry_delay(FLUSH_RETRY_MIN_DELAY),
+        batch_open(false),
+        batch_count(0)
     {
     }
 
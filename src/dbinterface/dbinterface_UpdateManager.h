@@ -6,8 +6,12 @@
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/lockfree/queue.hpp>
 #include <boost/atomic/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
 
 #include "dbtypes/dbtype_Id.h"
 #include "dbtypes/dbtype_Entity.h"
@@ -25,9 +29,14 @@ namespace dbinterface
      * anything contained by the Entity.  The program that issues the delete
      * is responsible for moving anything out that shouldn't be deleted.
      *
-     * Pending operations are queued for periodic processing on a thread.
-     * In the future this could allow for some sort of transaction-based updates
-     * to preserve integrity.
+     * Pending operations are queued for processing on a thread.  The thread
+     * sleeps until there is something to do, and then flushes once enough
+     * changes have accumulated or the oldest pending change has waited long
+     * enough, whichever comes first.  Shutdown wakes the thread immediately.
+     * Each round of processing is written to the database in one or more
+     * batches (transactions), bounded by a maximum size and age, rather than
+     * one write per Entity.  When requested, the thread also evicts
+     * Entities from the database cache after a round of processing.
      */
     class UpdateManager : public dbtype::DatabaseEntityChangeListener
     {
@@ -107,6 +116,32 @@ namespace dbinterface
          */
         bool is_entity_delete_pending(const dbtype::Id &entity_id);
 
+        /**
+         * Used to determine if an Entity has changes that have not yet been
+         * committed to the database.  Such an Entity must stay in the
+         * database cache even if it is no longer dirty, or the changes will
+         * be lost.
+         * @param entity_id[in] The ID of the Entity to check.
+         * @return True if Entity has an update pending.
+         */
+        bool is_entity_update_pending(const dbtype::Id &entity_id);
+
+        /**
+         * Gets every Entity with an update or delete pending at once, for
+         * when many Entities need to be checked.
+         * @param ids[out] The IDs of all Entities with an update or delete
+         * pending.  Any existing contents are replaced.
+         */
+        void get_pending_ids(dbtype::Entity::IdSet &ids);
+
+        /**
+         * Called when the database cache is over its memory budget.  The
+         * thread will evict Entities from the cache between batches, when
+         * nothing it has written is uncommitted.  Evictions are spaced at
+         * least a minimum interval apart.
+         */
+        void cache_eviction_requested(void);
+
         /**
          * Adds the given site ID to the list of pending database delete
          * commits.  The site must already have been marked as delete pending.
@@ -201,6 +236,47 @@ namespace dbinterface
             const dbtype::Id &target,
             const dbtype::EntityField field);
 
+        /**
+         * Notes that something was added to the pending updates or deletes,
+         * starting the clock on how long it may wait before being flushed,
+         * and wakes up the thread if needed.
+         * The lock mutex is assumed to be LOCKED.
+         */
+        void flush_requested(void);
+
+        /**
+         * Determines if the thread should wake up and process what is
+         * pending (or exit).
+         * The lock mutex is assumed to be LOCKED.
+         * @param made_progress[in] True if the previous round of processing
+         * wrote anything to the database.
+         * @return True if pending operations should be processed now.
+         */
+        bool flush_due(const bool made_progress);
+
+        /**
+         * Starts a new batch of database writes and resets the batch
+         * statistics.
+         */
+        void begin_batch(void);
+
+        /**
+         * Records a row written as part of the current batch.  If the batch
+         * has reached its maximum size or age, it is committed and a new one
+         * is started.
+         * @param id[in] The ID of the Entity written.
+         * @param deleted[in] True if the Entity was deleted, false if
+         * updated.
+         */
+        void batch_row_written(const dbtype::Id &id, const bool deleted);
+
+        /**
+         * Commits the current batch, if any, and reports its statistics.  If
+         * the commit fails, everything in the batch is requeued to be tried
+         * again later, after a delay that doubles each time it fails.
+         */
+        void commit_batch(void);
+
         /**
          * Singleton constructor.
          */
@@ -219,6 +295,21 @@ namespace dbinterface
         dbtype::Entity::IdSet pending_deletes; ///< Deletes to be committed
         dbtype::Id::SiteIdVector pending_site_deletes; ///< Pending site deletes
         boost::atomic<bool> shutdown_thread_flag; ///< True if thread should shutdown
+        boost::condition_variable flush_condition; ///< Wakes up the thread
+        boost::posix_time::ptime flush_deadline; ///< When pending must be flushed by
+        bool eviction_requested; ///< True if cache is over its memory budget
+        boost::posix_time::ptime last_eviction_time; ///< When cache last evicted
+        bool high_water_notified; ///< True if thread was woken for the high water mark
+        boost::posix_time::ptime retry_deadline; ///< If set, no flushing until then
+        boost::posix_time::time_duration retry_delay; ///< Wait after the next failed batch
+
+        // Only used by the UpdateManager thread, and therefore not locked.
+        //
+        bool batch_open; ///< True if a batch has been started
+        boost::posix_time::ptime batch_start_time; ///< When batch was started
+        dbtype::Entity::IdVector batch_updated_ids; ///< Updated in batch
+        dbtype::Entity::IdVector batch_deleted_ids; ///< Deleted in batch
+        MG_LongUnsignedInt batch_count; ///< Batches committed since startup
     };
 
 }
@@ -50,6 +50,7 @@ namespace dbtype
         entity_deleted_flag(false),
         need_call_listener(true),
         dirty_flag(false),
+        dirty_serial(0),
         ignore_changes(false),
         locked_thread_id_valid(false),
         inner_lock_count(0)
@@ -81,6 +82,7 @@ namespace dbtype
         entity_deleted_flag(false),
         need_call_listener(false),
         dirty_flag(false),
+        dirty_serial(0),
         ignore_changes(true),
         locked_thread_id_valid(false),
         inner_lock_count(0)
@@ -139,6 +141,7 @@ namespace dbtype
         entity_deleted_flag(false),
         need_call_listener(false),
         dirty_flag(false),
+        dirty_serial(0),
         ignore_changes(restoring),
         locked_thread_id_valid(false),
         inner_lock_count(0)
@@ -262,6 +265,55 @@ namespace dbtype
         return success;
     }
 
+    // -----------------------------------------------------------------------
+    bool Entity::clear_dirty(
+        concurrency::WriterLockToken &token,
+        const DirtySerialType serial)
+    {
+        bool success = true;
+
+        if (token.has_lock(*this))
+        {
+            if (dirty_serial == serial)
+            {
+                dirty_flag = false;
+                dirty_fields.clear();
+            }
+            else
+            {
+                success = false;
+            }
+        }
+        else
+        {
+            LOG(error, "dbtype", "clear_dirty",
+                "Using the wrong lock token!");
+
+            success = false;
+        }
+
+        return success;
+    }
+
+    // -----------------------------------------------------------------------
+    Entity::DirtySerialType Entity::get_dirty_serial(
+        concurrency::ReaderLockToken &token)
+    {
+        DirtySerialType serial = 0;
+
+        if (token.has_lock(*this))
+        {
+            serial = dirty_serial;
+        }
+        else
+        {
+            LOG(error, "dbtype", "get_dirty_serial",
+                "Using the wrong lock token!");
+        }
+
+        return serial;
+    }
+
     // -----------------------------------------------------------------------
     bool Entity::is_dirty(void)
     {
@@ -1871,6 +1923,7 @@ namespace dbtype
             field_entry = diff_ids_changed.find(field);
 
         dirty_flag = true;
+        ++dirty_serial;
 
         if (field_entry == diff_ids_changed.end())
         {
@@ -1898,6 +1951,7 @@ namespace dbtype
             field_entry = diff_ids_changed.find(field);
 
         dirty_flag = true;
+        ++dirty_serial;
 
         if (field_entry == diff_ids_changed.end())
         {
@@ -1934,6 +1988,7 @@ namespace dbtype
             field_entry = diff_ids_changed.find(field);
 
         dirty_flag = true;
+        ++dirty_serial;
 
         if (field_entry == diff_ids_changed.end())
         {
@@ -1963,6 +2018,7 @@ namespace dbtype
     void Entity::added_flag(const FlagType &flag_added)
     {
         dirty_flag = true;
+        ++dirty_serial;
         diff_flags_changed.first.erase(flag_added);
         diff_flags_changed.second.insert(flag_added);
     }
@@ -1971,6 +2027,7 @@ namespace dbtype
     void Entity::removed_flag(const FlagType &flag_removed)
     {
         dirty_flag = true;
+        ++dirty_serial;
         diff_flags_changed.first.insert(flag_removed);
         diff_flags_changed.second.erase(flag_removed);
     }
@@ -2302,6 +2359,7 @@ namespace dbtype
         if ((not ignore_changes) and (! db_listeners.empty()))
         {
             dirty_flag = true;
+            ++dirty_serial;
             dirty_fields.insert(field);
             diff_callback_fields.insert(field);
             need_call_listener = true;
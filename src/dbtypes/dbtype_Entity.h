@@ -90,6 +90,8 @@ namespace dbtype
         typedef MG_UnsignedInt VersionType;
         /** Data type for the access counter */
         typedef MG_VeryLongUnsignedInt AccessCountType;
+        /** Data type for the dirty serial number */
+        typedef MG_VeryLongUnsignedInt DirtySerialType;
 
         /** First is flags removed, second is flags added.  Process removals
          *  first, then adds. */
@@ -301,6 +303,27 @@ namespace dbtype
          */
         bool clear_dirty(concurrency::WriterLockToken &token);
 
+        /**
+         * Clears the dirty flag and any information regarding what was
+         * dirty, but only if the Entity has not been changed since serial
+         * was obtained.  This allows the Entity to be unlocked while it is
+         * being saved.
+         * @param token[in] The lock token.
+         * @param serial[in] The serial from get_dirty_serial(), obtained
+         * when the Entity was copied to be saved.
+         * @return True if success (valid lock and not changed since).
+         */
+        bool clear_dirty(
+            concurrency::WriterLockToken &token,
+            const DirtySerialType serial);
+
+        /**
+         * @param token[in] The lock token.
+         * @return A number that changes every time the Entity is marked
+         * dirty, for use with clear_dirty().  0 if error.
+         */
+        DirtySerialType get_dirty_serial(concurrency::ReaderLockToken &token);
+
         /**
          * This method will automatically get a lock.
          * @return True if the Entity is 'dirty' (has changes not yet
@@ -1377,6 +1400,7 @@ namespace dbtype
         static DbListeners db_listeners; ///< DB listeners
         bool need_call_listener;  ///< When true, call listener when unlocked
         bool dirty_flag; ///< When true, changes need to be saved
+        DirtySerialType dirty_serial; ///< Incremented when marked dirty
         bool ignore_changes; ///< Used when deserializing
 
         EntityFieldSet dirty_fields; ///< Set of dirty (changed) fields.
@@ -1,21 +1,47 @@
 /*
  * angelscript_td.cpp
+ * Runs a sample script, then measures how many times per second a trivial
+ * script can be invoked when its bytecode is loaded every time, versus
+ * when its module is kept in a ModuleCache.  Also measures how much memory
+ * each running script costs when it gets its own engine, versus when it
+ * only gets a context on a shared engine.
  */
 
+#include <string.h>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <angelscript.h>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #include "utilities/memory_ThreadVirtualHeapManager.h"
 #include "utilities/memory_MemHeapState.h"
 
 #include "angelscriptinterface/angelscript_AString.h"
 #include "angelscriptinterface/angelscript_StringFactory.h"
+#include "angelscriptinterface/angelscript_CompiledBytecodeStream.h"
+#include "angelscriptinterface/angelscript_ModuleCache.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "text/text_StringConversion.h"
 
 using namespace mutgos;
 
 unsigned int lines_executed = 0;
 
+/** How many times the trivial script is invoked per measurement */
+const unsigned int INVOCATIONS = 100000;
+/** How many copies of the trivial script run at once to measure memory */
+const unsigned int CONCURRENT_SCRIPTS = 100;
+
+const char *TRIVIAL_SCRIPT =
+    "int calls = 0;\n"
+    "void main() \n"
+    "{\n"
+    "  calls++;\n"
+    "}\n";
+
 void MessageCallback(const asSMessageInfo *msg, void *param)
 {
     const char *type = "ERR ";
@@ -46,28 +72,22 @@ void angel_print(const angelscript::AString &data)
     std::cout << ">> " << data_exported << std::endl;
 }
 
-// Adapted from sample angelscript code provided with library.
-int main(void)
+/**
+ * Creates an engine and registers what the scripts in this test use.
+ * @param string_factory_ptr[out] The engine's string factory.  Delete it
+ * after the engine has been shut down.
+ * @return The engine, or null if registration failed.
+ */
+asIScriptEngine *create_engine(angelscript::StringFactory *&string_factory_ptr)
 {
-    int rc = 0;
-    memory::MemHeapState heap_state(1024 * 2048);
-
-    memory::ThreadVirtualHeapManager::add_thread();
-    memory::ThreadVirtualHeapManager::set_thread_heap_state(heap_state);
-
-    asSetGlobalMemoryFunctions(
-        memory::ThreadVirtualHeapManager::mem_alloc_nofail,
-        memory::ThreadVirtualHeapManager::mem_free);
-    asPrepareMultithread();
-
     asIScriptEngine *engine = asCreateScriptEngine();
 
     engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
 
-    angelscript::StringFactory string_factory(engine);
+    string_factory_ptr = new angelscript::StringFactory(engine);
 
     angelscript::AString::register_methods(*engine);
-    rc = engine->RegisterStringFactory("string", &string_factory);
+    const int rc = engine->RegisterStringFactory("string", string_factory_ptr);
     engine->SetDefaultNamespace("ns");
     engine->RegisterGlobalFunction(
         "void print(const string &in str)",
@@ -77,15 +97,264 @@ int main(void)
         "void print(const string &in str)",
         asFUNCTION(angel_print), asCALL_CDECL);
 
-    // Create our context, prepare it, and then execute
-    asIScriptContext *ctx = engine->RequestContext();
-
     if (rc < 0)
     {
         std::cerr << "Unable to register string factory: " << rc << std::endl;
+        engine->ShutDownAndRelease();
+        engine = 0;
+    }
+
+    return engine;
+}
+
+/**
+ * Compiles the trivial script and saves its bytecode, the way a Program
+ * stores it.
+ * @param engine[in] The engine to compile with.
+ * @param bytecode[out] The saved bytecode.
+ * @return True if success.
+ */
+bool save_trivial_bytecode(
+    asIScriptEngine *engine,
+    angelscript::CompiledBytecodeStream &bytecode)
+{
+    bool success = false;
+    asIScriptModule *mod =
+        engine->GetModule("trivial", asGM_ALWAYS_CREATE);
+
+    if ((mod->AddScriptSection(
+            "trivial",
+            TRIVIAL_SCRIPT,
+            strlen(TRIVIAL_SCRIPT)) >= 0) and
+        (mod->Build() >= 0) and
+        (mod->SaveByteCode(&bytecode, false) >= 0))
+    {
+        success = true;
+    }
+
+    engine->DiscardModule("trivial");
+
+    return success;
+}
+
+/**
+ * Invokes the trivial script over and over, doing what AngelProcess does
+ * each time a script runs.
+ * @param engine[in] The engine to run the script on.
+ * @param ctx[in] The context to run the script with.
+ * @param bytecode[in] The script's bytecode, as stored in the Program.
+ * @param use_cache[in] True to keep the module in a ModuleCache, false to
+ * load the bytecode into a new module every invocation.
+ * @return Invocations per second, or 0 if error.
+ */
+double run_invocations(
+    asIScriptEngine *engine,
+    asIScriptContext *ctx,
+    angelscript::CompiledBytecodeStream &bytecode,
+    const bool use_cache)
+{
+    bool success = true;
+    const char *bytecode_ptr = 0;
+    size_t bytecode_size = 0;
+    angelscript::ModuleCache cache(*engine, 64);
+    const dbtype::Id program_id(1, 1);
+
+    bytecode.get_written_bytecode(bytecode_ptr, bytecode_size);
+
+    const boost::posix_time::ptime start_time =
+        boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int count = 0; success and (count < INVOCATIONS); ++count)
+    {
+        asIScriptModule *mod =
+            use_cache ? cache.take_module(program_id, 0) : 0;
+
+        if (mod)
+        {
+            success = (mod->ResetGlobalVars() >= 0);
+        }
+        else
+        {
+            // AngelScriptAccess::compile_script() hands out a copy.
+            char *bytecode_copy = new char[bytecode_size];
+            memcpy(bytecode_copy, bytecode_ptr, bytecode_size);
+            angelscript::CompiledBytecodeStream stream(
+                bytecode_copy,
+                bytecode_size);
+
+            mod = use_cache ?
+                cache.make_module() :
+                engine->GetModule("uncached", asGM_ALWAYS_CREATE);
+            success = mod and (mod->LoadByteCode(&stream) >= 0);
+        }
+
+        asIScriptFunction *func =
+            success ? mod->GetFunctionByDecl("void main()") : 0;
+
+        success = func and
+            (ctx->Prepare(func) >= 0) and
+            (ctx->Execute() == asEXECUTION_FINISHED);
+
+        ctx->Unprepare();
+
+        if (use_cache and mod)
+        {
+            cache.return_module(program_id, 0, mod);
+            engine->GarbageCollect(asGC_ONE_STEP);
+        }
+        else
+        {
+            engine->DiscardModule("uncached");
+            engine->GarbageCollect();
+        }
+    }
+
+    const boost::posix_time::time_duration elapsed =
+        boost::posix_time::microsec_clock::universal_time() - start_time;
+    const double seconds = elapsed.total_microseconds() / 1000000.0;
+
+    if (not success)
+    {
+        std::cerr << "ERROR: Trivial script failed to run." << std::endl;
+    }
+
+    return success ? (INVOCATIONS / (seconds > 0 ? seconds : 1)) : 0;
+}
+
+/**
+ * Measures how much memory each running script costs, by getting many
+ * copies of the trivial script ready to run at once.
+ * @param bytecode[in] The trivial script's bytecode.
+ * @param share_engine[in] True to give each copy a context on one shared
+ * engine, false to give each copy its own engine.
+ * @return Bytes used per script, or 0 if error.
+ */
+size_t measure_memory_per_script(
+    angelscript::CompiledBytecodeStream &bytecode,
+    const bool share_engine)
+{
+    bool success = true;
+    const char *bytecode_ptr = 0;
+    size_t bytecode_size = 0;
+    std::vector<asIScriptEngine *> engines;
+    std::vector<angelscript::StringFactory *> string_factories;
+    std::vector<asIScriptContext *> contexts;
+
+    bytecode.get_written_bytecode(bytecode_ptr, bytecode_size);
+
+    const memory::MemHeapState current_heap =
+        memory::ThreadVirtualHeapManager::get_thread_heap_state();
+    const memory::MemHeapState measure_heap;
+    memory::ThreadVirtualHeapManager::set_thread_heap_state(measure_heap);
+
+    for (unsigned int count = 0;
+        success and (count < CONCURRENT_SCRIPTS);
+        ++count)
+    {
+        if (engines.empty() or (not share_engine))
+        {
+            angelscript::StringFactory *string_factory_ptr = 0;
+            asIScriptEngine * const new_engine =
+                create_engine(string_factory_ptr);
+
+            string_factories.push_back(string_factory_ptr);
+
+            if (new_engine)
+            {
+                engines.push_back(new_engine);
+            }
+            else
+            {
+                success = false;
+            }
+        }
+
+        if (success)
+        {
+            // Each copy could be a different program, so each gets its own
+            // module either way.
+            //
+            asIScriptEngine * const engine = engines.back();
+            const std::string module_name =
+                "concurrent" + text::to_string(count);
+            char *bytecode_copy = new char[bytecode_size];
+            memcpy(bytecode_copy, bytecode_ptr, bytecode_size);
+            angelscript::CompiledBytecodeStream stream(
+                bytecode_copy,
+                bytecode_size);
+            asIScriptModule * const mod = engine->GetModule(
+                module_name.c_str(),
+                asGM_ALWAYS_CREATE);
+            asIScriptContext * const ctx = engine->RequestContext();
+
+            if (ctx)
+            {
+                contexts.push_back(ctx);
+            }
+
+            success = mod and ctx and
+                (mod->LoadByteCode(&stream) >= 0) and
+                (ctx->Prepare(mod->GetFunctionByDecl("void main()")) >= 0);
+        }
+    }
+
+    const size_t bytes_used =
+        memory::ThreadVirtualHeapManager::get_thread_heap_state().
+            get_mem_in_use();
+
+    // Clean up.  Each context is returned to the engine it came from.
+    //
+    for (size_t index = 0; index < contexts.size(); ++index)
+    {
+        contexts[index]->Unprepare();
+        contexts[index]->GetEngine()->ReturnContext(contexts[index]);
+    }
+
+    for (size_t index = 0; index < engines.size(); ++index)
+    {
+        engines[index]->ShutDownAndRelease();
+    }
+
+    for (size_t index = 0; index < string_factories.size(); ++index)
+    {
+        delete string_factories[index];
+    }
+
+    memory::ThreadVirtualHeapManager::set_thread_heap_state(current_heap);
+
+    if (not success)
+    {
+        std::cerr << "ERROR: Could not get scripts ready to run." << std::endl;
+    }
+
+    return success ? (bytes_used / CONCURRENT_SCRIPTS) : 0;
+}
+
+// Adapted from sample angelscript code provided with library.
+int main(void)
+{
+    int rc = 0;
+    memory::MemHeapState heap_state(1024 * 2048);
+
+    memory::ThreadVirtualHeapManager::add_thread();
+    memory::ThreadVirtualHeapManager::set_thread_heap_state(heap_state);
+
+    asSetGlobalMemoryFunctions(
+        memory::ThreadVirtualHeapManager::mem_alloc_nofail,
+        memory::ThreadVirtualHeapManager::mem_free);
+    asPrepareMultithread();
+
+    angelscript::StringFactory *string_factory_ptr = 0;
+    asIScriptEngine *engine = create_engine(string_factory_ptr);
+
+    if (not engine)
+    {
         return -1;
     }
 
+    // Create our context, prepare it, and then execute
+    asIScriptContext *ctx = engine->RequestContext();
+
     const char *script1 =
         "void main() \n"
         "{\n"
@@ -153,6 +422,28 @@ int main(void)
         }
     }
 
+    angelscript::CompiledBytecodeStream trivial_bytecode;
+
+    if (not save_trivial_bytecode(engine, trivial_bytecode))
+    {
+        std::cerr << "ERROR: Could not compile trivial script." << std::endl;
+    }
+    else
+    {
+        std::cout << "Invocations/sec, loading bytecode each time: "
+                  << run_invocations(engine, ctx, trivial_bytecode, false)
+                  << std::endl;
+        std::cout << "Invocations/sec, using module cache:         "
+                  << run_invocations(engine, ctx, trivial_bytecode, true)
+                  << std::endl;
+        std::cout << "Bytes per concurrent script, own engine:     "
+                  << measure_memory_per_script(trivial_bytecode, false)
+                  << std::endl;
+        std::cout << "Bytes per concurrent script, shared engine:  "
+                  << measure_memory_per_script(trivial_bytecode, true)
+                  << std::endl;
+    }
+
     heap_state = memory::ThreadVirtualHeapManager::get_thread_heap_state();
 
     std::cout << "Cleaning up..." << std::endl;
@@ -163,6 +454,7 @@ int main(void)
 
     engine->DiscardModule("script1");
     engine->ShutDownAndRelease();
+    delete string_factory_ptr;
     asThreadCleanup();
 
     heap_state = memory::ThreadVirtualHeapManager::get_thread_heap_state();
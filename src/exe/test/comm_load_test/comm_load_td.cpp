@@ -0,0 +1,397 @@
+/*
+ * comm_load_td.cpp
+ * Load test for the socket driver.  Opens thousands of local telnet
+ * connections, and has each of them repeatedly send a line and wait for
+ * the reply.  Reports how many replies per second the comm subsystem
+ * handles in total, and the p50 and p99 time from sending a line to
+ * getting its reply.
+ *
+ * Before logging in, every line sent gets the login screen back, so this
+ * runs with an empty database.  The database is created in the current
+ * directory, so run it in an empty one.
+ *
+ * Usage: comm_load_td [connections] [seconds]
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/placeholders.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+#include "utilities/memory_ThreadVirtualHeapManager.h"
+
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "events/events_EventAccess.h"
+#include "comminterface/comm_CommAccess.h"
+
+using namespace mutgos;
+
+namespace
+{
+    /** Connections to open if not given on the command line */
+    const unsigned int DEFAULT_CONNECTIONS = 2000;
+    /** How long to measure for if not given on the command line, in s */
+    const unsigned int DEFAULT_SECONDS = 10;
+    /** Longest to wait for every connection to get its login screen, in s */
+    const unsigned int CONNECT_TIMEOUT_SECONDS = 60;
+    /** File descriptors needed per connection (client and server side) */
+    const unsigned int FDS_PER_CONNECTION = 2;
+    /** File descriptors to leave for the database, logging, etc */
+    const unsigned int SPARE_FDS = 64;
+
+    /** The port the socket driver listens on */
+    const unsigned short SOCKET_PORT = 7072;
+    /** Starts every login screen */
+    const std::string REPLY_MARKER = "Welcome to the MUTGOS";
+    /** What each connection sends; anything but a login gets the screen */
+    const std::string REQUEST_LINE = "look\n";
+    /** Size of each connection's read buffer */
+    const size_t READ_BUFFER_SIZE = 4096;
+
+    /** Connections that have gotten their first login screen */
+    boost::atomic<unsigned int> connections_ready(0);
+    /** Connections that failed or were closed */
+    boost::atomic<unsigned int> connections_failed(0);
+    /** True while replies are being counted */
+    boost::atomic<bool> measuring(false);
+    /** Round trip times of the replies counted, in us.  Only used by the
+        client IO thread until it stops. */
+    std::vector<MG_LongUnsignedInt> round_trip_us;
+
+    /**
+     * One client connection.  It waits for the login screen the server
+     * sends on connect, and then sends a line every time a login screen
+     * arrives.  Only used from the client IO thread.
+     */
+    class LoadClient
+    {
+    public:
+        LoadClient(boost::asio::io_context &io_context)
+          : socket(io_context),
+            ready(false),
+            closed(false)
+        { }
+
+        /**
+         * Starts connecting.
+         * @param endpoints[in] Where to connect to.
+         */
+        void start(const boost::asio::ip::tcp::resolver::results_type &endpoints)
+        {
+            boost::asio::async_connect(
+                socket,
+                endpoints,
+                boost::bind(
+                    &LoadClient::on_connect,
+                    this,
+                    boost::asio::placeholders::error));
+        }
+
+        /**
+         * Closes the socket.  Handlers still queued will see the error.
+         */
+        void close(void)
+        {
+            boost::system::error_code error_code;
+            socket.close(error_code);
+        }
+
+    private:
+        void on_connect(const boost::system::error_code &error_code)
+        {
+            if (error_code)
+            {
+                fail();
+            }
+            else
+            {
+                do_read();
+            }
+        }
+
+        void do_read(void)
+        {
+            socket.async_read_some(
+                boost::asio::buffer(read_buffer, READ_BUFFER_SIZE),
+                boost::bind(
+                    &LoadClient::on_read,
+                    this,
+                    boost::asio::placeholders::error,
+                    boost::asio::placeholders::bytes_transferred));
+        }
+
+        void on_read(
+            const boost::system::error_code &error_code,
+            const size_t bytes_transferred)
+        {
+            if (error_code)
+            {
+                fail();
+            }
+            else
+            {
+                pending_text.append(read_buffer, bytes_transferred);
+
+                size_t marker_index = pending_text.find(REPLY_MARKER);
+                bool got_reply = false;
+
+                while (marker_index != std::string::npos)
+                {
+                    got_reply = true;
+                    pending_text.erase(0, marker_index + REPLY_MARKER.size());
+                    marker_index = pending_text.find(REPLY_MARKER);
+                }
+
+                // Keep the end of what was read, in case a marker is split
+                // between reads.
+                //
+                if (pending_text.size() > REPLY_MARKER.size())
+                {
+                    pending_text.erase(
+                        0,
+                        pending_text.size() - REPLY_MARKER.size());
+                }
+
+                if (got_reply)
+                {
+                    if (ready)
+                    {
+                        if (measuring.load())
+                        {
+                            round_trip_us.push_back(
+                                (boost::posix_time::microsec_clock::
+                                    universal_time() - request_time).
+                                        total_microseconds());
+                        }
+                    }
+                    else
+                    {
+                        ready = true;
+                        ++connections_ready;
+                    }
+
+                    request_time =
+                        boost::posix_time::microsec_clock::universal_time();
+
+                    boost::asio::async_write(
+                        socket,
+                        boost::asio::buffer(REQUEST_LINE),
+                        boost::bind(
+                            &LoadClient::on_write,
+                            this,
+                            boost::asio::placeholders::error));
+                }
+
+                do_read();
+            }
+        }
+
+        void on_write(const boost::system::error_code &error_code)
+        {
+            if (error_code)
+            {
+                fail();
+            }
+        }
+
+        void fail(void)
+        {
+            if (not closed)
+            {
+                closed = true;
+                ++connections_failed;
+            }
+        }
+
+        boost::asio::ip::tcp::socket socket;
+        char read_buffer[READ_BUFFER_SIZE];
+        std::string pending_text;
+        boost::posix_time::ptime request_time;
+        bool ready;
+        bool closed;
+    };
+
+    /**
+     * Raises the open file limit as far as allowed.
+     * @param connections[in] How many connections are wanted.
+     * @return How many connections the limit allows, up to connections.
+     */
+    unsigned int raise_fd_limit(const unsigned int connections)
+    {
+        rlimit limit;
+        unsigned int allowed = connections;
+
+        if (not getrlimit(RLIMIT_NOFILE, &limit))
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+            getrlimit(RLIMIT_NOFILE, &limit);
+
+            const rlim_t needed =
+                (connections * FDS_PER_CONNECTION) + SPARE_FDS;
+
+            if (limit.rlim_cur < needed)
+            {
+                allowed = (limit.rlim_cur > SPARE_FDS) ?
+                    (limit.rlim_cur - SPARE_FDS) / FDS_PER_CONNECTION : 0;
+            }
+        }
+
+        return allowed;
+    }
+
+    void run_load_test(const unsigned int connections, const unsigned int seconds)
+    {
+        boost::asio::io_context client_io(1);
+        boost::asio::ip::tcp::resolver resolver(client_io);
+        const boost::asio::ip::tcp::resolver::results_type endpoints =
+            resolver.resolve("127.0.0.1", text::to_string(SOCKET_PORT));
+        std::vector<LoadClient *> clients;
+
+        clients.reserve(connections);
+        round_trip_us.reserve(1024 * 1024);
+
+        for (unsigned int index = 0; index < connections; ++index)
+        {
+            clients.push_back(new LoadClient(client_io));
+            clients.back()->start(endpoints);
+        }
+
+        boost::thread client_thread(
+            boost::bind(&boost::asio::io_context::run, &client_io));
+
+        // Wait for everyone to connect and get their first login screen.
+        //
+        const boost::posix_time::ptime connect_start =
+            boost::posix_time::microsec_clock::universal_time();
+
+        while (((connections_ready.load() + connections_failed.load()) <
+                connections) and
+            ((boost::posix_time::microsec_clock::universal_time() -
+                connect_start).total_seconds() < CONNECT_TIMEOUT_SECONDS))
+        {
+            boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+        }
+
+        const double connect_seconds =
+            (boost::posix_time::microsec_clock::universal_time() -
+                connect_start).total_microseconds() / 1000000.0;
+
+        std::cout << "Connected " << connections_ready.load() << " of "
+                  << connections << " in " << connect_seconds << " s, "
+                  << connections_failed.load() << " failed." << std::endl;
+
+        // Measure.
+        //
+        const boost::posix_time::ptime start_time =
+            boost::posix_time::microsec_clock::universal_time();
+
+        measuring.store(true);
+        boost::this_thread::sleep_for(boost::chrono::seconds(seconds));
+        measuring.store(false);
+
+        const double elapsed_seconds =
+            (boost::posix_time::microsec_clock::universal_time() -
+                start_time).total_microseconds() / 1000000.0;
+
+        // Close everything before stopping the client thread, so the
+        // server sees the disconnects.
+        //
+        for (std::vector<LoadClient *>::iterator client_iter = clients.begin();
+            client_iter != clients.end();
+            ++client_iter)
+        {
+            (*client_iter)->close();
+        }
+
+        client_io.stop();
+        client_thread.join();
+
+        const size_t replies = round_trip_us.size();
+
+        std::cout << "Replies: " << replies << " in " << elapsed_seconds
+                  << " s, messages/sec: "
+                  << (unsigned long) (replies / elapsed_seconds) << std::endl;
+
+        if (replies)
+        {
+            std::sort(round_trip_us.begin(), round_trip_us.end());
+
+            std::cout << "Round trip p50: " << round_trip_us[replies / 2]
+                      << " us, p99: " << round_trip_us[(replies * 99) / 100]
+                      << " us, max: " << round_trip_us.back() << " us"
+                      << std::endl;
+        }
+
+        for (std::vector<LoadClient *>::iterator client_iter = clients.begin();
+            client_iter != clients.end();
+            ++client_iter)
+        {
+            delete *client_iter;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int connections =
+        (argc > 1) ? (unsigned int) atoi(argv[1]) : DEFAULT_CONNECTIONS;
+    const unsigned int seconds =
+        (argc > 2) ? (unsigned int) atoi(argv[2]) : DEFAULT_SECONDS;
+
+    memory::ThreadVirtualHeapManager::add_thread();
+    log::Logger::init(true);
+    log::Logger::set_level(error);
+
+    const unsigned int allowed = raise_fd_limit(connections);
+
+    if (allowed < connections)
+    {
+        std::cout << "Open file limit only allows " << allowed
+                  << " connections." << std::endl;
+        connections = allowed;
+    }
+
+    if (not (dbinterface::DatabaseAccess::make_singleton()->startup() and
+        events::EventAccess::make_singleton()->startup() and
+        comm::CommAccess::make_singleton()->startup()))
+    {
+        std::cerr << "FAILED to start up." << std::endl;
+        return -1;
+    }
+
+    std::cout << "CPU cores: " << boost::thread::hardware_concurrency()
+              << std::endl
+              << "Connections: " << connections << ", seconds: " << seconds
+              << std::endl;
+
+    run_load_test(connections, seconds);
+
+    comm::CommAccess::instance()->shutdown();
+    events::EventAccess::instance()->shutdown();
+    dbinterface::DatabaseAccess::instance()->shutdown();
+
+    comm::CommAccess::destroy_singleton();
+    events::EventAccess::destroy_singleton();
+    dbinterface::DatabaseAccess::destroy_singleton();
+
+    memory::ThreadVirtualHeapManager::delete_thread();
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * entity_codec_td.cpp
+ * Compares the compact Entity format against the old boost binary format,
+ * using the Entities from a dump file.
+ *
+ * This creates a database in the current directory, so run it in an empty
+ * one.
+ */
+
+#include <stddef.h>
+#include <string>
+#include <iostream>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "text/text_StringConversion.h"
+#include "logging/log_Logger.h"
+
+#include "dbdump/dbdump_MutgosDumpFileReader.h"
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "dbinterface/dbinterface_EntityCodec.h"
+#include "dbinterface/dbinterface_EntityRef.h"
+#include "dbtypes/dbtype_Entity.h"
+#include "dbtypes/dbtype_Id.h"
+#include "concurrency/concurrency_WriterLockToken.h"
+#include "utilities/utility_MemoryBuffer.h"
+
+using namespace mutgos;
+
+namespace
+{
+    /** How many times each Entity is serialized and deserialized */
+    const int ITERATIONS = 20;
+
+    /**
+     * Totals for one format.
+     */
+    struct FormatStats
+    {
+        FormatStats(void)
+          : bytes(0),
+            mismatches(0)
+        { }
+
+        size_t bytes; ///< Size of all Entities, serialized once
+        size_t mismatches; ///< Entities that changed going through the format
+        boost::posix_time::time_duration serialize_time; ///< Total time
+        boost::posix_time::time_duration deserialize_time; ///< Total time
+    };
+
+    /**
+     * Serializes and deserializes an Entity ITERATIONS times in the given
+     * format, adding the results to stats.
+     * @return False if serializing or deserializing failed.
+     */
+    bool run_format(
+        dbtype::Entity *entity_ptr,
+        const dbinterface::EntityCodec::Format format,
+        FormatStats &stats)
+    {
+        bool success = true;
+        char *data_ptr = 0;
+        size_t data_size = 0;
+        const std::string original = entity_ptr->to_string();
+
+        for (int iteration = 0; success and (iteration < ITERATIONS);
+            ++iteration)
+        {
+            utility::MemoryBuffer buffer;
+            dbtype::Entity *copy_ptr = 0;
+
+            // Scope for lock
+            {
+                concurrency::WriterLockToken token(*entity_ptr);
+                const boost::posix_time::ptime start_time =
+                    boost::posix_time::microsec_clock::universal_time();
+
+                success = dbinterface::EntityCodec::serialize(
+                    entity_ptr,
+                    buffer,
+                    format);
+
+                stats.serialize_time +=
+                    boost::posix_time::microsec_clock::universal_time()
+                        - start_time;
+            }
+
+            success = success and buffer.get_data(data_ptr, data_size);
+
+            if (success)
+            {
+                const boost::posix_time::ptime start_time =
+                    boost::posix_time::microsec_clock::universal_time();
+
+                copy_ptr = dbinterface::EntityCodec::deserialize(
+                    entity_ptr->get_entity_type(),
+                    data_ptr,
+                    data_size);
+
+                stats.deserialize_time +=
+                    boost::posix_time::microsec_clock::universal_time()
+                        - start_time;
+
+                success = copy_ptr;
+            }
+
+            if (success and (not iteration))
+            {
+                stats.bytes += data_size;
+
+                if (copy_ptr->to_string() != original)
+                {
+                    ++stats.mismatches;
+                }
+            }
+
+            delete copy_ptr;
+        }
+
+        return success;
+    }
+
+    /**
+     * Prints the results for a format.
+     */
+    void print_stats(
+        const std::string &name,
+        const FormatStats &stats,
+        const size_t entity_count)
+    {
+        const size_t divisor = entity_count ? entity_count : 1;
+        const MG_LongUnsignedInt runs = divisor * ITERATIONS;
+
+        std::cout << name << ":" << std::endl
+                  << "  Total bytes:          " << stats.bytes << std::endl
+                  << "  Average bytes:        " << stats.bytes / divisor
+                  << std::endl
+                  << "  Serialize (ns avg):   "
+                  << (stats.serialize_time.total_microseconds() * 1000) / runs
+                  << std::endl
+                  << "  Deserialize (ns avg): "
+                  << (stats.deserialize_time.total_microseconds() * 1000)
+                     / runs
+                  << std::endl
+                  << "  Round trip mismatches: " << stats.mismatches
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Syntax is: " << argv[0] << " <dump_file>" << std::endl;
+        return -1;
+    }
+
+    mutgos::log::Logger::init(true);
+
+    const std::string dump_file = argv[1];
+    std::string message;
+    mutgos::dbdump::MutgosDumpFileReader reader(dump_file);
+
+    if (not reader.parse(message))
+    {
+        std::cerr << "FAILURE: Parsing did NOT complete." << std::endl
+                  << "  Line: " << mutgos::text::to_string(
+                     reader.get_current_line_index()) << std::endl
+                  << "  Message: " << message << std::endl;
+        return -1;
+    }
+
+    dbinterface::DatabaseAccess * const db =
+        dbinterface::DatabaseAccess::instance();
+    const dbtype::Id::SiteIdVector site_ids = db->get_all_site_ids();
+    FormatStats legacy_stats;
+    FormatStats compact_stats;
+    size_t entity_count = 0;
+
+    for (dbtype::Id::SiteIdVector::const_iterator site_iter =
+            site_ids.begin();
+        site_iter != site_ids.end();
+        ++site_iter)
+    {
+        const dbtype::Entity::IdVector ids = db->find(*site_iter);
+
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            dbinterface::EntityRef entity_ref = db->get_entity(*id_iter);
+
+            if (entity_ref.valid())
+            {
+                if (not (run_format(
+                        entity_ref.get(),
+                        dbinterface::EntityCodec::FORMAT_LEGACY_BOOST,
+                        legacy_stats) and
+                    run_format(
+                        entity_ref.get(),
+                        dbinterface::EntityCodec::FORMAT_COMPACT,
+                        compact_stats)))
+                {
+                    std::cerr << "FAILED to serialize or deserialize "
+                              << id_iter->to_string(true) << std::endl;
+                    return -1;
+                }
+
+                ++entity_count;
+            }
+        }
+    }
+
+    std::cout << "Entities: " << entity_count << "   Iterations: "
+              << ITERATIONS << std::endl;
+    print_stats("boost binary_oarchive", legacy_stats, entity_count);
+    print_stats("Compact", compact_stats, entity_count);
+
+    if (compact_stats.mismatches or legacy_stats.mismatches)
+    {
+        std::cerr << "FAILED: Entities changed going through a format."
+                  << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,820 @@
+/*
+ * executor_td.cpp
+ * Measures executor throughput (process slices run per second) for
+ * different numbers of executor threads, how late sleeping processes
+ * wake up, how closely CPU time slices match the configured quantum, and
+ * how CPU is shared between a busy site and a quiet one, and how fast
+ * messages can be sent to processes from several threads.
+ *
+ * This creates a database in the current directory, so run it in an empty
+ * one.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "osinterface/osinterface_ThreadUtils.h"
+#include "logging/log_Logger.h"
+#include "utilities/memory_ThreadVirtualHeapManager.h"
+
+#include "dbinterface/dbinterface_DatabaseAccess.h"
+#include "events/events_EventAccess.h"
+
+#include "executor/executor_ExecutorAccess.h"
+#include "executor/executor_ProcessScheduler.h"
+#include "executor/executor_ThreadedExecutor.h"
+#include "executor/executor_Process.h"
+#include "executor/executor_ProcessServices.h"
+#include "executor/executor_ProcessStats.h"
+#include "executor/executor_ProcessMessage.h"
+
+using namespace mutgos;
+
+namespace
+{
+    /** How many processes run at once */
+    const unsigned int PROCESS_COUNT = 256;
+    /** How many times each process executes before finishing */
+    const unsigned int SLICES_PER_PROCESS = 2000;
+    /** Most executor threads to try */
+    const unsigned int MAX_THREADS = 64;
+    /** How many processes sleep at once in the sleep test */
+    const unsigned int SLEEP_PROCESS_COUNT = 64;
+    /** How many times each process sleeps in the sleep test */
+    const unsigned int SLEEPS_PER_PROCESS = 10;
+    /** How long each sleep is, in ms */
+    const unsigned int SLEEP_MS = 100;
+    /** How many processes share one program in the slice test */
+    const unsigned int SLICE_PROCESS_COUNT = 4;
+    /** The time slice used by the slice test, in microseconds */
+    const MG_UnsignedInt SLICE_TEST_US = 2000;
+    /** How long the slice test runs, in ms */
+    const unsigned int SLICE_TEST_MS = 500;
+    /** How many loop iterations between checks of the CPU clock */
+    const unsigned int SLICE_CHECK_LOOPS = 1024;
+    /** How many processes the busy site runs in the fair share test */
+    const unsigned int BUSY_SITE_PROCESS_COUNT = 8;
+    /** How many processes receive messages in the message test */
+    const unsigned int RECEIVER_COUNT = 4;
+    /** How many messages each sender thread sends in the message test.
+        Must be a multiple of RECEIVER_COUNT. */
+    const unsigned int MESSAGES_PER_SENDER = 200000;
+
+    typedef std::vector<executor::ThreadedExecutor *> Executors;
+    typedef std::vector<boost::thread *> Threads;
+    typedef std::vector<executor::PID> PIDs;
+
+    /**
+     * A process that spins the CPU a little each time it executes, and
+     * finishes after executing a set number of times.
+     */
+    class SpinProcess : public executor::Process
+    {
+    public:
+        /**
+         * Constructor.
+         * @param slices[in] How many times to execute before finishing.
+         * @param work[in] How many loop iterations to do per execute.
+         * @param remaining[in,out] Decremented when the process finishes.
+         */
+        SpinProcess(
+            const unsigned int slices,
+            const unsigned int work,
+            boost::atomic<unsigned int> &remaining)
+          : slices_left(slices),
+            work_per_slice(work),
+            processes_remaining(remaining),
+            result(0)
+        { }
+
+        virtual ~SpinProcess()
+        { }
+
+        virtual ProcessStatus process_execute(
+            const executor::PID pid,
+            executor::ProcessServices &services)
+        {
+            for (unsigned int count = 0; count < work_per_slice; ++count)
+            {
+                result = (result * 31) + count;
+            }
+
+            --slices_left;
+
+            return slices_left ? PROCESS_STATUS_EXECUTE_MORE :
+                PROCESS_STATUS_FINISHED;
+        }
+
+        virtual std::string process_get_name(const executor::PID pid)
+        {
+            return "spin";
+        }
+
+        virtual bool process_delete_when_finished(const executor::PID pid)
+        {
+            return true;
+        }
+
+        virtual void process_finished(const executor::PID pid)
+        {
+            --processes_remaining;
+        }
+
+    private:
+        unsigned int slices_left; ///< Executes left before finishing
+        const unsigned int work_per_slice; ///< Loop iterations per execute
+        boost::atomic<unsigned int> &processes_remaining; ///< Shared count
+        volatile unsigned int result; ///< Keeps the loop from being removed
+    };
+
+    /**
+     * A process that sleeps a set number of times, measuring how late it
+     * runs after each sleep.
+     */
+    class SleepProcess : public executor::Process
+    {
+    public:
+        /**
+         * Constructor.
+         * @param remaining[in,out] Decremented when the process finishes.
+         * @param total_lateness_us[in,out] Lateness of each wakeup is
+         * added to this.
+         * @param max_lateness_us[in,out] Updated with the latest wakeup.
+         */
+        SleepProcess(
+            boost::atomic<unsigned int> &remaining,
+            boost::atomic<MG_LongUnsignedInt> &total_lateness_us,
+            boost::atomic<MG_LongUnsignedInt> &max_lateness_us)
+          : sleeps_left(SLEEPS_PER_PROCESS),
+            processes_remaining(remaining),
+            total_lateness(total_lateness_us),
+            max_lateness(max_lateness_us)
+        { }
+
+        virtual ~SleepProcess()
+        { }
+
+        virtual ProcessStatus process_execute(
+            const executor::PID pid,
+            executor::ProcessServices &services)
+        {
+            const boost::posix_time::ptime now =
+                boost::posix_time::microsec_clock::universal_time();
+
+            if (not expected_wakeup.is_not_a_date_time())
+            {
+                const MG_LongUnsignedInt lateness = (now > expected_wakeup) ?
+                    (now - expected_wakeup).total_microseconds() : 0;
+                MG_LongUnsignedInt current_max = max_lateness.load();
+
+                total_lateness += lateness;
+
+                while ((lateness > current_max) and
+                    (not max_lateness.compare_exchange_weak(
+                        current_max,
+                        lateness)))
+                {
+                }
+            }
+
+            if (not sleeps_left)
+            {
+                return PROCESS_STATUS_FINISHED;
+            }
+
+            --sleeps_left;
+            expected_wakeup = now + boost::posix_time::milliseconds(SLEEP_MS);
+
+            return PROCESS_STATUS_SLEEP;
+        }
+
+        virtual std::string process_get_name(const executor::PID pid)
+        {
+            return "sleep";
+        }
+
+        virtual bool process_delete_when_finished(const executor::PID pid)
+        {
+            return true;
+        }
+
+        virtual osinterface::OsTypes::UnsignedInt process_get_sleep_time(
+            const executor::PID pid)
+        {
+            return SLEEP_MS;
+        }
+
+        virtual void process_finished(const executor::PID pid)
+        {
+            --processes_remaining;
+        }
+
+    private:
+        unsigned int sleeps_left; ///< Sleeps left before finishing
+        boost::posix_time::ptime expected_wakeup; ///< When sleep should end
+        boost::atomic<unsigned int> &processes_remaining; ///< Shared count
+        boost::atomic<MG_LongUnsignedInt> &total_lateness; ///< Shared sum
+        boost::atomic<MG_LongUnsignedInt> &max_lateness; ///< Shared max
+    };
+
+    /**
+     * A process that, like a script, runs until it has used up its CPU time
+     * slice and then asks to execute more, until told to stop.
+     */
+    class SliceProcess : public executor::Process
+    {
+    public:
+        /**
+         * Constructor.
+         * @param stop[in] When true, the process finishes.
+         * @param remaining[in,out] Decremented when the process finishes.
+         */
+        SliceProcess(
+            boost::atomic<bool> &stop,
+            boost::atomic<unsigned int> &remaining)
+          : stop_flag(stop),
+            processes_remaining(remaining),
+            result(0)
+        { }
+
+        virtual ~SliceProcess()
+        { }
+
+        virtual ProcessStatus process_execute(
+            const executor::PID pid,
+            executor::ProcessServices &services)
+        {
+            const MG_LongUnsignedInt slice_end_us =
+                osinterface::ThreadUtils::get_thread_cpu_time_us()
+                    + services.get_time_slice_us();
+
+            do
+            {
+                for (unsigned int count = 0; count < SLICE_CHECK_LOOPS;
+                    ++count)
+                {
+                    result = (result * 31) + count;
+                }
+            }
+            while (osinterface::ThreadUtils::get_thread_cpu_time_us() <
+                slice_end_us);
+
+            return stop_flag.load() ? PROCESS_STATUS_FINISHED :
+                PROCESS_STATUS_EXECUTE_MORE;
+        }
+
+        virtual std::string process_get_name(const executor::PID pid)
+        {
+            return "slice";
+        }
+
+        virtual bool process_delete_when_finished(const executor::PID pid)
+        {
+            return true;
+        }
+
+        virtual void process_finished(const executor::PID pid)
+        {
+            --processes_remaining;
+        }
+
+    private:
+        boost::atomic<bool> &stop_flag; ///< True when process should finish
+        boost::atomic<unsigned int> &processes_remaining; ///< Shared count
+        volatile unsigned int result; ///< Keeps the loop from being removed
+    };
+
+    /**
+     * An empty message, for the message test.
+     */
+    class CountMessage : public executor::ProcessMessage
+    {
+    public:
+        CountMessage(void)
+          : executor::ProcessMessage(MESSAGE_GENERIC)
+        { }
+
+        virtual ~CountMessage()
+        { }
+    };
+
+    /**
+     * A process that waits for messages, and finishes after receiving a set
+     * number of them.
+     */
+    class ReceiverProcess : public executor::Process
+    {
+    public:
+        /**
+         * Constructor.
+         * @param expected[in] How many messages to receive before finishing.
+         * @param remaining[in,out] Decremented when the process finishes.
+         */
+        ReceiverProcess(
+            const unsigned int expected,
+            boost::atomic<unsigned int> &remaining)
+          : messages_left(expected),
+            processes_remaining(remaining)
+        { }
+
+        virtual ~ReceiverProcess()
+        { }
+
+        virtual ProcessStatus process_execute(
+            const executor::PID pid,
+            executor::ProcessServices &services)
+        {
+            return PROCESS_STATUS_WAIT_MESSAGE;
+        }
+
+        virtual ProcessStatus process_execute(
+            const executor::PID pid,
+            executor::ProcessServices &services,
+            executor::ProcessMessage &message)
+        {
+            --messages_left;
+
+            return messages_left ? PROCESS_STATUS_WAIT_MESSAGE :
+                PROCESS_STATUS_FINISHED;
+        }
+
+        virtual std::string process_get_name(const executor::PID pid)
+        {
+            return "receiver";
+        }
+
+        virtual bool process_delete_when_finished(const executor::PID pid)
+        {
+            return true;
+        }
+
+        virtual void process_finished(const executor::PID pid)
+        {
+            --processes_remaining;
+        }
+
+    private:
+        unsigned int messages_left; ///< Messages left before finishing
+        boost::atomic<unsigned int> &processes_remaining; ///< Shared count
+    };
+
+    /**
+     * Sends MESSAGES_PER_SENDER messages, spread over the given processes.
+     * Runs on its own thread.
+     * @param scheduler[in] The scheduler to send with.
+     * @param pids[in] The processes to send to.
+     */
+    void send_messages(
+        executor::ProcessScheduler &scheduler,
+        const PIDs &pids)
+    {
+        for (unsigned int count = 0; count < MESSAGES_PER_SENDER; ++count)
+        {
+            scheduler.send_message(
+                pids[count % pids.size()],
+                new CountMessage());
+        }
+    }
+
+    /**
+     * Starts executor threads for a scheduler.
+     * @param scheduler[in] The scheduler the executors will run processes
+     * from.
+     * @param thread_count[in] How many executor threads to start.
+     * @param executors[out] The executors started.
+     * @param threads[out] The threads running the executors.
+     */
+    void start_executors(
+        executor::ProcessScheduler &scheduler,
+        const unsigned int thread_count,
+        Executors &executors,
+        Threads &threads)
+    {
+        scheduler.set_executor_count(thread_count);
+
+        for (unsigned int index = 0; index < thread_count; ++index)
+        {
+            executors.push_back(
+                new executor::ThreadedExecutor(&scheduler, index));
+            threads.push_back(
+                new boost::thread(boost::ref(*executors.back())));
+        }
+    }
+
+    /**
+     * Shuts down a scheduler and stops its executor threads.
+     * @param scheduler[in] The scheduler to shut down.
+     * @param executors[in,out] The executors to stop.  Will be empty when
+     * done.
+     * @param threads[in,out] The threads running the executors.  Will be
+     * empty when done.
+     */
+    void stop_executors(
+        executor::ProcessScheduler &scheduler,
+        Executors &executors,
+        Threads &threads)
+    {
+        scheduler.shutdown();
+
+        for (size_t index = 0; index < threads.size(); ++index)
+        {
+            executors[index]->stop();
+            threads[index]->join();
+            delete threads[index];
+            delete executors[index];
+        }
+
+        executors.clear();
+        threads.clear();
+    }
+
+    /**
+     * Runs PROCESS_COUNT SpinProcesses to completion on a new scheduler
+     * with the given number of executor threads.
+     * @param thread_count[in] How many executor threads to use.
+     * @param work[in] How many loop iterations each process does per
+     * execute.
+     * @return Process slices executed per second.
+     */
+    double run_benchmark(
+        const unsigned int thread_count,
+        const unsigned int work)
+    {
+        executor::ProcessScheduler scheduler;
+        Executors executors;
+        Threads threads;
+        boost::atomic<unsigned int> remaining(PROCESS_COUNT);
+
+        start_executors(scheduler, thread_count, executors, threads);
+
+        const boost::posix_time::ptime start_time =
+            boost::posix_time::microsec_clock::universal_time();
+
+        for (unsigned int count = 0; count < PROCESS_COUNT; ++count)
+        {
+            scheduler.start_process(scheduler.add_process(
+                dbtype::Id(),
+                dbtype::Id(),
+                new SpinProcess(SLICES_PER_PROCESS, work, remaining)));
+        }
+
+        while (remaining.load())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        const boost::posix_time::time_duration elapsed =
+            boost::posix_time::microsec_clock::universal_time() - start_time;
+
+        stop_executors(scheduler, executors, threads);
+
+        const double seconds = elapsed.total_microseconds() / 1000000.0;
+
+        return ((double) PROCESS_COUNT * SLICES_PER_PROCESS) /
+            (seconds > 0 ? seconds : 1);
+    }
+
+    /**
+     * Runs SLEEP_PROCESS_COUNT SleepProcesses to completion on a new
+     * scheduler, and prints how late they woke up.
+     * @param thread_count[in] How many executor threads to use.
+     */
+    void run_sleep_test(const unsigned int thread_count)
+    {
+        executor::ProcessScheduler scheduler;
+        Executors executors;
+        Threads threads;
+        boost::atomic<unsigned int> remaining(SLEEP_PROCESS_COUNT);
+        boost::atomic<MG_LongUnsignedInt> total_lateness_us(0);
+        boost::atomic<MG_LongUnsignedInt> max_lateness_us(0);
+
+        start_executors(scheduler, thread_count, executors, threads);
+
+        for (unsigned int count = 0; count < SLEEP_PROCESS_COUNT; ++count)
+        {
+            scheduler.start_process(scheduler.add_process(
+                dbtype::Id(),
+                dbtype::Id(),
+                new SleepProcess(
+                    remaining,
+                    total_lateness_us,
+                    max_lateness_us)));
+
+            // Spread the wakeups out
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        while (remaining.load())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        const executor::TimerStats stats = scheduler.get_timer_stats();
+        const MG_LongUnsignedInt sleeps =
+            SLEEP_PROCESS_COUNT * SLEEPS_PER_PROCESS;
+
+        stop_executors(scheduler, executors, threads);
+
+        std::cout << "Sleep test: " << SLEEP_PROCESS_COUNT << " processes, "
+                  << SLEEPS_PER_PROCESS << " sleeps of " << SLEEP_MS
+                  << "ms each, " << thread_count << " threads" << std::endl
+                  << "  Timer wheel wakeups: " << stats.wakeups
+                  << ", avg late (us): "
+                  << (stats.wakeups ?
+                      stats.total_lateness_us / stats.wakeups : 0)
+                  << ", max late (us): " << stats.max_lateness_us
+                  << std::endl
+                  << "  Process resumed avg late (us): "
+                  << total_lateness_us.load() / sleeps
+                  << ", max late (us): " << max_lateness_us.load()
+                  << std::endl;
+    }
+
+    /**
+     * Runs SLICE_PROCESS_COUNT SliceProcesses of the same program for a
+     * while, and prints the CPU accounting for each.
+     * @param thread_count[in] How many executor threads to use.
+     */
+    void run_slice_test(const unsigned int thread_count)
+    {
+        executor::ProcessScheduler scheduler;
+        Executors executors;
+        Threads threads;
+        boost::atomic<bool> stop(false);
+        boost::atomic<unsigned int> remaining(SLICE_PROCESS_COUNT);
+        std::vector<executor::PID> pids;
+        const dbtype::Id program_id(1, 100);
+
+        scheduler.set_time_slice_us(SLICE_TEST_US);
+        start_executors(scheduler, thread_count, executors, threads);
+
+        for (unsigned int count = 0; count < SLICE_PROCESS_COUNT; ++count)
+        {
+            pids.push_back(scheduler.add_process(
+                program_id,
+                dbtype::Id(),
+                new SliceProcess(stop, remaining)));
+            scheduler.start_process(pids.back());
+        }
+
+        boost::this_thread::sleep(
+            boost::posix_time::milliseconds(SLICE_TEST_MS));
+
+        std::cout << "Slice test: " << SLICE_PROCESS_COUNT
+                  << " processes of one program, " << SLICE_TEST_US
+                  << "us slices, " << thread_count << " threads" << std::endl
+                  << "  PID  CPU us  wall us  slices  avg CPU us/slice"
+                  << "  program CPU us" << std::endl;
+
+        for (std::vector<executor::PID>::const_iterator pid_iter =
+                pids.begin();
+            pid_iter != pids.end();
+            ++pid_iter)
+        {
+            const executor::ProcessStats stats =
+                scheduler.get_process_stats(*pid_iter);
+            const executor::ExecutionTimes &times =
+                stats.get_execution_times();
+
+            std::cout << "  " << stats.get_pid()
+                      << "  " << times.cpu_time_us
+                      << "  " << times.wall_time_us
+                      << "  " << times.slices
+                      << "  " << (times.slices ?
+                          times.cpu_time_us / times.slices : 0)
+                      << "  " << stats.get_executable_times().cpu_time_us
+                      << std::endl;
+        }
+
+        stop.store(true);
+
+        while (remaining.load())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        stop_executors(scheduler, executors, threads);
+    }
+
+    /**
+     * Runs BUSY_SITE_PROCESS_COUNT SliceProcesses for site 1 and one for
+     * site 2 for a while, and prints how the CPU was shared.
+     * @param thread_count[in] How many executor threads to use.
+     * @param site_two_weight[in] The weight of site 2.  Site 1 has a weight
+     * of 1.
+     */
+    void run_fair_share_test(
+        const unsigned int thread_count,
+        const MG_UnsignedInt site_two_weight)
+    {
+        executor::ProcessScheduler scheduler;
+        Executors executors;
+        Threads threads;
+        boost::atomic<bool> stop(false);
+        boost::atomic<unsigned int> remaining(BUSY_SITE_PROCESS_COUNT + 1);
+        MG_LongUnsignedInt total_cpu_us = 0;
+
+        scheduler.set_time_slice_us(SLICE_TEST_US);
+        scheduler.set_site_weight(2, site_two_weight);
+        start_executors(scheduler, thread_count, executors, threads);
+
+        for (unsigned int count = 0; count <= BUSY_SITE_PROCESS_COUNT;
+            ++count)
+        {
+            const dbtype::Id::SiteIdType site =
+                (count < BUSY_SITE_PROCESS_COUNT) ? 1 : 2;
+
+            scheduler.start_process(scheduler.add_process(
+                dbtype::Id(site, 100),
+                dbtype::Id(site, 2),
+                new SliceProcess(stop, remaining)));
+        }
+
+        boost::this_thread::sleep(
+            boost::posix_time::milliseconds(SLICE_TEST_MS));
+
+        const executor::FairShareQueue::SiteQueueStatsVector stats =
+            scheduler.get_site_queue_stats();
+
+        stop.store(true);
+
+        while (remaining.load())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        stop_executors(scheduler, executors, threads);
+
+        for (executor::FairShareQueue::SiteQueueStatsVector::const_iterator
+                stats_iter = stats.begin();
+            stats_iter != stats.end();
+            ++stats_iter)
+        {
+            total_cpu_us += stats_iter->cpu_time_us;
+        }
+
+        std::cout << "Fair share test: site 1 runs "
+                  << BUSY_SITE_PROCESS_COUNT
+                  << " processes, site 2 runs 1 with weight "
+                  << site_two_weight << ", " << thread_count << " threads"
+                  << std::endl
+                  << "  site  CPU %  dispatches  avg wait us  max wait us"
+                  << std::endl;
+
+        for (executor::FairShareQueue::SiteQueueStatsVector::const_iterator
+                stats_iter = stats.begin();
+            stats_iter != stats.end();
+            ++stats_iter)
+        {
+            std::cout << "  " << stats_iter->site_id
+                      << "  " << (total_cpu_us ?
+                          (stats_iter->cpu_time_us * 100) / total_cpu_us : 0)
+                      << "  " << stats_iter->dispatches
+                      << "  " << (stats_iter->dispatches ?
+                          stats_iter->total_wait_us / stats_iter->dispatches :
+                          0)
+                      << "  " << stats_iter->max_wait_us
+                      << std::endl;
+        }
+    }
+
+    /**
+     * Has several threads send messages to RECEIVER_COUNT ReceiverProcesses
+     * at once, and prints how fast they were sent and received.
+     * @param thread_count[in] How many executor threads to use.
+     * @param sender_count[in] How many threads send messages.
+     */
+    void run_message_test(
+        const unsigned int thread_count,
+        const unsigned int sender_count)
+    {
+        executor::ProcessScheduler scheduler;
+        Executors executors;
+        Threads threads;
+        Threads senders;
+        PIDs pids;
+        boost::atomic<unsigned int> remaining(RECEIVER_COUNT);
+        const MG_LongUnsignedInt total_messages =
+            (MG_LongUnsignedInt) sender_count * MESSAGES_PER_SENDER;
+
+        start_executors(scheduler, thread_count, executors, threads);
+
+        for (unsigned int count = 0; count < RECEIVER_COUNT; ++count)
+        {
+            pids.push_back(scheduler.add_process(
+                dbtype::Id(),
+                dbtype::Id(),
+                new ReceiverProcess(
+                    total_messages / RECEIVER_COUNT,
+                    remaining)));
+            scheduler.start_process(pids.back());
+        }
+
+        const boost::posix_time::ptime start_time =
+            boost::posix_time::microsec_clock::universal_time();
+
+        for (unsigned int count = 0; count < sender_count; ++count)
+        {
+            senders.push_back(new boost::thread(
+                send_messages,
+                boost::ref(scheduler),
+                boost::cref(pids)));
+        }
+
+        for (size_t index = 0; index < senders.size(); ++index)
+        {
+            senders[index]->join();
+            delete senders[index];
+        }
+
+        const boost::posix_time::time_duration send_elapsed =
+            boost::posix_time::microsec_clock::universal_time() - start_time;
+
+        while (remaining.load())
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+
+        const boost::posix_time::time_duration receive_elapsed =
+            boost::posix_time::microsec_clock::universal_time() - start_time;
+
+        stop_executors(scheduler, executors, threads);
+
+        const double send_seconds =
+            send_elapsed.total_microseconds() / 1000000.0;
+        const double receive_seconds =
+            receive_elapsed.total_microseconds() / 1000000.0;
+
+        std::cout << "Message test: " << sender_count << " senders, "
+                  << RECEIVER_COUNT << " receivers, " << thread_count
+                  << " threads, " << total_messages << " messages"
+                  << std::endl
+                  << "  sent/sec: " << (unsigned long) (total_messages /
+                      (send_seconds > 0 ? send_seconds : 1))
+                  << ", received/sec: " << (unsigned long) (total_messages /
+                      (receive_seconds > 0 ? receive_seconds : 1))
+                  << std::endl;
+    }
+}
+
+int main(void)
+{
+    memory::ThreadVirtualHeapManager::add_thread();
+    log::Logger::init(true);
+    log::Logger::set_level(error);
+
+    // Finishing a process publishes an event, which needs these.
+    //
+    if (not (dbinterface::DatabaseAccess::make_singleton()->startup() and
+        executor::ExecutorAccess::make_singleton()->startup(1) and
+        events::EventAccess::make_singleton()->startup()))
+    {
+        std::cerr << "FAILED to start up." << std::endl;
+        return -1;
+    }
+
+    const unsigned int cores = boost::thread::hardware_concurrency();
+
+    std::cout << "CPU cores: " << cores << std::endl
+              << "Processes: " << PROCESS_COUNT << ", slices each: "
+              << SLICES_PER_PROCESS << std::endl
+              << "threads  slices/sec (no work)  slices/sec (20k loop)"
+              << std::endl;
+
+    for (unsigned int thread_count = 1;
+        (thread_count <= MAX_THREADS) and
+            (thread_count <= (cores ? cores * 2 : 4));
+        thread_count *= 2)
+    {
+        const double empty_rate = run_benchmark(thread_count, 0);
+        const double work_rate = run_benchmark(thread_count, 20000);
+
+        std::cout << thread_count << "  " << (unsigned long) empty_rate
+                  << "  " << (unsigned long) work_rate << std::endl;
+    }
+
+    run_sleep_test(2);
+    run_slice_test(1);
+    run_fair_share_test(1, 1);
+    run_fair_share_test(1, 3);
+    run_message_test(2, 1);
+    run_message_test(2, 4);
+
+    executor::ExecutorAccess::instance()->shutdown();
+    events::EventAccess::instance()->shutdown();
+    dbinterface::DatabaseAccess::instance()->shutdown();
+
+    events::EventAccess::destroy_singleton();
+    executor::ExecutorAccess::destroy_singleton();
+    dbinterface::DatabaseAccess::destroy_singleton();
+
+    memory::ThreadVirtualHeapManager::delete_thread();
+
+    return 0;
+}
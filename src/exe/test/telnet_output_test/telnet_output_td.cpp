@@ -0,0 +1,156 @@
+/*
+ * telnet_output_td.cpp
+ * Checks that OutgoingTextQueue packs lines into chunks correctly, by
+ * queueing bursts of lines and "writing" them the way
+ * SocketClientConnection does.  Confirms the text written is exactly what
+ * was queued, that there were fewer writes than lines, and that each write
+ * was only a few buffers (iovecs) rather than one per line.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "socketcomm/socket_OutgoingTextQueue.h"
+
+using namespace mutgos;
+
+/** How many bursts of lines are queued, such as from room descriptions */
+const unsigned int BURST_COUNT = 2000;
+/** Most lines in a burst */
+const unsigned int MAX_BURST_LINES = 40;
+/** Most buffers asio puts in one writev */
+const size_t MAX_WRITE_BUFFERS = 64;
+
+/**
+ * @param line[in] The line number.
+ * @return A line of text, of varying length.
+ */
+std::string make_line(const unsigned int line)
+{
+    std::string text("say ");
+
+    text.append(10 + ((line * 37) % 120), 'a' + (line % 26));
+
+    // Now and then, a line longer than a chunk.
+    //
+    if (not (line % 997))
+    {
+        text.append(socket::OutgoingTextQueue::CHUNK_SIZE + 100, 'z');
+    }
+
+    return text;
+}
+
+/**
+ * "Writes" everything in the queue, the way SocketClientConnection does.
+ * @param queue[in,out] The queue to write.  It will be empty afterwards.
+ * @param sending[in,out] Holds the text being written.
+ * @param written[out] The text written is appended.
+ * @param max_buffers[in,out] The most buffers in any write so far.
+ * @param lines_written[in,out] Lines written so far.
+ */
+void write_queue(
+    socket::OutgoingTextQueue &queue,
+    socket::OutgoingTextQueue &sending,
+    std::string &written,
+    size_t &max_buffers,
+    size_t &lines_written)
+{
+    socket::OutgoingTextQueue::Buffers buffers;
+
+    sending.swap(queue);
+    sending.get_buffers(buffers);
+
+    for (size_t index = 0; index < buffers.size(); ++index)
+    {
+        written.append(
+            (const char *) buffers[index].data(),
+            buffers[index].size());
+    }
+
+    if (buffers.size() > max_buffers)
+    {
+        max_buffers = buffers.size();
+    }
+
+    lines_written += sending.get_line_count();
+    sending.clear();
+}
+
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    socket::OutgoingTextQueue queue;
+    socket::OutgoingTextQueue sending;
+    std::string expected;
+    std::string written;
+    unsigned int line = 0;
+    size_t lines_written = 0;
+    size_t writes = 0;
+    size_t max_buffers = 0;
+
+    for (unsigned int burst = 0; burst < BURST_COUNT; ++burst)
+    {
+        const unsigned int burst_lines = 1 + ((burst * 13) % MAX_BURST_LINES);
+
+        for (unsigned int index = 0; index < burst_lines; ++index, ++line)
+        {
+            const std::string text = make_line(line);
+
+            queue.append(text, true);
+            expected.append(text);
+            expected.append(1, '\n');
+        }
+
+        if (queue.size() != (expected.size() - written.size()))
+        {
+            std::cerr << "Queue size is wrong after burst " << burst
+                      << std::endl;
+            success = false;
+        }
+
+        write_queue(queue, sending, written, max_buffers, lines_written);
+        ++writes;
+    }
+
+    if (not queue.empty())
+    {
+        std::cerr << "Queue is not empty after the last write." << std::endl;
+        success = false;
+    }
+
+    if (written != expected)
+    {
+        std::cerr << "Text written does not match what was queued."
+                  << std::endl;
+        success = false;
+    }
+
+    if (lines_written != line)
+    {
+        std::cerr << "Counted " << lines_written << " lines written, but "
+                  << line << " were queued." << std::endl;
+        success = false;
+    }
+
+    if (writes >= lines_written)
+    {
+        std::cerr << "Expected fewer writes than lines." << std::endl;
+        success = false;
+    }
+
+    if (max_buffers > MAX_WRITE_BUFFERS)
+    {
+        std::cerr << "A write needed " << max_buffers
+                  << " buffers, more than fit in one writev." << std::endl;
+        success = false;
+    }
+
+    std::cout << lines_written << " lines (" << written.size()
+              << " bytes) in " << writes << " writes, at most "
+              << max_buffers << " buffers per write: "
+              << (success ? "passed" : "FAILED") << std::endl;
+
+    return success ? 0 : -1;
+}
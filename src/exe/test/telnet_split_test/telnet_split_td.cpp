@@ -0,0 +1,198 @@
+/*
+ * telnet_split_td.cpp
+ * Checks that TelnetLineSplitter splits lines and skips telnet commands
+ * correctly no matter how the data is broken up into reads, and then
+ * measures how many lines per second it splits compared to the old
+ * copy, find, and erase approach.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "socketcomm/socket_TelnetLineSplitter.h"
+
+using namespace mutgos;
+
+/** How many times the benchmark data is split */
+const unsigned int BENCHMARK_PASSES = 200;
+/** How many lines are in the benchmark data */
+const unsigned int BENCHMARK_LINES = 10000;
+/** Size of each read in the benchmark, like RawSocketConnection's */
+const size_t READ_SIZE = 1024;
+
+/**
+ * The old way of splitting lines, kept to compare against.
+ * @param data_ptr[in] The data read.
+ * @param data_size[in] The size of the data.
+ * @param buffer[in,out] The partial line.
+ * @param lines[out] The completed lines are appended.
+ */
+void old_split(
+    const char *data_ptr,
+    const size_t data_size,
+    std::string &buffer,
+    socket::TelnetLineSplitter::Lines &lines)
+{
+    std::string data(data_ptr, data_size);
+    size_t line_start_index = 0;
+    size_t line_end_index = 0;
+
+    boost::replace_all(data, std::string(1, '\r'), std::string());
+    buffer.append(data);
+
+    while ((line_end_index = buffer.find('\n', line_start_index)) !=
+        std::string::npos)
+    {
+        lines.push_back(buffer.substr(
+            line_start_index,
+            line_end_index - line_start_index));
+        line_start_index = line_end_index + 1;
+    }
+
+    buffer.erase(0, line_start_index);
+}
+
+/**
+ * Splits data in one call, and then one character at a time, and confirms
+ * both give the expected lines.
+ * @param name[in] Name of the check, for output.
+ * @param data[in] The data to split.
+ * @param expected[in] The lines expected.
+ * @return True if both matched.
+ */
+bool check_split(
+    const std::string &name,
+    const std::string &data,
+    const socket::TelnetLineSplitter::Lines &expected)
+{
+    socket::TelnetLineSplitter whole_splitter;
+    socket::TelnetLineSplitter char_splitter;
+    socket::TelnetLineSplitter::Lines whole_lines;
+    socket::TelnetLineSplitter::Lines char_lines;
+
+    whole_splitter.split(data.data(), data.size(), whole_lines);
+
+    for (size_t index = 0; index < data.size(); ++index)
+    {
+        char_splitter.split(data.data() + index, 1, char_lines);
+    }
+
+    const bool success = (whole_lines == expected) and
+        (char_lines == expected);
+
+    std::cout << name << ": " << (success ? "passed" : "FAILED") << std::endl;
+
+    return success;
+}
+
+/**
+ * @return True if all the correctness checks passed.
+ */
+bool check_splitter(void)
+{
+    bool success = true;
+    socket::TelnetLineSplitter::Lines expected;
+
+    expected.push_back("look");
+    expected.push_back("");
+    expected.push_back("say hi");
+    success = check_split("LF and CRLF", "look\n\r\nsay hi\r\npartial", expected)
+        and success;
+
+    expected.clear();
+    expected.push_back("abc");
+    success = check_split("Stray CRs", "\ra\rb\r\rc\r\n", expected)
+        and success;
+
+    expected.clear();
+    expected.push_back("say hi");
+    success = check_split(
+        "Negotiation",
+        "\xff\xfb\x1fsay \xff\xf1hi\xff\xfa\x18\x01x\xff\xff\xff\xf0\n",
+        expected) and success;
+
+    expected.clear();
+    expected.push_back("a\xff" "b");
+    success = check_split("Escaped IAC", "a\xff\xff" "b\n", expected)
+        and success;
+
+    return success;
+}
+
+/**
+ * Runs the benchmark for one way of splitting.
+ * @param name[in] Name of the approach, for output.
+ * @param data[in] The data to split.
+ * @param use_splitter[in] True for TelnetLineSplitter, false for the old
+ * way.
+ */
+void benchmark(
+    const std::string &name,
+    const std::string &data,
+    const bool use_splitter)
+{
+    socket::TelnetLineSplitter splitter;
+    socket::TelnetLineSplitter::Lines lines;
+    std::string buffer;
+    size_t lines_split = 0;
+
+    const boost::posix_time::ptime start_time =
+        boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int pass = 0; pass < BENCHMARK_PASSES; ++pass)
+    {
+        for (size_t index = 0; index < data.size(); index += READ_SIZE)
+        {
+            const size_t read_size = std::min(READ_SIZE, data.size() - index);
+
+            if (use_splitter)
+            {
+                splitter.split(data.data() + index, read_size, lines);
+            }
+            else
+            {
+                old_split(data.data() + index, read_size, buffer, lines);
+            }
+
+            lines_split += lines.size();
+            lines.clear();
+        }
+    }
+
+    const double elapsed_seconds =
+        (boost::posix_time::microsec_clock::universal_time() -
+            start_time).total_microseconds() / 1000000.0;
+
+    std::cout << name << ": " << lines_split << " lines in "
+              << elapsed_seconds << " s, lines/sec: "
+              << (unsigned long) (lines_split / elapsed_seconds) << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (not check_splitter())
+    {
+        std::cerr << "FAILED correctness checks." << std::endl;
+        return -1;
+    }
+
+    // Pasted text: lines of varying length, CRLF terminated.
+    //
+    std::string data;
+
+    for (unsigned int line = 0; line < BENCHMARK_LINES; ++line)
+    {
+        data.append("say ");
+        data.append(10 + ((line * 37) % 120), 'a' + (line % 26));
+        data.append("\r\n");
+    }
+
+    benchmark("Old (copy, find, erase)", data, false);
+    benchmark("TelnetLineSplitter", data, true);
+
+    return 0;
+}
@@ -1,14 +1,24 @@
 /*
  * vheap_td.cpp
- * Tests out basic virtual heap functionality.
+ * Tests out basic virtual heap functionality, then measures how many
+ * allocations per second the virtual heap can do on several threads at
+ * once, and how well its arena packs the blocks.
  */
 
 #include <string>
+#include <vector>
 #include <iostream>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #include "osinterface/osinterface_ThreadUtils.h"
 #include "utilities/memory_ThreadVirtualHeapManager.h"
 #include "utilities/memory_VirtualHeapAllocator.h"
 #include "utilities/memory_MemHeapState.h"
+#include "utilities/memory_SizeClassArena.h"
 
 using namespace mutgos;
 
@@ -16,6 +26,133 @@ typedef std::basic_string<
     char, std::char_traits<char>, memory::VirtualHeapAllocator<char> >
       ManagedString;
 
+/** How many allocations (and frees) each thread does in the benchmark */
+const unsigned int ALLOCS_PER_THREAD = 2000000;
+/** How many blocks each thread keeps allocated at once */
+const unsigned int BLOCKS_HELD = 64;
+
+/**
+ * Allocates and frees blocks of various sizes on the virtual heap, as a
+ * script would.
+ * @param start_barrier[in] Waited on so all threads start together.
+ * @param failures[in,out] Incremented if the thread's accounting is wrong.
+ */
+void alloc_thread(
+    boost::barrier &start_barrier,
+    boost::atomic<unsigned int> &failures)
+{
+    std::vector<void *> blocks(BLOCKS_HELD, (void *) 0);
+
+    memory::ThreadVirtualHeapManager::add_thread();
+    memory::ThreadVirtualHeapManager::set_thread_heap_state(
+        memory::MemHeapState(0));
+
+    start_barrier.wait();
+
+    for (unsigned int count = 0; count < ALLOCS_PER_THREAD; ++count)
+    {
+        void *&block = blocks[count % BLOCKS_HELD];
+
+        memory::ThreadVirtualHeapManager::mem_free(block);
+        block = memory::ThreadVirtualHeapManager::mem_alloc(
+            16 + ((count * 7) % 256));
+    }
+
+    for (size_t index = 0; index < blocks.size(); ++index)
+    {
+        memory::ThreadVirtualHeapManager::mem_free(blocks[index]);
+    }
+
+    if (memory::ThreadVirtualHeapManager::get_thread_heap_state().
+        get_mem_in_use())
+    {
+        ++failures;
+    }
+
+    memory::ThreadVirtualHeapManager::delete_thread();
+}
+
+/**
+ * Runs alloc_thread() on several threads at once.
+ * @param thread_count[in] How many threads to run.
+ * @return Allocations per second across all threads, or 0 if the
+ * accounting was wrong.
+ */
+double run_alloc_benchmark(const unsigned int thread_count)
+{
+    boost::barrier start_barrier(thread_count + 1);
+    boost::atomic<unsigned int> failures(0);
+    std::vector<boost::thread *> threads;
+
+    for (unsigned int count = 0; count < thread_count; ++count)
+    {
+        threads.push_back(new boost::thread(
+            alloc_thread,
+            boost::ref(start_barrier),
+            boost::ref(failures)));
+    }
+
+    start_barrier.wait();
+
+    const boost::posix_time::ptime start_time =
+        boost::posix_time::microsec_clock::universal_time();
+
+    for (size_t index = 0; index < threads.size(); ++index)
+    {
+        threads[index]->join();
+        delete threads[index];
+    }
+
+    const boost::posix_time::time_duration elapsed =
+        boost::posix_time::microsec_clock::universal_time() - start_time;
+    const double seconds = elapsed.total_microseconds() / 1000000.0;
+
+    if (failures.load())
+    {
+        std::cerr << "FAILED to correctly count memory on "
+                  << failures.load() << " threads." << std::endl;
+        return 0;
+    }
+
+    return ((double) thread_count * ALLOCS_PER_THREAD) /
+        (seconds > 0 ? seconds : 1);
+}
+
+/**
+ * Prints the arena statistics, and checks every block has been freed.
+ * @return True if every block allocated has been freed.
+ */
+bool print_arena_stats(void)
+{
+    const memory::ArenaStats stats = memory::SizeClassArena::get_stats();
+    bool all_freed = true;
+
+    for (size_t index = 0; index < stats.size_classes.size(); ++index)
+    {
+        const memory::SizeClassStats &class_stats = stats.size_classes[index];
+
+        std::cout << "  " << class_stats.block_size << " byte blocks: "
+                  << class_stats.allocs << " allocs, "
+                  << class_stats.frees << " frees, "
+                  << class_stats.blocks_reserved << " reserved"
+                  << std::endl;
+
+        all_freed = all_freed and (class_stats.allocs == class_stats.frees);
+    }
+
+    std::cout << "  Large blocks: "
+              << stats.large_blocks.allocs << " allocs, "
+              << stats.large_blocks.frees << " frees" << std::endl;
+    std::cout << "  Bytes reserved: " << stats.bytes_reserved
+              << ", in use: " << stats.bytes_in_use
+              << ", requested: " << stats.bytes_requested << std::endl;
+
+    all_freed = all_freed and
+        (stats.large_blocks.allocs == stats.large_blocks.frees);
+
+    return all_freed;
+}
+
 int main(void)
 {
     std::cout << "size_t bytes: " << sizeof(size_t) << std::endl;
@@ -110,5 +247,31 @@ int main(void)
 
     std::cout << "Tests passed." << std::endl;
 
+    std::cout << std::endl;
+    std::cout << "Running multithreaded allocation benchmark..." << std::endl;
+
+    for (unsigned int thread_count = 1; thread_count <= 8; thread_count *= 2)
+    {
+        const double allocs_per_sec = run_alloc_benchmark(thread_count);
+
+        if (not allocs_per_sec)
+        {
+            return -1;
+        }
+
+        std::cout << "  " << thread_count << " threads: "
+                  << (unsigned long) allocs_per_sec << " allocs/sec"
+                  << std::endl;
+    }
+
+    std::cout << std::endl;
+    std::cout << "Arena statistics:" << std::endl;
+
+    if (not print_arena_stats())
+    {
+        std::cerr << "FAILED to free every arena block." << std::endl;
+        return -1;
+    }
+
     return 0;
 }
@@ -0,0 +1,223 @@
+/*
+ * ws_batch_td.cpp
+ * Measures how many messages per second WSDecodeJob can decode when a
+ * websocket client sends them in batches, both as an array of message
+ * objects and as an array of messages embedded as strings, compared to
+ * the old way of parsing each array element again into its own document.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <string.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+#include "dbtypes/dbtype_Id.h"
+
+#include "utilities/memory_ThreadVirtualHeapManager.h"
+#include "utilities/json_JsonUtilities.h"
+#include "utilities/json_JsonParsedObject.h"
+#include "utilities/json_JsonParsePool.h"
+
+#include "clientmessages/message_ClientMessage.h"
+#include "clientmessages/message_ClientDataAcknowledge.h"
+#include "clientmessages/message_MessageFactory.h"
+
+#include "websocketcomm/websocket_WSDecodeJob.h"
+
+using namespace mutgos;
+
+/** How many messages are in each batch */
+const unsigned int BATCH_SIZE = 50;
+/** How many batches are decoded for each measurement */
+const unsigned int BATCH_COUNT = 20000;
+/** Size of the pool, the same as each WSClientConnection's */
+const size_t POOL_SIZE = 16384;
+
+/**
+ * Makes a batch of messages as a client would send it.
+ * @param as_strings[in] True to embed each message as a JSON string,
+ * false to put the message objects in the array directly.
+ * @return The batch as JSON.
+ */
+std::string make_batch(const bool as_strings)
+{
+    JSON_MAKE_ARRAY_ROOT(batch);
+
+    for (unsigned int index = 0; index < BATCH_SIZE; ++index)
+    {
+        const message::ClientDataAcknowledge message(index + 1);
+
+        if (as_strings)
+        {
+            JSON_MAKE_MAP_ROOT(message_json);
+
+            message.save(message_json, message_json);
+            json::array_add_value(json::write_json(message_json), batch, batch);
+        }
+        else
+        {
+            JSON_MAKE_MAP_NODE(message_json);
+
+            message.save(batch, message_json);
+            json::array_add_value(message_json, batch, batch);
+        }
+    }
+
+    return json::write_json(batch);
+}
+
+/**
+ * @param batch[in] The batch to copy.
+ * @return A copy of the batch, as the websocket hands it over.
+ */
+char *copy_batch(const std::string &batch)
+{
+    char * const data_ptr = new char[batch.size() + 1];
+    memcpy(data_ptr, batch.c_str(), batch.size() + 1);
+
+    return data_ptr;
+}
+
+/**
+ * The old way of decoding a batch of string embedded messages, kept to
+ * compare against: every element is copied out and parsed into a new
+ * document.
+ * @param data_ptr[in] The batch.  Ownership passes to this function.
+ * @return How many messages were restored.
+ */
+unsigned int old_decode(char *data_ptr)
+{
+    unsigned int restored = 0;
+    json::JsonParsedObject * const json_ptr = json::parse_json(data_ptr);
+
+    if (json_ptr)
+    {
+        const MG_UnsignedInt message_count = json::array_size(json_ptr->get());
+        char *raw_json_ptr = 0;
+        size_t raw_json_size = 0;
+
+        for (MG_UnsignedInt index = 0; index < message_count; ++index)
+        {
+            json::array_get_value(
+                json_ptr->get(),
+                index,
+                raw_json_ptr,
+                raw_json_size);
+
+            json::JsonParsedObject * const indexed_json_ptr =
+                json::parse_json(raw_json_ptr);
+
+            if (indexed_json_ptr)
+            {
+                message::ClientMessage * const message_ptr =
+                    message::MessageFactory::create_message(
+                        message::ClientMessage::get_message_type(
+                            indexed_json_ptr->get()));
+
+                if (message_ptr and
+                    message_ptr->restore(indexed_json_ptr->get()))
+                {
+                    ++restored;
+                }
+
+                delete message_ptr;
+                delete indexed_json_ptr;
+            }
+        }
+
+        delete json_ptr;
+    }
+
+    return restored;
+}
+
+/**
+ * Decodes the batch BATCH_COUNT times and prints the rate.
+ * @param name[in] Name of the measurement, for output.
+ * @param batch[in] The batch to decode.
+ * @param use_job[in] True to decode with WSDecodeJob, false for the old
+ * way.
+ * @return True if every message was restored.
+ */
+bool benchmark(
+    const std::string &name,
+    const std::string &batch,
+    const bool use_job)
+{
+    json::JsonParsePool pool(POOL_SIZE);
+    MG_LongUnsignedInt restored = 0;
+
+    const boost::posix_time::ptime start_time =
+        boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int count = 0; count < BATCH_COUNT; ++count)
+    {
+        if (use_job)
+        {
+            websocket::WSDecodeJob job(
+                0,
+                pool,
+                copy_batch(batch),
+                "ws_batch_td",
+                dbtype::Id());
+
+            job.decode();
+
+            for (size_t index = 0; index < job.get_messages().size(); ++index)
+            {
+                if (job.get_messages()[index])
+                {
+                    ++restored;
+                }
+            }
+        }
+        else
+        {
+            restored += old_decode(copy_batch(batch));
+        }
+    }
+
+    const double elapsed_seconds =
+        (boost::posix_time::microsec_clock::universal_time() -
+            start_time).total_microseconds() / 1000000.0;
+
+    std::cout << name << ": " << restored << " messages in "
+              << elapsed_seconds << " s, messages/sec: "
+              << (unsigned long) (restored / elapsed_seconds) << std::endl;
+
+    return restored == ((MG_LongUnsignedInt) BATCH_COUNT * BATCH_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    bool success = true;
+
+    memory::ThreadVirtualHeapManager::add_thread();
+    log::Logger::init(true);
+    log::Logger::set_level(error);
+
+    const std::string string_batch = make_batch(true);
+    const std::string object_batch = make_batch(false);
+
+    std::cout << "Batches of " << BATCH_SIZE << " messages." << std::endl;
+
+    success = benchmark("Old (parse each string element)", string_batch, false)
+        and success;
+    success = benchmark("WSDecodeJob, string elements", string_batch, true)
+        and success;
+    success = benchmark("WSDecodeJob, object elements", object_batch, true)
+        and success;
+
+    if (not success)
+    {
+        std::cerr << "FAILED to restore every message." << std::endl;
+    }
+
+    memory::ThreadVirtualHeapManager::delete_thread();
+
+    return success ? 0 : -1;
+}
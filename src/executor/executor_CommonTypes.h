@@ -29,6 +29,37 @@ namespace executor
     typedef std::vector<RID> ArrayOfRIDs;
     /** List of RIDs */
     typedef std::list<RID> ListOfRIDs;
+
+    /**
+     * How much time a process, or all processes of a program, spent
+     * executing.
+     */
+    struct ExecutionTimes
+    {
+        ExecutionTimes(void)
+          : cpu_time_us(0),
+            wall_time_us(0),
+            slices(0)
+        { }
+
+        /**
+         * Adds the given times to these.
+         * @param rhs[in] The times to add.
+         */
+        void add(const ExecutionTimes &rhs)
+        {
+            cpu_time_us += rhs.cpu_time_us;
+            wall_time_us += rhs.wall_time_us;
+            slices += rhs.slices;
+        }
+
+        /** Thread CPU time used while executing, in microseconds */
+        MG_LongUnsignedInt cpu_time_us;
+        /** Wall clock time spent executing, in microseconds */
+        MG_LongUnsignedInt wall_time_us;
+        /** How many times the process was executed */
+        MG_LongUnsignedInt slices;
+    };
 }
 }
 
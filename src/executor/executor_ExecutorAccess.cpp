@@ -10,6 +10,18 @@
 #include "executor/executor_ProcessScheduler.h"
 
 #include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+
+namespace
+{
+    // TODO Make data driven
+
+    /** How many threads execute processes.  If 0, one per CPU core */
+    const unsigned int EXECUTOR_THREAD_COUNT = 0;
+
+    /** How many threads to use if the CPU core count can't be found */
+    const unsigned int FALLBACK_THREAD_COUNT = 2;
+}
 
 namespace mutgos
 {
@@ -39,19 +51,37 @@ namespace executor
     }
 
     // ----------------------------------------------------------------------
-    bool ExecutorAccess::startup(void)
+    bool ExecutorAccess::startup(const unsigned int thread_count)
     {
-        // TODO Make data driven
-        const int THREAD_COUNT = 2;
-
         // Start the threads.
         //
         if (process_executors.empty())
         {
-            for (int count = 0; count < THREAD_COUNT; ++count)
+            unsigned int executor_count =
+                thread_count ? thread_count : EXECUTOR_THREAD_COUNT;
+
+            if (not executor_count)
+            {
+                executor_count = boost::thread::hardware_concurrency();
+
+                if (not executor_count)
+                {
+                    executor_count = FALLBACK_THREAD_COUNT;
+                }
+            }
+
+            LOG(info, "executor", "startup",
+                "Starting " + text::to_string(executor_count)
+                + " executor threads.");
+
+            // Local run queues must exist before the threads start.
+            process_scheduler.set_executor_count(executor_count);
+
+            for (unsigned int index = 0; index < executor_count; ++index)
             {
                 ThreadedExecutor *executor_ptr = new ThreadedExecutor(
-                    &process_scheduler);
+                    &process_scheduler,
+                    index);
                 boost::thread *thread_ptr =
                     new boost::thread(boost::ref(*executor_ptr));
 
@@ -157,6 +187,12 @@ namespace executor
         return not pids.empty();
     }
 
+    // ----------------------------------------------------------------------
+    void ExecutorAccess::forget_program_times(const dbtype::Id &program_id)
+    {
+        process_scheduler.forget_program_times(program_id);
+    }
+
     // ----------------------------------------------------------------------
     ExecutorAccess::ProcessStatsVector ExecutorAccess::get_process_stats_for_site(
         const dbtype::Id::SiteIdType site_id)
@@ -164,6 +200,39 @@ namespace executor
         return process_scheduler.get_process_stats_for_site(site_id);
     }
 
+    // ----------------------------------------------------------------------
+    TimerStats ExecutorAccess::get_timer_stats(void)
+    {
+        return process_scheduler.get_timer_stats();
+    }
+
+    // ----------------------------------------------------------------------
+    void ExecutorAccess::set_time_slice_us(const MG_UnsignedInt slice_us)
+    {
+        process_scheduler.set_time_slice_us(slice_us);
+    }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt ExecutorAccess::get_time_slice_us(void) const
+    {
+        return process_scheduler.get_time_slice_us();
+    }
+
+    // ----------------------------------------------------------------------
+    bool ExecutorAccess::set_site_weight(
+        const dbtype::Id::SiteIdType site_id,
+        const MG_UnsignedInt weight)
+    {
+        return process_scheduler.set_site_weight(site_id, weight);
+    }
+
+    // ----------------------------------------------------------------------
+    FairShareQueue::SiteQueueStatsVector
+        ExecutorAccess::get_site_queue_stats(void)
+    {
+        return process_scheduler.get_site_queue_stats();
+    }
+
     // ----------------------------------------------------------------------
     ExecutorAccess::ExecutorAccess(void)
     {
@@ -64,10 +64,13 @@ namespace executor
          * Initializes the singleton instance; called once as MUTGOS is coming
          * up and before any methods below are called.
          * Not thread safe.
+         * @param thread_count[in] Optional.  How many threads will execute
+         * processes.  If 0 (default), EXECUTOR_THREAD_COUNT is used, and if
+         * that is also 0, one thread per CPU core.
          * @return True if success.  If false is returned, MUTGOS should
          * fail initialization completely.
          */
-        bool startup(void);
+        bool startup(const unsigned int thread_count = 0);
 
         /**
          * Shuts down the singleton instance; called when MUTGOS is coming down.
@@ -167,6 +170,13 @@ namespace executor
          */
         bool cleanup_processes(const dbtype::Id &id);
 
+        /**
+         * Discards the execution time statistics kept for a program.  Call
+         * this when the program is deleted, so they are not kept forever.
+         * @param program_id[in] The ID of the deleted program.
+         */
+        void forget_program_times(const dbtype::Id &program_id);
+
         /**
          * @param site_id[in] The site ID to get process stats for.
          * @return Detailed process stats for every process running at the
@@ -175,6 +185,42 @@ namespace executor
         ProcessStatsVector get_process_stats_for_site(
             const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * @return Statistics about how late sleeping processes have been
+         * woken up.
+         */
+        TimerStats get_timer_stats(void);
+
+        /**
+         * Sets how much thread CPU time a process should use before it
+         * voluntarily gives up its executor.
+         * @param slice_us[in] The time slice, in microseconds.  Must not be 0.
+         */
+        void set_time_slice_us(const MG_UnsignedInt slice_us);
+
+        /**
+         * @return How much thread CPU time, in microseconds, a process
+         * should use before voluntarily giving up its executor.
+         */
+        MG_UnsignedInt get_time_slice_us(void) const;
+
+        /**
+         * Sets how much CPU a site's processes get relative to other sites
+         * when the executors are busy.  Sites default to a weight of 1.
+         * @param site_id[in] The site to set the weight of.
+         * @param weight[in] The weight.  Must not be 0.
+         * @return True if set.
+         */
+        bool set_site_weight(
+            const dbtype::Id::SiteIdType site_id,
+            const MG_UnsignedInt weight);
+
+        /**
+         * @return Run queue depth, wait time, and CPU time statistics for
+         * each site that has run processes.
+         */
+        FairShareQueue::SiteQueueStatsVector get_site_queue_stats(void);
+
         // TODO Add call for forcible removal of RID
 
         // TODO Later on, queries to get lists of process for @ps, etc
@@ -0,0 +1,277 @@
+/*
+ * executor_FairShareQueue.cpp
+ */
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
+#include "logging/log_Logger.h"
+
+#include "executor/executor_FairShareQueue.h"
+
+namespace
+{
+    // TODO make data driven
+
+    /** Weight of a site that has not been given one */
+    const MG_UnsignedInt DEFAULT_SITE_WEIGHT = 1;
+}
+
+namespace mutgos
+{
+namespace executor
+{
+    // ----------------------------------------------------------------------
+    FairShareQueue::FairShareQueue(const MG_UnsignedInt quantum_us)
+      : quantum(quantum_us ? quantum_us : 1)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    FairShareQueue::~FairShareQueue()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void FairShareQueue::set_quantum_us(const MG_UnsignedInt quantum_us)
+    {
+        if (not quantum_us)
+        {
+            LOG(error, "executor", "set_quantum_us", "Quantum cannot be 0.");
+        }
+        else
+        {
+            boost::lock_guard<boost::mutex> guard(queue_lock);
+            quantum = quantum_us;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool FairShareQueue::set_site_weight(
+        const dbtype::Id::SiteIdType site_id,
+        const MG_UnsignedInt weight)
+    {
+        bool success = false;
+
+        if (not weight)
+        {
+            LOG(error, "executor", "set_site_weight", "Weight cannot be 0.");
+        }
+        else
+        {
+            boost::lock_guard<boost::mutex> guard(queue_lock);
+
+            get_site(site_id).stats.weight = weight;
+            success = true;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void FairShareQueue::push(
+        ProcessInfo *const process_ptr,
+        const dbtype::Id::SiteIdType site_id,
+        const bool priority)
+    {
+        const boost::posix_time::ptime now =
+            boost::posix_time::microsec_clock::universal_time();
+        boost::lock_guard<boost::mutex> guard(queue_lock);
+        SiteQueue &site = get_site(site_id);
+
+        ++site.stats.queue_depth;
+
+        if (priority)
+        {
+            priority_queue.push_back(QueuedProcess(process_ptr, &site, now));
+        }
+        else
+        {
+            site.queue.push_back(QueuedProcess(process_ptr, &site, now));
+
+            if (not site.active)
+            {
+                // A site with time left resumes its turn, so a site with
+                // only one process can still use its whole turn.
+                //
+                site.active = true;
+
+                if (site.deficit_us > 0)
+                {
+                    active_sites.push_front(&site);
+                }
+                else
+                {
+                    active_sites.push_back(&site);
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    ProcessInfo *FairShareQueue::pop(bool &pre_charged)
+    {
+        ProcessInfo *process_ptr = 0;
+        const boost::posix_time::ptime now =
+            boost::posix_time::microsec_clock::universal_time();
+        boost::lock_guard<boost::mutex> guard(queue_lock);
+
+        pre_charged = false;
+
+        if (not priority_queue.empty())
+        {
+            process_ptr = take_front(priority_queue, now);
+        }
+
+        while ((not process_ptr) and (not active_sites.empty()))
+        {
+            SiteQueue * const site_ptr = active_sites.front();
+
+            if ((site_ptr->deficit_us < 0) and (active_sites.size() == 1))
+            {
+                // Nobody else is waiting, so the debt is owed to no one.
+                site_ptr->deficit_us = 0;
+            }
+
+            if (site_ptr->deficit_us <= 0)
+            {
+                // Start of the site's turn.
+                site_ptr->deficit_us += quantum * site_ptr->stats.weight;
+            }
+
+            if (site_ptr->deficit_us > 0)
+            {
+                // Assume the process uses a whole quantum.  charge() will
+                // correct it once the real time is known.
+                //
+                process_ptr = take_front(site_ptr->queue, now);
+                site_ptr->deficit_us -= quantum;
+                pre_charged = true;
+
+                if (site_ptr->queue.empty())
+                {
+                    // Leaving the round.  Any time left (never more than a
+                    // turn) or debt is kept for when it comes back.
+                    //
+                    site_ptr->active = false;
+                    active_sites.pop_front();
+                }
+                else if (site_ptr->deficit_us <= 0)
+                {
+                    // Turn is over.
+                    active_sites.pop_front();
+                    active_sites.push_back(site_ptr);
+                }
+            }
+            else
+            {
+                // Still in debt; let the next site have a turn.
+                active_sites.pop_front();
+                active_sites.push_back(site_ptr);
+            }
+        }
+
+        return process_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void FairShareQueue::charge(
+        const dbtype::Id::SiteIdType site_id,
+        const MG_LongUnsignedInt cpu_time_us,
+        const bool pre_charged)
+    {
+        boost::lock_guard<boost::mutex> guard(queue_lock);
+        SiteQueue &site = get_site(site_id);
+        const MG_LongSignedInt max_credit_us =
+            (MG_LongSignedInt) quantum * site.stats.weight;
+
+        site.stats.cpu_time_us += cpu_time_us;
+
+        if (pre_charged)
+        {
+            // Give back the quantum pop() assumed.
+            site.deficit_us += quantum;
+        }
+
+        site.deficit_us -= (MG_LongSignedInt) cpu_time_us;
+
+        // A site can't build up more than a turn of time, or it could
+        // later run ahead of everyone else for as long as it saved up.
+        //
+        if (site.deficit_us > max_credit_us)
+        {
+            site.deficit_us = max_credit_us;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    FairShareQueue::SiteQueueStatsVector FairShareQueue::get_stats(void)
+    {
+        SiteQueueStatsVector stats;
+        boost::lock_guard<boost::mutex> guard(queue_lock);
+
+        stats.reserve(site_queues.size());
+
+        for (SiteQueues::const_iterator site_iter = site_queues.begin();
+            site_iter != site_queues.end();
+            ++site_iter)
+        {
+            stats.push_back(site_iter->second.stats);
+        }
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    FairShareQueue::SiteQueue &FairShareQueue::get_site(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        SiteQueue &site = site_queues[site_id];
+
+        if (not site.stats.weight)
+        {
+            // Newly created
+            site.stats.site_id = site_id;
+            site.stats.weight = DEFAULT_SITE_WEIGHT;
+        }
+
+        return site;
+    }
+
+    // ----------------------------------------------------------------------
+    ProcessInfo *FairShareQueue::take_front(
+        ProcessQueue &queue,
+        const boost::posix_time::ptime &now)
+    {
+        const QueuedProcess &front = queue.front();
+        ProcessInfo * const process_ptr = front.process_ptr;
+        SiteQueueStats &stats = front.site_ptr->stats;
+        MG_LongUnsignedInt wait_us = 0;
+
+        if (now > front.queued_time)
+        {
+            wait_us = (now - front.queued_time).total_microseconds();
+        }
+
+        --stats.queue_depth;
+        ++stats.dispatches;
+        stats.total_wait_us += wait_us;
+
+        if (wait_us > stats.max_wait_us)
+        {
+            stats.max_wait_us = wait_us;
+        }
+
+        queue.pop_front();
+
+        return process_ptr;
+    }
+}
+}
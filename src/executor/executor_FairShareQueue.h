@@ -0,0 +1,218 @@
+/*
+ * executor_FairShareQueue.h
+ */
+
+#ifndef MUTGOS_EXECUTOR_FAIRSHAREQUEUE_H
+#define MUTGOS_EXECUTOR_FAIRSHAREQUEUE_H
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "dbtypes/dbtype_Id.h"
+
+namespace mutgos
+{
+namespace executor
+{
+    // Forward declarations
+    class ProcessInfo;
+
+    /**
+     * Statistics about the processes of one site waiting to run.
+     */
+    struct SiteQueueStats
+    {
+        SiteQueueStats(void)
+          : site_id(0),
+            weight(0),
+            queue_depth(0),
+            dispatches(0),
+            total_wait_us(0),
+            max_wait_us(0),
+            cpu_time_us(0)
+        { }
+
+        dbtype::Id::SiteIdType site_id; ///< The site the stats are about
+        MG_UnsignedInt weight; ///< CPU share relative to other sites
+        MG_LongUnsignedInt queue_depth; ///< Processes waiting to run now
+        MG_LongUnsignedInt dispatches; ///< Processes taken off the queue
+        MG_LongUnsignedInt total_wait_us; ///< Sum of waits, in microseconds
+        MG_LongUnsignedInt max_wait_us; ///< Longest wait, in microseconds
+        MG_LongUnsignedInt cpu_time_us; ///< CPU time charged to the site
+    };
+
+    /**
+     * A run queue that shares the executors between sites using deficit
+     * round robin, so one site running busy scripts can't starve the rest.
+     *
+     * Each site with processes waiting takes a turn.  At the start of its
+     * turn a site is given a quantum of CPU time multiplied by its weight,
+     * and it runs processes until that is used up.  A quantum is assumed for
+     * each process run; the CPU time it actually used is charged when it
+     * returns, so a site whose processes run long falls into debt and sits
+     * out turns until the debt is paid.  A site that runs out of processes
+     * keeps its time or debt, and resumes its turn if it has time left.
+     * Processes that ran without coming through this queue (such as from
+     * an executor's local queue) are charged their CPU time too, and no
+     * site can save up more than a turn's worth of time.
+     *
+     * Priority processes, such as the native ones that serve connected
+     * users, skip the sites and always run first.  They are not charged.
+     *
+     * This class is thread safe.
+     */
+    class FairShareQueue
+    {
+    public:
+        /** Statistics for every site that has used the queue */
+        typedef std::vector<SiteQueueStats> SiteQueueStatsVector;
+
+        /**
+         * Constructor.
+         * @param quantum_us[in] The CPU time, in microseconds, a site with
+         * a weight of 1 is given each turn.  Typically the time slice.
+         */
+        FairShareQueue(const MG_UnsignedInt quantum_us);
+
+        /**
+         * Destructor.
+         */
+        ~FairShareQueue();
+
+        /**
+         * Sets the CPU time a site with a weight of 1 is given each turn.
+         * @param quantum_us[in] The quantum, in microseconds.  Must not be 0.
+         */
+        void set_quantum_us(const MG_UnsignedInt quantum_us);
+
+        /**
+         * Sets how much CPU a site gets relative to other sites.  Sites
+         * default to a weight of 1.
+         * @param site_id[in] The site to set the weight of.
+         * @param weight[in] The weight.  Must not be 0.
+         * @return True if set.
+         */
+        bool set_site_weight(
+            const dbtype::Id::SiteIdType site_id,
+            const MG_UnsignedInt weight);
+
+        /**
+         * Adds a process to the back of its site's queue.
+         * @param process_ptr[in] The process that is ready to run.
+         * @param site_id[in] The site the process runs for.
+         * @param priority[in] True if the process should skip the site
+         * queues and run before any of them.
+         */
+        void push(
+            ProcessInfo * const process_ptr,
+            const dbtype::Id::SiteIdType site_id,
+            const bool priority);
+
+        /**
+         * Removes the next process to run.
+         * @param pre_charged[out] Set to true if the process's site was
+         * charged a quantum up front (see charge()), false otherwise.
+         * @return The next process to run, or null if none are waiting.
+         */
+        ProcessInfo *pop(bool &pre_charged);
+
+        /**
+         * Charges a site for the CPU time one of its processes actually
+         * used.  Call for every non-priority process of the site after it
+         * has executed, whether or not it came from this queue.
+         * @param site_id[in] The site the process runs for.
+         * @param cpu_time_us[in] The CPU time the process used, in
+         * microseconds.
+         * @param pre_charged[in] True if pop() said it charged the site
+         * a quantum for the process, which will be given back.
+         */
+        void charge(
+            const dbtype::Id::SiteIdType site_id,
+            const MG_LongUnsignedInt cpu_time_us,
+            const bool pre_charged);
+
+        /**
+         * @return Statistics for every site that has used the queue, in
+         * site ID order.
+         */
+        SiteQueueStatsVector get_stats(void);
+
+    private:
+        struct SiteQueue;
+
+        /**
+         * A process waiting in a queue.
+         */
+        struct QueuedProcess
+        {
+            QueuedProcess(
+                ProcessInfo * const process,
+                SiteQueue * const site,
+                const boost::posix_time::ptime &queued)
+              : process_ptr(process),
+                site_ptr(site),
+                queued_time(queued)
+            { }
+
+            ProcessInfo *process_ptr; ///< The process ready to run
+            SiteQueue *site_ptr; ///< The site the process runs for
+            boost::posix_time::ptime queued_time; ///< When it was queued
+        };
+
+        typedef std::deque<QueuedProcess> ProcessQueue;
+
+        /**
+         * The processes waiting for one site, and its place in the round.
+         */
+        struct SiteQueue
+        {
+            SiteQueue(void)
+              : deficit_us(0),
+                active(false)
+            { }
+
+            SiteQueueStats stats; ///< Statistics for the site
+            /** CPU time the site may still use this turn.  Negative if the
+                site is in debt. */
+            MG_LongSignedInt deficit_us;
+            bool active; ///< True if the site is in the round
+            ProcessQueue queue; ///< Site processes ready to run
+        };
+
+        typedef std::map<dbtype::Id::SiteIdType, SiteQueue> SiteQueues;
+        typedef std::deque<SiteQueue *> ActiveSites;
+
+        /**
+         * Gets the queue for a site, creating it if needed.  Lock must be
+         * held.
+         * @param site_id[in] The site to get.
+         * @return The queue for the site.
+         */
+        SiteQueue &get_site(const dbtype::Id::SiteIdType site_id);
+
+        /**
+         * Removes the front process of a queue and records how long it
+         * waited.  Lock must be held.
+         * @param queue[in,out] The queue to take from.  Must not be empty.
+         * @param now[in] The current time, in UTC.
+         * @return The process removed.
+         */
+        ProcessInfo *take_front(
+            ProcessQueue &queue,
+            const boost::posix_time::ptime &now);
+
+        boost::mutex queue_lock; ///< Lock for everything below
+        MG_LongSignedInt quantum; ///< CPU time per weight per turn, in us
+        ProcessQueue priority_queue; ///< Priority processes ready to run
+        SiteQueues site_queues; ///< Every site that has used the queue
+        ActiveSites active_sites; ///< Sites with processes, in turn order
+    };
+}
+}
+
+#endif //MUTGOS_EXECUTOR_FAIRSHAREQUEUE_H
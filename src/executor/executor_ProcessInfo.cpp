@@ -59,7 +59,8 @@ namespace executor
           process_state(ProcessInfo::PROCESS_STATE_CREATED),
           pending_killed(false),
           pending_suspended(false),
-          daemon(false)
+          daemon(false),
+          fair_queue_charged(false)
     {
         if (not process)
         {
@@ -374,6 +375,106 @@ namespace executor
         return set_daemon(is_daemon, token);
     }
 
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::get_fair_queue_charged(
+        concurrency::ReaderLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            return fair_queue_charged;
+        }
+        else
+        {
+            LOG(fatal, "executor", "get_fair_queue_charged",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::get_fair_queue_charged(void)
+    {
+        concurrency::ReaderLockToken token(*this);
+
+        return get_fair_queue_charged(token);
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::set_fair_queue_charged(
+        const bool charged,
+        concurrency::WriterLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            fair_queue_charged = charged;
+            return true;
+        }
+        else
+        {
+            LOG(fatal, "executor", "set_fair_queue_charged",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    ExecutionTimes ProcessInfo::get_execution_times(
+        concurrency::ReaderLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            return execution_times;
+        }
+        else
+        {
+            LOG(fatal, "executor", "get_execution_times",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return ExecutionTimes();
+    }
+
+    // ----------------------------------------------------------------------
+    ExecutionTimes ProcessInfo::get_execution_times(void)
+    {
+        concurrency::ReaderLockToken token(*this);
+
+        return get_execution_times(token);
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::add_execution_times(
+        const ExecutionTimes &times,
+        concurrency::WriterLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            execution_times.add(times);
+            return true;
+        }
+        else
+        {
+            LOG(fatal, "executor", "add_execution_times",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::add_execution_times(const ExecutionTimes &times)
+    {
+        concurrency::WriterLockToken token(*this);
+
+        return add_execution_times(times, token);
+    }
+
     // ----------------------------------------------------------------------
     bool ProcessInfo::cleanup(concurrency::WriterLockToken &token)
     {
@@ -381,11 +482,7 @@ namespace executor
         {
             // Delete all messages
             //
-            while (not waiting_messages.empty())
-            {
-                delete waiting_messages.front().second;
-                waiting_messages.pop();
-            }
+            clear_all_messages(token);
 
             if (not resources.empty())
             {
@@ -504,6 +601,7 @@ namespace executor
             LOG(fatal, "executor", "add_message",
                 "Message pointer is null!  PID "
                 + text::to_string(my_pid));
+            result = false;
         }
         else if (token.has_lock(*this))
         {
@@ -513,38 +611,21 @@ namespace executor
                 + " with RID "
                 + text::to_string(rid));
 
-            if (not rid)
+            if (accept_message_rid(rid, token))
             {
                 waiting_messages.push(std::make_pair(rid, message_ptr));
             }
             else
             {
-                // Confirm this RID is actually ours.
-                if (resources.find(rid) == resources.end())
-                {
-                    // Not ours!
-                    result = false;
-
-                    LOG(error, "executor", "add_message",
-                        "Using unknown RID!  PID "
-                        + text::to_string(my_pid)
-                        + ", RID "
-                        + text::to_string(rid));
-                }
-                else
-                {
-                    waiting_messages.push(std::make_pair(rid, message_ptr));
-                    remove_blocked_resource(rid);
-                }
+                result = false;
             }
-
-            return true;
         }
         else
         {
             LOG(fatal, "executor", "add_message",
                 "Using the wrong lock token!  PID "
                 + text::to_string(my_pid));
+            result = false;
         }
 
         return result;
@@ -558,6 +639,75 @@ namespace executor
         return add_message(message_ptr, rid, token);
     }
 
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::post_message(ProcessMessage *message_ptr, const RID rid)
+    {
+        mailbox.post(rid, message_ptr);
+
+        return mailbox.claim_wakeup();
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::collect_messages(concurrency::WriterLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            RID rid = 0;
+            ProcessMessage *message_ptr = 0;
+
+            while (mailbox.take(rid, message_ptr))
+            {
+                if (not add_message(message_ptr, rid, token))
+                {
+                    // Nobody else has the message now.
+                    delete message_ptr;
+                }
+
+                message_ptr = 0;
+            }
+
+            return true;
+        }
+        else
+        {
+            LOG(fatal, "executor", "collect_messages",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return false;
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::accept_message_rid(
+        const RID rid,
+        concurrency::WriterLockToken &token)
+    {
+        bool accepted = true;
+
+        if (rid)
+        {
+            // Confirm this RID is actually ours.
+            if (resources.find(rid) == resources.end())
+            {
+                // Not ours!
+                accepted = false;
+
+                LOG(error, "executor", "accept_message_rid",
+                    "Using unknown RID!  PID "
+                    + text::to_string(my_pid)
+                    + ", RID "
+                    + text::to_string(rid));
+            }
+            else
+            {
+                remove_blocked_resource(rid, token);
+            }
+        }
+
+        return accepted;
+    }
+
     // ----------------------------------------------------------------------
     ProcessMessage *ProcessInfo::get_next_message(
         concurrency::WriterLockToken &token)
@@ -584,9 +734,28 @@ namespace executor
 
         if (token.has_lock(*this))
         {
-            rid = waiting_messages.front().first;
-            next_message_ptr = waiting_messages.front().second;
-            waiting_messages.pop();
+            // Anything collected is older than what is in the mailbox.
+            //
+            if (not waiting_messages.empty())
+            {
+                rid = waiting_messages.front().first;
+                next_message_ptr = waiting_messages.front().second;
+                waiting_messages.pop();
+            }
+            else
+            {
+                // Take straight from the mailbox, skipping the queue.
+                //
+                while ((not next_message_ptr) and
+                    mailbox.take(rid, next_message_ptr))
+                {
+                    if (not accept_message_rid(rid, token))
+                    {
+                        delete next_message_ptr;
+                        next_message_ptr = 0;
+                    }
+                }
+            }
         }
         else
         {
@@ -611,7 +780,7 @@ namespace executor
     {
         if (token.has_lock(*this))
         {
-            return waiting_messages.empty();
+            return waiting_messages.empty() and mailbox.empty();
         }
         else
         {
@@ -631,17 +800,51 @@ namespace executor
         return messages_empty(token);
     }
 
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::posted_messages_empty(
+        concurrency::ReaderLockToken &token)
+    {
+        if (token.has_lock(*this))
+        {
+            return mailbox.empty();
+        }
+        else
+        {
+            LOG(fatal, "executor", "posted_messages_empty",
+                "Using the wrong lock token!  PID "
+                + text::to_string(my_pid));
+        }
+
+        return true;
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessInfo::posted_messages_empty(void)
+    {
+        concurrency::ReaderLockToken token(*this);
+
+        return posted_messages_empty(token);
+    }
+
     // ----------------------------------------------------------------------
     bool ProcessInfo::clear_all_messages(concurrency::WriterLockToken &token)
     {
         if (token.has_lock(*this))
         {
+            RID rid = 0;
+            ProcessMessage *message_ptr = 0;
+
             while (not waiting_messages.empty())
             {
                 delete waiting_messages.front().second;
                 waiting_messages.pop();
             }
 
+            while (mailbox.take(rid, message_ptr))
+            {
+                delete message_ptr;
+            }
+
             return true;
         }
         else
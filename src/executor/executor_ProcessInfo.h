@@ -13,6 +13,7 @@
 #include "concurrency/concurrency_WriterLockToken.h"
 
 #include "executor/executor_CommonTypes.h"
+#include "executor/executor_ProcessMailbox.h"
 
 #include "dbtypes/dbtype_Id.h"
 
@@ -320,6 +321,62 @@ namespace executor
          */
         bool set_daemon(const bool is_daemon);
 
+        /**
+         * @param token[in] The lock token.
+         * @return True if the process's site was charged a quantum up front
+         * when it was last dispatched from the fair share queue.
+         */
+        bool get_fair_queue_charged(concurrency::ReaderLockToken &token);
+
+        /**
+         * This method will automatically get a lock.
+         * @return True if the process's site was charged a quantum up front
+         * when it was last dispatched from the fair share queue.
+         */
+        bool get_fair_queue_charged(void);
+
+        /**
+         * Sets whether the process's site was charged a quantum up front
+         * when it was dispatched.
+         * @param charged[in] The flag value to set.
+         * @param token[in] The lock token.
+         * @return True if successfully set.
+         */
+        bool set_fair_queue_charged(
+            const bool charged,
+            concurrency::WriterLockToken &token);
+
+        /**
+         * @param token[in] The lock token.
+         * @return How much time the process has spent executing so far.
+         */
+        ExecutionTimes get_execution_times(
+            concurrency::ReaderLockToken &token);
+
+        /**
+         * This method will automatically get a lock.
+         * @return How much time the process has spent executing so far.
+         */
+        ExecutionTimes get_execution_times(void);
+
+        /**
+         * Adds to how much time the process has spent executing.
+         * @param times[in] The times to add, typically from one execution.
+         * @param token[in] The lock token.
+         * @return True if successfully added.
+         */
+        bool add_execution_times(
+            const ExecutionTimes &times,
+            concurrency::WriterLockToken &token);
+
+        /**
+         * Adds to how much time the process has spent executing.
+         * This method will automatically get a lock.
+         * @param times[in] The times to add, typically from one execution.
+         * @return True if successfully added.
+         */
+        bool add_execution_times(const ExecutionTimes &times);
+
         /**
          * This does not check the current process state, so it will return
          * a wakeup time in the past if the wakeup already happened.
@@ -404,6 +461,47 @@ namespace executor
          */
         bool add_message(ProcessMessage *message_ptr, const RID rid);
 
+        /**
+         * Posts a message to the process's mailbox without locking, so the
+         * sender does not wait on the process or the scheduler.  The
+         * message is moved to the queue, and checked, when the process or
+         * scheduler next collects its messages.
+         * @param message_ptr[in] The message to post.  Control of the
+         * pointer will pass to this class.
+         * @param rid[in] The ID of the resource that sent the message, or 0
+         * if none.
+         * @return True if the process's mail wakeup was claimed by this
+         * call, meaning the caller must have the scheduler deliver the mail.
+         * False if someone else already will.
+         */
+        bool post_message(ProcessMessage *message_ptr, const RID rid);
+
+        /**
+         * Claims the mail wakeup flag.  Does not lock.
+         * @return True if it was not already claimed.
+         * @see ProcessMailbox
+         */
+        bool claim_mail_wakeup(void)
+          { return mailbox.claim_wakeup(); }
+
+        /**
+         * Releases the mail wakeup flag, because the process is going idle.
+         * Does not lock.  Check posted_messages_empty() after in case
+         * something was posted just before.
+         * @see ProcessMailbox
+         */
+        void release_mail_wakeup(void)
+          { mailbox.release_wakeup(); }
+
+        /**
+         * Moves every message posted to the mailbox to the back of the
+         * queue, as add_message() would.  Messages from RIDs the process
+         * doesn't have are deleted.
+         * @param token[in] The lock token.
+         * @return True if success.
+         */
+        bool collect_messages(concurrency::WriterLockToken &token);
+
         /**
          * @param token[in] The lock token.
          * @return The next message in the queue, or null if none waiting or
@@ -446,7 +544,8 @@ namespace executor
 
         /**
          * @param token[in] The lock token.
-         * @return True if no messages are waiting for the process.
+         * @return True if no messages are waiting for the process, including
+         * those posted but not yet collected.
          */
         bool messages_empty(concurrency::ReaderLockToken &token);
 
@@ -456,6 +555,20 @@ namespace executor
          */
         bool messages_empty(void);
 
+        /**
+         * @param token[in] The lock token.
+         * @return True if no messages have been posted since they were last
+         * collected.
+         */
+        bool posted_messages_empty(concurrency::ReaderLockToken &token);
+
+        /**
+         * This method will automatically get a lock.
+         * @return True if no messages have been posted since they were last
+         * collected.
+         */
+        bool posted_messages_empty(void);
+
         /**
          * Removes all messages waiting in the queue and frees the
          * associated memory.
@@ -641,6 +754,18 @@ namespace executor
         bool blocked_resources_empty(void);
 
     private:
+        /**
+         * Checks the RID a message came from.  Messages from a RID the
+         * process has are accepted, and the RID is no longer blocked.
+         * Lock must be held.
+         * @param rid[in] The ID of the resource that sent the message, or 0
+         * if none.
+         * @param token[in] The lock token.
+         * @return True if the message should be given to the process.
+         */
+        bool accept_message_rid(
+            const RID rid,
+            concurrency::WriterLockToken &token);
 
         /** First is the RID that sent the message (or 0), second is the message
             pointer */
@@ -663,10 +788,14 @@ namespace executor
         bool pending_killed; ///< True if process kill has been requested
         bool pending_suspended; ///< True if process suspension has been requested
         bool daemon; ///< True if a process is a daemon (not cleaned up) TODO remove
+        bool fair_queue_charged; ///< True if FairShareQueue::pop() charged a quantum for this run
 
         WakeupTimeUTC wakeup_time; ///< If sleeping, when wakeup occurs
 
-        MessageQueue waiting_messages; ///< ProcessMessages sent to process
+        ExecutionTimes execution_times; ///< Time spent executing so far
+
+        ProcessMailbox mailbox; ///< ProcessMessages posted to process
+        MessageQueue waiting_messages; ///< ProcessMessages collected for process
 
         ResourceMap resources; ///< Resources the process is using
         ResourceSet default_blocked_resources; ///< When blocked_resources is reset, this is the template
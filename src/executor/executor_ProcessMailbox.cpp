@@ -0,0 +1,83 @@
+/*
+ * executor_ProcessMailbox.cpp
+ */
+
+#include <boost/atomic.hpp>
+
+#include "executor/executor_CommonTypes.h"
+#include "executor/executor_ProcessMessage.h"
+
+#include "executor/executor_ProcessMailbox.h"
+
+namespace mutgos
+{
+namespace executor
+{
+    // ----------------------------------------------------------------------
+    ProcessMailbox::ProcessMailbox(void)
+      : head(0),
+        tail(new Node()),
+        wakeup_claimed(false)
+    {
+        head.store(tail);
+    }
+
+    // ----------------------------------------------------------------------
+    ProcessMailbox::~ProcessMailbox()
+    {
+        RID rid = 0;
+        ProcessMessage *message_ptr = 0;
+
+        while (take(rid, message_ptr))
+        {
+            delete message_ptr;
+        }
+
+        delete tail;
+    }
+
+    // ----------------------------------------------------------------------
+    void ProcessMailbox::post(
+        const RID rid,
+        ProcessMessage *const message_ptr)
+    {
+        Node * const node_ptr = new Node();
+
+        node_ptr->rid = rid;
+        node_ptr->message_ptr = message_ptr;
+
+        // Become the head, then link the old head to us.  Until the link is
+        // made the consumer can't see this node.
+        //
+        Node * const previous_ptr = head.exchange(node_ptr);
+        previous_ptr->next.store(node_ptr);
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessMailbox::take(RID &rid, ProcessMessage *&message_ptr)
+    {
+        Node * const next_ptr = tail->next.load();
+        const bool found = next_ptr;
+
+        if (found)
+        {
+            // The next node now becomes the one before the oldest message.
+            //
+            rid = next_ptr->rid;
+            message_ptr = next_ptr->message_ptr;
+            next_ptr->message_ptr = 0;
+
+            delete tail;
+            tail = next_ptr;
+        }
+
+        return found;
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessMailbox::empty(void) const
+    {
+        return not tail->next.load();
+    }
+}
+}
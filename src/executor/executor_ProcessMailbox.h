@@ -0,0 +1,128 @@
+/*
+ * executor_ProcessMailbox.h
+ */
+
+#ifndef MUTGOS_EXECUTOR_PROCESSMAILBOX_H
+#define MUTGOS_EXECUTOR_PROCESSMAILBOX_H
+
+#include <boost/atomic.hpp>
+
+#include "executor/executor_CommonTypes.h"
+
+namespace mutgos
+{
+namespace executor
+{
+    // Forward declarations
+    class ProcessMessage;
+
+    /**
+     * A mailbox that any number of threads can post messages to without
+     * locking, and one thread at a time can take them out of, in the order
+     * posted.
+     *
+     * Each post adds a node to the head of a linked list with a single
+     * atomic exchange.  The consumer follows the list from the tail.  A
+     * post that has swapped the head but not yet linked its node hides it
+     * and anything posted after it until it finishes, which is always
+     * shortly.
+     *
+     * Along with the messages is a wakeup flag, which senders use to make
+     * sure only one of them schedules an idle process.  The flag is claimed
+     * by whoever will make the process look at its mail, and released when
+     * the process goes idle again.  A sender that posts and finds the flag
+     * already claimed can leave, because its message will be seen.
+     *
+     * post(), claim_wakeup() and release_wakeup() are thread safe.  take(),
+     * empty() and the destructor may only be called by one thread at a time;
+     * ProcessInfo does so while holding its lock.
+     */
+    class ProcessMailbox
+    {
+    public:
+        /**
+         * Constructor.
+         */
+        ProcessMailbox(void);
+
+        /**
+         * Destructor.  Deletes any messages still in the mailbox.
+         */
+        ~ProcessMailbox();
+
+        /**
+         * Adds a message to the mailbox.  Does not lock or block.
+         * @param rid[in] The ID of the resource that sent the message, or 0
+         * if none.
+         * @param message_ptr[in] The message to add.  Control of the pointer
+         * passes to the mailbox.
+         */
+        void post(const RID rid, ProcessMessage * const message_ptr);
+
+        /**
+         * Removes the oldest message from the mailbox.
+         * @param rid[out] The ID of the resource that sent the message, or 0
+         * if none.
+         * @param message_ptr[out] The message removed.  Control of the
+         * pointer passes to the caller.  Unchanged if none removed.
+         * @return True if a message was removed, false if the mailbox is
+         * empty.
+         */
+        bool take(RID &rid, ProcessMessage *&message_ptr);
+
+        /**
+         * @return True if there are no messages the consumer can take.
+         */
+        bool empty(void) const;
+
+        /**
+         * Claims the wakeup flag.  Call after posting.
+         * @return True if the flag was not already claimed, meaning the
+         * caller must now make the process look at its mail.
+         */
+        bool claim_wakeup(void)
+          { return (not wakeup_claimed.load()) and
+              (not wakeup_claimed.exchange(true)); }
+
+        /**
+         * Releases the wakeup flag.  Call when the process goes idle, and
+         * then check empty() in case something was posted while it was still
+         * claimed.
+         */
+        void release_wakeup(void)
+          { wakeup_claimed.store(false); }
+
+    private:
+        /**
+         * A message in the mailbox.
+         */
+        struct Node
+        {
+            Node(void)
+              : next(0),
+                rid(0),
+                message_ptr(0)
+            { }
+
+            boost::atomic<Node *> next; ///< Next newer node, set by poster
+            RID rid; ///< The resource that sent the message, or 0
+            ProcessMessage *message_ptr; ///< The message
+        };
+
+        // No copying
+        //
+        ProcessMailbox(const ProcessMailbox &rhs);
+        ProcessMailbox &operator=(const ProcessMailbox &rhs);
+
+        /** Newest node, where posters add to */
+        boost::atomic<Node *> head;
+        /** Node before the oldest message.  Its contents were already taken.
+            Only used by the consumer. */
+        Node *tail;
+        /** True if someone will make the process look at its mail */
+        boost::atomic<bool> wakeup_claimed;
+    };
+}
+}
+
+#endif //MUTGOS_EXECUTOR_PROCESSMAILBOX_H
@@ -2,11 +2,16 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <deque>
 #include <unistd.h>
 
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
-#include <boost/lockfree/queue.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 #include "text/text_StringConversion.h"
 #include <boost/date_time/microsec_time_clock.hpp>
 
@@ -26,6 +31,33 @@
 #include "events/events_ProcessExecutionEvent.h"
 #include "events/events_EventAccess.h"
 
+namespace
+{
+    // TODO make data driven
+
+    /** How many processes an executor pulls from its local run queue
+        before it checks the global run queue first, so processes woken by
+        other threads can't be starved by busy local queues */
+    const unsigned int GLOBAL_QUEUE_CHECK_INTERVAL = 31;
+
+    /** How long each tick of the timer wheel is.  Sleeping processes wake
+        up to this much late. */
+    const boost::posix_time::time_duration TIMER_TICK =
+        boost::posix_time::milliseconds(1);
+
+    /** Longest the timer thread sleeps when no timers are pending */
+    const boost::posix_time::time_duration TIMER_IDLE_WAIT =
+        boost::posix_time::seconds(5);
+
+    /** Default thread CPU time a process uses before it gives up the
+        executor, in microseconds */
+    const MG_UnsignedInt DEFAULT_TIME_SLICE_US = 5000;
+
+    /** How many pieces the processes are split into for sending messages,
+        so senders rarely wait on each other */
+    const size_t MAILBOX_SHARD_COUNT = 16;
+}
+
 namespace mutgos
 {
 namespace executor
@@ -33,20 +65,109 @@ namespace executor
     // ----------------------------------------------------------------------
     ProcessScheduler::ProcessScheduler(void)
       : shutting_down(false),
+        time_slice_us(DEFAULT_TIME_SLICE_US),
         process_run_queue_semaphore(0),
-        process_run_queue(1),
+        process_run_queue(DEFAULT_TIME_SLICE_US),
+        current_local_queue(&ProcessScheduler::local_queue_cleanup),
+        idle_executors(0),
+        process_timer_wheel(TIMER_TICK),
+        timer_next_wakeup(boost::posix_time::pos_infin),
+        timer_signaled(false),
+        timer_stop(false),
+        timer_thread_ptr(0),
         next_pid(1),
         next_rid(1),
         max_pid(30000), // TODO Avoids full semaphore for now on Linux??
         max_rid(std::numeric_limits<RID>::max() - 1)
     {
+        for (size_t index = 0; index < MAILBOX_SHARD_COUNT; ++index)
+        {
+            mailbox_shards.push_back(new MailboxShard());
+        }
+
+        timer_thread_ptr = new boost::thread(
+            boost::bind(&ProcessScheduler::timer_thread_main, this));
     }
 
     // ----------------------------------------------------------------------
     ProcessScheduler::~ProcessScheduler()
     {
         shutdown();
-        // All data structures should be empty; nothing to cleanup.
+
+        // Stop the timer thread
+        //
+        timer_stop.store(true);
+
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(timer_mutex);
+            timer_signaled = true;
+            timer_condition.notify_one();
+        }
+
+        timer_thread_ptr->join();
+        delete timer_thread_ptr;
+        timer_thread_ptr = 0;
+
+        // All data structures should be empty; only the local queues
+        // and mailbox shards themselves need cleanup.
+
+        for (LocalRunQueues::iterator queue_iter = local_run_queues.begin();
+            queue_iter != local_run_queues.end();
+            ++queue_iter)
+        {
+            delete *queue_iter;
+        }
+
+        local_run_queues.clear();
+
+        for (MailboxShards::iterator shard_iter = mailbox_shards.begin();
+            shard_iter != mailbox_shards.end();
+            ++shard_iter)
+        {
+            delete *shard_iter;
+        }
+
+        mailbox_shards.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    void ProcessScheduler::set_executor_count(const unsigned int count)
+    {
+        if (not local_run_queues.empty())
+        {
+            LOG(error, "executor", "set_executor_count",
+                "Executor count already set!");
+        }
+        else
+        {
+            for (unsigned int index = 0; index < count; ++index)
+            {
+                local_run_queues.push_back(new LocalRunQueue(index));
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessScheduler::register_executor_thread(
+        const unsigned int executor_index)
+    {
+        bool success = true;
+
+        if (executor_index >= local_run_queues.size())
+        {
+            LOG(error, "executor", "register_executor_thread",
+                "Executor index out of range: "
+                + text::to_string(executor_index));
+
+            success = false;
+        }
+        else
+        {
+            current_local_queue.reset(local_run_queues[executor_index]);
+        }
+
+        return success;
     }
 
     // ----------------------------------------------------------------------
@@ -152,6 +273,16 @@ namespace executor
                     // run the process yet.
                     //
                     all_processes.insert(std::make_pair(pid, process_info_ptr));
+
+                    {
+                        MailboxShard &shard = get_mailbox_shard(pid);
+                        boost::lock_guard<boost::mutex> shard_guard(
+                            shard.shard_lock);
+
+                        shard.processes.insert(
+                            std::make_pair(pid, process_info_ptr));
+                    }
+
                     all_processes_entity[owner_id.get_site_id()]
                       [owner_id.get_entity_id()].push_back(process_info_ptr);
                 }
@@ -340,114 +471,59 @@ namespace executor
             LOG(error, "executor", "send_message",
                 "pid is invalid!");
         }
-        else if (lock())
+        else if (shutting_down.load())
         {
-            // Find the process, append the message, and schedule process for
-            // execution so message can be processed.
-            //
-            PidToProcessMap::iterator process_iter = all_processes.find(pid);
-            bool need_schedule = false;
+            LOG(debug, "executor", "send_message",
+                "Shutting down.  Skipping message for PID "
+                + text::to_string(pid));
+        }
+        else
+        {
+            bool need_deliver = false;
 
-            if (process_iter == all_processes.end())
-            {
-                LOG(error, "executor", "send_message",
-                    "PID " + text::to_string(pid)
-                    + " not found.  Cannot send message.");
-            }
-            else
             {
-                concurrency::WriterLockToken token(*process_iter->second);
-
-                const ProcessInfo::ProcessState process_state =
-                    process_iter->second->get_process_state(token);
-
-                // See if process can receive messages
+                // Senders only need the process to still exist while they
+                // post, so they don't wait on process_lock.
                 //
-                if (not can_receive_messages(process_state))
+                MailboxShard &shard = get_mailbox_shard(pid);
+                boost::lock_guard<boost::mutex> shard_guard(shard.shard_lock);
+                PidToProcessMap::const_iterator process_iter =
+                    shard.processes.find(pid);
+
+                if (process_iter == shard.processes.end())
                 {
-                    LOG(debug, "executor", "send_message",
+                    LOG(error, "executor", "send_message",
                         "PID " + text::to_string(pid)
-                        + " cannot receive messages right now.  Skipping.");
+                        + " not found.  Cannot send message.");
                 }
                 else
                 {
-                    result = process_iter->second->add_message(
+                    need_deliver = process_iter->second->post_message(
                         message_ptr,
-                        rid,
-                        token);
-
-                    if (not rid)
-                    {
-                        // Determine if we can schedule process for execution.
-                        switch (process_state)
-                        {
-                            case ProcessInfo::PROCESS_STATE_BLOCKED:
-                            case ProcessInfo::PROCESS_STATE_CREATED:
-                            {
-                                // Process cannot be scheduled if in these
-                                // states.  If blocked, for instance,
-                                // since this message does not provide a RID,
-                                // the wait list cannot be reduced and so it
-                                // cannot be made ready from this message.
-                                break;
-                            }
-
-                            default:
-                            {
-                                // All other states that are possible here can
-                                // be scheduled.
-                                need_schedule = true;
-                                break;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        // If we're using a RID, see if we can schedule it based on
-                        // how many resources are still waiting.
-                        //
-                        const bool done_blocking =
-                            process_iter->second->blocked_resources_empty(token);
-
-                        // Determine if we can schedule process for execution.
-                        switch (process_state)
-                        {
-                            case ProcessInfo::PROCESS_STATE_BLOCKED:
-                            {
-                                // Only schedule if everything blocking the
-                                // process has sent a message.
-                                need_schedule = done_blocking;
-                                break;
-                            }
-
-                            case ProcessInfo::PROCESS_STATE_CREATED:
-                            {
-                                // Process cannot be scheduled if
-                                // uninitialized.
-                                break;
-                            }
-
-                            default:
-                            {
-                                // All other states that are possible here can
-                                // be scheduled.
-                                need_schedule = true;
-                                break;
-                            }
-                        }
-                    }
+                        rid);
+                    result = true;
                 }
             }
 
-            // Schedule the process if the code above determined it's nessecary.
+            // Only the sender that finds the process idle needs the
+            // scheduler.  Everyone else can rely on the process being
+            // scheduled already.
             //
-            if (result and need_schedule)
+            if (need_deliver and lock())
             {
-                schedule_process(process_iter->second);
-            }
+                // Look again, since the process could have finished after
+                // the shard lock was released.  Its messages went with it.
+                //
+                PidToProcessMap::iterator process_iter =
+                    all_processes.find(pid);
 
-            unlock();
+                if (process_iter != all_processes.end())
+                {
+                    deliver_messages(process_iter->second);
+                }
 
+                unlock();
+            }
         }
 
         if (not result)
@@ -592,67 +668,78 @@ namespace executor
         bool &is_shutting_down)
     {
         ProcessInfo *process_info_ptr = 0;
-        boost::posix_time::ptime current_time_utc =
-            boost::posix_time::microsec_clock::universal_time();
-        bool shutdown_caller = false;
+        bool fair_queue_charged = false;
+        const bool shutdown_caller = shutting_down.load();
 
-        // First, schedule anything due that is currently sleeping and needs
-        // to wake up.
+        // Find something to run.  Prefer the local run queue since
+        // the process probably last ran on this thread, but check the
+        // global run queue first now and then so it isn't starved.
         //
-        if (lock())
-        {
-            shutdown_caller = shutting_down;
+        LocalRunQueue * const local_queue_ptr = current_local_queue.get();
 
-            bool keep_looking = not process_timer_queue.empty();
+        if (local_queue_ptr)
+        {
+            ++local_queue_ptr->dispatch_count;
 
-            while (keep_looking)
+            if (local_queue_ptr->dispatch_count >= GLOBAL_QUEUE_CHECK_INTERVAL)
             {
-                // Using this instead of a for loop because scheduling
-                // a process invalidates the iterator.
-                TimeQueue::iterator timer_iter = process_timer_queue.begin();
-
-                if (timer_iter == process_timer_queue.end())
-                {
-                    // No more timers at all.
-                    keep_looking = false;
-                }
-                else if (timer_iter->first > current_time_utc)
-                {
-                    // The remaining entries in the map are beyond the current
-                    // time and cannot be scheduled yet.
-                    keep_looking = false;
-                }
-                else
-                {
-                    // Time to wakeup the process.
-                    schedule_process(timer_iter->second);
-                }
+                local_queue_ptr->dispatch_count = 0;
+                process_info_ptr = pop_global_queue(fair_queue_charged);
             }
 
-            unlock();
+            if (not process_info_ptr)
+            {
+                process_info_ptr = pop_local_queue(*local_queue_ptr);
+            }
         }
 
-        // Next, wait for a little bit on the semaphore
-        //
-        current_time_utc = boost::posix_time::microsec_clock::universal_time();
-        bool got_sem = false;
-
-        try
+        if (not process_info_ptr)
         {
-            // Wait 3 seconds for semaphore to be posted.
-            got_sem = process_run_queue_semaphore.timed_wait(
-                current_time_utc + boost::posix_time::seconds(3));
+            process_info_ptr = pop_global_queue(fair_queue_charged);
         }
-        catch (...)
+
+        if (not process_info_ptr)
         {
-            LOG(fatal, "executor", "get_next_execute",
-                "Exception while doing timed_wait() on semaphore!");
+            process_info_ptr = steal_process(local_queue_ptr);
         }
 
-        if (got_sem)
+        if (not process_info_ptr)
         {
-            // We have a process to run, get it.
-            process_run_queue.pop(process_info_ptr);
+            // Nothing to run anywhere, so wait for a little bit on the
+            // semaphore
+            //
+            const boost::posix_time::ptime current_time_utc =
+                boost::posix_time::microsec_clock::universal_time();
+            bool got_sem = false;
+
+            ++idle_executors;
+
+            try
+            {
+                // Wait 3 seconds for semaphore to be posted.
+                got_sem = process_run_queue_semaphore.timed_wait(
+                    current_time_utc + boost::posix_time::seconds(3));
+            }
+            catch (...)
+            {
+                LOG(fatal, "executor", "get_next_execute",
+                    "Exception while doing timed_wait() on semaphore!");
+            }
+
+            --idle_executors;
+
+            if (got_sem)
+            {
+                // Either a process was put on the global run queue, or
+                // another executor has more than it can run.
+                //
+                process_info_ptr = process_run_queue.pop(fair_queue_charged);
+
+                if (not process_info_ptr)
+                {
+                    process_info_ptr = steal_process(local_queue_ptr);
+                }
+            }
         }
 
         // Fill in parameters and update state as needed.
@@ -669,6 +756,9 @@ namespace executor
             process_info_ptr->set_process_state(
                 ProcessInfo::PROCESS_STATE_EXECUTING,
                 token);
+
+            // So the right amount is charged when it returns.
+            process_info_ptr->set_fair_queue_charged(fair_queue_charged, token);
         }
         else
         {
@@ -683,7 +773,8 @@ namespace executor
     // ----------------------------------------------------------------------
     void ProcessScheduler::returned_from_execute(
         ProcessInfo * const process_ptr,
-        const Process::ProcessStatus status)
+        const Process::ProcessStatus status,
+        const ExecutionTimes &times)
     {
         if (not process_ptr)
         {
@@ -703,6 +794,22 @@ namespace executor
         bool suspended = false;
         bool cleaned_up = false;
 
+        // Record the time spent before anything can clean up the process.
+        //
+        process_ptr->add_execution_times(times);
+
+        if (not process_ptr->get_db_executable_id().is_default())
+        {
+            program_execution_times[process_ptr->get_db_executable_id()].add(
+                times);
+
+            // Only non-native processes share the CPU by site.
+            process_run_queue.charge(
+                process_ptr->get_db_owner_id().get_site_id(),
+                times.cpu_time_us,
+                process_ptr->get_fair_queue_charged());
+        }
+
         // First, if there are any states that always cleanup, do those first.
         //
         switch (status)
@@ -829,10 +936,10 @@ namespace executor
                 }
                 else
                 {
-                    // Insert it into the timequeue
-                    process_timer_queue.insert(std::make_pair(
-                        process_ptr->get_utc_wakeup_time(token),
-                        process_ptr));
+                    // Insert it into the timer wheel
+                    add_timer(
+                        process_ptr,
+                        process_ptr->get_utc_wakeup_time(token));
                 }
 
                 process_ptr->set_process_state(
@@ -869,10 +976,78 @@ namespace executor
         {
             schedule_process(process_ptr);
         }
+        else if (not cleaned_up)
+        {
+            // The process has gone idle, so the next sender needs to wake
+            // it.  Anything posted before the release would have been
+            // missed, so check.
+            //
+            process_ptr->release_mail_wakeup();
+
+            if ((not process_ptr->posted_messages_empty()) and
+                process_ptr->claim_mail_wakeup())
+            {
+                deliver_messages(process_ptr);
+            }
+        }
 
         unlock();
     }
 
+    // ----------------------------------------------------------------------
+    void ProcessScheduler::set_time_slice_us(const MG_UnsignedInt slice_us)
+    {
+        if (not slice_us)
+        {
+            LOG(error, "executor", "set_time_slice_us",
+                "Time slice cannot be 0.");
+        }
+        else
+        {
+            time_slice_us.store(slice_us);
+            process_run_queue.set_quantum_us(slice_us);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool ProcessScheduler::set_site_weight(
+        const dbtype::Id::SiteIdType site_id,
+        const MG_UnsignedInt weight)
+    {
+        return process_run_queue.set_site_weight(site_id, weight);
+    }
+
+    // ----------------------------------------------------------------------
+    FairShareQueue::SiteQueueStatsVector
+        ProcessScheduler::get_site_queue_stats(void)
+    {
+        return process_run_queue.get_stats();
+    }
+
+    // ----------------------------------------------------------------------
+    void ProcessScheduler::forget_program_times(const dbtype::Id &program_id)
+    {
+        if (lock())
+        {
+            program_execution_times.erase(program_id);
+            unlock();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    TimerStats ProcessScheduler::get_timer_stats(void)
+    {
+        TimerStats stats;
+
+        if (lock())
+        {
+            stats = process_timer_wheel.get_stats();
+            unlock();
+        }
+
+        return stats;
+    }
+
     // ----------------------------------------------------------------------
     RID ProcessScheduler::get_next_rid(const PID pid)
     {
@@ -933,13 +1108,25 @@ namespace executor
     {
         if (process_info_ptr)
         {
+            ExecutionTimes program_times;
+            const ProgramTimesMap::const_iterator program_iter =
+                program_execution_times.find(
+                    process_info_ptr->get_db_executable_id());
+
+            if (program_iter != program_execution_times.end())
+            {
+                program_times = program_iter->second;
+            }
+
             return ProcessStats(
                 process_info_ptr->get_pid(),
                 process_info_ptr->get_process()->process_get_name(
                     process_info_ptr->get_pid()),
                 process_info_ptr->get_db_owner_id(),
                 process_info_ptr->get_db_executable_id(),
-                process_info_ptr->get_process_state());
+                process_info_ptr->get_process_state(),
+                process_info_ptr->get_execution_times(),
+                program_times);
         }
         else
         {
@@ -990,6 +1177,7 @@ namespace executor
             bool in_queue = false;
             bool executing = false;
             bool sleeping = false;
+            bool just_executed = false;
 
             switch (process_ptr->get_process_state(token))
             {
@@ -1012,6 +1200,13 @@ namespace executor
                     break;
                 }
 
+                case ProcessInfo::PROCESS_STATE_SCHEDULING:
+                {
+                    // Called from returned_from_execute()
+                    just_executed = true;
+                    break;
+                }
+
                 default:
                 {
                     // Initial bool values are correct
@@ -1052,74 +1247,297 @@ namespace executor
                         token);
                 }
 
-                // Remove process from timequeue if needed
+                // Remove process from timer wheel if needed.  It won't be
+                // there if the timer thread is waking it up.
                 if (sleeping)
                 {
-                    const boost::posix_time::ptime wakeup_time =
-                        process_ptr->get_utc_wakeup_time(token);
-                    TimeQueue::iterator time_iter = process_timer_queue.find(
-                        wakeup_time);
+                    process_timer_wheel.remove(process_ptr);
+                }
 
-                    while (time_iter != process_timer_queue.end())
-                    {
-                        // Find the process in the timequeue and remove it
+                queue_process(process_ptr, just_executed);
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    void ProcessScheduler::timer_thread_main(void)
+    {
+        TimerWheel::DueProcesses due;
+        boost::posix_time::ptime next_wakeup;
+
+        while (not timer_stop.load())
+        {
+            // Scope for lock
+            {
+                // Any timer added from now on may be sooner than anything
+                // seen below.
+                boost::lock_guard<boost::mutex> guard(timer_mutex);
+                timer_next_wakeup = boost::posix_time::pos_infin;
+            }
+
+            if (lock())
+            {
+                process_timer_wheel.advance(
+                    boost::posix_time::microsec_clock::universal_time(),
+                    due);
+
+                for (TimerWheel::DueProcesses::iterator due_iter =
+                        due.begin();
+                    due_iter != due.end();
+                    ++due_iter)
+                {
+                    schedule_process(*due_iter);
+                }
+
+                next_wakeup = process_timer_wheel.get_next_advance_time();
+                unlock();
+            }
+
+            due.clear();
+
+            if (next_wakeup.is_not_a_date_time())
+            {
+                next_wakeup =
+                    boost::posix_time::microsec_clock::universal_time()
+                    + TIMER_IDLE_WAIT;
+            }
+
+            // Sleep until the next timer is due, unless something sooner was
+            // added while we were busy.
+            //
+            boost::unique_lock<boost::mutex> timer_lock(timer_mutex);
+
+            timer_next_wakeup = next_wakeup;
+
+            while ((not timer_signaled) and (not timer_stop.load()) and
+                timer_condition.timed_wait(timer_lock, timer_next_wakeup))
+            {
+            }
+
+            timer_signaled = false;
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    void ProcessScheduler::add_timer(
+        ProcessInfo *const process_ptr,
+        const boost::posix_time::ptime &wakeup_time)
+    {
+        process_timer_wheel.add(process_ptr, wakeup_time);
+
+        boost::lock_guard<boost::mutex> guard(timer_mutex);
+
+        if (wakeup_time < timer_next_wakeup)
+        {
+            timer_signaled = true;
+            timer_condition.notify_one();
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    void ProcessScheduler::local_queue_cleanup(LocalRunQueue *queue_ptr)
+    {
+        // The scheduler owns the local run queues; nothing to do.
+    }
+
+    // -----------------------------------------------------------------------
+    void ProcessScheduler::queue_process(
+        ProcessInfo *const process_ptr,
+        const bool just_executed)
+    {
+        LocalRunQueue * const local_queue_ptr = current_local_queue.get();
+
+        if (local_queue_ptr and (not just_executed))
+        {
+            // Scope for lock
+            {
+                boost::lock_guard<boost::mutex> guard(
+                    local_queue_ptr->queue_lock);
+
+                local_queue_ptr->queue.push_back(process_ptr);
+            }
+
+            // This executor is busy running something else, so let an idle
+            // executor steal the process rather than have it wait.
+            //
+            if (idle_executors.load())
+            {
+                wakeup_executor();
+            }
+        }
+        else
+        {
+            // Native processes, such as the ones serving connected users,
+            // go ahead of all sites.
+            //
+            process_run_queue.push(
+                process_ptr,
+                process_ptr->get_db_owner_id().get_site_id(),
+                process_ptr->get_db_executable_id().is_default());
+            wakeup_executor();
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    void ProcessScheduler::wakeup_executor(void)
+    {
+        try
+        {
+            process_run_queue_semaphore.post();
+        }
+        catch (...)
+        {
+            // TODO Fix full semaphore situation
+            LOG(fatal, "executor", "wakeup_executor",
+                "Queue semaphore is full!");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    ProcessInfo *ProcessScheduler::pop_local_queue(LocalRunQueue &local_queue)
+    {
+        ProcessInfo *process_info_ptr = 0;
+        boost::lock_guard<boost::mutex> guard(local_queue.queue_lock);
+
+        if (not local_queue.queue.empty())
+        {
+            process_info_ptr = local_queue.queue.front();
+            local_queue.queue.pop_front();
+        }
+
+        return process_info_ptr;
+    }
+
+    // -----------------------------------------------------------------------
+    ProcessInfo *ProcessScheduler::pop_global_queue(bool &fair_queue_charged)
+    {
+        ProcessInfo *process_info_ptr = 0;
+
+        fair_queue_charged = false;
+
+        // Only pull from the queue when holding a post, so waiting executors
+        // are never left without a post for something on the queue.
+        //
+        try
+        {
+            if (process_run_queue_semaphore.try_wait())
+            {
+                process_info_ptr = process_run_queue.pop(fair_queue_charged);
+            }
+        }
+        catch (...)
+        {
+            LOG(fatal, "executor", "pop_global_queue",
+                "Exception while doing try_wait() on semaphore!");
+        }
 
-                        if (time_iter->second == process_ptr)
+        return process_info_ptr;
+    }
+
+    // -----------------------------------------------------------------------
+    ProcessInfo *ProcessScheduler::steal_process(
+        const LocalRunQueue *const thief_ptr)
+    {
+        ProcessInfo *process_info_ptr = 0;
+        const size_t queue_count = local_run_queues.size();
+        const size_t start_index =
+            thief_ptr ? thief_ptr->executor_index + 1 : 0;
+
+        // Start after the thief so executors don't all pick on the same
+        // victim.
+        //
+        for (size_t offset = 0;
+            (offset < queue_count) and (not process_info_ptr);
+            ++offset)
+        {
+            LocalRunQueue * const victim_ptr =
+                local_run_queues[(start_index + offset) % queue_count];
+
+            if (victim_ptr != thief_ptr)
+            {
+                process_info_ptr = pop_local_queue(*victim_ptr);
+            }
+        }
+
+        return process_info_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void ProcessScheduler::deliver_messages(ProcessInfo *const process_ptr)
+    {
+        bool claimed = true;
+
+        while (claimed)
+        {
+            bool need_schedule = false;
+
+            {
+                concurrency::WriterLockToken token(*process_ptr);
+
+                const ProcessInfo::ProcessState process_state =
+                    process_ptr->get_process_state(token);
+
+                if (not can_receive_messages(process_state))
+                {
+                    LOG(debug, "executor", "deliver_messages",
+                        "PID " + text::to_string(process_ptr->get_pid())
+                        + " cannot receive messages right now.  Skipping.");
+
+                    process_ptr->clear_all_messages(token);
+                }
+                else
+                {
+                    // Collecting removes the RIDs that sent messages from
+                    // the blocked list.
+                    //
+                    process_ptr->collect_messages(token);
+
+                    // Determine if we can schedule process for execution.
+                    switch (process_state)
+                    {
+                        case ProcessInfo::PROCESS_STATE_BLOCKED:
                         {
-                            // Found it!
-                            process_timer_queue.erase(time_iter);
-                            time_iter = process_timer_queue.end();
+                            // Only schedule if everything blocking the
+                            // process has sent a message.  Messages without
+                            // a RID can't reduce the wait list.
+                            need_schedule =
+                                process_ptr->blocked_resources_empty(token);
+                            break;
                         }
-                        else if (time_iter->first != wakeup_time)
+
+                        case ProcessInfo::PROCESS_STATE_CREATED:
                         {
-                            // Gone past the wakeup time.  Not found (bad!)
-                            //
-                            LOG(error, "executor", "schedule_process",
-                                "Could not find sleeping PID "
-                                  + text::to_string(
-                                    process_ptr->get_pid())
-                                  + " in timequeue.");
-
-                            time_iter = process_timer_queue.end();
+                            // Process cannot be scheduled if
+                            // uninitialized.
+                            break;
                         }
-                        else
+
+                        default:
                         {
-                            // Not found; keep looking.
-                            ++time_iter;
-
-                            if (time_iter == process_timer_queue.end())
-                            {
-                                // Past the wakeup time, and didn't find it.
-                                // Bad!
-                                //
-                                LOG(error, "executor", "schedule_process",
-                                    "Could not find sleeping PID "
-                                    + text::to_string(
-                                        process_ptr->get_pid())
-                                    + " in timequeue.");
-                            }
+                            // All other states that are possible here can
+                            // be scheduled.
+                            need_schedule =
+                                not process_ptr->messages_empty(token);
+                            break;
                         }
                     }
                 }
+            }
 
-                if (process_run_queue.push(process_ptr))
-                {
-                    try
-                    {
-                        process_run_queue_semaphore.post();
-                    }
-                    catch (...)
-                    {
-                        // TODO Fix full semaphore situation
-                        LOG(fatal, "executor", "schedule_process",
-                            "Queue semaphore is full!");
-                    }
-                }
-                else
-                {
-                    LOG(fatal, "executor", "schedule_process",
-                        "Unable to queue process!");
-                }
+            if (need_schedule)
+            {
+                // The wakeup stays claimed until the process goes idle.
+                schedule_process(process_ptr);
+                claimed = false;
+            }
+            else
+            {
+                // Still idle.  Release the wakeup, and try again if something
+                // was posted before the release.
+                //
+                process_ptr->release_mail_wakeup();
+                claimed = (not process_ptr->posted_messages_empty()) and
+                    process_ptr->claim_mail_wakeup();
             }
         }
     }
@@ -1247,6 +1665,14 @@ namespace executor
             all_processes.erase(all_processes_iter);
         }
 
+        // Scope for lock
+        {
+            MailboxShard &shard = get_mailbox_shard(pid);
+            boost::lock_guard<boost::mutex> shard_guard(shard.shard_lock);
+
+            shard.processes.erase(pid);
+        }
+
         SiteIdToProcessesMap::iterator site_iter = all_processes_entity.find(
             process_entity_id.get_site_id());
 
@@ -5,17 +5,24 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <deque>
 
 #include <boost/interprocess/sync/interprocess_semaphore.hpp>
-#include <boost/lockfree/queue.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
 
 #include "osinterface/osinterface_OsTypes.h"
 
 #include "executor/executor_ProcessInfo.h"
 #include "executor/executor_ProcessStats.h"
 #include "executor/executor_Process.h"
+#include "executor/executor_TimerWheel.h"
+#include "executor/executor_FairShareQueue.h"
 #include "dbtypes/dbtype_Id.h"
 
 namespace mutgos
@@ -44,17 +51,38 @@ namespace executor
         typedef std::vector<ProcessStats> ProcessStatsVector;
 
         /**
-         * Constructor.  This initializes all data structures.  When
-         * returned, the scheduler is immediately ready for use.
+         * Constructor.  This initializes all data structures and starts the
+         * timer thread.  When returned, the scheduler is immediately ready
+         * for use.
          */
         ProcessScheduler(void);
 
         /**
          * Destructor.  Also cleans up any processes still known to the
-         * scheduler by running shutdown().
+         * scheduler by running shutdown(), and stops the timer thread.
          */
         ~ProcessScheduler();
 
+        /**
+         * Sets how many executor threads will be calling get_next_execute(),
+         * and creates a local run queue for each one.  Must be called once,
+         * before any executor thread is started.
+         * Not thread safe.
+         * @param count[in] The number of executor threads.
+         */
+        void set_executor_count(const unsigned int count);
+
+        /**
+         * Called by each executor thread before it first calls
+         * get_next_execute(), to associate the thread with its local
+         * run queue.  Processes the thread reschedules go on its local
+         * queue, and idle executors steal from the other local queues.
+         * @param executor_index[in] The index of the executor, from 0 to
+         * one less than the count given to set_executor_count().
+         * @return True if success, false if the index is out of range.
+         */
+        bool register_executor_thread(const unsigned int executor_index);
+
         /**
          * Cleans up all running processes and does not accept new processes.
          * When this method returns, all processes (including those actively
@@ -132,6 +160,9 @@ namespace executor
          * always take ownership of the pointer.
          * @returnTrue if found the process and resource, and queued the message,
          * false if error (process or resource not found?).
+         * A message for a process that cannot receive it, or from a RID the
+         * process doesn't have, is deleted when the process collects it,
+         * after this has returned true.
          */
         bool send_message(
             const PID pid,
@@ -167,6 +198,13 @@ namespace executor
          */
         ProcessStats get_process_stats(const PID pid);
 
+        /**
+         * Discards the execution time accumulated for a program, such as
+         * when it has been deleted.
+         * @param program_id[in] The ID of the program.
+         */
+        void forget_program_times(const dbtype::Id &program_id);
+
         /**
          * Called by whoever actually executes a process, this method
          * will block for a period of time until any process is ready for
@@ -178,7 +216,6 @@ namespace executor
          * When execution has completed, do not call this again; instead call
          * returned_from_execute() first.
          *
-         * As this method also does housekeeping, it must be called frequently.
          * It is safe to call this on multiple threads.
          *
          * @param is_killed[out] Set to true when the returned process is being
@@ -202,10 +239,52 @@ namespace executor
          * @param status[in] Status returned from the process after executing.
          * Based on the status, the scheduler may call certain methods on the
          * process to get additional information.
+         * @param times[in] How much time the process spent executing.  This
+         * is added to the totals for the process and its program.
          */
         void returned_from_execute(
             ProcessInfo * const process_ptr,
-            const Process::ProcessStatus status);
+            const Process::ProcessStatus status,
+            const ExecutionTimes &times);
+
+        /**
+         * Sets how much thread CPU time a process should use before it
+         * voluntarily gives up the executor.  Processes check this
+         * themselves; the scheduler does not preempt.
+         * @param slice_us[in] The time slice, in microseconds.  Must not be 0.
+         */
+        void set_time_slice_us(const MG_UnsignedInt slice_us);
+
+        /**
+         * Thread safe.
+         * @return How much thread CPU time, in microseconds, a process should
+         * use before voluntarily giving up the executor.
+         */
+        MG_UnsignedInt get_time_slice_us(void) const
+          { return time_slice_us.load(); }
+
+        /**
+         * @return Statistics about how late sleeping processes have been
+         * woken up.
+         */
+        TimerStats get_timer_stats(void);
+
+        /**
+         * Sets how much CPU a site's processes get relative to other sites
+         * when the executors are busy.  Sites default to a weight of 1.
+         * @param site_id[in] The site to set the weight of.
+         * @param weight[in] The weight.  Must not be 0.
+         * @return True if set.
+         */
+        bool set_site_weight(
+            const dbtype::Id::SiteIdType site_id,
+            const MG_UnsignedInt weight);
+
+        /**
+         * @return Run queue depth, wait time, and CPU time statistics for
+         * each site that has run processes.
+         */
+        FairShareQueue::SiteQueueStatsVector get_site_queue_stats(void);
 
         /**
          * Gets the next RID.
@@ -232,12 +311,102 @@ namespace executor
         /** Maps Site ID portion of an ID to the processes */
         typedef std::map<dbtype::Id::SiteIdType, EntityIdToProcessMap>
             SiteIdToProcessesMap;
-        /** Key is the absolute time to run the process */
-        typedef std::multimap<boost::posix_time::ptime, ProcessInfo *> TimeQueue;
-        /** Lock free queue of processes waiting to be executed */
-        typedef boost::lockfree::queue<ProcessInfo *> RunQueue;
         /** Maps an active RID to an active PID. ProcessInfo can map in reverse */
         typedef std::map<RID, PID> RidToPidMap;
+        /** Maps a program Entity ID to the time all its processes executed */
+        typedef std::map<dbtype::Id, ExecutionTimes> ProgramTimesMap;
+
+        /**
+         * Processes ready to run that were scheduled by one executor thread.
+         * The owning executor pulls from it first; other executors steal
+         * from it when they have nothing to do.
+         */
+        struct LocalRunQueue
+        {
+            LocalRunQueue(const unsigned int index)
+              : executor_index(index),
+                dispatch_count(0)
+            { }
+
+            const unsigned int executor_index; ///< Index of owning executor
+            boost::mutex queue_lock; ///< Lock for the queue
+            std::deque<ProcessInfo *> queue; ///< Processes ready to run
+            /** How many processes the owner has pulled since last checking
+                the global run queue first.  Only used by the owner. */
+            unsigned int dispatch_count;
+        };
+
+        /** All the local run queues, indexed by executor */
+        typedef std::vector<LocalRunQueue *> LocalRunQueues;
+
+        /**
+         * Some of the processes, by PID, that messages can be sent to.
+         */
+        struct MailboxShard
+        {
+            boost::mutex shard_lock; ///< Lock for the processes
+            PidToProcessMap processes; ///< Processes in the shard
+        };
+
+        typedef std::vector<MailboxShard *> MailboxShards;
+
+        /**
+         * @param pid[in] The PID of a process.
+         * @return The mailbox shard the process belongs in.
+         */
+        MailboxShard &get_mailbox_shard(const PID pid)
+          { return *mailbox_shards[pid % mailbox_shards.size()]; }
+
+        /**
+         * Used by current_local_queue when a thread exits.  Does nothing,
+         * since the local run queues are owned by the scheduler.
+         * @param queue_ptr[in] The local run queue of the exiting thread.
+         */
+        static void local_queue_cleanup(LocalRunQueue *queue_ptr);
+
+        /**
+         * Puts a process on the calling executor's local run queue, or on
+         * the global run queue if not called from an executor thread or if
+         * the process just executed.  Processes that keep running always go
+         * through the global run queue, so they get their site's fair share
+         * and no more.
+         * This assumes the class instance has already been locked.
+         * @param process_ptr[in] The process to queue.
+         * @param just_executed[in] True if the process is being rescheduled
+         * right after executing.
+         */
+        void queue_process(
+            ProcessInfo * const process_ptr,
+            const bool just_executed);
+
+        /**
+         * Wakes up an executor waiting in get_next_execute().
+         */
+        void wakeup_executor(void);
+
+        /**
+         * @param local_queue[in] The local run queue to pull from.
+         * @return The oldest process on the local run queue, or null if
+         * empty.
+         */
+        ProcessInfo *pop_local_queue(LocalRunQueue &local_queue);
+
+        /**
+         * Pulls a process from the global run queue without blocking.
+         * @param fair_queue_charged[out] Set to true if the process's site
+         * was charged a quantum for it (see FairShareQueue::pop()).
+         * @return The process pulled, or null if none.
+         */
+        ProcessInfo *pop_global_queue(bool &fair_queue_charged);
+
+        /**
+         * Takes the oldest process from another executor's local run queue.
+         * @param thief_ptr[in] The local run queue of the calling executor,
+         * or null if not called from an executor thread.
+         * @return The stolen process, or null if all other local run queues
+         * are empty.
+         */
+        ProcessInfo *steal_process(const LocalRunQueue * const thief_ptr);
 
         /**
          * @param process_info_ptr[in] The process to get stats for.
@@ -264,6 +433,33 @@ namespace executor
          */
         void schedule_process(ProcessInfo * const process_ptr);
 
+        /**
+         * Main loop of the timer thread.  Waits until the next sleeping
+         * process is due and schedules it.
+         */
+        void timer_thread_main(void);
+
+        /**
+         * Puts a sleeping process on the timer wheel, waking the timer
+         * thread if it needs to run sooner than planned.
+         * This assumes the class instance has already been locked.
+         * @param process_ptr[in] The sleeping process.
+         * @param wakeup_time[in] When the process should wake, in UTC.
+         */
+        void add_timer(
+            ProcessInfo * const process_ptr,
+            const boost::posix_time::ptime &wakeup_time);
+
+        /**
+         * Collects the messages posted to a process whose mail wakeup was
+         * just claimed, and schedules it if the messages allow it to run.
+         * If not, the wakeup is released again.  Messages for a process
+         * that cannot receive them are deleted.
+         * This assumes the class instance has already been locked.
+         * @param process_ptr[in] The process to deliver to.
+         */
+        void deliver_messages(ProcessInfo * const process_ptr);
+
         /**
          * This assumes the class instance has already been locked.
          * @param state[in] The state of a process.
@@ -299,24 +495,67 @@ namespace executor
         /** The lock for using any attribute on this class. */
         boost::recursive_mutex process_lock;
 
-        bool shutting_down; ///< True if shutting down (no new processes)
+        /** True if shutting down (no new processes).  Atomic so executors
+            can check it without the lock. */
+        boost::atomic<bool> shutting_down;
 
         /** All processes the scheduler is responsible for */
         PidToProcessMap all_processes;
         /** All processes, organized by the associated 'process owner' ID */
         SiteIdToProcessesMap all_processes_entity;
+        /** Time spent executing by each program, including processes that
+            have since finished */
+        ProgramTimesMap program_execution_times;
+        /** All processes again, split up by PID, so send_message() can
+            find a process without process_lock.  Only changed after getting
+            process_lock.  Each shard has its own lock. */
+        MailboxShards mailbox_shards;
+
+        /** How much thread CPU time a process should use before giving up
+            the executor, in microseconds */
+        boost::atomic<MG_UnsignedInt> time_slice_us;
 
         // TODO Will need to handle semaphore overflow ( > 32,000) at some point
         /** Semaphore associated with the run queue so threads can easily block
-            and wait for the next process to run.  Thead safe. */
+            and wait for the next process to run.  It is posted once for every
+            process put on the global run queue, and once whenever an idle
+            executor should steal from a busy local run queue, so a wakeup may
+            find nothing to do.  Thead safe. */
         boost::interprocess::interprocess_semaphore process_run_queue_semaphore;
-        /** The process run queue; anything on this queue is ready to be
-            executed.  Thread safe. */
-        RunQueue process_run_queue;
+        /** The global process run queue; anything on this queue is ready to
+            be executed.  Shares the executors fairly between sites.  Used for
+            processes that just executed, and processes scheduled by threads
+            that are not executors.  Thread safe. */
+        FairShareQueue process_run_queue;
+
+        /** Run queues local to each executor.  Only changed before executors
+            start and during destruction.  Each queue has its own lock. */
+        LocalRunQueues local_run_queues;
+        /** The local run queue of the current thread, or null if the thread
+            is not an executor. */
+        boost::thread_specific_ptr<LocalRunQueue> current_local_queue;
+        /** How many executors are waiting on the run queue semaphore */
+        boost::atomic<unsigned int> idle_executors;
 
         /** Processes that are currently sleeping, organized by UTC time to wake
-            them */
-        TimeQueue process_timer_queue;
+            them.  Locked using process_lock. */
+        TimerWheel process_timer_wheel;
+
+        /** Lock for the timer thread's sleep; never held while getting
+            process_lock */
+        boost::mutex timer_mutex;
+        /** Wakes the timer thread when a timer is due sooner than planned,
+            or when stopping */
+        boost::condition_variable timer_condition;
+        /** When the timer thread next plans to wake.  pos_infin while it is
+            awake, so any new timer makes it check again.  Uses timer_mutex. */
+        boost::posix_time::ptime timer_next_wakeup;
+        /** True if the timer thread was signaled.  Uses timer_mutex. */
+        bool timer_signaled;
+        /** True when the timer thread should exit */
+        boost::atomic<bool> timer_stop;
+        /** Runs timer_thread_main() */
+        boost::thread *timer_thread_ptr;
 
 
         // The RID and PID stuff is locked using process_lock
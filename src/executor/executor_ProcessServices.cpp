@@ -283,5 +283,11 @@ namespace executor
 
         return success;
     }
+
+    // ----------------------------------------------------------------------
+    MG_UnsignedInt ProcessServices::get_time_slice_us(void) const
+    {
+        return scheduler_ptr->get_time_slice_us();
+    }
 }
 }
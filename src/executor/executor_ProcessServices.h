@@ -108,6 +108,14 @@ namespace executor
          */
         bool remove_resource(const RID rid);
 
+        /**
+         * Processes that can pause themselves should do so after using
+         * about this much thread CPU time in one execution, so other
+         * processes get a turn.
+         * @return The time slice, in microseconds.
+         */
+        MG_UnsignedInt get_time_slice_us(void) const;
+
     private:
         ProcessInfo  ** const process_info_ptr; ///< Pointer to active process
         ProcessScheduler * const scheduler_ptr; ///< Pointer to scheduler
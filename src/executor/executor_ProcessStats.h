@@ -30,18 +30,25 @@ namespace executor
          * @param executable[in] If not 'native', the softcode program entity
          * ID.  If 'native', this must be defaulted.
          * @param state[in] The current process state.
+         * @param times[in] How much time the process has spent executing.
+         * @param program_times[in] How much time all processes of the
+         * executable have spent executing.  Empty if 'native'.
          */
         ProcessStats(
             const PID pid,
             const std::string &name,
             const dbtype::Id &owner,
             const dbtype::Id &executable,
-            const ProcessInfo::ProcessState state)
+            const ProcessInfo::ProcessState state,
+            const ExecutionTimes &times,
+            const ExecutionTimes &program_times)
           : my_pid(pid),
             process_name(name),
             owner_id(owner),
             executable_id(executable),
-            process_state(state)
+            process_state(state),
+            process_times(times),
+            executable_times(program_times)
           { }
 
         /**
@@ -89,12 +96,28 @@ namespace executor
         ProcessInfo::ProcessState get_process_state(void) const
           { return process_state; }
 
+        /**
+         * @return How much time the process has spent executing.
+         */
+        const ExecutionTimes &get_execution_times(void) const
+          { return process_times; }
+
+        /**
+         * @return How much time all processes of the softcode program
+         * have spent executing, including ones no longer running.  Empty if
+         * 'native'.
+         */
+        const ExecutionTimes &get_executable_times(void) const
+          { return executable_times; }
+
     private:
         PID my_pid; ///< The PID the stats are about.
         std::string process_name; ///< Friendly name of process.
         dbtype::Id owner_id; ///< Who owns the process
         dbtype::Id executable_id;  ///< If not 'native', the softcode program entity ID
         ProcessInfo::ProcessState process_state; ///< The current process state
+        ExecutionTimes process_times; ///< Time the process spent executing
+        ExecutionTimes executable_times; ///< Time the program spent executing
     };
 }
 }
@@ -1,5 +1,8 @@
 #include <string>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_ThreadUtils.h"
 #include "text/text_StringConversion.h"
 
 #include "logging/log_Logger.h"
@@ -19,8 +22,11 @@ namespace mutgos
 namespace executor
 {
     // ----------------------------------------------------------------------
-    ThreadedExecutor::ThreadedExecutor(ProcessScheduler *const scheduler_ptr)
+    ThreadedExecutor::ThreadedExecutor(
+        ProcessScheduler *const scheduler_ptr,
+        const unsigned int index)
       : process_scheduler_ptr(scheduler_ptr),
+        executor_index(index),
         current_process_info_ptr(0),
         services(&current_process_info_ptr, process_scheduler_ptr),
         stop_flag(false)
@@ -61,10 +67,18 @@ namespace executor
         PID pid = 0;
         RID rid = 0;
         ProcessMessage *message_ptr = 0;
-        bool process_messages = true;
 
         memory::ThreadVirtualHeapManager::add_thread();
 
+        if (not process_scheduler_ptr->register_executor_thread(
+            executor_index))
+        {
+            LOG(error, "executor", "thread_main",
+                "Could not register executor "
+                + text::to_string(executor_index)
+                + ".  Processes will only use the global run queue.");
+        }
+
         while (not stop_flag.load())
         {
             // See if we have something to execute
@@ -83,6 +97,11 @@ namespace executor
                     + text::to_string(pid)
                     + ", name " + process_ptr->process_get_name(pid));
 
+                const MG_LongUnsignedInt start_cpu_time_us =
+                    osinterface::ThreadUtils::get_thread_cpu_time_us();
+                const boost::posix_time::ptime start_wall_time =
+                    boost::posix_time::microsec_clock::universal_time();
+
                 if (process_is_killed)
                 {
                     LOG(debug, "executor", "thread_main",
@@ -99,74 +118,73 @@ namespace executor
                     // If there are messages waiting, execute the process
                     // that way, otherwise just do a plain execute.
                     //
-                    if (current_process_info_ptr->messages_empty())
+                    message_ptr =
+                        current_process_info_ptr->get_next_message(rid);
+
+                    if (not message_ptr)
                     {
                         process_status = process_ptr->process_execute(
                             pid,
                             services);
                     }
-                    else
+
+                    while (message_ptr)
                     {
-                        while (process_messages and
-                            (not current_process_info_ptr->messages_empty()))
+                        if (rid)
+                        {
+                            process_status =
+                                process_ptr->process_execute(
+                                    pid,
+                                    services,
+                                    rid,
+                                    *message_ptr);
+                        }
+                        else
                         {
-                            message_ptr =
-                                current_process_info_ptr->get_next_message(rid);
+                            process_status =
+                                process_ptr->process_execute(
+                                    pid,
+                                    services,
+                                    *message_ptr);
+                        }
 
-                            if (not message_ptr)
-                            {
-                                // This shouldn't happen, but this way the
-                                // process always gets to execute.
-                                process_status =
-                                    Process::PROCESS_STATUS_EXECUTE_MORE;
-                            }
-                            else
+                        delete message_ptr;
+                        message_ptr = 0;
+
+                        // Confirm the process hasn't errored out before
+                        // giving it more messages.
+                        //
+                        switch (process_status)
+                        {
+                            case Process::PROCESS_STATUS_ERROR:
+                            case Process::PROCESS_STATUS_SUSPENDED:
+                            case Process::PROCESS_STATUS_FINISHED:
                             {
-                                if (rid)
-                                {
-                                    process_status =
-                                        process_ptr->process_execute(
-                                            pid,
-                                            services,
-                                            rid,
-                                            *message_ptr);
-                                }
-                                else
-                                {
-                                    process_status =
-                                        process_ptr->process_execute(
-                                            pid,
-                                            services,
-                                            *message_ptr);
-                                }
-
-                                delete message_ptr;
-                                message_ptr = 0;
+                                // Doesn't want any more messages.
+                                // Stop early.
+                                break;
                             }
 
-                            // Confirm the process hasn't errored out before
-                            // giving it more messages.
-                            //
-                            switch (process_status)
+                            default:
                             {
-                                case Process::PROCESS_STATUS_ERROR:
-                                case Process::PROCESS_STATUS_SUSPENDED:
-                                case Process::PROCESS_STATUS_FINISHED:
-                                {
-                                    // Doesn't want any more messages.
-                                    // Stop early.
-                                    process_messages = false;
-                                    break;
-                                }
-
-                                default:
-                                {
-                                }
+                                message_ptr =
+                                    current_process_info_ptr->
+                                        get_next_message(rid);
                             }
                         }
                     }
                 }
 
+                ExecutionTimes times;
+
+                times.cpu_time_us =
+                    osinterface::ThreadUtils::get_thread_cpu_time_us()
+                        - start_cpu_time_us;
+                times.wall_time_us =
+                    (boost::posix_time::microsec_clock::universal_time()
+                        - start_wall_time).total_microseconds();
+                times.slices = 1;
+
                 LOG(debug, "executor", "ThreadedExecutor",
                     "Finished execution of PID "
                     + text::to_string(pid)
@@ -174,13 +192,13 @@ namespace executor
 
                 process_scheduler_ptr->returned_from_execute(
                     current_process_info_ptr,
-                    process_status);
+                    process_status,
+                    times);
 
                 current_process_info_ptr = 0;
                 process_ptr = 0;
                 pid = 0;
                 rid = 0;
-                process_messages = true;
             }
 
             if (scheduler_is_shutting_down)
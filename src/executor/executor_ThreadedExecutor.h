@@ -23,8 +23,13 @@ namespace executor
         /**
          * Constructor.
          * @param scheduler_ptr[in] The process scheduler instance.
+         * @param index[in] The index of this executor, used to find its
+         * local run queue in the scheduler.  See
+         * ProcessScheduler::set_executor_count().
          */
-        ThreadedExecutor(ProcessScheduler * const scheduler_ptr);
+        ThreadedExecutor(
+            ProcessScheduler * const scheduler_ptr,
+            const unsigned int index);
 
         /**
          * Destructor.
@@ -51,6 +56,7 @@ namespace executor
 
     private:
         ProcessScheduler * const process_scheduler_ptr; ///< Process scheduler
+        const unsigned int executor_index; ///< Index of this executor
         ProcessInfo *current_process_info_ptr; ///< Currently executing process
         ProcessServices services; ///< Services to pass to executing process
         boost::atomic<bool> stop_flag; ///< If true, exit thread_main()
@@ -0,0 +1,265 @@
+/*
+ * executor_TimerWheel.cpp
+ */
+
+#include <stddef.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+#include "executor/executor_TimerWheel.h"
+
+namespace
+{
+    /** How many bits of the tick each level uses */
+    const size_t SLOT_BITS = 6;
+    /** How many slots are in each level */
+    const size_t SLOTS_PER_LEVEL = 1 << SLOT_BITS;
+    /** Mask to get a slot from a shifted tick */
+    const MG_LongUnsignedInt SLOT_MASK = SLOTS_PER_LEVEL - 1;
+    /** How many levels the wheel has.  At 1ms per tick, the top level
+        covers about 4.6 hours; anything later is moved down as it nears. */
+    const size_t LEVELS = 4;
+    /** Most ticks in the future the wheel can directly place something */
+    const MG_LongUnsignedInt MAX_PLACEMENT_TICKS =
+        ((MG_LongUnsignedInt) 1 << (SLOT_BITS * LEVELS)) - 1;
+}
+
+namespace mutgos
+{
+namespace executor
+{
+    // ----------------------------------------------------------------------
+    TimerWheel::TimerWheel(const boost::posix_time::time_duration &tick)
+      : tick_duration(tick),
+        start_time(boost::posix_time::microsec_clock::universal_time()),
+        current_tick(0),
+        slots(SLOTS_PER_LEVEL * LEVELS)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    TimerWheel::~TimerWheel()
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void TimerWheel::add(
+        ProcessInfo *const process_ptr,
+        const boost::posix_time::ptime &wakeup_time)
+    {
+        MG_LongUnsignedInt expire_tick = time_to_tick(wakeup_time);
+
+        remove(process_ptr);
+
+        // Ticks up to current_tick have already been processed.
+        //
+        if (expire_tick <= current_tick)
+        {
+            expire_tick = current_tick + 1;
+        }
+
+        place(Entry(process_ptr, wakeup_time, expire_tick));
+    }
+
+    // ----------------------------------------------------------------------
+    bool TimerWheel::remove(ProcessInfo *const process_ptr)
+    {
+        LocationMap::iterator location_iter = locations.find(process_ptr);
+        const bool found = (location_iter != locations.end());
+
+        if (found)
+        {
+            slots[location_iter->second.slot_index].erase(
+                location_iter->second.entry_iter);
+            locations.erase(location_iter);
+        }
+
+        return found;
+    }
+
+    // ----------------------------------------------------------------------
+    void TimerWheel::advance(
+        const boost::posix_time::ptime &now,
+        DueProcesses &due)
+    {
+        MG_LongUnsignedInt target_tick = 0;
+
+        if (now > start_time)
+        {
+            target_tick = (now - start_time).total_microseconds() /
+                tick_duration.total_microseconds();
+        }
+
+        while (current_tick < target_tick)
+        {
+            if (locations.empty())
+            {
+                // Nothing left to wake, so skip right to the end.
+                current_tick = target_tick;
+            }
+            else
+            {
+                ++current_tick;
+
+                // When a level turns over, move the next slot of the level
+                // above down, and so on up the levels.
+                //
+                bool turned_over = not (current_tick & SLOT_MASK);
+
+                for (size_t level = 1; turned_over and (level < LEVELS);
+                    ++level)
+                {
+                    const size_t slot = (size_t)
+                        ((current_tick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+                    cascade(level, slot);
+                    turned_over = not slot;
+                }
+
+                expire((size_t) (current_tick & SLOT_MASK), now, due);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    boost::posix_time::ptime TimerWheel::get_next_advance_time(void) const
+    {
+        boost::posix_time::ptime next_time;
+
+        if (not locations.empty())
+        {
+            // Look for the next occupied slot before the lowest level turns
+            // over.  If there isn't one, the turn over is the next time
+            // something could move down and become due.
+            //
+            const MG_LongUnsignedInt turn_over_tick =
+                (current_tick | SLOT_MASK) + 1;
+            MG_LongUnsignedInt tick = current_tick + 1;
+
+            while ((tick < turn_over_tick) and slots[tick & SLOT_MASK].empty())
+            {
+                ++tick;
+            }
+
+            next_time = tick_to_time(tick);
+        }
+
+        return next_time;
+    }
+
+    // ----------------------------------------------------------------------
+    void TimerWheel::place(const Entry &entry)
+    {
+        const MG_LongUnsignedInt placement_tick =
+            std::min(entry.expire_tick, current_tick + MAX_PLACEMENT_TICKS);
+        const MG_LongUnsignedInt delta = placement_tick - current_tick;
+        size_t level = 0;
+
+        while ((level < (LEVELS - 1)) and
+            (delta >= ((MG_LongUnsignedInt) 1 << (SLOT_BITS * (level + 1)))))
+        {
+            ++level;
+        }
+
+        Location location;
+
+        location.slot_index = (level * SLOTS_PER_LEVEL) +
+            (size_t) ((placement_tick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+        Slot &slot = slots[location.slot_index];
+
+        location.entry_iter = slot.insert(slot.end(), entry);
+        locations[entry.process_ptr] = location;
+    }
+
+    // ----------------------------------------------------------------------
+    void TimerWheel::cascade(const size_t level, const size_t slot)
+    {
+        Slot entries;
+
+        entries.swap(slots[(level * SLOTS_PER_LEVEL) + slot]);
+
+        for (Slot::const_iterator entry_iter = entries.begin();
+            entry_iter != entries.end();
+            ++entry_iter)
+        {
+            place(*entry_iter);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void TimerWheel::expire(
+        const size_t slot,
+        const boost::posix_time::ptime &now,
+        DueProcesses &due)
+    {
+        Slot entries;
+
+        entries.swap(slots[slot]);
+
+        for (Slot::const_iterator entry_iter = entries.begin();
+            entry_iter != entries.end();
+            ++entry_iter)
+        {
+            if (entry_iter->expire_tick > current_tick)
+            {
+                // Not due yet.  This shouldn't happen on the lowest level.
+                place(*entry_iter);
+            }
+            else
+            {
+                MG_LongUnsignedInt lateness_us = 0;
+
+                if (now > entry_iter->wakeup_time)
+                {
+                    lateness_us =
+                        (now - entry_iter->wakeup_time).total_microseconds();
+                }
+
+                ++stats.wakeups;
+                stats.total_lateness_us += lateness_us;
+
+                if (lateness_us > stats.max_lateness_us)
+                {
+                    stats.max_lateness_us = lateness_us;
+                }
+
+                locations.erase(entry_iter->process_ptr);
+                due.push_back(entry_iter->process_ptr);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    MG_LongUnsignedInt TimerWheel::time_to_tick(
+        const boost::posix_time::ptime &time) const
+    {
+        MG_LongUnsignedInt tick = 0;
+
+        if (time > start_time)
+        {
+            const MG_LongUnsignedInt tick_us =
+                tick_duration.total_microseconds();
+
+            tick = ((time - start_time).total_microseconds() + tick_us - 1) /
+                tick_us;
+        }
+
+        return tick;
+    }
+
+    // ----------------------------------------------------------------------
+    boost::posix_time::ptime TimerWheel::tick_to_time(
+        const MG_LongUnsignedInt tick) const
+    {
+        return start_time + boost::posix_time::microseconds(
+            tick * tick_duration.total_microseconds());
+    }
+}
+}
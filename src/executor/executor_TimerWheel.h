@@ -0,0 +1,201 @@
+/*
+ * executor_TimerWheel.h
+ */
+
+#ifndef MUTGOS_EXECUTOR_TIMERWHEEL_H
+#define MUTGOS_EXECUTOR_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+namespace mutgos
+{
+namespace executor
+{
+    // Forward declarations
+    class ProcessInfo;
+
+    /**
+     * Statistics about how late sleeping processes were woken up.
+     */
+    struct TimerStats
+    {
+        TimerStats(void)
+          : wakeups(0),
+            total_lateness_us(0),
+            max_lateness_us(0)
+        { }
+
+        /** How many sleeping processes have been woken by their timer */
+        MG_LongUnsignedInt wakeups;
+        /** Sum of how late each wakeup was, in microseconds */
+        MG_LongUnsignedInt total_lateness_us;
+        /** The latest any wakeup has been, in microseconds */
+        MG_LongUnsignedInt max_lateness_us;
+    };
+
+    /**
+     * A hierarchical timer wheel holding sleeping processes, organized by
+     * when they wake up.  Adding or removing a process costs one map lookup,
+     * and advancing the wheel only looks at the slots that came due.
+     *
+     * Time is counted in ticks from when the wheel was created.  The lowest
+     * level has one slot per tick; each higher level has slots covering a
+     * whole turn of the level below it.  As a level turns over, the next
+     * slot of the level above is moved down.
+     *
+     * This class is not thread safe.
+     */
+    class TimerWheel
+    {
+    public:
+        /** Processes that are due to wake up */
+        typedef std::vector<ProcessInfo *> DueProcesses;
+
+        /**
+         * Constructor.
+         * @param tick[in] How much time each tick of the wheel covers.
+         * Wakeups are rounded up to the next tick.
+         */
+        TimerWheel(const boost::posix_time::time_duration &tick);
+
+        /**
+         * Destructor.
+         */
+        ~TimerWheel();
+
+        /**
+         * Adds a process to the wheel.  If it is already on the wheel, it is
+         * moved to the new wakeup time.
+         * @param process_ptr[in] The process to add.
+         * @param wakeup_time[in] When the process should wake, in UTC.
+         */
+        void add(
+            ProcessInfo * const process_ptr,
+            const boost::posix_time::ptime &wakeup_time);
+
+        /**
+         * Removes a process from the wheel, if present.
+         * @param process_ptr[in] The process to remove.
+         * @return True if the process was on the wheel.
+         */
+        bool remove(ProcessInfo * const process_ptr);
+
+        /**
+         * Advances the wheel to the given time, removing every process due
+         * to wake up.
+         * @param now[in] The current time, in UTC.
+         * @param due[out] The processes now due are appended to this.
+         */
+        void advance(const boost::posix_time::ptime &now, DueProcesses &due);
+
+        /**
+         * @return The time advance() next needs to be called, in UTC, or
+         * not_a_date_time if the wheel is empty.
+         */
+        boost::posix_time::ptime get_next_advance_time(void) const;
+
+        /**
+         * @return True if no processes are on the wheel.
+         */
+        bool empty(void) const
+          { return locations.empty(); }
+
+        /**
+         * @return Wakeup lateness statistics since the wheel was created.
+         */
+        const TimerStats &get_stats(void) const
+          { return stats; }
+
+    private:
+        /**
+         * A process on the wheel.
+         */
+        struct Entry
+        {
+            Entry(
+                ProcessInfo * const process,
+                const boost::posix_time::ptime &wakeup,
+                const MG_LongUnsignedInt expire)
+              : process_ptr(process),
+                wakeup_time(wakeup),
+                expire_tick(expire)
+            { }
+
+            ProcessInfo *process_ptr; ///< The sleeping process
+            boost::posix_time::ptime wakeup_time; ///< Requested wakeup
+            MG_LongUnsignedInt expire_tick; ///< Tick the process wakes on
+        };
+
+        typedef std::list<Entry> Slot;
+        typedef std::vector<Slot> Slots;
+
+        /**
+         * Where a process is on the wheel.
+         */
+        struct Location
+        {
+            size_t slot_index; ///< Index into slots
+            Slot::iterator entry_iter; ///< Entry within the slot
+        };
+
+        typedef std::map<ProcessInfo *, Location> LocationMap;
+
+        /**
+         * Puts an entry in the slot matching its expire tick, and records
+         * where it went.
+         * @param entry[in] The entry to place.
+         */
+        void place(const Entry &entry);
+
+        /**
+         * Moves every entry in a slot of a higher level down to where it now
+         * belongs.
+         * @param level[in] The level of the slot.
+         * @param slot[in] The slot within the level.
+         */
+        void cascade(const size_t level, const size_t slot);
+
+        /**
+         * Removes every entry in a slot of the lowest level, recording
+         * statistics.
+         * @param slot[in] The slot within the lowest level.
+         * @param now[in] The current time, in UTC.
+         * @param due[out] The processes removed are appended to this.
+         */
+        void expire(
+            const size_t slot,
+            const boost::posix_time::ptime &now,
+            DueProcesses &due);
+
+        /**
+         * @param time[in] A time in UTC.
+         * @return The first tick at or after the given time.
+         */
+        MG_LongUnsignedInt time_to_tick(
+            const boost::posix_time::ptime &time) const;
+
+        /**
+         * @param tick[in] A tick.
+         * @return The time the tick starts, in UTC.
+         */
+        boost::posix_time::ptime tick_to_time(
+            const MG_LongUnsignedInt tick) const;
+
+        const boost::posix_time::time_duration tick_duration; ///< Per tick
+        const boost::posix_time::ptime start_time; ///< Time of tick 0
+        MG_LongUnsignedInt current_tick; ///< All ticks up to here are done
+        Slots slots; ///< All slots of all levels, lowest level first
+        LocationMap locations; ///< Where every process on the wheel is
+        TimerStats stats; ///< Wakeup statistics
+    };
+}
+}
+
+#endif //MUTGOS_EXECUTOR_TIMERWHEEL_H
@@ -12,6 +12,7 @@
 #define MG_SignedInt mutgos::osinterface::OsTypes::SignedInt
 #define MG_VeryLongUnsignedInt mutgos::osinterface::OsTypes::VeryLongUnsignedInt
 #define MG_LongUnsignedInt mutgos::osinterface::OsTypes::LongUnsignedInt
+#define MG_LongSignedInt mutgos::osinterface::OsTypes::LongSignedInt
 #define MG_Float mutgos::osinterface::OsTypes::Float
 
 #define MG_NewLine "\n"
@@ -40,6 +41,9 @@ namespace osinterface
         /** 8 byte unsigned integer */
         typedef uint64_t LongUnsignedInt;
 
+        /** 8 byte signed integer */
+        typedef int64_t LongSignedInt;
+
         /** Standard 8 byte float */
         typedef float Float;
 
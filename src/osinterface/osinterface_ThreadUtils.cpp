@@ -5,6 +5,7 @@
 #include "osinterface_ThreadUtils.h"
 
 #include <pthread.h>
+#include <time.h>
 
 namespace mutgos
 {
@@ -29,5 +30,20 @@ namespace osinterface
     {
         pthread_yield();
     }
+
+    // -----------------------------------------------------------------------
+    MG_LongUnsignedInt ThreadUtils::get_thread_cpu_time_us(void)
+    {
+        MG_LongUnsignedInt cpu_time_us = 0;
+        struct timespec cpu_time;
+
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time) == 0)
+        {
+            cpu_time_us = ((MG_LongUnsignedInt) cpu_time.tv_sec * 1000000) +
+                (cpu_time.tv_nsec / 1000);
+        }
+
+        return cpu_time_us;
+    }
 } /* namespace osinterface */
 } /* namespace mutgos */
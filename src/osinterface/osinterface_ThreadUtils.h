@@ -7,6 +7,8 @@
 
 #include <pthread.h>
 
+#include "osinterface/osinterface_OsTypes.h"
+
 namespace mutgos
 {
 namespace osinterface
@@ -39,6 +41,12 @@ namespace osinterface
          * Yields the thread (puts in back of execution queue).
          */
         static void yield(void);
+
+        /**
+         * @return How much CPU time the calling thread has used since it
+         * started, in microseconds, or 0 if not available.
+         */
+        static MG_LongUnsignedInt get_thread_cpu_time_us(void);
     };
 
 } /* namespace osinterface */
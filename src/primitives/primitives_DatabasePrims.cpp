@@ -2278,16 +2278,19 @@ namespace primitives
             (entity_types == CONTENTS_ALL);
         const bool want_non_actions = (entity_types == CONTENTS_NON_ACTIONS_ONLY) or
             (entity_types == CONTENTS_ALL);
-        dbinterface::EntityRef entity_ref;
+        // Get them all at once rather than one at a time.
+        dbinterface::EntityRefVector entity_refs =
+            db_access->get_entities(contents);
+        dbinterface::EntityRefVector::iterator ref_iter = entity_refs.begin();
 
         effective_contents.reserve(contents.size());
 
         for (dbtype::Entity::IdVector::const_iterator id_iter =
                 contents.begin();
             id_iter != contents.end();
-            ++id_iter)
+            ++id_iter, ++ref_iter)
         {
-            entity_ref = db_access->get_entity(*id_iter);
+            dbinterface::EntityRef &entity_ref = *ref_iter;
 
             if (entity_ref.valid())
             {
@@ -2340,14 +2343,17 @@ namespace primitives
 
         dbinterface::DatabaseAccess * const db_access =
             dbinterface::DatabaseAccess::instance();
+        // Get them all at once rather than one at a time.
+        dbinterface::EntityRefVector entity_refs =
+            db_access->get_entities(contents);
+        dbinterface::EntityRefVector::iterator ref_iter = entity_refs.begin();
 
         for (dbtype::Entity::IdVector::const_iterator entity_iter =
             contents.begin();
              entity_iter != contents.end();
-             ++entity_iter)
+             ++entity_iter, ++ref_iter)
         {
-            dbinterface::EntityRef entity_ref =
-                db_access->get_entity(*entity_iter);
+            dbinterface::EntityRef &entity_ref = *ref_iter;
 
             if (entity_ref.valid())
             {
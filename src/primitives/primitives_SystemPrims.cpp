@@ -81,6 +81,10 @@ namespace primitives
                << std::left << std::setw(28) << "NAME"
                << std::left << std::setw(20) << "EXECUTABLE"
                << std::left << std::setw(18) << "OWNER"
+               << std::right << std::setw(10) << "CPU MS"
+               << std::right << std::setw(10) << "WALL MS"
+               << std::right << std::setw(8) << "SLICES"
+               << std::right << std::setw(12) << "PROG CPU MS"
                << std::endl;
 
             output += strstream.str();
@@ -356,6 +360,14 @@ namespace primitives
             << std::left << std::setw(20)
             << get_name(process.get_executable_id())
             << std::left << std::setw(18) << get_name(process.get_owner_id())
+            << std::right << std::setw(10)
+            << process.get_execution_times().cpu_time_us / 1000
+            << std::right << std::setw(10)
+            << process.get_execution_times().wall_time_us / 1000
+            << std::right << std::setw(8)
+            << process.get_execution_times().slices
+            << std::right << std::setw(12)
+            << process.get_executable_times().cpu_time_us / 1000
             << std::endl;
 
         output += strstream.str();
@@ -0,0 +1,126 @@
+/*
+ * socket_OutgoingTextQueue.cpp
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <boost/asio/buffer.hpp>
+
+#include "socket_OutgoingTextQueue.h"
+
+namespace
+{
+    const char TELNET_LF = '\n';
+
+    // TODO make data driven
+    /** Most empty chunks kept for reuse after a clear() */
+    const size_t MAX_SPARE_CHUNKS = 4;
+}
+
+namespace mutgos
+{
+namespace socket
+{
+    // Statics
+    //
+    const size_t OutgoingTextQueue::CHUNK_SIZE = 4096;
+
+    // ----------------------------------------------------------------------
+    OutgoingTextQueue::OutgoingTextQueue(void)
+      : chunks_used(0),
+        total_size(0),
+        line_count(0)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void OutgoingTextQueue::append(
+        const std::string &text,
+        const bool add_newline)
+    {
+        append_data(text.data(), text.size());
+
+        if (add_newline)
+        {
+            append_data(&TELNET_LF, 1);
+        }
+
+        ++line_count;
+    }
+
+    // ----------------------------------------------------------------------
+    void OutgoingTextQueue::get_buffers(Buffers &buffers) const
+    {
+        buffers.clear();
+
+        for (size_t index = 0; index < chunks_used; ++index)
+        {
+            buffers.push_back(boost::asio::buffer(chunks[index]));
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void OutgoingTextQueue::clear(void)
+    {
+        // Chunks keep their memory when cleared, so only a few are kept
+        // to avoid holding on to a large burst forever.
+        //
+        if (chunks.size() > MAX_SPARE_CHUNKS)
+        {
+            chunks.resize(MAX_SPARE_CHUNKS);
+        }
+
+        for (Chunks::iterator chunk_iter = chunks.begin();
+            chunk_iter != chunks.end();
+            ++chunk_iter)
+        {
+            chunk_iter->clear();
+        }
+
+        chunks_used = 0;
+        total_size = 0;
+        line_count = 0;
+    }
+
+    // ----------------------------------------------------------------------
+    void OutgoingTextQueue::swap(OutgoingTextQueue &rhs)
+    {
+        chunks.swap(rhs.chunks);
+        std::swap(chunks_used, rhs.chunks_used);
+        std::swap(total_size, rhs.total_size);
+        std::swap(line_count, rhs.line_count);
+    }
+
+    // ----------------------------------------------------------------------
+    void OutgoingTextQueue::append_data(const char *data_ptr, size_t data_size)
+    {
+        while (data_size)
+        {
+            if ((not chunks_used) or
+                (chunks[chunks_used - 1].size() >= CHUNK_SIZE))
+            {
+                // Need another chunk.  Use a spare if there is one.
+                //
+                if (chunks_used == chunks.size())
+                {
+                    chunks.push_back(std::string());
+                }
+
+                chunks[chunks_used].reserve(CHUNK_SIZE);
+                ++chunks_used;
+            }
+
+            std::string &chunk = chunks[chunks_used - 1];
+            const size_t append_size =
+                std::min(data_size, CHUNK_SIZE - chunk.size());
+
+            chunk.append(data_ptr, append_size);
+            data_ptr += append_size;
+            data_size -= append_size;
+            total_size += append_size;
+        }
+    }
+}
+}
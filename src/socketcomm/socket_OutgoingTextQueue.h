@@ -0,0 +1,106 @@
+/*
+ * socket_OutgoingTextQueue.h
+ */
+
+#ifndef MUTGOS_SOCKET_OUTGOINGTEXTQUEUE_H
+#define MUTGOS_SOCKET_OUTGOINGTEXTQUEUE_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include <boost/asio/buffer.hpp>
+
+namespace mutgos
+{
+namespace socket
+{
+    /**
+     * Text waiting to be written to a socket.  Lines are packed one after
+     * the other into fixed size chunks, a new chunk only being started
+     * when the last one is full, so a write of many short lines is only a
+     * few buffers (iovecs) for the socket.  Chunks are kept for reuse
+     * after clear(), up to a limit, so a busy connection isn't always
+     * allocating them.
+     *
+     * This class is not thread safe.
+     */
+    class OutgoingTextQueue
+    {
+    public:
+        /** Buffers to write with one scatter-gather write, in order */
+        typedef std::vector<boost::asio::const_buffer> Buffers;
+
+        /** Size of each chunk, in bytes */
+        static const size_t CHUNK_SIZE;
+
+        /**
+         * Constructor.
+         */
+        OutgoingTextQueue(void);
+
+        /**
+         * Adds a line (or other text) to the end of the queue.
+         * @param text[in] The text to add.
+         * @param add_newline[in] True to add a newline after the text.
+         */
+        void append(const std::string &text, const bool add_newline);
+
+        /**
+         * @return True if nothing is queued.
+         */
+        bool empty(void) const
+          { return not total_size; }
+
+        /**
+         * @return How many bytes are queued.
+         */
+        size_t size(void) const
+          { return total_size; }
+
+        /**
+         * @return How many times append() has been called since the last
+         * clear().
+         */
+        size_t get_line_count(void) const
+          { return line_count; }
+
+        /**
+         * Gets where the queued text is, to give to the socket.  The queue
+         * must not be changed until the write using them is done.
+         * @param buffers[out] One buffer per chunk used is put here.  Any
+         * existing contents are replaced.
+         */
+        void get_buffers(Buffers &buffers) const;
+
+        /**
+         * Empties the queue, keeping some of the chunks to be reused.
+         */
+        void clear(void);
+
+        /**
+         * Swaps contents with another queue.
+         * @param rhs[in,out] The queue to swap with.
+         */
+        void swap(OutgoingTextQueue &rhs);
+
+    private:
+        typedef std::vector<std::string> Chunks;
+
+        /**
+         * Adds raw data to the end of the queue, filling the last chunk
+         * before starting another.
+         * @param data_ptr[in] The data to add.
+         * @param data_size[in] The size of the data.
+         */
+        void append_data(const char *data_ptr, size_t data_size);
+
+        Chunks chunks; ///< The chunks; those past chunks_used are spares
+        size_t chunks_used; ///< How many chunks have text in them
+        size_t total_size; ///< Bytes in all the chunks
+        size_t line_count; ///< Times append() was called since clear()
+    };
+}
+}
+
+#endif //MUTGOS_SOCKET_OUTGOINGTEXTQUEUE_H
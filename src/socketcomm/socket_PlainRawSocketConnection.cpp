@@ -132,23 +132,24 @@ namespace socket
     }
 
     // ----------------------------------------------------------------------
-    bool PlainRawSocketConnection::raw_send(
-        const char *data_ptr,
-        const size_t data_size)
+    bool PlainRawSocketConnection::raw_send(const OutgoingBuffers &buffers)
     {
         bool success = false;
 
         if (socket_accepted and socket_connected and (not socket_blocked))
         {
-            if (not data_size)
+            if (buffers.empty())
             {
                 success = true;
             }
-            else if (data_ptr)
+            else
             {
+                // ASIO copies the list of buffers, and writes as many at
+                // once as the OS allows.
+                //
                 boost::asio::async_write(
                     socket,
-                    boost::asio::buffer(data_ptr, data_size),
+                    buffers,
                     boost::bind(
                         &PlainRawSocketConnection::on_write_complete,
                         shared_from_this(),
@@ -69,14 +69,15 @@ namespace socket
         virtual bool raw_is_encrypted(void) const;
 
         /**
-         * Sends the given data over the socket.
-         * @param data_ptr[in] The data to send.  The data itself will not be
-         * copied.  It must be kept intact until the send is complete.
-         * @param data_size[in] The size of the data.
+         * Sends the given data over the socket, with a single scatter-gather
+         * write.
+         * @param buffers[in] The data to send, in order.  The data itself
+         * will not be copied.  It must be kept intact until the send is
+         * complete.
          * @return True if send has started, false if send did NOT start
          * because it was blocked, not connected, or had some other error.
          */
-        virtual bool raw_send(const char *data_ptr, const size_t data_size);
+        virtual bool raw_send(const OutgoingBuffers &buffers);
 
     protected:
 
@@ -41,6 +41,9 @@ namespace socket
           client_ptr(0),
           strand_executor(io_context.get_executor()),
           timer(
+              io_context,
+              (std::chrono::steady_clock::time_point::max())),
+          flush_timer(
               io_context,
               (std::chrono::steady_clock::time_point::max()))
     {
@@ -122,6 +125,23 @@ namespace socket
         timer.cancel();
     }
 
+    // ----------------------------------------------------------------------
+    void RawSocketConnection::set_flush_timer(const MG_UnsignedInt milliseconds)
+    {
+        if (socket_connected)
+        {
+            flush_timer.expires_after(std::chrono::milliseconds(milliseconds));
+
+            flush_timer.async_wait(
+                boost::asio::bind_executor(
+                    strand_executor,
+                    std::bind(
+                        &RawSocketConnection::on_flush_timer,
+                        shared_from_this(),
+                        std::placeholders::_1)));
+        }
+    }
+
     // ----------------------------------------------------------------------
     void RawSocketConnection::client_released(void)
     {
@@ -212,6 +232,15 @@ namespace socket
         }
     }
 
+    // ----------------------------------------------------------------------
+    void RawSocketConnection::on_flush_timer(boost::system::error_code error_code)
+    {
+        if (socket_connected and (not error_code) and client_ptr)
+        {
+            client_ptr->raw_flush_timer_expired();
+        }
+    }
+
     // ----------------------------------------------------------------------
     void RawSocketConnection::handle_disconnect(void)
     {
@@ -222,6 +251,7 @@ namespace socket
             socket_blocked = true;
 
             cancel_timer();
+            flush_timer.cancel();
 
             if (client_ptr)
             {
@@ -6,6 +6,7 @@
 #define MUTGOS_SOCKET_RAWSOCKETCONNECTION_H
 
 #include <stddef.h>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -42,6 +43,9 @@ namespace socket
         : public boost::enable_shared_from_this<RawSocketConnection>
     {
     public:
+        /** Buffers to send with one scatter-gather write, in order */
+        typedef std::vector<boost::asio::const_buffer> OutgoingBuffers;
+
         /**
          * Creates a RawSocketConnection base class instance.
          * @param driver[in] Pointer to the socket driver in use.
@@ -86,6 +90,17 @@ namespace socket
          */
         void cancel_timer(void);
 
+        /**
+         * Sets the flush timer, used to wait a little for more outgoing
+         * data before sending.  It is separate from set_timer().  Any
+         * existing flush timer will be cancelled.  Can only be used when
+         * connected.
+         * On the SocketClientConnection, raw_flush_timer_expired() will be
+         * called when the specified time has passed.
+         * @param milliseconds[in] The milliseconds to set the timer for.
+         */
+        void set_flush_timer(const MG_UnsignedInt milliseconds);
+
         /**
          * Informs the class that the client connection pointer has been
          * deleted, so it will no longer be used.
@@ -127,14 +142,15 @@ namespace socket
         virtual bool raw_is_encrypted(void) const =0;
 
         /**
-         * Sends the given data over the socket.
-         * @param data_ptr[in] The data to send.  The data itself will not be
-         * copied.  It must be kept intact until the send is complete.
-         * @param data_size[in] The size of the data.
+         * Sends the given data over the socket, with a single scatter-gather
+         * write.
+         * @param buffers[in] The data to send, in order.  The data itself
+         * will not be copied.  It must be kept intact until the send is
+         * complete.  The list of buffers may be changed once this returns.
          * @return True if send has started, false if send did NOT start
          * because it was blocked, not connected, or had some other error.
          */
-        virtual bool raw_send(const char *data_ptr, const size_t data_size) =0;
+        virtual bool raw_send(const OutgoingBuffers &buffers) =0;
 
     protected:
         /**
@@ -170,6 +186,12 @@ namespace socket
          */
         void on_timer(boost::system::error_code error_code);
 
+        /**
+         * Called when the flush timer has expired, cancelled, etc.
+         * @param error_code[in] Indicates if the timer completed successfully.
+         */
+        void on_flush_timer(boost::system::error_code error_code);
+
         /**
          * Used when ASIO indicates the socket closed during an operation.
          */
@@ -186,6 +208,7 @@ namespace socket
 
         boost::asio::strand<boost::asio::executor> strand_executor; ///< The executor
         boost::asio::steady_timer timer; ///< General timer.  Put here to keep all asio stuff in one place.
+        boost::asio::steady_timer flush_timer; ///< Times when coalesced outgoing data is sent
 
         char *incoming_buffer; //< Array of char that functions as buffer for incoming data
         static const size_t incoming_buffer_size; ///< Size of incoming_buffer
@@ -6,8 +6,6 @@
 #include <string.h>
 #include <stddef.h>
 
-#include <boost/algorithm/string/replace.hpp>
-
 #include "osinterface/osinterface_OsTypes.h"
 
 #include "text/text_StringConversion.h"
@@ -28,7 +26,6 @@
 #include "socket_SocketClientConnection.h"
 
 #include "text/text_Utf8Tools.h"
-#include "text/text_ExternalTextConverter.h"
 #include "text/text_AnsiConverter.h"
 #include "text/text_ExternalText.h"
 
@@ -44,7 +41,12 @@ namespace
 {
     // TODO Update if name changes
     const std::string SESSION_AGENT_CHANNEL_NAME = "Session Agent";
-    const std::string TELNET_CR(1, '\r');
+
+    // TODO make data driven
+
+    /** How long to wait for more outgoing text before sending it, in ms.
+        If 0, it is sent at the end of each pass through the router. */
+    const MG_UnsignedInt OUTGOING_COALESCE_MS = 0;
 }
 
 namespace mutgos
@@ -64,7 +66,15 @@ namespace socket
         client_connected(false),
         client_do_reconnect(false),
         requested_service(false),
+        disconnect_pending(false),
+        decode_shard(driver ? driver->get_decode_pool().assign_shard() : 0),
+        decodes_pending(0),
         config_ansi_enabled(true),
+        write_in_progress(false),
+        flush_timer_set(false),
+        stats_bytes_sent(0),
+        stats_writes_sent(0),
+        stats_lines_sent(0),
         pending_ids_message_size(0),
         ack_lines_received_from_client(0),
         next_input_ser_id(1),
@@ -119,6 +129,12 @@ namespace socket
     // ----------------------------------------------------------------------
     SocketClientConnection::~SocketClientConnection()
     {
+        LOG(debug, "socket", "~SocketClientConnection",
+            "Source " + client_source + " was sent "
+            + text::to_string(stats_bytes_sent) + " bytes ("
+            + text::to_string(stats_lines_sent) + " lines) in "
+            + text::to_string(stats_writes_sent) + " writes.");
+
         // This will not cause a double-delete because the Driver should
         // already know it is in the middle of deleting this.
         raw_connection->client_released();
@@ -161,42 +177,38 @@ namespace socket
                 ack_outgoing_data(false);
             }
 
-            if (not client_blocked)
+            if (not write_in_progress)
             {
                 if (not outgoing_control_buffer.empty())
                 {
                     // Add the control buffer to what's going out so we can
                     // send it all at once.
                     //
-                    outgoing_text_buffer.append(outgoing_control_buffer);
+                    queue_outgoing(outgoing_control_buffer, false);
                     outgoing_control_buffer.clear();
                     outgoing_control_buffer.shrink_to_fit();
                 }
 
-                if (not outgoing_text_buffer.empty())
+                if (not outgoing_queue.empty())
                 {
-                    if (raw_connection->raw_send(
-                        outgoing_text_buffer.c_str(),
-                        outgoing_text_buffer.size()))
+                    // Send now if there's enough to be worth it or we've
+                    // waited long enough for more, otherwise wait.
+                    //
+                    const MG_UnsignedInt waited_ms =
+                        std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() -
+                                outgoing_queue_start).count();
+
+                    if ((outgoing_queue.size() >= max_pending_data_size) or
+                        (waited_ms >= OUTGOING_COALESCE_MS))
                     {
-                        // Wait for it to confirm sending.
-                        client_blocked = true;
+                        send_outgoing();
                     }
-                    else
+                    else if (not flush_timer_set)
                     {
-                        // Error condition.  We should always know the state
-                        // of the connection.  It may have disconnected
-                        // and not yet notified us, which is an expected
-                        // condition.  If we are still connected, however,
-                        // that is an error condition.
-                        if (raw_connection->raw_is_connected())
-                        {
-                            LOG(error, "socket", "do_work",
-                                "Unable to send buffer to source "
-                                  + client_source + ".  Disconnecting.");
-                        }
-
-                        raw_disconnected();
+                        flush_timer_set = true;
+                        raw_connection->set_flush_timer(
+                            OUTGOING_COALESCE_MS - waited_ms);
                     }
                 }
             }
@@ -585,17 +597,16 @@ namespace socket
     // ----------------------------------------------------------------------
     void SocketClientConnection::raw_send_complete(void)
     {
-        outgoing_text_buffer.clear();
+        stats_bytes_sent += outgoing_sending.size();
+        stats_lines_sent += outgoing_sending.get_line_count();
+        ++stats_writes_sent;
 
-        if (client_connected and client_blocked)
-        {
-            client_blocked = false;
-
-            if (client_session_ptr)
-            {
-                client_session_ptr->client_unblocked();
-            }
+        outgoing_sending.clear();
+        write_in_progress = false;
 
+        if (client_connected)
+        {
+            // Send whatever was queued up during the write.
             request_service();
         }
     }
@@ -603,7 +614,14 @@ namespace socket
     // ----------------------------------------------------------------------
     void SocketClientConnection::raw_disconnected(void)
     {
-        if (client_connected)
+        if (decodes_pending)
+        {
+            // Let the session see everything the client sent before it
+            // sees the disconnect.  input_decoded() will call back.
+            //
+            disconnect_pending = true;
+        }
+        else if (client_connected)
         {
             LOG(debug, "socket", "raw_disconnected",
                 "Client disconnected.  Source " + client_source + ", entity "
@@ -628,11 +646,43 @@ namespace socket
     {
         if (data_size)
         {
-            std::string data(data_ptr, data_size);
-            process_raw_incoming_data(data);
+            process_raw_incoming_data(data_ptr, data_size);
         }
     }
 
+    // ----------------------------------------------------------------------
+    void SocketClientConnection::input_decoded(
+        SocketDecodeJob::TextLines &lines)
+    {
+        for (SocketDecodeJob::TextLines::iterator line_iter = lines.begin();
+            line_iter != lines.end();
+            ++line_iter)
+        {
+            if (client_connected)
+            {
+                command_processor.process_input(*line_iter);
+                ++ack_lines_received_from_client;
+            }
+            else
+            {
+                // We disconnected them while this was being decoded.
+                text::ExternalText::clear_text_line(**line_iter);
+                delete *line_iter;
+            }
+        }
+
+        lines.clear();
+        --decodes_pending;
+
+        if ((not decodes_pending) and disconnect_pending)
+        {
+            disconnect_pending = false;
+            raw_disconnected();
+        }
+
+        driver_ptr->release(this);
+    }
+
     // ----------------------------------------------------------------------
     void SocketClientConnection::raw_timer_expired(void)
     {
@@ -665,12 +715,11 @@ namespace socket
 
             // Add to outgoing text
             //
-            outgoing_text_buffer += text;
-            outgoing_text_buffer += TELNET_LF;
+            queue_outgoing(text, true);
 
             // Determine if we can send more.
             //
-            if (outgoing_text_buffer.size() >= max_pending_data_size)
+            if (outgoing_queue.size() >= max_pending_data_size)
             {
                 // We're done for now.
                 //
@@ -684,6 +733,71 @@ namespace socket
         return status;
     }
 
+    // ----------------------------------------------------------------------
+    void SocketClientConnection::queue_outgoing(
+        const std::string &text,
+        const bool add_newline)
+    {
+        if (outgoing_queue.empty())
+        {
+            outgoing_queue_start = std::chrono::steady_clock::now();
+        }
+
+        outgoing_queue.append(text, add_newline);
+    }
+
+    // ----------------------------------------------------------------------
+    void SocketClientConnection::send_outgoing(void)
+    {
+        // The queued text stays where it is until the write completes;
+        // only the list of where it is gets handed to the socket.  The
+        // queue gets the chunks from the last write to reuse.
+        //
+        outgoing_sending.swap(outgoing_queue);
+        outgoing_sending.get_buffers(outgoing_buffers);
+
+        if (raw_connection->raw_send(outgoing_buffers))
+        {
+            // Wait for it to confirm sending.  Meanwhile the queue is
+            // empty again, so the session can keep going.
+            //
+            write_in_progress = true;
+
+            if (client_connected and client_blocked)
+            {
+                client_blocked = false;
+
+                if (client_session_ptr)
+                {
+                    client_session_ptr->client_unblocked();
+                }
+            }
+        }
+        else
+        {
+            // Error condition.  We should always know the state
+            // of the connection.  It may have disconnected
+            // and not yet notified us, which is an expected
+            // condition.  If we are still connected, however,
+            // that is an error condition.
+            if (raw_connection->raw_is_connected())
+            {
+                LOG(error, "socket", "send_outgoing",
+                    "Unable to send buffer to source "
+                      + client_source + ".  Disconnecting.");
+            }
+
+            raw_disconnected();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SocketClientConnection::raw_flush_timer_expired(void)
+    {
+        flush_timer_set = false;
+        request_service();
+    }
+
     // ----------------------------------------------------------------------
     void SocketClientConnection::disconnect_socket(void)
     {
@@ -766,79 +880,37 @@ namespace socket
     }
 
     // ----------------------------------------------------------------------
-    void SocketClientConnection::process_raw_incoming_data(std::string &data)
+    void SocketClientConnection::process_raw_incoming_data(
+        const char *data_ptr,
+        const size_t data_size)
     {
-        if (not data.empty())
-        {
-            size_t line_start_index = 0;
-            size_t line_end_index = 0;
-            std::string line;
-
-            // Remove any CRs, since those are not supposed to be there.
-            boost::replace_all(data, TELNET_CR, std::string());
-            incoming_text_buffer.append(data);
-            const size_t string_end_index = data.size() - 1;
+        SocketDecodeJob::RawLines lines;
 
-            while (line_start_index <= string_end_index)
-            {
-                line_end_index = incoming_text_buffer.find(
-                    TELNET_LF,
-                    line_start_index);
-
-                if (line_end_index == std::string::npos)
-                {
-                    // No more full lines left.
-                    // Confirm the line is not too long.
-                    //
-                    if ((data.size() - line_start_index) > MAX_CLIENT_LINE_SIZE)
-                    {
-                        LOG(warning, "socket", "process_raw_incoming_data",
-                            "Client " + client_source + " sent too long a line."
-                            "  Disconnecting.");
-
-                        line_start_index =  std::string::npos;
-                        line_end_index = std::string::npos;
-
-                        disconnect_socket();
-                    }
-
-                    break;
-                }
-                else
-                {
-                    // Found a full line.
-                    line = incoming_text_buffer.substr(
-                        line_start_index,
-                        line_end_index - line_start_index);
-
-                    // Convert into ExternalTextLine
-                    //
-                    line = text::convert_extended_to_utf8(line);
-                    text::ExternalTextLine *external_text_line_ptr =
-                        new text::ExternalTextLine(
-                            text::ExternalTextConverter::to_external(line));
+        incoming_splitter.split(data_ptr, data_size, lines);
 
-                    command_processor.process_input(external_text_line_ptr);
-                    ++ack_lines_received_from_client;
+        // Confirm the line still coming in is not too long.
+        //
+        if (incoming_splitter.get_partial_size() > MAX_CLIENT_LINE_SIZE)
+        {
+            LOG(warning, "socket", "process_raw_incoming_data",
+                "Client " + client_source + " sent too long a line."
+                "  Disconnecting.");
 
-                    line_start_index = line_end_index + 1;
-                }
-            }
+            incoming_splitter.clear();
+            disconnect_socket();
+        }
 
-            // Processed as many full lines as available.  Shift the used
-            // characters out of the buffer.
+        if (not lines.empty())
+        {
+            // Stay alive until the decoded lines come back.  They're
+            // converted into ExternalTextLines by the decode pool.
             //
-            if (line_start_index > string_end_index)
-            {
-                // Used all characters.
-                incoming_text_buffer.clear();
-            }
-            else if (line_start_index and
-                (line_end_index == std::string::npos))
-            {
-                // Used only some characters.
-                incoming_text_buffer.erase(0, line_start_index);
-            }
+            driver_ptr->add_reference(this);
+            ++decodes_pending;
+
+            driver_ptr->get_decode_pool().submit(
+                decode_shard,
+                new SocketDecodeJob(this, lines));
         }
     }
 
@@ -10,6 +10,7 @@
 #include <vector>
 #include <deque>
 #include <map>
+#include <chrono>
 #include <stddef.h>
 
 #include <boost/shared_ptr.hpp>
@@ -26,6 +27,9 @@
 #include "comminterface/comm_ClientConnection.h"
 
 #include "socket_CommandProcessor.h"
+#include "socket_SocketDecodeJob.h"
+#include "socket_TelnetLineSplitter.h"
+#include "socket_OutgoingTextQueue.h"
 
 namespace mutgos
 {
@@ -122,6 +126,26 @@ namespace socket
         SocketDriver *get_driver(void) const
         { return driver_ptr; }
 
+        /**
+         * @return How many bytes have been written to the socket so far.
+         */
+        MG_LongUnsignedInt get_bytes_sent(void) const
+        { return stats_bytes_sent; }
+
+        /**
+         * @return How many writes (each possibly of many lines) have been
+         * done to the socket so far.
+         */
+        MG_LongUnsignedInt get_writes_sent(void) const
+        { return stats_writes_sent; }
+
+        /**
+         * @return How many lines (or other pieces of text) have been written
+         * to the socket so far.
+         */
+        MG_LongUnsignedInt get_lines_sent(void) const
+        { return stats_lines_sent; }
+
         /**
          * @return The send and receive window sizes, in number of messages.
          */
@@ -324,12 +348,26 @@ namespace socket
          */
         void raw_data(const char *data_ptr, const size_t data_size);
 
+        /**
+         * Called back by SocketDecodeJob with the lines decoded from data
+         * given to raw_data(), in the order it was given.
+         * @param lines[in,out] The lines decoded.  Control of the pointers
+         * passes to this method, and the vector will be cleared.
+         */
+        void input_decoded(SocketDecodeJob::TextLines &lines);
+
         /**
          * Called by the raw connection class instance when the timer
          * has expired.
          */
         void raw_timer_expired(void);
 
+        /**
+         * Called by the raw connection class instance when the flush timer
+         * has expired.
+         */
+        void raw_flush_timer_expired(void);
+
         /**
          * Sets whether or not ANSI is enabled.
          * @param enabled[in] True if enabled, false to strip out ANSI color.
@@ -350,6 +388,21 @@ namespace socket
          */
         SendReturnCode send_text_line(const std::string &text);
 
+        /**
+         * Adds text to the end of outgoing_queue.  This does not check if
+         * blocked, etc.
+         * @param text[in] The text to add.
+         * @param add_newline[in] True to add a newline after the text.
+         */
+        void queue_outgoing(const std::string &text, const bool add_newline);
+
+        /**
+         * Starts writing everything in outgoing_queue to the socket, and
+         * unblocks the session if it was waiting for room in the queue.
+         * Must not be called while a write is in progress.
+         */
+        void send_outgoing(void);
+
         /**
          * Requests an immediate disconnect of the socket; internal states
          * and the session are updated as needed.  It is safe to call this
@@ -377,14 +430,17 @@ namespace socket
 
         /**
          * Given new incoming data (which may be only part of a line),
-         * determine if any complete lines have been created (combining with
-         * incoming_text_buffer as needed), and if so, pass them to
-         * process_incoming_line() after converting to UTF8 and
-         * ExternalTextLine.  Leftover data will be stored in the buffer.
-         * @param data[in,out] The raw data from the socket to process.  The
-         * data may be modified directly for efficiency.
+         * split out any complete lines (combining with the partial line
+         * from before as needed), and if so, submit them to the driver's
+         * DecodePool to be converted to UTF8 and ExternalTextLine.
+         * Leftover data is kept by incoming_splitter.
+         * @param data_ptr[in] The raw data from the socket to process.  It
+         * is only copied as complete lines or a leftover partial line.
+         * @param data_size[in] The size of data_ptr.
          */
-        void process_raw_incoming_data(std::string &data);
+        void process_raw_incoming_data(
+            const char *data_ptr,
+            const size_t data_size);
 
         /**
          * The incoming ser ID is not really used for anything, but having
@@ -418,13 +474,25 @@ namespace socket
         bool client_connected; ///< True if socket is currently connected.
         bool client_do_reconnect; ///< True if reconnect procedure is required
         bool requested_service; ///< True if services has been requested on the driver
+        bool disconnect_pending; ///< True if raw_disconnected() is waiting for decodes to finish
+
+        MG_UnsignedInt decode_shard; ///< The DecodePool shard our input is decoded on
+        MG_UnsignedInt decodes_pending; ///< Input submitted but not yet back from decoding
 
         // Client configuration
         bool config_ansi_enabled;
 
-        std::string outgoing_text_buffer; ///< Buffer/queue of outgoing data
+        OutgoingTextQueue outgoing_queue; ///< Outgoing text not yet being sent
+        std::chrono::steady_clock::time_point outgoing_queue_start; ///< When the oldest text in outgoing_queue was added
+        OutgoingTextQueue outgoing_sending; ///< Outgoing text currently being written to the socket
+        OutgoingTextQueue::Buffers outgoing_buffers; ///< Scatter-gather list for outgoing_sending
+        bool write_in_progress; ///< True if outgoing_sending is being written
+        bool flush_timer_set; ///< True if waiting on the flush timer to send
+        MG_LongUnsignedInt stats_bytes_sent; ///< Bytes written to the socket
+        MG_LongUnsignedInt stats_writes_sent; ///< Writes done to the socket
+        MG_LongUnsignedInt stats_lines_sent; ///< Lines written to the socket
         std::string outgoing_control_buffer; ///< Temporary buffer/queue of outgoing responses from control commands
-        std::string incoming_text_buffer; ///< Buffered partial incoming line
+        TelnetLineSplitter incoming_splitter; ///< Splits incoming data into lines
 
         PendingSerialIds pending_serial_ids; ///< Outgoing message serial IDs that have yet to be ACKed
         MG_LongUnsignedInt pending_ids_message_size; ///< Size of encoded messages from pending_serial_ids added up
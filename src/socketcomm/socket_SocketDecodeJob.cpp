@@ -0,0 +1,63 @@
+/*
+ * socket_SocketDecodeJob.cpp
+ */
+
+#include <string>
+#include <vector>
+
+#include "text/text_Utf8Tools.h"
+#include "text/text_ExternalTextConverter.h"
+#include "text/text_ExternalText.h"
+
+#include "socket_SocketDecodeJob.h"
+#include "socket_SocketClientConnection.h"
+
+namespace mutgos
+{
+namespace socket
+{
+    // ----------------------------------------------------------------------
+    SocketDecodeJob::SocketDecodeJob(
+        SocketClientConnection *connection_ptr,
+        RawLines &lines)
+      : client_connection_ptr(connection_ptr)
+    {
+        raw_lines.swap(lines);
+    }
+
+    // ----------------------------------------------------------------------
+    SocketDecodeJob::~SocketDecodeJob()
+    {
+        for (TextLines::iterator line_iter = text_lines.begin();
+            line_iter != text_lines.end();
+            ++line_iter)
+        {
+            text::ExternalText::clear_text_line(**line_iter);
+            delete *line_iter;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SocketDecodeJob::decode(void)
+    {
+        text_lines.reserve(raw_lines.size());
+
+        for (RawLines::const_iterator line_iter = raw_lines.begin();
+            line_iter != raw_lines.end();
+            ++line_iter)
+        {
+            text_lines.push_back(new text::ExternalTextLine(
+                text::ExternalTextConverter::to_external(
+                    text::convert_extended_to_utf8(*line_iter))));
+        }
+
+        raw_lines.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    void SocketDecodeJob::decoded(void)
+    {
+        client_connection_ptr->input_decoded(text_lines);
+    }
+}
+}
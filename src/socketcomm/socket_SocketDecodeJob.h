@@ -0,0 +1,74 @@
+/*
+ * socket_SocketDecodeJob.h
+ */
+
+#ifndef MUTGOS_SOCKET_SOCKETDECODEJOB_H
+#define MUTGOS_SOCKET_SOCKETDECODEJOB_H
+
+#include <string>
+#include <vector>
+
+#include "text/text_ExternalText.h"
+
+#include "comminterface/comm_DecodeJob.h"
+
+namespace mutgos
+{
+namespace socket
+{
+    // Forward declarations
+    //
+    class SocketClientConnection;
+
+    /**
+     * Decodes complete lines of text from a socket client: converts them
+     * to UTF8 and then to ExternalTextLines.  The lines are then handed
+     * to the SocketClientConnection to process.
+     */
+    class SocketDecodeJob : public comm::DecodeJob
+    {
+    public:
+        typedef std::vector<std::string> RawLines;
+        typedef std::vector<text::ExternalTextLine *> TextLines;
+
+        /**
+         * Constructor.  The caller must hold a reference to the connection
+         * (see SocketDriver::add_reference()), which will be released
+         * once the connection has been called back.
+         * @param connection_ptr[in] The connection the lines came from.
+         * @param lines[in,out] The lines to decode, without newlines.  The
+         * contents will be swapped out to avoid copies.
+         */
+        SocketDecodeJob(
+            SocketClientConnection *connection_ptr,
+            RawLines &lines);
+
+        /**
+         * Destructor.  Cleans up anything not handed to the connection.
+         */
+        virtual ~SocketDecodeJob();
+
+        /**
+         * Converts the lines.
+         */
+        virtual void decode(void);
+
+        /**
+         * Hands the converted lines to the connection.
+         */
+        virtual void decoded(void);
+
+    private:
+        // No copying
+        //
+        SocketDecodeJob &operator=(const SocketDecodeJob &rhs);
+        SocketDecodeJob(const SocketDecodeJob &rhs);
+
+        SocketClientConnection * const client_connection_ptr; ///< Where the lines came from
+        RawLines raw_lines; ///< The lines to decode, until decoded
+        TextLines text_lines; ///< Lines decoded, in order
+    };
+}
+}
+
+#endif //MUTGOS_SOCKET_SOCKETDECODEJOB_H
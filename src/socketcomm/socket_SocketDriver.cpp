@@ -14,6 +14,14 @@
 #include "socket_SocketClientConnection.h"
 #include "socket_ConnectionListener.h"
 
+namespace
+{
+    // TODO make data driven
+
+    /** Threads to decode input on, or 0 for one less than the cores */
+    const unsigned int DECODE_THREAD_COUNT = 0;
+}
+
 namespace mutgos
 {
 namespace socket
@@ -22,7 +30,8 @@ namespace socket
     SocketDriver::SocketDriver(
         mutgos::comm::RouterSessionManager *router)
         : my_router_ptr(router),
-          io_context{1},
+          io_context(router->get_io_context()),
+          decode_pool(router),
           started(false)
     {
         if (not my_router_ptr)
@@ -40,6 +49,12 @@ namespace socket
                 "Destructed without calling stop()!");
         }
 
+        // Hand back any input still being decoded now, while the
+        // connections it references can still be released.
+        //
+        decode_pool.stop();
+        decode_pool.deliver_decoded();
+
         if (not client_connections.empty())
         {
             LOG(error, "socket", "~SocketDriver",
@@ -63,6 +78,8 @@ namespace socket
             const unsigned short port = 7072;
 
 
+            decode_pool.start(DECODE_THREAD_COUNT);
+
             started = boost::make_shared<ConnectionListener>(
                 this,
                 io_context,
@@ -94,6 +111,11 @@ namespace socket
                 connection_iter->first->stop();
             }
 
+            // Let input already read be decoded and delivered with the
+            // other work below.
+            //
+            decode_pool.stop();
+
             for (MG_UnsignedInt count = 0; count < 5; ++count)
             {
                 if (not do_work(router_ptr))
@@ -103,8 +125,6 @@ namespace socket
                 }
             }
 
-            io_context.stop();
-
             started = false;
             LOG(info, "socket", "stop", "Socket Driver stopped");
         }
@@ -121,6 +141,12 @@ namespace socket
             // First, run the IO Context to service anything.
             done = not io_context.poll();
 
+            // Next, hand back decoded input.
+            if (decode_pool.deliver_decoded())
+            {
+                done = false;
+            }
+
             // Then, service the pending actions.
             for (PendingActions::iterator actions_iter = pending_actions.begin();
                  actions_iter != pending_actions.end();
@@ -189,6 +215,7 @@ namespace socket
         if (connection_ptr)
         {
             pending_actions.push_back(connection_ptr);
+            my_router_ptr->wakeup();
         }
     }
 }
@@ -0,0 +1,194 @@
+/*
+ * socket_TelnetLineSplitter.cpp
+ */
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+#include "socket_TelnetLineSplitter.h"
+
+namespace
+{
+    const unsigned char TELNET_LF = '\n';
+    const unsigned char TELNET_CR = '\r';
+
+    const unsigned char TELNET_IAC = 255;
+    const unsigned char TELNET_SB = 250;
+    const unsigned char TELNET_SE = 240;
+    /** WILL, WONT, DO, and DONT are 251 - 254, and take an option */
+    const unsigned char TELNET_FIRST_OPTION_CMD = 251;
+}
+
+namespace mutgos
+{
+namespace socket
+{
+    // ----------------------------------------------------------------------
+    TelnetLineSplitter::TelnetLineSplitter(void)
+      : telnet_state(TELNET_STATE_DATA)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    void TelnetLineSplitter::split(
+        const char *data_ptr,
+        const size_t data_size,
+        Lines &lines)
+    {
+        const char * const data_end_ptr = data_ptr + data_size;
+        // Start of the characters in this read not yet copied anywhere.
+        // Only meaningful in TELNET_STATE_DATA.
+        const char *segment_start_ptr = data_ptr;
+        const char *current_ptr = data_ptr;
+
+        while (current_ptr < data_end_ptr)
+        {
+            if (telnet_state == TELNET_STATE_DATA)
+            {
+                current_ptr = find_special(current_ptr, data_end_ptr);
+            }
+
+            if (current_ptr < data_end_ptr)
+            {
+                const unsigned char current_char = *current_ptr;
+
+                if (telnet_state == TELNET_STATE_DATA)
+                {
+                    if (current_char == TELNET_LF)
+                    {
+                        // Found a full line.  A CR right before it is just
+                        // left off.
+                        //
+                        const char *line_end_ptr = current_ptr;
+
+                        if ((line_end_ptr > segment_start_ptr) and
+                            (*(line_end_ptr - 1) == TELNET_CR))
+                        {
+                            --line_end_ptr;
+                        }
+
+                        lines.push_back(std::string());
+                        lines.back().swap(partial_line);
+                        lines.back().append(segment_start_ptr, line_end_ptr);
+
+                        segment_start_ptr = current_ptr + 1;
+                    }
+                    else if (current_char == TELNET_CR)
+                    {
+                        // Any CR not right before a LF has to be cut out.
+                        //
+                        if (((current_ptr + 1) == data_end_ptr) or
+                            (*(current_ptr + 1) != TELNET_LF))
+                        {
+                            partial_line.append(segment_start_ptr, current_ptr);
+                            segment_start_ptr = current_ptr + 1;
+                        }
+                    }
+                    else if (current_char == TELNET_IAC)
+                    {
+                        partial_line.append(segment_start_ptr, current_ptr);
+                        telnet_state = TELNET_STATE_IAC;
+                    }
+                }
+                else if (telnet_state == TELNET_STATE_IAC)
+                {
+                    if (current_char == TELNET_IAC)
+                    {
+                        // Escaped 0xFF; keep the second one as data.
+                        segment_start_ptr = current_ptr;
+                        telnet_state = TELNET_STATE_DATA;
+                    }
+                    else if (current_char >= TELNET_FIRST_OPTION_CMD)
+                    {
+                        telnet_state = TELNET_STATE_OPTION;
+                    }
+                    else if (current_char == TELNET_SB)
+                    {
+                        telnet_state = TELNET_STATE_SUBNEG;
+                    }
+                    else
+                    {
+                        // Two character command.  Nothing is done with it.
+                        segment_start_ptr = current_ptr + 1;
+                        telnet_state = TELNET_STATE_DATA;
+                    }
+                }
+                else if (telnet_state == TELNET_STATE_OPTION)
+                {
+                    // Options are not negotiated, so it is ignored.
+                    segment_start_ptr = current_ptr + 1;
+                    telnet_state = TELNET_STATE_DATA;
+                }
+                else if (telnet_state == TELNET_STATE_SUBNEG)
+                {
+                    if (current_char == TELNET_IAC)
+                    {
+                        telnet_state = TELNET_STATE_SUBNEG_IAC;
+                    }
+                }
+                else
+                {
+                    // TELNET_STATE_SUBNEG_IAC
+                    //
+                    if (current_char == TELNET_SE)
+                    {
+                        segment_start_ptr = current_ptr + 1;
+                        telnet_state = TELNET_STATE_DATA;
+                    }
+                    else
+                    {
+                        telnet_state = TELNET_STATE_SUBNEG;
+                    }
+                }
+
+                ++current_ptr;
+            }
+        }
+
+        // Keep the start of the next line for the next read.
+        //
+        if (telnet_state == TELNET_STATE_DATA)
+        {
+            partial_line.append(segment_start_ptr, data_end_ptr);
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    const char *TelnetLineSplitter::find_special(
+        const char *start_ptr,
+        const char *end_ptr)
+    {
+        // The LF bounds the other searches, so each character of a line
+        // is only looked at a few times.
+        //
+        const void *found_ptr =
+            memchr(start_ptr, TELNET_LF, end_ptr - start_ptr);
+        const char *special_ptr =
+            found_ptr ? (const char *) found_ptr : end_ptr;
+
+        found_ptr = memchr(start_ptr, TELNET_CR, special_ptr - start_ptr);
+
+        if (found_ptr)
+        {
+            special_ptr = (const char *) found_ptr;
+        }
+
+        found_ptr = memchr(start_ptr, TELNET_IAC, special_ptr - start_ptr);
+
+        if (found_ptr)
+        {
+            special_ptr = (const char *) found_ptr;
+        }
+
+        return special_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void TelnetLineSplitter::clear(void)
+    {
+        partial_line.clear();
+        telnet_state = TELNET_STATE_DATA;
+    }
+}
+}
@@ -0,0 +1,97 @@
+/*
+ * socket_TelnetLineSplitter.h
+ */
+
+#ifndef MUTGOS_SOCKET_TELNETLINESPLITTER_H
+#define MUTGOS_SOCKET_TELNETLINESPLITTER_H
+
+#include <string>
+#include <vector>
+
+namespace mutgos
+{
+namespace socket
+{
+    /**
+     * Splits raw data from a telnet socket into lines.  The data is scanned
+     * where it was read into, and a string is only made once a line is
+     * complete; the only thing copied ahead of time is a partial line left
+     * over at the end of a read.
+     *
+     * CRs are removed, and telnet commands (IAC ...) are skipped, including
+     * option negotiation and subnegotiation.  IAC IAC is kept as a single
+     * 0xFF character.  Commands split across reads are handled.
+     *
+     * This class is not thread safe.
+     */
+    class TelnetLineSplitter
+    {
+    public:
+        typedef std::vector<std::string> Lines;
+
+        /**
+         * Constructor.
+         */
+        TelnetLineSplitter(void);
+
+        /**
+         * Splits newly read data into lines.
+         * @param data_ptr[in] The data read from the socket.  It is not
+         * referenced after this returns.
+         * @param data_size[in] The size of the data.
+         * @param lines[out] Each line completed by the data is appended,
+         * in order, without the line ending.
+         */
+        void split(
+            const char *data_ptr,
+            const size_t data_size,
+            Lines &lines);
+
+        /**
+         * @return How many characters of the current line have been
+         * received so far.
+         */
+        size_t get_partial_size(void) const
+          { return partial_line.size(); }
+
+        /**
+         * Throws away the partial line and any telnet command in progress.
+         */
+        void clear(void);
+
+    private:
+        /**
+         * Where in the telnet protocol the next character is.
+         */
+        enum TelnetState
+        {
+            /** Normal characters */
+            TELNET_STATE_DATA,
+            /** Character after an IAC */
+            TELNET_STATE_IAC,
+            /** Option after WILL, WONT, DO, or DONT */
+            TELNET_STATE_OPTION,
+            /** Inside a subnegotiation */
+            TELNET_STATE_SUBNEG,
+            /** Character after an IAC inside a subnegotiation */
+            TELNET_STATE_SUBNEG_IAC
+        };
+
+        /**
+         * Finds the next character that has to be handled in
+         * TELNET_STATE_DATA: a LF, CR, or IAC.
+         * @param start_ptr[in] Where to start looking.
+         * @param end_ptr[in] One past the last character to look at.
+         * @return The character found, or end_ptr if none.
+         */
+        static const char *find_special(
+            const char *start_ptr,
+            const char *end_ptr);
+
+        std::string partial_line; ///< The current line, up to the last read
+        TelnetState telnet_state; ///< Protocol state as of the last read
+    };
+}
+}
+
+#endif //MUTGOS_SOCKET_TELNETLINESPLITTER_H
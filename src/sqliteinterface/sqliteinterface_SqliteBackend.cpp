@@ -4,9 +4,15 @@
 
 #include <stddef.h>
 #include <string>
+#include <map>
+#include <set>
+#include <algorithm>
 #include <sqlite3.h>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -25,6 +31,24 @@
 
 #include "logging/log_Logger.h"
 
+namespace
+{
+    // TODO make data driven
+    /** The database file to open */
+    const char * const DATABASE_FILE_NAME = "mutgos.db";
+    /** How many read-only connections to use for loads and searches */
+    const size_t READ_CONNECTION_POOL_SIZE = 4;
+    /** How many Entities get_entities_stmt loads per query */
+    const size_t GET_ENTITIES_BATCH_SIZE = 32;
+    /** user_version of a database whose Entity name index has been built */
+    const int NAME_INDEX_SCHEMA_VERSION = 1;
+    /** How many preloaded rows are handed to a worker thread at a time */
+    const size_t PRELOAD_CHUNK_SIZE = 256;
+    /** Most chunks of preloaded rows waiting to be deserialized */
+    const size_t PRELOAD_MAX_PENDING_CHUNKS = 16;
+    /** Most threads deserializing preloaded rows */
+    const unsigned int PRELOAD_MAX_THREADS = 4;
+}
 
 namespace mutgos
 {
@@ -33,13 +57,7 @@ namespace sqliteinterface
     // ----------------------------------------------------------------------
     SqliteBackend::SqliteBackend(void)
       : dbhandle_ptr(0),
-        list_sites_stmt(0),
         list_deleted_sites_stmt(0),
-        list_all_entities_site_stmt(0),
-        find_name_in_db_stmt(0),
-        find_name_type_in_db_stmt(0),
-        find_exact_name_type_in_db_stmt(0),
-        get_entity_type_stmt(0),
         undelete_site_stmt(0),
         next_site_id_stmt(0),
         insert_first_next_site_id_stmt(0),
@@ -47,9 +65,9 @@ namespace sqliteinterface
         insert_new_site_stmt(0),
         insert_first_site_entity_id_stmt(0),
         update_entity_stmt(0),
-        get_entity_stmt(0),
         delete_site_entities_stmt(0),
         delete_site_display_names_stmt(0),
+        delete_site_program_bytecode_stmt(0),
         get_next_deleted_entity_id_stmt(0),
         mark_deleted_id_used_stmt(0),
         get_next_entity_id_stmt(0),
@@ -57,9 +75,17 @@ namespace sqliteinterface
         add_entity_stmt(0),
         delete_entity_stmt(0),
         add_reuse_entity_id_stmt(0),
+        delete_program_bytecode_stmt(0),
+        save_program_bytecode_stmt(0),
         mark_site_deleted_stmt(0),
         delete_all_site_entity_id_reuse_stmt(0),
-        delete_site_next_entity_id_stmt(0)
+        delete_site_next_entity_id_stmt(0),
+        begin_batch_stmt(0),
+        commit_batch_stmt(0),
+        rollback_batch_stmt(0),
+        in_batch(false),
+        batch_failed(false),
+        name_index_available(false)
     {
     }
 
@@ -80,8 +106,7 @@ namespace sqliteinterface
         {
             LOG(info, "sqliteinterface", "init", "Mounting database...");
 
-            // TODO Make database name data driven.
-            const int rc = sqlite3_open("mutgos.db", &dbhandle_ptr);
+            const int rc = sqlite3_open(DATABASE_FILE_NAME, &dbhandle_ptr);
             success = (rc == SQLITE_OK);
 
             if (success)
@@ -104,7 +129,9 @@ namespace sqliteinterface
                         0,
                         0,
                         0) == SQLITE_OK)
-                    and create_tables() and sql_init();
+                    and create_tables() and create_name_index()
+                    and create_accessed_index() and sql_init()
+                    and open_read_connections();
 
                 if (success)
                 {
@@ -135,27 +162,16 @@ namespace sqliteinterface
 
         if (success and dbhandle_ptr)
         {
-            sqlite3_finalize(list_sites_stmt);
-            list_sites_stmt = 0;
+            // Don't lose anything that was in the middle of being written.
+            commit_batch();
+
+            close_read_connections();
+            finalize_read_statements(write_read_connection);
+            write_read_connection.dbhandle_ptr = 0;
 
             sqlite3_finalize(list_deleted_sites_stmt);
             list_deleted_sites_stmt = 0;
 
-            sqlite3_finalize(list_all_entities_site_stmt);
-            list_all_entities_site_stmt = 0;
-
-            sqlite3_finalize(find_name_in_db_stmt);
-            find_name_in_db_stmt = 0;
-
-            sqlite3_finalize(find_name_type_in_db_stmt);
-            find_name_type_in_db_stmt = 0;
-
-            sqlite3_finalize(find_exact_name_type_in_db_stmt);
-            find_exact_name_type_in_db_stmt = 0;
-
-            sqlite3_finalize(get_entity_type_stmt);
-            get_entity_type_stmt = 0;
-
             sqlite3_finalize(undelete_site_stmt);
             undelete_site_stmt = 0;
 
@@ -177,15 +193,15 @@ namespace sqliteinterface
             sqlite3_finalize(update_entity_stmt);
             update_entity_stmt = 0;
 
-            sqlite3_finalize(get_entity_stmt);
-            get_entity_stmt = 0;
-
             sqlite3_finalize(delete_site_entities_stmt);
             delete_site_entities_stmt = 0;
 
             sqlite3_finalize(delete_site_display_names_stmt);
             delete_site_display_names_stmt = 0;
 
+            sqlite3_finalize(delete_site_program_bytecode_stmt);
+            delete_site_program_bytecode_stmt = 0;
+
             sqlite3_finalize(get_next_deleted_entity_id_stmt);
             get_next_deleted_entity_id_stmt = 0;
 
@@ -207,6 +223,12 @@ namespace sqliteinterface
             sqlite3_finalize(add_reuse_entity_id_stmt);
             add_reuse_entity_id_stmt = 0;
 
+            sqlite3_finalize(delete_program_bytecode_stmt);
+            delete_program_bytecode_stmt = 0;
+
+            sqlite3_finalize(save_program_bytecode_stmt);
+            save_program_bytecode_stmt = 0;
+
             sqlite3_finalize(mark_site_deleted_stmt);
             mark_site_deleted_stmt = 0;
 
@@ -216,6 +238,15 @@ namespace sqliteinterface
             sqlite3_finalize(delete_site_next_entity_id_stmt);
             delete_site_next_entity_id_stmt = 0;
 
+            sqlite3_finalize(begin_batch_stmt);
+            begin_batch_stmt = 0;
+
+            sqlite3_finalize(commit_batch_stmt);
+            commit_batch_stmt = 0;
+
+            sqlite3_finalize(rollback_batch_stmt);
+            rollback_batch_stmt = 0;
+
             success = (sqlite3_close(dbhandle_ptr) == SQLITE_OK);
 
             if (success)
@@ -258,6 +289,10 @@ namespace sqliteinterface
     {
         boost::lock_guard<boost::mutex> guard(mutex);
 
+        // The next ID must never be rolled back with a failed batch, or
+        // the ID could be given out twice.
+        const bool batch_suspended = suspend_batch();
+
         dbtype::Entity *entity_ptr = 0;
         dbtype::Id::EntityIdType entity_id = 0;
         int rc = SQLITE_OK;
@@ -409,11 +444,10 @@ namespace sqliteinterface
         if (entity_ptr)
         {
             concurrency::WriterLockToken token(*entity_ptr);
+            EntitySnapshot snapshot;
 
-            fatal_error = not bind_entity_update_params(
-                entity_ptr,
-                token,
-                add_entity_stmt);
+            fatal_error = not (snapshot_entity(entity_ptr, token, snapshot)
+                and bind_entity_update_params(snapshot, add_entity_stmt));
 
             if (sqlite3_bind_int(
                 add_entity_stmt,
@@ -457,6 +491,7 @@ namespace sqliteinterface
         }
 
         reset(add_entity_stmt);
+        resume_batch(batch_suspended);
 
         return entity_ptr;
     }
@@ -464,17 +499,18 @@ namespace sqliteinterface
     // ----------------------------------------------------------------------
     dbtype::Entity *SqliteBackend::get_entity_db(const dbtype::Id &id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
         dbtype::Entity *entity_ptr = get_entity_pointer(id);
 
         if (not entity_ptr)
         {
             // Not in memory, try and get it from the database
             //
+            ReadConnection * const connection_ptr = acquire_read_connection();
+            sqlite3_stmt * const stmt = connection_ptr->get_entity_stmt;
+
             if (sqlite3_bind_int(
-                get_entity_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$SITEID"),
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$SITEID"),
                 id.get_site_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_db",
@@ -482,8 +518,8 @@ namespace sqliteinterface
             }
 
             if (sqlite3_bind_int64(
-                get_entity_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$ENTITYID"),
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
                 id.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_db",
@@ -492,88 +528,410 @@ namespace sqliteinterface
 
             // Should be 0 or 1 lines
             //
-            if (sqlite3_step(get_entity_stmt) == SQLITE_ROW)
+            if (sqlite3_step(stmt) == SQLITE_ROW)
             {
                 // Entity exists.  Deserialize it.
+                entity_ptr = deserialize_entity_row(stmt, id);
+            }
+
+            reset(stmt);
+            release_read_connection(connection_ptr);
+
+            // The pool can't see a delete in the open batch, so the row
+            // may still be there.  Checked after reading so a delete made
+            // during the read is caught.
+            //
+            if (entity_ptr and is_batch_deleted(id))
+            {
+                delete entity_ptr;
+                entity_ptr = 0;
+            }
+
+            // Put into lookup map.  If another thread loaded the same
+            // Entity while we were, use theirs instead.
+            //
+            if (entity_ptr and (not added_mem_owned(entity_ptr)))
+            {
+                delete entity_ptr;
+                entity_ptr = get_entity_pointer(id);
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::get_entities_db(
+        const dbtype::Entity::IdVector &ids,
+        EntityPtrVector &entities)
+    {
+        typedef std::map<dbtype::Id::EntityIdType, dbtype::Entity *> LoadedMap;
+
+        dbtype::Entity::IdVector ids_to_load;
+        LoadedMap loaded;
+
+        entities.clear();
+        entities.reserve(ids.size());
+
+        // Use what's already in memory first.
+        //
+        for (dbtype::Entity::IdVector::const_iterator id_iter = ids.begin();
+            id_iter != ids.end();
+            ++id_iter)
+        {
+            entities.push_back(get_entity_pointer(*id_iter));
+
+            if (not entities.back())
+            {
+                ids_to_load.push_back(*id_iter);
+            }
+        }
+
+        if (not ids_to_load.empty())
+        {
+            const dbtype::Id::SiteIdType site_id =
+                ids_to_load.front().get_site_id();
+            ReadConnection * const connection_ptr = acquire_read_connection();
+            sqlite3_stmt * const stmt = connection_ptr->get_entities_stmt;
+            const int site_index =
+                sqlite3_bind_parameter_index(stmt, "$SITEID");
+
+            for (size_t batch_start = 0;
+                batch_start < ids_to_load.size();
+                batch_start += GET_ENTITIES_BATCH_SIZE)
+            {
+                if (sqlite3_bind_int(stmt, site_index, site_id) != SQLITE_OK)
+                {
+                    LOG(error, "sqliteinterface", "get_entities_db",
+                        "For get_entities_stmt, could not bind $SITEID");
+                }
+
+                // Unused slots are left NULL, which matches nothing.
                 //
-                const int entity_type_int = sqlite3_column_int(get_entity_stmt, 0);
-                const void *blob_ptr = sqlite3_column_blob(get_entity_stmt, 1);
-                const int blob_size = sqlite3_column_bytes(get_entity_stmt, 1);
+                for (size_t slot = 0;
+                    (slot < GET_ENTITIES_BATCH_SIZE) and
+                        ((batch_start + slot) < ids_to_load.size());
+                    ++slot)
+                {
+                    if (sqlite3_bind_int64(
+                        stmt,
+                        site_index + 1 + slot,
+                        ids_to_load[batch_start + slot].get_entity_id())
+                            != SQLITE_OK)
+                    {
+                        LOG(error, "sqliteinterface", "get_entities_db",
+                            "For get_entities_stmt, could not bind entity ID");
+                    }
+                }
+
+                while (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    const dbtype::Id id(
+                        site_id,
+                        (dbtype::Id::EntityIdType)
+                            sqlite3_column_int64(stmt, 2));
 
-                if ((not blob_ptr) or (blob_size <= 0))
+                    if (loaded.find(id.get_entity_id()) == loaded.end())
+                    {
+                        loaded[id.get_entity_id()] =
+                            deserialize_entity_row(stmt, id);
+                    }
+                }
+
+                reset(stmt);
+            }
+
+            release_read_connection(connection_ptr);
+
+            // Put into lookup map.  If another thread loaded the same
+            // Entity while we were, use theirs instead.  Entities deleted
+            // in the open batch are discarded, as in get_entity_db().
+            //
+            for (LoadedMap::iterator loaded_iter = loaded.begin();
+                loaded_iter != loaded.end();
+                ++loaded_iter)
+            {
+                if (loaded_iter->second and
+                    is_batch_deleted(dbtype::Id(site_id, loaded_iter->first)))
                 {
-                    LOG(error, "sqliteinterface", "get_entity_db",
-                        "No blob data for ID " + id.to_string(true));
+                    delete loaded_iter->second;
+                    loaded_iter->second = 0;
                 }
-                else
+
+                if (loaded_iter->second and
+                    (not added_mem_owned(loaded_iter->second)))
+                {
+                    delete loaded_iter->second;
+                    loaded_iter->second = get_entity_pointer(
+                        dbtype::Id(site_id, loaded_iter->first));
+                }
+            }
+
+            for (size_t index = 0; index < ids.size(); ++index)
+            {
+                if (not entities[index])
+                {
+                    LoadedMap::const_iterator loaded_iter =
+                        loaded.find(ids[index].get_entity_id());
+
+                    if (loaded_iter != loaded.end())
+                    {
+                        entities[index] = loaded_iter->second;
+                    }
+                }
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::get_preload_entities_db(
+        const dbtype::Id::SiteIdType site_id,
+        const EntityTypeVector &types,
+        const size_t recent_count,
+        const size_t max_bytes,
+        EntityPtrVector &entities)
+    {
+        std::string types_str;
+        size_t bytes_read = 0;
+        std::vector<PreloadRows *> chunks;
+        PreloadState state;
+        boost::thread_group workers;
+        const unsigned int worker_count = std::max(
+            1U,
+            std::min(PRELOAD_MAX_THREADS, boost::thread::hardware_concurrency()));
+
+        entities.clear();
+
+        // Types are integers, so they can safely go directly in the SQL.
+        //
+        for (EntityTypeVector::const_iterator type_iter = types.begin();
+            type_iter != types.end();
+            ++type_iter)
+        {
+            if (not types_str.empty())
+            {
+                types_str += ", ";
+            }
+
+            types_str += text::to_string((int) *type_iter);
+        }
+
+        const std::string preload_str =
+            "SELECT type, data, entity_id FROM entities "
+            "WHERE site_id = $SITEID AND (type IN (" + types_str + ") OR "
+              "entity_id IN (SELECT entity_id FROM entities "
+                "WHERE site_id = $SITEID ORDER BY accessed DESC "
+                "LIMIT $RECENTCOUNT)) "
+            "ORDER BY accessed DESC;";
+
+        ReadConnection * const connection_ptr = acquire_read_connection();
+        sqlite3_stmt *stmt = 0;
+
+        if (sqlite3_prepare_v2(
+            connection_ptr->dbhandle_ptr,
+            preload_str.c_str(),
+            -1,
+            &stmt,
+            0) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "get_preload_entities_db",
+                "Failed prepared statement for preloading Entities: "
+                + std::string(sqlite3_errmsg(connection_ptr->dbhandle_ptr)));
+        }
+        else
+        {
+            if (sqlite3_bind_int(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$SITEID"),
+                site_id) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "get_preload_entities_db",
+                    "For preload statement, could not bind $SITEID");
+            }
+
+            if (sqlite3_bind_int64(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$RECENTCOUNT"),
+                recent_count) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "get_preload_entities_db",
+                    "For preload statement, could not bind $RECENTCOUNT");
+            }
+
+            for (unsigned int index = 0; index < worker_count; ++index)
+            {
+                workers.create_thread(boost::bind(
+                    &SqliteBackend::preload_worker,
+                    this,
+                    boost::ref(state)));
+            }
+
+            // Stream the rows to the workers a chunk at a time, pausing if
+            // they fall too far behind.
+            //
+            PreloadRows *chunk_ptr = 0;
+            bool more_rows = true;
+
+            while (more_rows)
+            {
+                // Rows past the budget would only be freed again by the
+                // cache, so don't spend the time reading them.
+                //
+                more_rows = (bytes_read < max_bytes) and
+                    (sqlite3_step(stmt) == SQLITE_ROW);
+
+                if (more_rows)
                 {
-                    const dbtype::EntityType entity_type =
-                        (dbtype::EntityType) entity_type_int;
+                    if (not chunk_ptr)
+                    {
+                        chunk_ptr = new PreloadRows();
+                        chunk_ptr->reserve(PRELOAD_CHUNK_SIZE);
+                    }
+
+                    chunk_ptr->push_back(PreloadRow());
+
+                    PreloadRow &row = chunk_ptr->back();
 
-                    utility::MemoryBuffer buffer(blob_ptr, blob_size);
-                    entity_ptr = make_deserialize_entity(entity_type, buffer);
+                    row.id = dbtype::Id(
+                        site_id,
+                        (dbtype::Id::EntityIdType)
+                            sqlite3_column_int64(stmt, 2));
+                    row.type = (dbtype::EntityType) sqlite3_column_int(stmt, 0);
+                    row.entity_ptr = get_entity_pointer(row.id);
+                    row.already_loaded = (row.entity_ptr != 0);
 
-                    if (not entity_ptr)
+                    if (not row.already_loaded)
                     {
-                        LOG(error, "sqliteinterface", "get_entity_db",
-                            "Unknown type to deserialize: "
-                              + dbtype::entity_type_to_string(entity_type)
-                              + "  ID: " + id.to_string(true));
+                        const char *blob_ptr =
+                            (const char *) sqlite3_column_blob(stmt, 1);
+                        const int blob_size = sqlite3_column_bytes(stmt, 1);
+
+                        if (blob_ptr and (blob_size > 0))
+                        {
+                            row.data.assign(blob_ptr, blob_size);
+                            bytes_read += blob_size;
+                        }
                     }
-                    else
+                }
+
+                if (chunk_ptr and ((not more_rows) or
+                    (chunk_ptr->size() >= PRELOAD_CHUNK_SIZE)))
+                {
+                    chunks.push_back(chunk_ptr);
+
+                    boost::unique_lock<boost::mutex> lock(state.mutex);
+
+                    while (state.pending_chunks.size() >=
+                        PRELOAD_MAX_PENDING_CHUNKS)
                     {
-                        // Put into lookup map
-                        added_mem_owned(entity_ptr);
+                        state.condition.wait(lock);
                     }
+
+                    state.pending_chunks.push_back(chunk_ptr);
+                    state.condition.notify_all();
+                    chunk_ptr = 0;
                 }
             }
+        }
 
-            reset(get_entity_stmt);
+        // Scope for lock
+        {
+            boost::lock_guard<boost::mutex> guard(state.mutex);
+            state.done_reading = true;
+            state.condition.notify_all();
         }
 
-        return entity_ptr;
+        workers.join_all();
+        sqlite3_finalize(stmt);
+        release_read_connection(connection_ptr);
+
+        // Put into lookup map, in order.  If another thread loaded the same
+        // Entity while we were, use theirs instead.
+        //
+        for (std::vector<PreloadRows *>::iterator chunk_iter = chunks.begin();
+            chunk_iter != chunks.end();
+            ++chunk_iter)
+        {
+            for (PreloadRows::iterator row_iter = (*chunk_iter)->begin();
+                row_iter != (*chunk_iter)->end();
+                ++row_iter)
+            {
+                if ((not row_iter->already_loaded) and row_iter->entity_ptr and
+                    (not added_mem_owned(row_iter->entity_ptr)))
+                {
+                    delete row_iter->entity_ptr;
+                    row_iter->entity_ptr = get_entity_pointer(row_iter->id);
+                }
+
+                if (row_iter->entity_ptr)
+                {
+                    entities.push_back(row_iter->entity_ptr);
+                }
+            }
+
+            delete *chunk_iter;
+        }
     }
 
     // ----------------------------------------------------------------------
     bool SqliteBackend::save_entity_db(dbtype::Entity *entity_ptr)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-
         bool success = entity_ptr and is_mem_owned(entity_ptr);
 
         if (success)
         {
-            concurrency::WriterLockToken token(*entity_ptr);
+            EntitySnapshot snapshot;
 
-            success = bind_entity_update_params(
-                entity_ptr,
-                token,
-                update_entity_stmt);
-
-            if (not success)
+            // Serialize before locking the database, so loads and searches
+            // are not held up while a large Entity is being serialized.
+            // Only a read lock is needed, and it is released before the
+            // database is locked so the Entity can be used during the write.
+            //
+            // Scope for lock
             {
-                LOG(error, "sqliteinterface", "save_entity_db",
-                    "Could not save entity!");
+                concurrency::ReaderLockToken token(*entity_ptr);
+
+                success = snapshot_entity(entity_ptr, token, snapshot);
             }
 
             if (success)
             {
-                const int rc = sqlite3_step(update_entity_stmt);
+                boost::lock_guard<boost::mutex> guard(mutex);
 
-                if (rc != SQLITE_DONE)
-                {
-                    LOG(error, "sqliteinterface", "save_entity_db",
-                        "Could not update Entity: "
-                        + std::string(sqlite3_errstr(rc)));
-                    success = false;
-                }
-                else
+                success = bind_entity_update_params(
+                    snapshot,
+                    update_entity_stmt);
+
+                if (success)
                 {
-                    entity_ptr->clear_dirty(token);
+                    const int rc = sqlite3_step(update_entity_stmt);
+
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(error, "sqliteinterface", "save_entity_db",
+                            "Could not update Entity: "
+                            + std::string(sqlite3_errstr(rc)));
+                        success = false;
+                    }
                 }
+
+                reset(update_entity_stmt);
             }
 
-            reset(update_entity_stmt);
+            if (success)
+            {
+                // If the Entity changed while it was being written, it
+                // stays dirty so the changes are saved later.
+                //
+                concurrency::WriterLockToken token(*entity_ptr);
+
+                entity_ptr->clear_dirty(token, snapshot.dirty_serial);
+            }
+            else
+            {
+                LOG(error, "sqliteinterface", "save_entity_db",
+                    "Could not save entity!");
+            }
         }
 
         return success;
@@ -627,6 +985,40 @@ namespace sqliteinterface
 
             if (delete_good)
             {
+                // Loads on the pool still see the row until the batch is
+                // committed.  Outside a batch it's gone now, even if an
+                // earlier batch deleting it failed.
+                //
+                boost::lock_guard<boost::mutex> deleted_guard(
+                    batch_deleted_mutex);
+
+                if (in_batch)
+                {
+                    batch_deleted_ids.insert(id);
+                }
+                else
+                {
+                    batch_deleted_ids.erase(id);
+                }
+            }
+
+            if (delete_good)
+            {
+                // Only Programs have bytecode, but checking the type costs
+                // more than a delete that finds nothing.
+                //
+                bind_site_entity_id(delete_program_bytecode_stmt, id);
+                rc = sqlite3_step(delete_program_bytecode_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "delete_entity_db",
+                        "Could not delete Program bytecode: "
+                        + std::string(sqlite3_errstr(rc)));
+                }
+
+                reset(delete_program_bytecode_stmt);
+
                 // Delete worked, add ID into table for future reuse
                 //
                 if (sqlite3_bind_int(
@@ -668,7 +1060,6 @@ namespace sqliteinterface
     {
         dbtype::EntityType entity_type = dbtype::ENTITYTYPE_invalid;
 
-        boost::lock_guard<boost::mutex> guard(mutex);
         dbtype::Entity * const entity_ptr = get_entity_pointer(id);
 
         if (entity_ptr)
@@ -680,9 +1071,12 @@ namespace sqliteinterface
         {
             // Not in cache, try and get it from the database
             //
+            ReadConnection * const connection_ptr = acquire_read_connection();
+            sqlite3_stmt * const stmt = connection_ptr->get_entity_type_stmt;
+
             if (sqlite3_bind_int(
-                get_entity_type_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$SITEID"),
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$SITEID"),
                 id.get_site_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_type_db",
@@ -690,8 +1084,8 @@ namespace sqliteinterface
             }
 
             if (sqlite3_bind_int64(
-                get_entity_type_stmt,
-                sqlite3_bind_parameter_index(get_entity_stmt, "$ENTITYID"),
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
                 id.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "get_entity_type_db",
@@ -700,17 +1094,17 @@ namespace sqliteinterface
 
             // Should be 0 or 1 lines
             //
-            if (sqlite3_step(get_entity_type_stmt) == SQLITE_ROW)
+            if (sqlite3_step(stmt) == SQLITE_ROW)
             {
                 // Entity exists.  Get the type.
                 //
-                const int entity_type_int =
-                    sqlite3_column_int(get_entity_type_stmt, 0);
+                const int entity_type_int = sqlite3_column_int(stmt, 0);
 
                 entity_type = (dbtype::EntityType) entity_type_int;
             }
 
-            reset(get_entity_type_stmt);
+            reset(stmt);
+            release_read_connection(connection_ptr);
         }
 
         return entity_type;
@@ -724,13 +1118,13 @@ namespace sqliteinterface
         const bool exact)
     {
         dbtype::Entity::IdVector result;
-        boost::lock_guard<boost::mutex> guard(mutex);
+        ReadConnection * const connection_ptr = acquire_read_connection(true);
 
-        sqlite3_stmt *stmt = find_name_type_in_db_stmt;
+        sqlite3_stmt *stmt = connection_ptr->find_name_type_in_db_stmt;
 
         if (exact)
         {
-            stmt = find_exact_name_type_in_db_stmt;
+            stmt = connection_ptr->find_exact_name_type_in_db_stmt;
         }
 
         if (sqlite3_bind_int(
@@ -765,6 +1159,7 @@ namespace sqliteinterface
         add_entity_ids(stmt, site_id, result);
 
         reset(stmt);
+        release_read_connection(connection_ptr);
 
         return result;
     }
@@ -774,12 +1169,13 @@ namespace sqliteinterface
         const dbtype::Id::SiteIdType site_id,
         const std::string &name)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
         dbtype::Entity::IdVector result;
+        ReadConnection * const connection_ptr = acquire_read_connection(true);
+        sqlite3_stmt * const stmt = connection_ptr->find_name_in_db_stmt;
 
         if (sqlite3_bind_int(
-            find_name_in_db_stmt,
-            sqlite3_bind_parameter_index(find_name_in_db_stmt, "$SITEID"),
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
             site_id) != SQLITE_OK)
         {
             LOG(error, "sqliteinterface", "find_in_db(name)",
@@ -787,8 +1183,8 @@ namespace sqliteinterface
         }
 
         if (sqlite3_bind_text(
-            find_name_in_db_stmt,
-            sqlite3_bind_parameter_index(find_name_in_db_stmt, "$NAME"),
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$NAME"),
             name.c_str(),
             name.size(),
             SQLITE_TRANSIENT) != SQLITE_OK)
@@ -797,9 +1193,10 @@ namespace sqliteinterface
                 "For find_name_in_db_stmt, could not bind $NAME");
         }
 
-        add_entity_ids(find_name_in_db_stmt, site_id, result);
+        add_entity_ids(stmt, site_id, result);
 
-        reset(find_name_in_db_stmt);
+        reset(stmt);
+        release_read_connection(connection_ptr);
 
         return result;
     }
@@ -808,21 +1205,58 @@ namespace sqliteinterface
     dbtype::Entity::IdVector SqliteBackend::find_in_db(
         const dbtype::Id::SiteIdType site_id)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
         dbtype::Entity::IdVector result;
+        ReadConnection * const connection_ptr = acquire_read_connection(true);
+        sqlite3_stmt * const stmt = connection_ptr->list_all_entities_site_stmt;
 
         if (sqlite3_bind_int(
-            list_all_entities_site_stmt,
-            sqlite3_bind_parameter_index(list_all_entities_site_stmt, "$SITEID"),
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
             site_id) != SQLITE_OK)
         {
             LOG(error, "sqliteinterface", "find_in_db(site)",
                 "For list_all_entities_site_stmt, could not bind $SITEID");
         }
 
-        add_entity_ids(list_all_entities_site_stmt, site_id, result);
+        add_entity_ids(stmt, site_id, result);
+
+        reset(stmt);
+        release_read_connection(connection_ptr);
+
+        return result;
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity::IdVector SqliteBackend::find_in_db(
+        const dbtype::Id::SiteIdType site_id,
+        const dbtype::EntityType type)
+    {
+        dbtype::Entity::IdVector result;
+        ReadConnection * const connection_ptr = acquire_read_connection(true);
+        sqlite3_stmt * const stmt = connection_ptr->list_type_entities_site_stmt;
+
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_in_db(site, type)",
+                "For list_type_entities_site_stmt, could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$TYPE"),
+            type) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "find_in_db(site, type)",
+                "For list_type_entities_site_stmt, could not bind $TYPE");
+        }
+
+        add_entity_ids(stmt, site_id, result);
 
-        reset(list_all_entities_site_stmt);
+        reset(stmt);
+        release_read_connection(connection_ptr);
 
         return result;
     }
@@ -830,16 +1264,17 @@ namespace sqliteinterface
     // ----------------------------------------------------------------------
     dbtype::Id::SiteIdVector SqliteBackend::get_site_ids_in_db(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
+        ReadConnection * const connection_ptr = acquire_read_connection(true);
+        sqlite3_stmt * const stmt = connection_ptr->list_sites_stmt;
 
         dbtype::Id::SiteIdVector result;
-        int rc = sqlite3_step(list_sites_stmt);
+        int rc = sqlite3_step(stmt);
 
         while (rc == SQLITE_ROW)
         {
             result.push_back(
-                (dbtype::Id::SiteIdType) sqlite3_column_int(list_sites_stmt, 0));
-            rc = sqlite3_step(list_sites_stmt);
+                (dbtype::Id::SiteIdType) sqlite3_column_int(stmt, 0));
+            rc = sqlite3_step(stmt);
         }
 
         if (rc != SQLITE_DONE)
@@ -849,7 +1284,8 @@ namespace sqliteinterface
                 + std::string(sqlite3_errstr(rc)));
         }
 
-        reset(list_sites_stmt);
+        reset(stmt);
+        release_read_connection(connection_ptr);
 
         return result;
     }
@@ -858,6 +1294,7 @@ namespace sqliteinterface
     bool SqliteBackend::new_site_in_db(dbtype::Id::SiteIdType &site_id)
     {
         boost::lock_guard<boost::mutex> guard(mutex);
+        const bool batch_suspended = suspend_batch();
 
         bool success = false;
         int rc = SQLITE_OK;
@@ -1054,6 +1491,8 @@ namespace sqliteinterface
             }
         }
 
+        resume_batch(batch_suspended);
+
         return success;
     }
 
@@ -1061,6 +1500,7 @@ namespace sqliteinterface
     bool SqliteBackend::delete_site_in_db(const dbtype::Id::SiteIdType site_id)
     {
         boost::lock_guard<boost::mutex> guard(mutex);
+        const bool batch_suspended = suspend_batch();
 
         bool success = delete_site_entity_data(site_id);
         int rc = SQLITE_OK;
@@ -1141,6 +1581,146 @@ namespace sqliteinterface
             reset(delete_site_next_entity_id_stmt);
         }
 
+        resume_batch(batch_suspended);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::begin_batch(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        bool success = not in_batch;
+
+        if (not success)
+        {
+            LOG(error, "sqliteinterface", "begin_batch",
+                "Batch already in progress.");
+        }
+        else
+        {
+            batch_failed = false;
+            success = begin_batch_transaction();
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::commit_batch(void)
+    {
+        boost::lock_guard<boost::mutex> guard(mutex);
+
+        const bool success = commit_batch_transaction() and (not batch_failed);
+
+        batch_failed = false;
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::get_program_bytecode_db(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        std::string &bytecode)
+    {
+        bool found = false;
+        ReadConnection * const connection_ptr = acquire_read_connection();
+        sqlite3_stmt * const stmt = connection_ptr->get_program_bytecode_stmt;
+
+        bytecode.clear();
+        bind_site_entity_id(stmt, id);
+
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            // Only usable if compiled from the same source.
+            //
+            const char * const source_ptr =
+                (const char *) sqlite3_column_text(stmt, 0);
+            const size_t source_size = sqlite3_column_bytes(stmt, 0);
+
+            if (source_ptr and (source_size == source_code.size()) and
+                (source_code.compare(0, source_size, source_ptr, source_size)
+                    == 0))
+            {
+                const char * const blob_ptr =
+                    (const char *) sqlite3_column_blob(stmt, 1);
+                const size_t blob_size = sqlite3_column_bytes(stmt, 1);
+
+                if (blob_ptr and blob_size)
+                {
+                    bytecode.assign(blob_ptr, blob_size);
+                    found = true;
+                }
+            }
+        }
+
+        reset(stmt);
+        release_read_connection(connection_ptr);
+
+        return found;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::save_program_bytecode_db(
+        const dbtype::Id &id,
+        const std::string &source_code,
+        const char * const bytecode_ptr,
+        const size_t bytecode_size)
+    {
+        bool success = bytecode_ptr and bytecode_size;
+
+        if (success)
+        {
+            boost::lock_guard<boost::mutex> guard(mutex);
+
+            bind_site_entity_id(save_program_bytecode_stmt, id);
+
+            if (sqlite3_bind_text(
+                save_program_bytecode_stmt,
+                sqlite3_bind_parameter_index(
+                    save_program_bytecode_stmt,
+                    "$SOURCE"),
+                source_code.c_str(),
+                source_code.size(),
+                SQLITE_STATIC) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "save_program_bytecode_db",
+                    "For save_program_bytecode_stmt, could not bind $SOURCE");
+                success = false;
+            }
+
+            if (sqlite3_bind_blob(
+                save_program_bytecode_stmt,
+                sqlite3_bind_parameter_index(
+                    save_program_bytecode_stmt,
+                    "$BYTECODE"),
+                bytecode_ptr,
+                bytecode_size,
+                SQLITE_STATIC) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "save_program_bytecode_db",
+                    "For save_program_bytecode_stmt, could not bind $BYTECODE");
+                success = false;
+            }
+
+            if (success)
+            {
+                const int rc = sqlite3_step(save_program_bytecode_stmt);
+
+                if (rc != SQLITE_DONE)
+                {
+                    LOG(error, "sqliteinterface", "save_program_bytecode_db",
+                        "Could not save bytecode: "
+                        + std::string(sqlite3_errstr(rc)));
+                    success = false;
+                }
+            }
+
+            reset(save_program_bytecode_stmt);
+        }
+
         return success;
     }
 
@@ -1156,6 +1736,7 @@ namespace sqliteinterface
             "version INTEGER NOT NULL,"
             "name TEXT NOT NULL COLLATE NOCASE,"
             "data BLOB NOT NULL,"
+            "accessed INTEGER NOT NULL DEFAULT 0,"
          "PRIMARY KEY(site_id, entity_id)) WITHOUT ROWID;"
          "CREATE INDEX IF NOT EXISTS entity_type_idx ON entities(site_id, name, type);"
 
@@ -1186,7 +1767,14 @@ namespace sqliteinterface
             "display_name TEXT NOT NULL COLLATE NOCASE,"
             "PRIMARY KEY(site_id, entity_id),"
             "FOREIGN KEY(site_id, entity_id) REFERENCES entities(site_id, entity_id)) WITHOUT ROWID;"
-         "CREATE INDEX IF NOT EXISTS display_name_player_idx ON display_names(site_id, player, name, display_name);";
+         "CREATE INDEX IF NOT EXISTS display_name_player_idx ON display_names(site_id, player, name, display_name);"
+
+         "CREATE TABLE IF NOT EXISTS program_bytecode("
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "source TEXT NOT NULL,"
+            "bytecode BLOB NOT NULL,"
+            "PRIMARY KEY(site_id, entity_id)) WITHOUT ROWID;";
 
         bool success = true;
         char *rc_error_str_ptr = 0;
@@ -1213,104 +1801,253 @@ namespace sqliteinterface
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::sql_init(void)
+    bool SqliteBackend::create_name_index(void)
     {
-        bool success = true;
+        // The entities table has no rowid, so entity_name_keys assigns one
+        // to each Entity for use as the rowid of its entry in entity_names.
+        //
+        const std::string create_index_str =
+         "CREATE TABLE IF NOT EXISTS entity_name_keys("
+            "name_key INTEGER PRIMARY KEY,"
+            "site_id INTEGER NOT NULL,"
+            "entity_id INTEGER NOT NULL,"
+            "UNIQUE(site_id, entity_id));"
+
+         "CREATE VIRTUAL TABLE IF NOT EXISTS entity_names USING fts5("
+            "name, site_id UNINDEXED, entity_id UNINDEXED, type UNINDEXED,"
+            "tokenize = 'trigram');"
+
+         "CREATE TRIGGER IF NOT EXISTS entity_names_insert "
+          "AFTER INSERT ON entities BEGIN "
+            "INSERT INTO entity_name_keys(site_id, entity_id) "
+              "VALUES (new.site_id, new.entity_id);"
+            "INSERT INTO entity_names(rowid, name, site_id, entity_id, type) "
+              "VALUES ((SELECT name_key FROM entity_name_keys WHERE "
+                "site_id = new.site_id AND entity_id = new.entity_id), "
+                "new.name, new.site_id, new.entity_id, new.type);"
+          "END;"
+
+         "CREATE TRIGGER IF NOT EXISTS entity_names_update "
+          "AFTER UPDATE OF name, type ON entities "
+          "WHEN old.name IS NOT new.name OR old.type IS NOT new.type BEGIN "
+            "UPDATE entity_names SET name = new.name, type = new.type "
+              "WHERE rowid = (SELECT name_key FROM entity_name_keys WHERE "
+                "site_id = new.site_id AND entity_id = new.entity_id);"
+          "END;"
+
+         "CREATE TRIGGER IF NOT EXISTS entity_names_delete "
+          "AFTER DELETE ON entities BEGIN "
+            "DELETE FROM entity_names "
+              "WHERE rowid = (SELECT name_key FROM entity_name_keys WHERE "
+                "site_id = old.site_id AND entity_id = old.entity_id);"
+            "DELETE FROM entity_name_keys "
+              "WHERE site_id = old.site_id AND entity_id = old.entity_id;"
+          "END;";
 
-        if (sqlite3_prepare_v2(
+        bool success = true;
+        char *rc_error_str_ptr = 0;
+        int rc = sqlite3_exec(
             dbhandle_ptr,
-            "SELECT site_id FROM sites WHERE deleted = 0;",
-            -1,
-            &list_sites_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+            create_index_str.c_str(),
+            0,
+            0,
+            &rc_error_str_ptr);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding valid sites.");
-        }
+        name_index_available = (rc == SQLITE_OK);
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT site_id FROM sites WHERE deleted = 1;",
-            -1,
-            &list_deleted_sites_stmt,
-            0) != SQLITE_OK)
+        if (not name_index_available)
         {
-            success = false;
+            // Most likely FTS5 or its trigram tokenizer (SQLite 3.34+) is
+            // not available.  Remove any triggers left from a previous run
+            // with a newer SQLite, since they would cause every write to
+            // fail, and mark the index as needing a rebuild.
+            //
+            LOG(warning, "sqliteinterface", "create_name_index",
+                "Unable to create name index, name searches will be slow: "
+                + std::string(sqlite3_errstr(rc))
+                + "   Full error: "
+                + std::string(rc_error_str_ptr ? rc_error_str_ptr : ""));
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for finding deleted sites.");
-        }
+            sqlite3_free(rc_error_str_ptr);
+            rc_error_str_ptr = 0;
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID;",
-            -1,
-            &list_all_entities_site_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+            rc = sqlite3_exec(
+                dbhandle_ptr,
+                "DROP TRIGGER IF EXISTS entity_names_insert;"
+                "DROP TRIGGER IF EXISTS entity_names_update;"
+                "DROP TRIGGER IF EXISTS entity_names_delete;"
+                "PRAGMA user_version = 0;",
+                0,
+                0,
+                0);
+
+            if (rc != SQLITE_OK)
+            {
+                success = false;
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing all of site's entities.");
+                LOG(fatal, "sqliteinterface", "create_name_index",
+                    "Unable to remove name index triggers: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
         }
-
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name LIKE '%' || $NAME || '%';",
-            -1,
-            &find_name_in_db_stmt,
-            0) != SQLITE_OK)
+        else
         {
-            success = false;
+            // See if the index needs to be built from existing entities.
+            //
+            sqlite3_stmt *user_version_stmt = 0;
+            int user_version = 0;
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by name.");
+            if ((sqlite3_prepare_v2(
+                    dbhandle_ptr,
+                    "PRAGMA user_version;",
+                    -1,
+                    &user_version_stmt,
+                    0) == SQLITE_OK) and
+                (sqlite3_step(user_version_stmt) == SQLITE_ROW))
+            {
+                user_version = sqlite3_column_int(user_version_stmt, 0);
+            }
+
+            sqlite3_finalize(user_version_stmt);
+            user_version_stmt = 0;
+
+            if (user_version < NAME_INDEX_SCHEMA_VERSION)
+            {
+                LOG(info, "sqliteinterface", "create_name_index",
+                    "Building name index...");
+
+                const boost::posix_time::ptime start_time =
+                    boost::posix_time::microsec_clock::universal_time();
+                const std::string build_index_str =
+                 "BEGIN IMMEDIATE;"
+                 "DELETE FROM entity_names;"
+                 "DELETE FROM entity_name_keys;"
+                 "INSERT INTO entity_name_keys(site_id, entity_id) "
+                   "SELECT site_id, entity_id FROM entities;"
+                 "INSERT INTO entity_names(rowid, name, site_id, entity_id, type) "
+                   "SELECT k.name_key, e.name, e.site_id, e.entity_id, e.type "
+                   "FROM entities AS e JOIN entity_name_keys AS k "
+                   "ON k.site_id = e.site_id AND k.entity_id = e.entity_id;"
+                 "PRAGMA user_version = "
+                   + text::to_string(NAME_INDEX_SCHEMA_VERSION) + ";"
+                 "COMMIT;";
+
+                rc = sqlite3_exec(
+                    dbhandle_ptr,
+                    build_index_str.c_str(),
+                    0,
+                    0,
+                    &rc_error_str_ptr);
+
+                if (rc != SQLITE_OK)
+                {
+                    success = false;
+
+                    LOG(fatal, "sqliteinterface", "create_name_index",
+                        "Unable to build name index: "
+                        + std::string(sqlite3_errstr(rc))
+                        + "   Full error: "
+                        + std::string(
+                            rc_error_str_ptr ? rc_error_str_ptr : ""));
+
+                    sqlite3_free(rc_error_str_ptr);
+                    rc_error_str_ptr = 0;
+
+                    sqlite3_exec(dbhandle_ptr, "ROLLBACK;", 0, 0, 0);
+                }
+                else
+                {
+                    LOG(info, "sqliteinterface", "create_name_index",
+                        "Built name index in "
+                        + text::to_string(
+                            (boost::posix_time::microsec_clock::universal_time()
+                                - start_time).total_milliseconds())
+                        + " ms.");
+                }
+            }
         }
 
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::create_accessed_index(void)
+    {
+        bool success = true;
+        sqlite3_stmt *accessed_stmt = 0;
+
+        // Databases created before the column existed need it added.
+        //
         if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name LIKE '%' || $NAME || '%' AND type = $TYPE;",
-            -1,
-            &find_name_type_in_db_stmt,
-            0) != SQLITE_OK)
-        {
-            success = false;
+                dbhandle_ptr,
+                "SELECT accessed FROM entities LIMIT 0;",
+                -1,
+                &accessed_stmt,
+                0) != SQLITE_OK)
+        {
+            LOG(info, "sqliteinterface", "create_accessed_index",
+                "Adding accessed column to entities...");
+
+            const int rc = sqlite3_exec(
+                dbhandle_ptr,
+                "ALTER TABLE entities "
+                  "ADD COLUMN accessed INTEGER NOT NULL DEFAULT 0;",
+                0,
+                0,
+                0);
+
+            if (rc != SQLITE_OK)
+            {
+                success = false;
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by name and type.");
+                LOG(fatal, "sqliteinterface", "create_accessed_index",
+                    "Unable to add accessed column: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
         }
 
-        if (sqlite3_prepare_v2(
-            dbhandle_ptr,
-            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
-                "name = $NAME AND type = $TYPE;",
-            -1,
-            &find_exact_name_type_in_db_stmt,
-            0) != SQLITE_OK)
+        sqlite3_finalize(accessed_stmt);
+        accessed_stmt = 0;
+
+        if (success)
         {
-            success = false;
+            const int rc = sqlite3_exec(
+                dbhandle_ptr,
+                "CREATE INDEX IF NOT EXISTS entity_accessed_idx "
+                  "ON entities(site_id, accessed);",
+                0,
+                0,
+                0);
 
-            LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for listing entity by exact "
-                    "name and type.");
+            if (rc != SQLITE_OK)
+            {
+                success = false;
+
+                LOG(fatal, "sqliteinterface", "create_accessed_index",
+                    "Unable to create accessed index: "
+                    + std::string(sqlite3_errstr(rc)));
+            }
         }
 
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::sql_init(void)
+    {
+        bool success = true;
+
         if (sqlite3_prepare_v2(
             dbhandle_ptr,
-            "SELECT type FROM entities WHERE site_id = $SITEID "
-            "and entity_id = $ENTITYID;",
+            "SELECT site_id FROM sites WHERE deleted = 1;",
             -1,
-            &get_entity_type_stmt,
+            &list_deleted_sites_stmt,
             0) != SQLITE_OK)
         {
             success = false;
 
             LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting an Entity type.");
+                "Failed prepared statement for finding deleted sites.");
         }
 
         if (sqlite3_prepare_v2(
@@ -1420,31 +2157,30 @@ namespace sqliteinterface
 
         if (sqlite3_prepare_v2(
             dbhandle_ptr,
-            "UPDATE entities SET owner = $OWNER, type = $TYPE, name = $NAME, "
-                                "data = $DATA "
-                "WHERE site_id = $SITEID and entity_id = $ENTITYID;",
+            "DELETE FROM program_bytecode WHERE site_id = $SITEID;",
             -1,
-            &update_entity_stmt,
+            &delete_site_program_bytecode_stmt,
             0) != SQLITE_OK)
         {
             success = false;
 
             LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for updating an Entity.");
+                "Failed prepared statement for delete a site's bytecode.");
         }
 
         if (sqlite3_prepare_v2(
             dbhandle_ptr,
-            "SELECT type, data FROM entities WHERE site_id = $SITEID "
-                "and entity_id = $ENTITYID;",
+            "UPDATE entities SET owner = $OWNER, type = $TYPE, name = $NAME, "
+                                "data = $DATA, accessed = $ACCESSED "
+                "WHERE site_id = $SITEID and entity_id = $ENTITYID;",
             -1,
-            &get_entity_stmt,
+            &update_entity_stmt,
             0) != SQLITE_OK)
         {
             success = false;
 
             LOG(fatal, "sqliteinterface", "sql_init",
-                "Failed prepared statement for getting an Entity.");
+                "Failed prepared statement for updating an Entity.");
         }
 
         if (sqlite3_prepare_v2(
@@ -1503,8 +2239,10 @@ namespace sqliteinterface
         if (sqlite3_prepare_v2(
             dbhandle_ptr,
             "INSERT INTO "
-              "entities(site_id, entity_id, owner, type, version, name, data) "
-              "VALUES ($SITEID, $ENTITYID, $OWNER, $TYPE, $VERSION, $NAME, $DATA);",
+              "entities(site_id, entity_id, owner, type, version, name, data, "
+                "accessed) "
+              "VALUES ($SITEID, $ENTITYID, $OWNER, $TYPE, $VERSION, $NAME, $DATA, "
+                "$ACCESSED);",
             -1,
             &add_entity_stmt,
             0) != SQLITE_OK)
@@ -1528,6 +2266,35 @@ namespace sqliteinterface
                 "Failed prepared statement for deleting an Entity.");
         }
 
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "DELETE FROM program_bytecode WHERE site_id = $SITEID "
+                "AND entity_id = $ENTITYID;",
+            -1,
+            &delete_program_bytecode_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for deleting Program bytecode.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "INSERT OR REPLACE INTO program_bytecode"
+                "(site_id, entity_id, source, bytecode) VALUES "
+                "($SITEID, $ENTITYID, $SOURCE, $BYTECODE);",
+            -1,
+            &save_program_bytecode_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for saving Program bytecode.");
+        }
+
         if (sqlite3_prepare_v2(
             dbhandle_ptr,
             "INSERT INTO id_reuse(site_id, deleted_entity_id) VALUES "
@@ -1581,18 +2348,544 @@ namespace sqliteinterface
                 "Failed prepared statement for deleting site next Entity ID.");
         }
 
-        return success;
-    }
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "BEGIN IMMEDIATE;",
+            -1,
+            &begin_batch_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
 
-    // ----------------------------------------------------------------------
-    bool SqliteBackend::delete_site_entity_data(
-        const dbtype::Id::SiteIdType site_id)
-    {
-        bool success = true;
-        int rc = SQLITE_OK;
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for beginning a batch.");
+        }
 
-        if (sqlite3_bind_int(
-            delete_site_entities_stmt,
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "COMMIT;",
+            -1,
+            &commit_batch_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for committing a batch.");
+        }
+
+        if (sqlite3_prepare_v2(
+            dbhandle_ptr,
+            "ROLLBACK;",
+            -1,
+            &rollback_batch_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "sql_init",
+                "Failed prepared statement for rolling back a batch.");
+        }
+
+        // Loads and searches done on the write connection, while a batch
+        // is open.
+        //
+        write_read_connection.dbhandle_ptr = dbhandle_ptr;
+
+        if (not prepare_read_statements(write_read_connection))
+        {
+            success = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::prepare_read_statements(ReadConnection &connection)
+    {
+        bool success = true;
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT site_id FROM sites WHERE deleted = 0;",
+            -1,
+            &connection.list_sites_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for finding valid sites.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID;",
+            -1,
+            &connection.list_all_entities_site_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for listing all of site's entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+                "type = $TYPE;",
+            -1,
+            &connection.list_type_entities_site_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for listing site's entities of "
+                    "a type.");
+        }
+
+        // Substring searches use the trigram index when it's available,
+        // since otherwise they must scan every Entity in the site.
+        //
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            name_index_available ?
+                "SELECT entity_id FROM entity_names WHERE site_id = $SITEID AND "
+                    "name LIKE '%' || $NAME || '%';" :
+                "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+                    "name LIKE '%' || $NAME || '%';",
+            -1,
+            &connection.find_name_in_db_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for listing entity by name.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            name_index_available ?
+                "SELECT entity_id FROM entity_names WHERE site_id = $SITEID AND "
+                    "name LIKE '%' || $NAME || '%' AND type = $TYPE;" :
+                "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+                    "name LIKE '%' || $NAME || '%' AND type = $TYPE;",
+            -1,
+            &connection.find_name_type_in_db_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for listing entity by name and type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT entity_id FROM entities WHERE site_id = $SITEID AND "
+                "name = $NAME AND type = $TYPE;",
+            -1,
+            &connection.find_exact_name_type_in_db_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for listing entity by exact "
+                    "name and type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT type FROM entities WHERE site_id = $SITEID "
+            "and entity_id = $ENTITYID;",
+            -1,
+            &connection.get_entity_type_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for getting an Entity type.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT type, data FROM entities WHERE site_id = $SITEID "
+                "and entity_id = $ENTITYID;",
+            -1,
+            &connection.get_entity_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for getting an Entity.");
+        }
+
+        // The entity ID parameters directly follow $SITEID.
+        //
+        std::string get_entities_str =
+            "SELECT type, data, entity_id FROM entities WHERE "
+                "site_id = $SITEID and entity_id IN (";
+
+        for (size_t slot = 0; slot < GET_ENTITIES_BATCH_SIZE; ++slot)
+        {
+            get_entities_str += (slot ? ", ?" : "?");
+        }
+
+        get_entities_str += ");";
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            get_entities_str.c_str(),
+            -1,
+            &connection.get_entities_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for getting several Entities.");
+        }
+
+        if (sqlite3_prepare_v2(
+            connection.dbhandle_ptr,
+            "SELECT source, bytecode FROM program_bytecode "
+                "WHERE site_id = $SITEID AND entity_id = $ENTITYID;",
+            -1,
+            &connection.get_program_bytecode_stmt,
+            0) != SQLITE_OK)
+        {
+            success = false;
+
+            LOG(fatal, "sqliteinterface", "prepare_read_statements",
+                "Failed prepared statement for getting Program bytecode.");
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::finalize_read_statements(ReadConnection &connection)
+    {
+        sqlite3_finalize(connection.list_sites_stmt);
+        connection.list_sites_stmt = 0;
+
+        sqlite3_finalize(connection.list_all_entities_site_stmt);
+        connection.list_all_entities_site_stmt = 0;
+
+        sqlite3_finalize(connection.list_type_entities_site_stmt);
+        connection.list_type_entities_site_stmt = 0;
+
+        sqlite3_finalize(connection.find_name_in_db_stmt);
+        connection.find_name_in_db_stmt = 0;
+
+        sqlite3_finalize(connection.find_name_type_in_db_stmt);
+        connection.find_name_type_in_db_stmt = 0;
+
+        sqlite3_finalize(connection.find_exact_name_type_in_db_stmt);
+        connection.find_exact_name_type_in_db_stmt = 0;
+
+        sqlite3_finalize(connection.get_entity_type_stmt);
+        connection.get_entity_type_stmt = 0;
+
+        sqlite3_finalize(connection.get_entity_stmt);
+        connection.get_entity_stmt = 0;
+
+        sqlite3_finalize(connection.get_entities_stmt);
+        connection.get_entities_stmt = 0;
+
+        sqlite3_finalize(connection.get_program_bytecode_stmt);
+        connection.get_program_bytecode_stmt = 0;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::open_read_connections(void)
+    {
+        bool success = true;
+
+        for (size_t index = 0; index < READ_CONNECTION_POOL_SIZE; ++index)
+        {
+            ReadConnection *connection_ptr = new ReadConnection();
+
+            // No SQLite internal mutex is needed since a connection is
+            // only used by one thread at a time.
+            //
+            const int rc = sqlite3_open_v2(
+                DATABASE_FILE_NAME,
+                &connection_ptr->dbhandle_ptr,
+                SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                0);
+
+            if ((rc != SQLITE_OK) or
+                (not prepare_read_statements(*connection_ptr)))
+            {
+                LOG(fatal, "sqliteinterface", "open_read_connections",
+                    "Unable to open read connection: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                finalize_read_statements(*connection_ptr);
+                sqlite3_close(connection_ptr->dbhandle_ptr);
+                delete connection_ptr;
+
+                success = false;
+                break;
+            }
+
+            read_connections.push_back(connection_ptr);
+        }
+
+        if (success)
+        {
+            available_read_connections = read_connections;
+
+            LOG(info, "sqliteinterface", "open_read_connections",
+                "Opened " + text::to_string(read_connections.size())
+                + " read connections.");
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::close_read_connections(void)
+    {
+        LOG(info, "sqliteinterface", "close_read_connections",
+            "Write connection:  Reads: "
+            + text::to_string(write_read_connection.use_count)
+            + "  Total wait (ms): "
+            + text::to_string(
+                write_read_connection.total_wait_time.total_milliseconds())
+            + "  Max wait (ms): "
+            + text::to_string(
+                write_read_connection.max_wait_time.total_milliseconds()));
+
+        for (size_t index = 0; index < read_connections.size(); ++index)
+        {
+            ReadConnection * const connection_ptr = read_connections[index];
+
+            LOG(info, "sqliteinterface", "close_read_connections",
+                "Read connection " + text::to_string(index)
+                + ":  Reads: " + text::to_string(connection_ptr->use_count)
+                + "  Total wait (ms): "
+                + text::to_string(
+                    connection_ptr->total_wait_time.total_milliseconds())
+                + "  Max wait (ms): "
+                + text::to_string(
+                    connection_ptr->max_wait_time.total_milliseconds()));
+
+            finalize_read_statements(*connection_ptr);
+            sqlite3_close(connection_ptr->dbhandle_ptr);
+            delete connection_ptr;
+        }
+
+        read_connections.clear();
+        available_read_connections.clear();
+    }
+
+    // ----------------------------------------------------------------------
+    SqliteBackend::ReadConnection *SqliteBackend::acquire_read_connection(
+        const bool see_batch)
+    {
+        const boost::posix_time::ptime start_time =
+            boost::posix_time::microsec_clock::universal_time();
+        ReadConnection *connection_ptr = 0;
+
+        // Rows written in an open batch are only visible on the write
+        // connection until committed.  Loads don't need to see them, since
+        // the cache keeps every Entity with uncommitted changes (it only
+        // evicts once the UpdateManager has committed everything), and
+        // loads of Entities deleted in the batch are rejected by
+        // is_batch_deleted(), so they always use the pool.  Searches do
+        // need to see them, or a newly
+        // created or renamed Entity would not be found until the batch
+        // commits.  The mutex is taken before checking for a batch so one
+        // can't start or finish in between.
+        //
+        if (see_batch or read_connections.empty())
+        {
+            mutex.lock();
+
+            if (in_batch or read_connections.empty())
+            {
+                connection_ptr = &write_read_connection;
+            }
+            else
+            {
+                mutex.unlock();
+            }
+        }
+
+        if (not connection_ptr)
+        {
+            boost::unique_lock<boost::mutex> lock(read_pool_mutex);
+
+            while (available_read_connections.empty())
+            {
+                read_pool_condition.wait(lock);
+            }
+
+            connection_ptr = available_read_connections.back();
+            available_read_connections.pop_back();
+        }
+
+        // The connection is now ours alone, so the stats can be safely
+        // updated.
+        //
+        const boost::posix_time::time_duration wait_time =
+            boost::posix_time::microsec_clock::universal_time() - start_time;
+
+        ++connection_ptr->use_count;
+        connection_ptr->total_wait_time += wait_time;
+
+        if (wait_time > connection_ptr->max_wait_time)
+        {
+            connection_ptr->max_wait_time = wait_time;
+        }
+
+        return connection_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::release_read_connection(ReadConnection *connection_ptr)
+    {
+        if (connection_ptr == &write_read_connection)
+        {
+            mutex.unlock();
+        }
+        else if (connection_ptr)
+        {
+            {
+                boost::lock_guard<boost::mutex> guard(read_pool_mutex);
+                available_read_connections.push_back(connection_ptr);
+            }
+
+            read_pool_condition.notify_one();
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::begin_batch_transaction(void)
+    {
+        const int rc = sqlite3_step(begin_batch_stmt);
+        const bool success = (rc == SQLITE_DONE);
+
+        if (not success)
+        {
+            LOG(error, "sqliteinterface", "begin_batch_transaction",
+                "Could not begin batch transaction: "
+                + std::string(sqlite3_errstr(rc)));
+        }
+        else
+        {
+            in_batch = true;
+        }
+
+        reset(begin_batch_stmt);
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::commit_batch_transaction(void)
+    {
+        bool success = true;
+
+        if (in_batch)
+        {
+            int rc = sqlite3_step(commit_batch_stmt);
+            reset(commit_batch_stmt);
+
+            if (rc != SQLITE_DONE)
+            {
+                LOG(error, "sqliteinterface", "commit_batch_transaction",
+                    "Could not commit batch transaction, rolling back: "
+                    + std::string(sqlite3_errstr(rc)));
+
+                success = false;
+
+                // The transaction may have already been rolled back
+                // automatically, depending on the error.
+                //
+                if (not sqlite3_get_autocommit(dbhandle_ptr))
+                {
+                    rc = sqlite3_step(rollback_batch_stmt);
+                    reset(rollback_batch_stmt);
+
+                    if (rc != SQLITE_DONE)
+                    {
+                        LOG(fatal, "sqliteinterface",
+                            "commit_batch_transaction",
+                            "Could not roll back batch transaction: "
+                            + std::string(sqlite3_errstr(rc)));
+                    }
+                }
+            }
+            else
+            {
+                // The deletes are now visible everywhere.  If the batch
+                // failed they are kept, since the rows are back but the
+                // Entities are still deleted and will be retried.
+                //
+                boost::lock_guard<boost::mutex> deleted_guard(
+                    batch_deleted_mutex);
+                batch_deleted_ids.clear();
+            }
+
+            in_batch = false;
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::is_batch_deleted(const dbtype::Id &id)
+    {
+        boost::lock_guard<boost::mutex> deleted_guard(batch_deleted_mutex);
+
+        return batch_deleted_ids.find(id) != batch_deleted_ids.end();
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::suspend_batch(void)
+    {
+        const bool suspended = in_batch;
+
+        if (suspended and (not commit_batch_transaction()))
+        {
+            // Reported to the batch's owner when it commits, so it can
+            // retry everything it wrote.
+            batch_failed = true;
+        }
+
+        return suspended;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::resume_batch(const bool suspended)
+    {
+        if (suspended and (not begin_batch_transaction()))
+        {
+            // The rest of the batch's writes will each commit on their
+            // own, which is slower but still correct.
+            LOG(warning, "sqliteinterface", "resume_batch",
+                "Could not resume batch; remaining writes not batched.");
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::delete_site_entity_data(
+        const dbtype::Id::SiteIdType site_id)
+    {
+        bool success = true;
+        int rc = SQLITE_OK;
+
+        if (sqlite3_bind_int(
+            delete_site_entities_stmt,
             sqlite3_bind_parameter_index(
                 delete_site_entities_stmt,
                 "$SITEID"),
@@ -1647,9 +2940,61 @@ namespace sqliteinterface
 
         reset(delete_site_display_names_stmt);
 
+        if (sqlite3_bind_int(
+            delete_site_program_bytecode_stmt,
+            sqlite3_bind_parameter_index(
+                delete_site_program_bytecode_stmt,
+                "$SITEID"),
+            site_id) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "For delete_site_program_bytecode_stmt, could not bind $SITEID");
+        }
+
+        rc = sqlite3_step(delete_site_program_bytecode_stmt);
+
+        if (rc != SQLITE_DONE)
+        {
+            LOG(error, "sqliteinterface", "delete_site_entity_data",
+                "Could not delete site bytecode: "
+                + std::string(sqlite3_errstr(rc)));
+
+            success = false;
+        }
+        else
+        {
+            rc = SQLITE_OK;
+        }
+
+        reset(delete_site_program_bytecode_stmt);
+
         return success;
     }
 
+    // ----------------------------------------------------------------------
+    void SqliteBackend::bind_site_entity_id(
+        sqlite3_stmt *stmt,
+        const dbtype::Id &id)
+    {
+        if (sqlite3_bind_int(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$SITEID"),
+            id.get_site_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_site_entity_id",
+                "Could not bind $SITEID");
+        }
+
+        if (sqlite3_bind_int64(
+            stmt,
+            sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
+            id.get_entity_id()) != SQLITE_OK)
+        {
+            LOG(error, "sqliteinterface", "bind_site_entity_id",
+                "Could not bind $ENTITYID");
+        }
+    }
+
     // ----------------------------------------------------------------------
     void SqliteBackend::add_entity_ids(
         sqlite3_stmt *result_stmt_ptr,
@@ -1680,32 +3025,55 @@ namespace sqliteinterface
     }
 
     // ----------------------------------------------------------------------
-    bool SqliteBackend::bind_entity_update_params(
+    bool SqliteBackend::snapshot_entity(
         dbtype::Entity *entity_ptr,
-        concurrency::WriterLockToken &token,
-        sqlite3_stmt *stmt)
+        concurrency::ReaderLockToken &token,
+        EntitySnapshot &snapshot)
     {
         bool success = entity_ptr;
 
         if (success)
         {
-            utility::MemoryBuffer buffer;
-            const std::string name = entity_ptr->get_entity_name(token);
-            char *data_ptr = 0;
-            size_t data_size = 0;
-            success = serialize_entity(entity_ptr, buffer) and
-                      buffer.get_data(data_ptr, data_size);
+            snapshot.id = entity_ptr->get_entity_id();
+            snapshot.owner = entity_ptr->get_entity_owner(token);
+            snapshot.type = entity_ptr->get_entity_type();
+            snapshot.name = entity_ptr->get_entity_name(token);
+            snapshot.accessed =
+                entity_ptr->get_entity_accessed_timestamp(token).get_time();
+            snapshot.dirty_serial = entity_ptr->get_dirty_serial(token);
+
+            success = serialize_entity(entity_ptr, snapshot.data);
 
             if (not success)
             {
-                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                LOG(error, "sqliteinterface", "snapshot_entity",
                     "Could not serialize entity!");
             }
+        }
 
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool SqliteBackend::bind_entity_update_params(
+        EntitySnapshot &snapshot,
+        sqlite3_stmt *stmt)
+    {
+        char *data_ptr = 0;
+        size_t data_size = 0;
+        bool success = snapshot.data.get_data(data_ptr, data_size);
+
+        if (not success)
+        {
+            LOG(error, "sqliteinterface", "bind_entity_update_params",
+                "No serialized data for entity!");
+        }
+        else
+        {
             if (sqlite3_bind_int64(
                 stmt,
                 sqlite3_bind_parameter_index(stmt, "$OWNER"),
-                entity_ptr->get_entity_owner(token).get_entity_id()) != SQLITE_OK)
+                snapshot.owner.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
                     "For statement, could not bind $OWNER");
@@ -1714,7 +3082,7 @@ namespace sqliteinterface
             if (sqlite3_bind_int(
                 stmt,
                 sqlite3_bind_parameter_index(stmt, "$TYPE"),
-                entity_ptr->get_entity_type()) != SQLITE_OK)
+                snapshot.type) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
                     "For statement, could not bind $TYPE");
@@ -1723,8 +3091,8 @@ namespace sqliteinterface
             if (sqlite3_bind_text(
                 stmt,
                 sqlite3_bind_parameter_index(stmt, "$NAME"),
-                name.c_str(),
-                name.size(),
+                snapshot.name.c_str(),
+                snapshot.name.size(),
                 SQLITE_TRANSIENT) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
@@ -1734,7 +3102,7 @@ namespace sqliteinterface
             if (sqlite3_bind_int(
                 stmt,
                 sqlite3_bind_parameter_index(stmt, "$SITEID"),
-                entity_ptr->get_entity_id().get_site_id()) != SQLITE_OK)
+                snapshot.id.get_site_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
                     "For statement, could not bind $SITEID");
@@ -1743,7 +3111,7 @@ namespace sqliteinterface
             if (sqlite3_bind_int64(
                 stmt,
                 sqlite3_bind_parameter_index(stmt, "$ENTITYID"),
-                entity_ptr->get_entity_id().get_entity_id()) != SQLITE_OK)
+                snapshot.id.get_entity_id()) != SQLITE_OK)
             {
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
                     "For statement, could not bind $ENTITYID");
@@ -1759,12 +3127,124 @@ namespace sqliteinterface
                 LOG(error, "sqliteinterface", "bind_entity_update_params",
                     "For statement, could not bind $DATA");
             }
+
+            if (sqlite3_bind_int64(
+                stmt,
+                sqlite3_bind_parameter_index(stmt, "$ACCESSED"),
+                snapshot.accessed) != SQLITE_OK)
+            {
+                LOG(error, "sqliteinterface", "bind_entity_update_params",
+                    "For statement, could not bind $ACCESSED");
+            }
         }
 
         return success;
 
     }
 
+    // ----------------------------------------------------------------------
+    dbtype::Entity *SqliteBackend::deserialize_entity_row(
+        sqlite3_stmt *stmt,
+        const dbtype::Id &id)
+    {
+        // Column bytes must be gotten after the blob.
+        //
+        const dbtype::EntityType entity_type =
+            (dbtype::EntityType) sqlite3_column_int(stmt, 0);
+        const void *blob_ptr = sqlite3_column_blob(stmt, 1);
+        const int blob_size = sqlite3_column_bytes(stmt, 1);
+
+        return deserialize_entity_data(entity_type, blob_ptr, blob_size, id);
+    }
+
+    // ----------------------------------------------------------------------
+    dbtype::Entity *SqliteBackend::deserialize_entity_data(
+        const dbtype::EntityType entity_type,
+        const void *blob_ptr,
+        const int blob_size,
+        const dbtype::Id &id)
+    {
+        dbtype::Entity *entity_ptr = 0;
+
+        if ((not blob_ptr) or (blob_size <= 0))
+        {
+            LOG(error, "sqliteinterface", "deserialize_entity_data",
+                "No blob data for ID " + id.to_string(true));
+        }
+        else
+        {
+            entity_ptr =
+                make_deserialize_entity(entity_type, blob_ptr, blob_size);
+
+            if (not entity_ptr)
+            {
+                LOG(error, "sqliteinterface", "deserialize_entity_data",
+                    "Unknown type to deserialize: "
+                      + dbtype::entity_type_to_string(entity_type)
+                      + "  ID: " + id.to_string(true));
+            }
+        }
+
+        return entity_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SqliteBackend::preload_worker(PreloadState &state)
+    {
+        PreloadRows *chunk_ptr = 0;
+        bool done = false;
+
+        while (not done)
+        {
+            // Scope for lock
+            {
+                boost::unique_lock<boost::mutex> lock(state.mutex);
+
+                while (state.pending_chunks.empty() and
+                    (not state.done_reading))
+                {
+                    state.condition.wait(lock);
+                }
+
+                if (state.pending_chunks.empty())
+                {
+                    done = true;
+                }
+                else
+                {
+                    chunk_ptr = state.pending_chunks.front();
+                    state.pending_chunks.pop_front();
+
+                    // Reader may be waiting for room in the queue.
+                    state.condition.notify_all();
+                }
+            }
+
+            if (not done)
+            {
+                // The reader keeps the chunk, so deserialize in place.
+                // Only this thread touches it until the workers are joined.
+                //
+                for (PreloadRows::iterator row_iter = chunk_ptr->begin();
+                    row_iter != chunk_ptr->end();
+                    ++row_iter)
+                {
+                    if (not row_iter->already_loaded)
+                    {
+                        row_iter->entity_ptr = deserialize_entity_data(
+                            row_iter->type,
+                            row_iter->data.data(),
+                            row_iter->data.size(),
+                            row_iter->id);
+
+                        // Blob copy is no longer needed.
+                        std::string().swap(row_iter->data);
+                    }
+                }
+            }
+        }
+    }
+
     // ----------------------------------------------------------------------
     void SqliteBackend::reset(sqlite3_stmt *stmt_ptr)
     {
@@ -5,14 +5,25 @@
 #ifndef MUTGOS_SQLITEINTERFACE_SQLITEBACKEND_H
 #define MUTGOS_SQLITEINTERFACE_SQLITEBACKEND_H
 
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
 #include <sqlite3.h>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
 
 #include "dbinterface/dbinterface_DbBackend.h"
 
 #include "concurrency/concurrency_WriterLockToken.h"
 
+#include "utilities/utility_MemoryBuffer.h"
+
 #include "dbtypes/dbtype_Id.h"
+#include "dbtypes/dbtype_EntityType.h"
 
 namespace mutgos
 {
@@ -20,6 +31,12 @@ namespace sqliteinterface
 {
     /**
      * Implements a DbBackend that uses SQLite.
+     *
+     * All writes go through a single connection.  Loads and searches are
+     * spread across a pool of read-only connections so they can run in
+     * parallel with each other and with writes, except while a batch is
+     * open, when they use the write connection so uncommitted changes are
+     * visible.
      */
     class SqliteBackend : public dbinterface::DbBackend
     {
@@ -97,6 +114,46 @@ namespace sqliteinterface
          */
         virtual dbtype::Entity *get_entity_db(const dbtype::Id &id);
 
+        /**
+         * Gets several Entities in the same site from the database, using
+         * one query per GET_ENTITIES_BATCH_SIZE Entities not already in
+         * memory.  Any already present in memory are provided as the
+         * existing pointer.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * @param ids[in] The IDs of the Entities to retrieve.  All must be in
+         * the same site.
+         * @param entities[out] Pointers to the Entities retrieved, in the
+         * same order as ids.  A pointer is null if not found.
+         */
+        virtual void get_entities_db(
+            const dbtype::Entity::IdVector &ids,
+            EntityPtrVector &entities);
+
+        /**
+         * Gets the Entities in a site that are likely to be used soon, so
+         * they can be preloaded into the cache at startup.  The rows are
+         * streamed from a single query and deserialized by several threads
+         * as they are read.  Any already present in memory are provided as
+         * the existing pointer.
+         * Caller must manage the pointers and delete them with
+         * delete_entity_mem().
+         * @param site_id[in] The site to get Entities from.
+         * @param types[in] All Entities of these types are gotten.
+         * @param recent_count[in] Up to this many of the most recently
+         * accessed Entities, of any type, are also gotten.
+         * @param max_bytes[in] Rows stop being read once this many bytes of
+         * serialized data have been read.
+         * @param entities[out] Pointers to the Entities retrieved, most
+         * recently accessed first.  None will be null.
+         */
+        virtual void get_preload_entities_db(
+            const dbtype::Id::SiteIdType site_id,
+            const EntityTypeVector &types,
+            const size_t recent_count,
+            const size_t max_bytes,
+            EntityPtrVector &entities);
+
         /**
          * Saves the given Entity to the database.  Existing Entity data for
          * that ID and version are overwritten.  The entity must have been
@@ -161,6 +218,16 @@ namespace sqliteinterface
         virtual dbtype::Entity::IdVector find_in_db(
             const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * @param site_id[in] The site ID to get the IDs for.
+         * @param type[in] The type of entity to get the IDs of.
+         * @return All valid Entity IDs of the given type for the given site,
+         * or empty if none or site doesn't exist.
+         */
+        virtual dbtype::Entity::IdVector find_in_db(
+            const dbtype::Id::SiteIdType site_id,
+            const dbtype::EntityType type);
+
         /**
          * @return A list of all known site IDs in the database.
          */
@@ -182,8 +249,174 @@ namespace sqliteinterface
          */
         virtual bool delete_site_in_db(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Starts a batch of database writes by opening a single (immediate)
+         * transaction.  Saves and deletes of Entities until commit_batch()
+         * is called become part of the transaction.  Other writes (new
+         * Entities, new and deleted sites) are never part of it: the open
+         * transaction is committed before they are made, and a new one
+         * is opened afterwards.  Batches do not nest.
+         * @return True if success.
+         */
+        virtual bool begin_batch(void);
+
+        /**
+         * Commits the transaction started by begin_batch().  If no batch was
+         * started, this does nothing.  If the commit fails, the transaction
+         * is rolled back.
+         * @return True if the batch was committed, false if it (or a part of
+         * it committed early for another write) failed and its writes
+         * have been rolled back.
+         */
+        virtual bool commit_batch(void);
+
+        /**
+         * Gets the bytecode saved for a Program, if it was compiled from
+         * the given source code.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The Program's current source code.
+         * @param bytecode[out] The bytecode, if found.
+         * @return True if bytecode compiled from source_code was found.
+         */
+        virtual bool get_program_bytecode_db(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            std::string &bytecode);
+
+        /**
+         * Saves the bytecode for a Program, replacing any saved before.
+         * Unlike new Entities, this may become part of an open batch, since
+         * losing it only means compiling again.
+         * @param id[in] The ID of the Program.
+         * @param source_code[in] The source code that was compiled.
+         * @param bytecode_ptr[in] The bytecode.
+         * @param bytecode_size[in] The size of bytecode_ptr.
+         * @return True if saved.
+         */
+        virtual bool save_program_bytecode_db(
+            const dbtype::Id &id,
+            const std::string &source_code,
+            const char * const bytecode_ptr,
+            const size_t bytecode_size);
+
     private:
 
+        /**
+         * Everything needed to write an Entity to the database, captured
+         * while the Entity is locked so that the database itself does not
+         * need to be locked while the (potentially large) Entity is
+         * serialized.
+         */
+        struct EntitySnapshot
+        {
+            /**
+             * Constructor.
+             */
+            EntitySnapshot(void)
+              : type(dbtype::ENTITYTYPE_invalid),
+                accessed(0),
+                dirty_serial(0)
+            { }
+
+            dbtype::Id id; ///< ID of the Entity
+            dbtype::Id owner; ///< Owner of the Entity
+            dbtype::EntityType type; ///< Type of the Entity
+            std::string name; ///< Name of the Entity
+            osinterface::OsTypes::TimeEpochType accessed; ///< When last accessed
+            utility::MemoryBuffer data; ///< Serialized Entity
+            dbtype::Entity::DirtySerialType
+                dirty_serial; ///< Dirty serial when the snapshot was taken
+        };
+
+        /**
+         * A row read by get_preload_entities_db(), waiting to be
+         * deserialized.
+         */
+        struct PreloadRow
+        {
+            /**
+             * Constructor.
+             */
+            PreloadRow(void)
+              : type(dbtype::ENTITYTYPE_invalid),
+                already_loaded(false),
+                entity_ptr(0)
+            { }
+
+            dbtype::Id id; ///< ID of the Entity
+            dbtype::EntityType type; ///< Type of the Entity
+            bool already_loaded; ///< True if Entity was already in memory
+            std::string data; ///< Serialized Entity, if not already loaded
+            dbtype::Entity *entity_ptr; ///< The Entity, once deserialized
+        };
+
+        typedef std::vector<PreloadRow> PreloadRows;
+        typedef std::deque<PreloadRows *> PreloadChunkQueue;
+
+        /**
+         * Shared between get_preload_entities_db() and the threads
+         * deserializing the rows it reads.
+         */
+        struct PreloadState
+        {
+            /**
+             * Constructor.
+             */
+            PreloadState(void)
+              : done_reading(false)
+            { }
+
+            boost::mutex mutex; ///< Protects everything in this struct
+            boost::condition_variable condition; ///< Signals a queue change
+            PreloadChunkQueue pending_chunks; ///< Rows to be deserialized
+            bool done_reading; ///< True when no more rows will be queued
+        };
+
+        /**
+         * A database connection and the prepared statements used for loads
+         * and searches, along with statistics about how long callers waited
+         * to use it.
+         */
+        struct ReadConnection
+        {
+            /**
+             * Constructor.
+             */
+            ReadConnection(void)
+              : dbhandle_ptr(0),
+                list_sites_stmt(0),
+                list_all_entities_site_stmt(0),
+                list_type_entities_site_stmt(0),
+                find_name_in_db_stmt(0),
+                find_name_type_in_db_stmt(0),
+                find_exact_name_type_in_db_stmt(0),
+                get_entity_type_stmt(0),
+                get_entity_stmt(0),
+                get_entities_stmt(0),
+                get_program_bytecode_stmt(0),
+                use_count(0)
+            { }
+
+            sqlite3 *dbhandle_ptr; ///< SQLite handle data structure
+
+            sqlite3_stmt *list_sites_stmt; ///< Lists all valid site IDs
+            sqlite3_stmt *list_all_entities_site_stmt; ///< Show all entities in site
+            sqlite3_stmt *list_type_entities_site_stmt; ///< Show all entities of type in site
+            sqlite3_stmt *find_name_in_db_stmt; ///< Find all with name LIKE
+            sqlite3_stmt *find_name_type_in_db_stmt; ///< Find all of type with name LIKE
+            sqlite3_stmt *find_exact_name_type_in_db_stmt; ///< Find all of type with name
+            sqlite3_stmt *get_entity_type_stmt; ///< Gets the type for an Entity
+            sqlite3_stmt *get_entity_stmt; ///< Gets the blob data for an Entity
+            sqlite3_stmt *get_entities_stmt; ///< Gets blob data for several
+            sqlite3_stmt *get_program_bytecode_stmt; ///< Gets a Program's saved bytecode
+
+            MG_LongUnsignedInt use_count; ///< Times the connection was used
+            boost::posix_time::time_duration total_wait_time; ///< Total time waited
+            boost::posix_time::time_duration max_wait_time; ///< Longest wait
+        };
+
+        typedef std::vector<ReadConnection *> ReadConnections;
+
         /**
          * Creates the needed tables in the database if they do not already
          * exist.  Assumes database is already opened.
@@ -191,6 +424,26 @@ namespace sqliteinterface
          */
         bool create_tables(void);
 
+        /**
+         * Creates the trigram full text index on Entity names, and the
+         * triggers that keep it in sync with the entities table, if they do
+         * not already exist.  If the index is new, it is built from the
+         * existing entities.  If this version of SQLite does not support
+         * trigram indices, name searches fall back to scanning the entities
+         * table.  Assumes database is already opened and tables created.
+         * @return True if success, including if falling back to scans.
+         */
+        bool create_name_index(void);
+
+        /**
+         * Adds the column holding when each Entity was last accessed, and
+         * its index, if they do not already exist.  Existing Entities will
+         * be considered never accessed until they are next saved.  Assumes
+         * database is already opened and tables created.
+         * @return True if success.
+         */
+        bool create_accessed_index(void);
+
         /**
          * Creates prepared statements, does any other prep work after the
          * database has been opened.
@@ -198,6 +451,52 @@ namespace sqliteinterface
          */
         bool sql_init(void);
 
+        /**
+         * Creates prepared statements for loads and searches on the given
+         * connection.  The connection must already be opened.
+         * @param connection[in,out] The connection to prepare statements on.
+         * @return True if success.
+         */
+        bool prepare_read_statements(ReadConnection &connection);
+
+        /**
+         * Finalizes the prepared statements for the given connection.  The
+         * connection itself is not closed.
+         * @param connection[in,out] The connection to finalize statements on.
+         */
+        void finalize_read_statements(ReadConnection &connection);
+
+        /**
+         * Opens the pool of read-only connections.  Assumes the write
+         * connection is already opened and the tables have been created.
+         * @return True if success.
+         */
+        bool open_read_connections(void);
+
+        /**
+         * Logs usage statistics for, then closes, all read-only connections.
+         */
+        void close_read_connections(void);
+
+        /**
+         * Waits for a connection to do loads or searches on, from the pool
+         * of read-only connections.  If the read must see what has been
+         * written in an open batch and one is open, this instead locks the
+         * main mutex and provides the write connection.
+         * release_read_connection() MUST be called when done.
+         * @param see_batch[in] True if the read must see writes in a batch
+         * that is not yet committed.
+         * @return The connection to use.  Will never be null.
+         */
+        ReadConnection *acquire_read_connection(const bool see_batch = false);
+
+        /**
+         * Makes a connection from acquire_read_connection() available to
+         * others.
+         * @param connection_ptr[in] The connection to release.
+         */
+        void release_read_connection(ReadConnection *connection_ptr);
+
         /**
          * Delete all entities and display name lookups for a site.
          * @param site_id[in] The site ID to delete.
@@ -205,6 +504,51 @@ namespace sqliteinterface
          */
         bool delete_site_entity_data(const dbtype::Id::SiteIdType site_id);
 
+        /**
+         * Opens the batch transaction.  The mutex must be locked.
+         * @return True if success.
+         */
+        bool begin_batch_transaction(void);
+
+        /**
+         * Commits the batch transaction if one is open, rolling it back if
+         * the commit fails.  The mutex must be locked.
+         * @return True if committed or no batch was open.
+         */
+        bool commit_batch_transaction(void);
+
+        /**
+         * @param id[in] The ID of the Entity to check.
+         * @return True if the Entity was deleted in a batch that has not
+         * yet been committed, so its row can still be seen on the read
+         * connections and must not be loaded.
+         */
+        bool is_batch_deleted(const dbtype::Id &id);
+
+        /**
+         * Called before a write that must not be part of a batch, so it
+         * can't be rolled back with the batch.  Commits any open batch; if
+         * that fails, the next commit_batch() reports it.  The mutex must
+         * be locked.
+         * @return True if a batch was open, to be passed to
+         * resume_batch().
+         */
+        bool suspend_batch(void);
+
+        /**
+         * Called after the write, to reopen the batch if one was open.
+         * The mutex must be locked.
+         * @param suspended[in] What suspend_batch() returned.
+         */
+        void resume_batch(const bool suspended);
+
+        /**
+         * Binds $SITEID and $ENTITYID of a statement to an ID.
+         * @param stmt[in,out] The statement to bind.
+         * @param id[in] The ID to bind.
+         */
+        void bind_site_entity_id(sqlite3_stmt *stmt, const dbtype::Id &id);
+
         /**
          * Given a statement with a result, add all IDs present to result.
          * @param result_stmt_ptr[in,out] A statement with parameters bound,
@@ -220,18 +564,66 @@ namespace sqliteinterface
             dbtype::Entity::IdVector &result);
 
         /**
-         * Binds common parameters to a create/update entity type statement.
-         * Also serializes the Entity.
-         * @param entity_ptr[in] The Entity to be bound to the statement.
+         * Serializes the Entity and captures the other fields needed to
+         * write it to the database.  The database mutex does not need to be
+         * locked.
+         * @param entity_ptr[in] The Entity to snapshot.
          * @param token[in] The lock token for entity_ptr.
+         * @param snapshot[out] The snapshot of the Entity.
+         * @return True if success.
+         */
+        bool snapshot_entity(
+            dbtype::Entity *entity_ptr,
+            concurrency::ReaderLockToken &token,
+            EntitySnapshot &snapshot);
+
+        /**
+         * Binds common parameters to a create/update entity type statement.
+         * The database mutex must be locked.
+         * @param snapshot[in] The Entity snapshot to be bound to the
+         * statement.
          * @param stmt[in,out] The statement to bind to.
          * @return True if success.
          */
         bool bind_entity_update_params(
-            dbtype::Entity *entity_ptr,
-            concurrency::WriterLockToken &token,
+            EntitySnapshot &snapshot,
             sqlite3_stmt *stmt);
 
+        /**
+         * Deserializes the Entity in the current row of a statement.  The
+         * row must have the Entity type in column 0 and the blob data in
+         * column 1.
+         * @param stmt[in] The statement positioned on the row.
+         * @param id[in] The ID of the Entity, for logging.
+         * @return The deserialized Entity, or null if error.  Caller
+         * must manage the pointer.
+         */
+        dbtype::Entity *deserialize_entity_row(
+            sqlite3_stmt *stmt,
+            const dbtype::Id &id);
+
+        /**
+         * Deserializes an Entity from blob data.
+         * @param entity_type[in] The type of the Entity.
+         * @param blob_ptr[in] The serialized Entity.
+         * @param blob_size[in] The size of blob_ptr, in bytes.
+         * @param id[in] The ID of the Entity, for logging.
+         * @return The deserialized Entity, or null if error.  Caller
+         * must manage the pointer.
+         */
+        dbtype::Entity *deserialize_entity_data(
+            const dbtype::EntityType entity_type,
+            const void *blob_ptr,
+            const int blob_size,
+            const dbtype::Id &id);
+
+        /**
+         * Thread body for get_preload_entities_db().  Deserializes queued
+         * rows in place until reading is done and the queue is empty.
+         * @param state[in,out] The queues shared with the reader.
+         */
+        void preload_worker(PreloadState &state);
+
         /**
          * Resets and clears bindings for a statement.
          * @param stmt_ptr[in,out] Prepared statement to reset.
@@ -242,13 +634,7 @@ namespace sqliteinterface
 
         // Searches
         //
-        sqlite3_stmt *list_sites_stmt; ///< Lists all valid site IDs
         sqlite3_stmt *list_deleted_sites_stmt; ///< Show all deleted sites
-        sqlite3_stmt *list_all_entities_site_stmt; ///< Show all entities in site
-        sqlite3_stmt *find_name_in_db_stmt; ///< Find all with name LIKE
-        sqlite3_stmt *find_name_type_in_db_stmt; ///< Find all of type with name LIKE
-        sqlite3_stmt *find_exact_name_type_in_db_stmt; ///< Find all of type with name
-        sqlite3_stmt *get_entity_type_stmt; ///< Gets the type for an Entity
 
         // Create, delete sites
         //
@@ -262,12 +648,12 @@ namespace sqliteinterface
         // Update and load entity
         //
         sqlite3_stmt *update_entity_stmt; ///< Updates Entity data, including blob
-        sqlite3_stmt *get_entity_stmt; ///< Gets the blob data for an Entity
 
         // Delete site
         //
         sqlite3_stmt *delete_site_entities_stmt; ///< Delete all entities of a site
         sqlite3_stmt *delete_site_display_names_stmt; ///< Delete site's display names
+        sqlite3_stmt *delete_site_program_bytecode_stmt; ///< Delete site's saved bytecode
 
         // New entity
         //
@@ -281,6 +667,11 @@ namespace sqliteinterface
         //
         sqlite3_stmt *delete_entity_stmt; ///< Deletes entity
         sqlite3_stmt *add_reuse_entity_id_stmt; ///< Adds entity ID to reuse table
+        sqlite3_stmt *delete_program_bytecode_stmt; ///< Deletes a Program's saved bytecode
+
+        // Program bytecode
+        //
+        sqlite3_stmt *save_program_bytecode_stmt; ///< Saves a Program's bytecode
 
         // Delete site
         //
@@ -288,7 +679,26 @@ namespace sqliteinterface
         sqlite3_stmt *delete_all_site_entity_id_reuse_stmt; ///< Delete site ent ID reuse
         sqlite3_stmt *delete_site_next_entity_id_stmt; ///< Delete site next ent ID
 
+        // Batches
+        //
+        sqlite3_stmt *begin_batch_stmt; ///< Starts a batch transaction
+        sqlite3_stmt *commit_batch_stmt; ///< Commits a batch transaction
+        sqlite3_stmt *rollback_batch_stmt; ///< Rolls back a batch transaction
+
+        bool in_batch; ///< True if a batch transaction is open.  Locked by mutex
+        bool batch_failed; ///< True if part of the batch failed to commit.  Locked by mutex
+        std::set<dbtype::Id> batch_deleted_ids; ///< Deleted in uncommitted batches
+        boost::mutex batch_deleted_mutex; ///< Locks batch_deleted_ids.  Taken after mutex
+        bool name_index_available; ///< True if name searches use the index
         boost::mutex mutex; ///< Enforces single access at a time.
+
+        // Loads and searches
+        //
+        ReadConnection write_read_connection; ///< Reads on the write connection
+        ReadConnections read_connections; ///< All read-only connections
+        ReadConnections available_read_connections; ///< Read-only not in use
+        boost::mutex read_pool_mutex; ///< Protects available_read_connections
+        boost::condition_variable read_pool_condition; ///< Signals one available
     };
 }
 }
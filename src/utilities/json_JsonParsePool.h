@@ -0,0 +1,65 @@
+/*
+ * json_JsonParsePool.h
+ */
+
+#ifndef MUTGOS_JSON_JSONPARSEPOOL_H
+#define MUTGOS_JSON_JSONPARSEPOOL_H
+
+#include <vector>
+#include <stddef.h>
+
+#include "utilities/json_JsonUtilities.h"
+
+namespace mutgos
+{
+namespace json
+{
+    /**
+     * A block of memory that JSON documents can be parsed into over and
+     * over, so parsing a typical message does not allocate any nodes.
+     * Documents using it are made with get_allocator(), and once they are
+     * all gone, reset() makes the memory available again.  Anything too
+     * big for the block is allocated normally and freed by reset().
+     *
+     * Normally one of these belongs to something that parses messages in
+     * order, such as a connection.
+     * This is not thread safe.
+     */
+    class JsonParsePool
+    {
+    public:
+        /**
+         * Creates a pool.
+         * @param pool_size[in] Size of the block of memory, in bytes.
+         */
+        JsonParsePool(const size_t pool_size)
+          : pool_buffer(pool_size),
+            pool_allocator(&pool_buffer[0], pool_buffer.size())
+          {  }
+
+        /**
+         * @return The allocator to give to a JSONRoot.  It must not be used
+         * after this pool is destructed.
+         */
+        JSONAllocator &get_allocator(void)
+          { return pool_allocator; }
+
+        /**
+         * Frees everything allocated from the pool.  Only call this once
+         * nothing parsed using the pool is in use.
+         */
+        void reset(void)
+          { pool_allocator.Clear(); }
+
+    private:
+        // No copying
+        JsonParsePool(const JsonParsePool &rhs);
+        JsonParsePool &operator=(const JsonParsePool &rhs);
+
+        std::vector<char> pool_buffer; ///< The block; must outlive pool_allocator
+        JSONAllocator pool_allocator; ///< Allocates from pool_buffer first
+    };
+}
+}
+
+#endif //MUTGOS_JSON_JSONPARSEPOOL_H
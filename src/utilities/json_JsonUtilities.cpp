@@ -55,6 +55,56 @@ namespace json
         return parsed_result;
     }
 
+    // ----------------------------------------------------------------------
+    bool parse_json_insitu(char * const data_ptr, JSONRoot &document)
+    {
+        bool success = false;
+
+        if (data_ptr)
+        {
+            bool threw_exception = false;
+
+            try
+            {
+                document.ParseInsitu(data_ptr);
+            }
+            catch (...)
+            {
+                LOG(warning, "json", "parse_json_insitu",
+                    "ParseInsitu threw exception!");
+                threw_exception = true;
+            }
+
+            success = not (document.HasParseError() or threw_exception);
+
+            if (not success)
+            {
+                LOG(warning, "json", "parse_json_insitu",
+                    "Invalid JSON parse attempted!");
+            }
+        }
+
+        return success;
+    }
+
+    // ----------------------------------------------------------------------
+    bool parse_json_insitu(const JSONNode &string_node, JSONRoot &document)
+    {
+        bool success = false;
+
+        if (string_node.IsString())
+        {
+            // The insitu parse left the string unescaped and null
+            // terminated inside its own data, which the caller owns.
+            //
+            success = parse_json_insitu(
+                const_cast<char *>(string_node.GetString()),
+                document);
+        }
+
+        return success;
+    }
+
     // ----------------------------------------------------------------------
     std::string write_json(JSONRoot &root)
     {
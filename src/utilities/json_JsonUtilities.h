@@ -114,6 +114,8 @@ namespace json
     typedef rapidjson::Value JSONNode;
     /** The root of the JSON document tree */
     typedef rapidjson::Document JSONRoot;
+    /** What a JSONRoot allocates its nodes from (see JsonParsePool) */
+    typedef JSONRoot::AllocatorType JSONAllocator;
 
     //
     // Static methods to make working with the JSON library easier and portable.
@@ -128,6 +130,28 @@ namespace json
      */
     JsonParsedObject *parse_json(char * const data_ptr);
 
+    /**
+     * Parses the provided string as JSON into a document the caller
+     * provides, such as one using a JsonParsePool.
+     * @param data_ptr[in] Pointer to the JSON data as a string.  Ownership
+     * of the pointer does NOT pass to this method.  The data will be
+     * modified, and must be kept until the document is no longer used.
+     * @param document[out] The document to parse into.
+     * @return True if the data was valid JSON.
+     */
+    bool parse_json_insitu(char * const data_ptr, JSONRoot &document);
+
+    /**
+     * Parses a string value as JSON, right where the string is.  This is
+     * for JSON that has other JSON embedded in it as strings.
+     * @param string_node[in] The string value to parse.  It MUST be part of
+     * a document parsed with parse_json_insitu(), since that makes it a
+     * null terminated part of the original data, which will be modified.
+     * @param document[out] The document to parse into.
+     * @return True if the node is a string and was valid JSON.
+     */
+    bool parse_json_insitu(const JSONNode &string_node, JSONRoot &document);
+
     /**
      * Converts the document into a JSON string.
      * @param root[in] The document root to convert to a JSON string.
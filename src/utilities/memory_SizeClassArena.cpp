@@ -0,0 +1,332 @@
+/*
+ * memory_SizeClassArena.cpp
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/atomic.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+#include "text/text_StringConversion.h"
+
+#include "memory_SizeClassArena.h"
+
+namespace
+{
+    /** Block sizes are multiples of this, which is also their alignment */
+    const size_t SIZE_GRANULE = 16;
+
+    /** Bytes in each block of each size class, smallest first */
+    const size_t CLASS_BLOCK_SIZES[] =
+        { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+          320, 384, 448, 512 };
+
+    /** Largest request a size class can hold */
+    const size_t MAX_CLASS_BLOCK_SIZE = 512;
+
+    /** The size class for a request of up to (index * SIZE_GRANULE) bytes */
+    const unsigned char GRANULES_TO_CLASS[] =
+        { 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+          12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15 };
+
+    // TODO make data driven
+
+    /** Bytes malloc()ed at a time to carve blocks from */
+    const size_t SLAB_SIZE = 64 * 1024;
+    /** How many blocks move between a thread and the shared list at once */
+    const size_t TRANSFER_BLOCKS = 32;
+    /** Most free blocks of one size class a thread holds before draining */
+    const size_t MAX_THREAD_BLOCKS = TRANSFER_BLOCKS * 2;
+    /** How many allocs and frees a thread counts before adding them to the
+        shared statistics */
+    const MG_LongUnsignedInt STATS_UPDATE_OPS = 1024;
+}
+
+namespace mutgos
+{
+namespace memory
+{
+    // Statics
+    //
+    thread_local SizeClassArena::ThreadCache SizeClassArena::thread_cache;
+    SizeClassArena::SharedClass
+        SizeClassArena::shared_classes[SizeClassArena::SIZE_CLASS_COUNT];
+    boost::atomic<MG_LongUnsignedInt> SizeClassArena::large_allocs(0);
+    boost::atomic<MG_LongUnsignedInt> SizeClassArena::large_frees(0);
+    boost::atomic<MG_LongUnsignedInt> SizeClassArena::large_bytes(0);
+
+    // ----------------------------------------------------------------------
+    void *SizeClassArena::alloc_block(const size_t size)
+    {
+        void *block_ptr = 0;
+
+        if (size > MAX_CLASS_BLOCK_SIZE)
+        {
+            block_ptr = malloc(size);
+
+            if (block_ptr)
+            {
+                large_allocs.fetch_add(1, boost::memory_order_relaxed);
+                large_bytes.fetch_add(size, boost::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            const size_t class_index =
+                GRANULES_TO_CLASS[(size + SIZE_GRANULE - 1) / SIZE_GRANULE];
+            ThreadClass &thread_class = thread_cache.classes[class_index];
+
+            if (not thread_class.free_list_ptr)
+            {
+                refill(class_index, thread_class);
+            }
+
+            FreeBlock * const free_ptr = thread_class.free_list_ptr;
+
+            if (free_ptr)
+            {
+                thread_class.free_list_ptr = free_ptr->next_ptr;
+                --thread_class.free_count;
+                ++thread_class.allocs;
+                thread_class.bytes_allocated += size;
+                block_ptr = free_ptr;
+
+                if ((thread_class.allocs + thread_class.frees) >=
+                    STATS_UPDATE_OPS)
+                {
+                    SharedClass &shared_class = shared_classes[class_index];
+                    boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+                    add_stats(thread_class, shared_class);
+                }
+            }
+        }
+
+        return block_ptr;
+    }
+
+    // ----------------------------------------------------------------------
+    void SizeClassArena::free_block(void *ptr, const size_t size)
+    {
+        if (ptr and (size > MAX_CLASS_BLOCK_SIZE))
+        {
+            large_frees.fetch_add(1, boost::memory_order_relaxed);
+            large_bytes.fetch_sub(size, boost::memory_order_relaxed);
+            free(ptr);
+        }
+        else if (ptr)
+        {
+            const size_t class_index =
+                GRANULES_TO_CLASS[(size + SIZE_GRANULE - 1) / SIZE_GRANULE];
+            ThreadClass &thread_class = thread_cache.classes[class_index];
+            FreeBlock * const free_ptr = reinterpret_cast<FreeBlock *>(ptr);
+
+            free_ptr->next_ptr = thread_class.free_list_ptr;
+            thread_class.free_list_ptr = free_ptr;
+            ++thread_class.free_count;
+            ++thread_class.frees;
+            thread_class.bytes_freed += size;
+
+            if (thread_class.free_count > MAX_THREAD_BLOCKS)
+            {
+                drain(class_index, thread_class);
+            }
+            else if ((thread_class.allocs + thread_class.frees) >=
+                STATS_UPDATE_OPS)
+            {
+                SharedClass &shared_class = shared_classes[class_index];
+                boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+                add_stats(thread_class, shared_class);
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SizeClassArena::release_thread_cache(void)
+    {
+        for (size_t class_index = 0; class_index < SIZE_CLASS_COUNT;
+            ++class_index)
+        {
+            ThreadClass &thread_class = thread_cache.classes[class_index];
+            SharedClass &shared_class = shared_classes[class_index];
+            boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+            add_stats(thread_class, shared_class);
+
+            if (thread_class.free_list_ptr)
+            {
+                FreeBlock *last_ptr = thread_class.free_list_ptr;
+
+                while (last_ptr->next_ptr)
+                {
+                    last_ptr = last_ptr->next_ptr;
+                }
+
+                last_ptr->next_ptr = shared_class.free_list_ptr;
+                shared_class.free_list_ptr = thread_class.free_list_ptr;
+                shared_class.free_count += thread_class.free_count;
+
+                thread_class.free_list_ptr = 0;
+                thread_class.free_count = 0;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    ArenaStats SizeClassArena::get_stats(void)
+    {
+        ArenaStats stats;
+
+        stats.size_classes.reserve(SIZE_CLASS_COUNT);
+
+        for (size_t class_index = 0; class_index < SIZE_CLASS_COUNT;
+            ++class_index)
+        {
+            SizeClassStats class_stats;
+            SharedClass &shared_class = shared_classes[class_index];
+
+            class_stats.block_size = CLASS_BLOCK_SIZES[class_index];
+
+            // Scope for lock
+            {
+                boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+                class_stats.allocs = shared_class.allocs;
+                class_stats.frees = shared_class.frees;
+                class_stats.blocks_reserved = shared_class.blocks_reserved;
+
+                // Blocks may be freed on a thread whose counts have been
+                // added before those of the thread that allocated them.
+                //
+                if (shared_class.bytes_allocated > shared_class.bytes_freed)
+                {
+                    class_stats.bytes_requested =
+                        shared_class.bytes_allocated - shared_class.bytes_freed;
+                }
+            }
+
+            if (class_stats.allocs > class_stats.frees)
+            {
+                stats.bytes_in_use += class_stats.block_size *
+                    (class_stats.allocs - class_stats.frees);
+            }
+
+            stats.bytes_reserved +=
+                class_stats.blocks_reserved * class_stats.block_size;
+            stats.bytes_requested += class_stats.bytes_requested;
+            stats.size_classes.push_back(class_stats);
+        }
+
+        stats.large_blocks.allocs = large_allocs.load();
+        stats.large_blocks.frees = large_frees.load();
+        stats.large_blocks.bytes_requested = large_bytes.load();
+
+        return stats;
+    }
+
+    // ----------------------------------------------------------------------
+    void SizeClassArena::refill(
+        const size_t class_index,
+        ThreadClass &thread_class)
+    {
+        SharedClass &shared_class = shared_classes[class_index];
+        boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+        add_stats(thread_class, shared_class);
+
+        if (not shared_class.free_list_ptr)
+        {
+            const size_t block_size = CLASS_BLOCK_SIZES[class_index];
+            const size_t block_count = SLAB_SIZE / block_size;
+            char * const slab_ptr =
+                reinterpret_cast<char *>(malloc(block_count * block_size));
+
+            if (not slab_ptr)
+            {
+                // This should never happen unless we run out of system
+                // memory.
+                LOG(fatal, "memory", "refill",
+                    "Failed to malloc slab for "
+                    + text::to_string(block_size) + " byte blocks!");
+            }
+            else
+            {
+                // Carve the slab so the list runs in address order.
+                //
+                for (size_t block_index = block_count; block_index > 0;
+                    --block_index)
+                {
+                    FreeBlock * const free_ptr = reinterpret_cast<FreeBlock *>(
+                        slab_ptr + ((block_index - 1) * block_size));
+
+                    free_ptr->next_ptr = shared_class.free_list_ptr;
+                    shared_class.free_list_ptr = free_ptr;
+                }
+
+                shared_class.free_count += block_count;
+                shared_class.blocks_reserved += block_count;
+            }
+        }
+
+        while (shared_class.free_list_ptr and
+            (thread_class.free_count < TRANSFER_BLOCKS))
+        {
+            FreeBlock * const free_ptr = shared_class.free_list_ptr;
+
+            shared_class.free_list_ptr = free_ptr->next_ptr;
+            --shared_class.free_count;
+
+            free_ptr->next_ptr = thread_class.free_list_ptr;
+            thread_class.free_list_ptr = free_ptr;
+            ++thread_class.free_count;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SizeClassArena::drain(
+        const size_t class_index,
+        ThreadClass &thread_class)
+    {
+        SharedClass &shared_class = shared_classes[class_index];
+        boost::lock_guard<boost::mutex> guard(shared_class.lock);
+
+        add_stats(thread_class, shared_class);
+
+        for (size_t count = 0;
+            (count < TRANSFER_BLOCKS) and thread_class.free_list_ptr;
+            ++count)
+        {
+            FreeBlock * const free_ptr = thread_class.free_list_ptr;
+
+            thread_class.free_list_ptr = free_ptr->next_ptr;
+            --thread_class.free_count;
+
+            free_ptr->next_ptr = shared_class.free_list_ptr;
+            shared_class.free_list_ptr = free_ptr;
+            ++shared_class.free_count;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void SizeClassArena::add_stats(
+        ThreadClass &thread_class,
+        SharedClass &shared_class)
+    {
+        shared_class.allocs += thread_class.allocs;
+        shared_class.frees += thread_class.frees;
+        shared_class.bytes_allocated += thread_class.bytes_allocated;
+        shared_class.bytes_freed += thread_class.bytes_freed;
+
+        thread_class.allocs = 0;
+        thread_class.frees = 0;
+        thread_class.bytes_allocated = 0;
+        thread_class.bytes_freed = 0;
+    }
+}
+}
@@ -0,0 +1,227 @@
+/*
+ * memory_SizeClassArena.h
+ */
+
+#ifndef MUTGOS_MEMORY_SIZECLASSARENA_H
+#define MUTGOS_MEMORY_SIZECLASSARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+
+#include "osinterface/osinterface_OsTypes.h"
+
+namespace mutgos
+{
+namespace memory
+{
+    /**
+     * Allocation statistics for one size class of the arena.
+     */
+    struct SizeClassStats
+    {
+        SizeClassStats(void)
+          : block_size(0),
+            allocs(0),
+            frees(0),
+            blocks_reserved(0),
+            bytes_requested(0)
+        { }
+
+        /** Bytes in each block of the class, or 0 for the blocks too big
+            for any class, which come straight from malloc() */
+        size_t block_size;
+        MG_LongUnsignedInt allocs; ///< Blocks handed out so far
+        MG_LongUnsignedInt frees; ///< Blocks given back so far
+        MG_LongUnsignedInt blocks_reserved; ///< Blocks carved from slabs
+        MG_LongUnsignedInt bytes_requested; ///< Bytes asked for, of blocks in use
+    };
+
+    /**
+     * Allocation statistics for the whole arena.
+     *
+     * Internal fragmentation (space lost rounding requests up to a block
+     * size) is 1 - (bytes_requested / bytes_in_use).  Idle space (blocks
+     * carved but free) is 1 - (bytes_in_use / bytes_reserved).  Neither
+     * includes the large blocks.
+     */
+    struct ArenaStats
+    {
+        ArenaStats(void)
+          : bytes_reserved(0),
+            bytes_in_use(0),
+            bytes_requested(0)
+        { }
+
+        /** Stats for each size class, smallest first */
+        std::vector<SizeClassStats> size_classes;
+        SizeClassStats large_blocks; ///< Stats for blocks too big for a class
+        MG_LongUnsignedInt bytes_reserved; ///< Bytes of slabs malloc()ed
+        MG_LongUnsignedInt bytes_in_use; ///< Bytes of class blocks in use
+        MG_LongUnsignedInt bytes_requested; ///< Bytes asked for in class blocks
+    };
+
+    /**
+     * A size-class allocator for the many small blocks the softcode
+     * interpreters allocate, used by ThreadVirtualHeapManager in place of
+     * malloc() and free().
+     *
+     * Small requests are rounded up to one of a few block sizes.  Blocks
+     * of each size are carved out of large slabs and kept on free lists,
+     * so most allocations and frees just pop or push a list.  Each thread
+     * keeps its own short free lists in thread local storage, and only
+     * locks when its list for a size runs out or grows too long, at which
+     * point a batch of blocks is moved from or to a shared list.  A block
+     * may be freed on a different thread than allocated it.  Requests too
+     * big for any size class go to malloc().
+     *
+     * Slabs are never given back to the system.  Virtual heap accounting
+     * is not done here; ThreadVirtualHeapManager still charges the
+     * requested size to the thread's MemHeapState.
+     *
+     * Statistics are counted per thread and added to the shared totals
+     * every so often, so they may lag slightly behind.
+     *
+     * This class is thread safe.
+     */
+    class SizeClassArena
+    {
+    public:
+        /**
+         * Works like malloc().
+         * @param size[in] The size of the block to allocate.
+         * @return The block, or null if out of memory.  It must be freed
+         * with free_block(), passing the same size.
+         */
+        static void *alloc_block(const size_t size);
+
+        /**
+         * Works like free().
+         * @param ptr[in] The block to free, or null to do nothing.  It must
+         * have come from alloc_block().
+         * @param size[in] The size passed to alloc_block() for the block.
+         */
+        static void free_block(void *ptr, const size_t size);
+
+        /**
+         * Moves every free block held by the currently executing thread
+         * to the shared lists, where other threads can use them.  Call
+         * when a thread is shutting down; blocks held by a thread that
+         * exits without calling this can't be reused.  The thread may
+         * still allocate afterwards.
+         */
+        static void release_thread_cache(void);
+
+        /**
+         * @return Allocation statistics for the arena.
+         */
+        static ArenaStats get_stats(void);
+
+    private:
+
+        /** How many block sizes there are */
+        static const size_t SIZE_CLASS_COUNT = 16;
+
+        /**
+         * A free block.  The pointer is stored in the block itself.
+         */
+        struct FreeBlock
+        {
+            FreeBlock *next_ptr; ///< Next free block in the list, or null
+        };
+
+        /**
+         * A thread's free blocks and pending statistics for one size class.
+         * All zeros when empty.
+         */
+        struct ThreadClass
+        {
+            FreeBlock *free_list_ptr; ///< Free blocks held by the thread
+            size_t free_count; ///< How many blocks are in free_list_ptr
+            MG_LongUnsignedInt allocs; ///< Allocs not yet added to totals
+            MG_LongUnsignedInt frees; ///< Frees not yet added to totals
+            MG_LongUnsignedInt bytes_allocated; ///< Requested bytes alloced
+            MG_LongUnsignedInt bytes_freed; ///< Requested bytes freed
+        };
+
+        /**
+         * Everything a thread holds for itself.
+         */
+        struct ThreadCache
+        {
+            ThreadClass classes[SIZE_CLASS_COUNT]; ///< Indexed by size class
+        };
+
+        /**
+         * Free blocks and statistics for one size class, shared by all
+         * threads.
+         */
+        struct SharedClass
+        {
+            SharedClass(void)
+              : free_list_ptr(0),
+                free_count(0),
+                blocks_reserved(0),
+                allocs(0),
+                frees(0),
+                bytes_allocated(0),
+                bytes_freed(0)
+            { }
+
+            boost::mutex lock; ///< Lock for everything below
+            FreeBlock *free_list_ptr; ///< Free blocks not held by a thread
+            size_t free_count; ///< How many blocks are in free_list_ptr
+            MG_LongUnsignedInt blocks_reserved; ///< Blocks carved from slabs
+            MG_LongUnsignedInt allocs; ///< Total blocks handed out
+            MG_LongUnsignedInt frees; ///< Total blocks given back
+            MG_LongUnsignedInt bytes_allocated; ///< Total requested bytes
+            MG_LongUnsignedInt bytes_freed; ///< Total requested bytes freed
+        };
+
+        /**
+         * Moves a batch of blocks from the shared list to the thread's,
+         * carving a new slab if the shared list is empty.
+         * @param class_index[in] The size class to refill.
+         * @param thread_class[in,out] The thread's list to refill.
+         */
+        static void refill(
+            const size_t class_index,
+            ThreadClass &thread_class);
+
+        /**
+         * Moves a batch of blocks from the thread's list to the shared
+         * list.
+         * @param class_index[in] The size class to drain.
+         * @param thread_class[in,out] The thread's list to drain.
+         */
+        static void drain(
+            const size_t class_index,
+            ThreadClass &thread_class);
+
+        /**
+         * Adds a thread's pending statistics to the shared totals.  The
+         * shared class lock must be held.
+         * @param thread_class[in,out] The thread's statistics.  Reset to 0.
+         * @param shared_class[in,out] The shared totals.
+         */
+        static void add_stats(
+            ThreadClass &thread_class,
+            SharedClass &shared_class);
+
+        static thread_local ThreadCache thread_cache; ///< Running thread's blocks
+        static SharedClass shared_classes[SIZE_CLASS_COUNT]; ///< Shared blocks
+        static boost::atomic<MG_LongUnsignedInt> large_allocs; ///< Big allocs
+        static boost::atomic<MG_LongUnsignedInt> large_frees; ///< Big frees
+        static boost::atomic<MG_LongUnsignedInt> large_bytes; ///< Big bytes in use
+
+        // Static class only; disable constructor/destructor.
+        //
+        SizeClassArena(void);
+        ~SizeClassArena();
+    };
+}
+}
+
+#endif //MUTGOS_MEMORY_SIZECLASSARENA_H
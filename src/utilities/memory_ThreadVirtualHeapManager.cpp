@@ -2,18 +2,13 @@
  * memory_ThreadVirtualHeapManager.cpp
  */
 
-#include <stdlib.h>
 #include <exception>
 
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/lock_guard.hpp>
-#include <boost/thread/thread.hpp>
-
 #include "logging/log_Logger.h"
 #include "text/text_StringConversion.h"
-#include "osinterface/osinterface_ThreadUtils.h"
 
 #include "memory_MemHeapState.h"
+#include "memory_SizeClassArena.h"
 #include "memory_ThreadVirtualHeapManager.h"
 
 namespace
@@ -27,15 +22,12 @@ namespace memory
 {
     // Statics
     //
-    ThreadVirtualHeapManager::ThreadHeapStates
-        ThreadVirtualHeapManager::thread_heap_states;
-    boost::mutex ThreadVirtualHeapManager::mutex;
+    thread_local MemHeapState *ThreadVirtualHeapManager::thread_heap_state_ptr =
+        0;
 
     /*
-     * Note that for the malloc and free calls, NO locking is performed for
-     * performance reasons.  This is because the data to be modified is assumed
-     * to be in a fixed location and will not be changed by any other thread
-     * until completion.
+     * Note that NO locking is performed anywhere.  Each thread only ever
+     * touches its own heap state.
      */
 
     // ----------------------------------------------------------------------
@@ -61,7 +53,7 @@ namespace memory
             else
             {
                 alloc_block_ptr = reinterpret_cast<size_t *>(
-                    malloc(actual_malloc_size));
+                    SizeClassArena::alloc_block(actual_malloc_size));
 
                 if (not alloc_block_ptr)
                 {
@@ -106,7 +98,7 @@ namespace memory
             external_malloc(actual_malloc_size, true);
 
             alloc_block_ptr = reinterpret_cast<size_t *>(
-                malloc(actual_malloc_size));
+                SizeClassArena::alloc_block(actual_malloc_size));
 
             if (not alloc_block_ptr)
             {
@@ -143,8 +135,12 @@ namespace memory
             size_t * const alloc_block_ptr =
                 reinterpret_cast<size_t *>(ptr) - 1;
 
-            external_free(*alloc_block_ptr + sizeof(size_t));
-            free(reinterpret_cast<void *>(alloc_block_ptr));
+            const size_t actual_malloc_size = *alloc_block_ptr + sizeof(size_t);
+
+            external_free(actual_malloc_size);
+            SizeClassArena::free_block(
+                reinterpret_cast<void *>(alloc_block_ptr),
+                actual_malloc_size);
         }
     }
 
@@ -153,97 +149,51 @@ namespace memory
         const size_t size,
         const bool override_max)
     {
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
+        MemHeapState * const heap_state_ptr = thread_heap_state_ptr;
 
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-             thread_iter != thread_heap_states.end();
-             ++thread_iter)
+        if (not heap_state_ptr)
         {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread, try and do the external malloc.
-                return thread_iter->second.alloc_mem(size, override_max);
-            }
-        }
+            LOG(fatal, "memory", "external_malloc",
+                "Unable to find thread heap state!");
 
-        LOG(fatal, "memory", "external_malloc",
-            "Unable to find thread heap state!");
+            return false;
+        }
 
-        return false;
+        return heap_state_ptr->alloc_mem(size, override_max);
     }
 
     // ----------------------------------------------------------------------
     void ThreadVirtualHeapManager::external_free(const size_t size)
     {
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
+        MemHeapState * const heap_state_ptr = thread_heap_state_ptr;
 
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-             thread_iter != thread_heap_states.end();
-             ++thread_iter)
+        if (not heap_state_ptr)
         {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread, try and do the external free.
-                thread_iter->second.free_mem(size);
-                return;
-            }
+            LOG(fatal, "memory", "external_free",
+                "Unable to find thread heap state!");
+        }
+        else
+        {
+            heap_state_ptr->free_mem(size);
         }
-
-        LOG(fatal, "memory", "external_free",
-            "Unable to find thread heap state!");
     }
 
     // ----------------------------------------------------------------------
     void ThreadVirtualHeapManager::add_thread(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
-
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-             thread_iter != thread_heap_states.end();
-             ++thread_iter)
+        if (not thread_heap_state_ptr)
         {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread, so we don't need to do add it again.
-                return;
-            }
+            thread_heap_state_ptr = new MemHeapState(0);
         }
-
-        thread_heap_states.push_back(
-            std::make_pair(current_thread, MemHeapState(0)));
     }
 
     // ----------------------------------------------------------------------
     void ThreadVirtualHeapManager::delete_thread(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
+        SizeClassArena::release_thread_cache();
 
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-             thread_iter != thread_heap_states.end();
-             ++thread_iter)
-        {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread.  Delete it.
-                //
-                thread_heap_states.erase(thread_iter);
-                break;
-            }
-        }
+        delete thread_heap_state_ptr;
+        thread_heap_state_ptr = 0;
     }
 
     // ----------------------------------------------------------------------
@@ -268,25 +218,12 @@ namespace memory
         const MemHeapState &heap_state)
     {
         bool found_thread = false;
-        boost::lock_guard<boost::mutex> guard(mutex);
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
 
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-                thread_iter != thread_heap_states.end();
-            ++thread_iter)
+        if (thread_heap_state_ptr)
         {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread.  Copy the state in.
-                //
-                thread_iter->second = heap_state;
-
-                found_thread = true;
-                break;
-            }
+            // Copy the state in.
+            *thread_heap_state_ptr = heap_state;
+            found_thread = true;
         }
 
         return found_thread;
@@ -295,27 +232,15 @@ namespace memory
     // ----------------------------------------------------------------------
     const MemHeapState &ThreadVirtualHeapManager::get_thread_heap_state(void)
     {
-        boost::lock_guard<boost::mutex> guard(mutex);
-        osinterface::ThreadUtils::ThreadId current_thread =
-            osinterface::ThreadUtils::get_thread_id();
-
-        for (ThreadHeapStates::iterator thread_iter = thread_heap_states.begin();
-             thread_iter != thread_heap_states.end();
-             ++thread_iter)
+        if (not thread_heap_state_ptr)
         {
-            if (osinterface::ThreadUtils::thread_id_equal(
-                thread_iter->first,
-                current_thread))
-            {
-                // Found our thread.  Return the state.
-                return thread_iter->second;
-            }
-        }
+            LOG(fatal, "memory", "get_thread_heap_state",
+                "Unable to find thread heap state!");
 
-        LOG(fatal, "memory", "get_thread_heap_state",
-            "Unable to find thread heap state!");
+            return INVALID_HEAP_STATE;
+        }
 
-        return INVALID_HEAP_STATE;
+        return *thread_heap_state_ptr;
     }
 }
 }
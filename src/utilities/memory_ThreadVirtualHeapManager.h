@@ -5,13 +5,8 @@
 #ifndef MUTGOS_MEMORY_VIRTUALHEAPMANAGER_H
 #define MUTGOS_MEMORY_VIRTUALHEAPMANAGER_H
 
-#include <map>
-#include <vector>
 #include <stddef.h>
 
-#include <boost/thread/mutex.hpp>
-
-#include "osinterface/osinterface_ThreadUtils.h"
 #include "memory_MemHeapState.h"
 
 namespace mutgos
@@ -28,6 +23,13 @@ namespace memory
      * Before a VM that uses this manager activates on a thread, it must set
      * the current heap state using the methods below.  Due to performance
      * reasons, very little error checking is done.
+     *
+     * Each thread's heap state is kept in thread local storage, so finding
+     * it takes the same (short) time no matter how many threads there are,
+     * and threads never need to lock to use or change their own state.
+     *
+     * The blocks themselves come from SizeClassArena rather than malloc(),
+     * since interpreters allocate and free a great many small blocks.
      */
     class ThreadVirtualHeapManager
     {
@@ -97,17 +99,16 @@ namespace memory
 
         /**
          * Adds the currently executing thread to the heap manager, generally
-         * called because the thread has started up.
-         * NOTE: Do not call this if other threads are currently executing
-         * (using malloc() and free()).
+         * called because the thread has started up.  Other threads are not
+         * affected.
          */
         static void add_thread(void);
 
         /**
          * Removes the currently executing thread from the heap manager,
-         * generally called because the thread is shutting down.
-         * NOTE: Do not call this if other threads are currently executing
-         * (using malloc() and free()).
+         * generally called because the thread is shutting down.  Free
+         * blocks the thread was holding are given back for other threads
+         * to use.  Other threads are not affected.
          */
         static void delete_thread(void);
 
@@ -143,12 +144,8 @@ namespace memory
     private:
 
         typedef size_t AllocBlockSize;
-        typedef std::pair<osinterface::ThreadUtils::ThreadId, MemHeapState>
-            ThreadToHeapState;
-        typedef std::vector<ThreadToHeapState> ThreadHeapStates;
 
-        static ThreadHeapStates thread_heap_states; ///< Current virtual heap states, organized by running thread
-        static boost::mutex mutex; ///< Enforces single access at a time when making major changes
+        static thread_local MemHeapState *thread_heap_state_ptr; ///< Virtual heap state of the running thread, or null if not added
 
         // Static class only; disable constructor/destructor.
         //
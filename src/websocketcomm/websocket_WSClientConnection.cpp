@@ -15,13 +15,11 @@
 #include "dbtypes/dbtype_Id.h"
 
 #include "dbinterface/dbinterface_DatabaseAccess.h"
-#include "utilities/json_JsonParsedObject.h"
 #include "utilities/json_JsonUtilities.h"
 
 #include "comminterface/comm_RouterSessionManager.h"
 
 #include "clientmessages/message_ClientMessage.h"
-#include "clientmessages/message_MessageFactory.h"
 #include "clientmessages/message_ChannelData.h"
 #include "clientmessages/message_ClientTextData.h"
 #include "clientmessages/message_ClientSiteList.h"
@@ -36,6 +34,7 @@
 
 #define MAX_CLIENT_WINDOW_SIZE 8192
 #define MAX_AUTHENTICATION_TIME_SECS 120
+#define DECODE_JSON_POOL_SIZE 16384
 
 // TODO May want to work on ChannelData, ClientTextData to have a 'no copy' mode for performance
 
@@ -56,6 +55,10 @@ namespace websocket
         client_error(false),
         client_disconnect_state(WSClientConnection::DISCONNECT_STATE_NOT_REQUESTED),
         requested_service(false),
+        disconnect_pending(false),
+        decode_shard(driver ? driver->get_decode_pool().assign_shard() : 0),
+        decodes_pending(0),
+        decode_json_pool(DECODE_JSON_POOL_SIZE),
         outgoing_size(0),
         outgoing_json_node(JSON_MAKE_ARRAY_ROOT()),
         auth_attempts(0),
@@ -348,11 +351,18 @@ namespace websocket
             "Client disconnected.  Source " + client_source + ", entity "
             + client_entity_id.to_string(true));
 
-        // Only process if we didn't initiate the disconnection or it was
-        // disconnected due to an error condition.
-        //
-        if (client_connected or client_error)
+        if (decodes_pending)
+        {
+            // Let the session see everything the client sent before it
+            // sees the disconnect.  input_decoded() will call back.
+            //
+            disconnect_pending = true;
+        }
+        else if (client_connected or client_error)
         {
+            // Only process if we didn't initiate the disconnection or it was
+            // disconnected due to an error condition.
+            //
             client_connected = false;
             client_blocked = true;
             client_disconnect_state = DISCONNECT_STATE_NOT_REQUESTED;
@@ -384,91 +394,60 @@ namespace websocket
                 + " bytes.  Source " + client_source + ", entity "
                 + client_entity_id.to_string(true));
 
-            json::JsonParsedObject *json_ptr = json::parse_json(data_ptr);
-            data_ptr = 0;
+            // Stay alive until the decoded input comes back.
+            //
+            driver_ptr->add_reference(this);
+            ++decodes_pending;
+
+            driver_ptr->get_decode_pool().submit(
+                decode_shard,
+                new WSDecodeJob(
+                    this,
+                    decode_json_pool,
+                    data_ptr,
+                    client_source,
+                    client_entity_id));
+        }
+    }
 
-            if (not json_ptr)
+    // ----------------------------------------------------------------------
+    void WSClientConnection::input_decoded(
+        WSDecodeJob::ClientMessages &messages,
+        const bool decode_error)
+    {
+        for (WSDecodeJob::ClientMessages::iterator message_iter =
+                messages.begin();
+            message_iter != messages.end();
+            ++message_iter)
+        {
+            if (client_connected)
             {
-                LOG(error, "websocket", "raw_data",
-                    "Client sent invalid/incomplete JSON data!  "
-                    "Source " + client_source + ", entity "
-                    + client_entity_id.to_string(true));
-
-                client_error = true;
-                request_service();
+                process_message(*message_iter);
             }
             else
             {
-                // We now have a valid, parsed JSON.  Split it out into
-                // the various messages and parse each one.
-                //
-                if (json::is_map(json_ptr->get()))
-                {
-                    // Single message not sent as array.  Process directly.
-                    process_message(restore_message(json_ptr));
-                }
-                else if (json::is_array(json_ptr->get()))
-                {
-                    // One or more messages sent as array.  Process one at a
-                    // time.
-                    //
-                    const MG_UnsignedInt message_count =
-                        json::array_size(json_ptr->get());
-                    char *raw_json_ptr = 0;
-                    size_t raw_json_size = 0;
-                    json::JsonParsedObject *indexed_json_ptr = 0;
+                // We disconnected them while this was being decoded.
+                delete *message_iter;
+            }
+        }
 
-                    for (MG_UnsignedInt index = 0; index < message_count; ++index)
-                    {
-                        json::array_get_value(
-                            json_ptr->get(),
-                            index,
-                            raw_json_ptr,
-                            raw_json_size);
-
-                        if (not raw_json_ptr)
-                        {
-                            LOG(error, "websocket", "raw_data",
-                                "Empty JSON found in array, or wrong type.");
-                            client_error = true;
-                            request_service();
-                        }
-                        else
-                        {
-                            indexed_json_ptr = json::parse_json(raw_json_ptr);
-
-                            if (not indexed_json_ptr)
-                            {
-                                LOG(error, "websocket", "raw_data",
-                                    "Client sent invalid/incomplete JSON data "
-                                    "in array!  Source " + client_source
-                                    + ", entity "
-                                    + client_entity_id.to_string(true));
-
-                                client_error = true;
-                                request_service();
-                            }
-                            else
-                            {
-                                process_message(
-                                    restore_message(indexed_json_ptr));
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    LOG(error, "websocket", "raw_data",
-                        "Client sent unknown JSON data!  "
-                            "Source " + client_source + ", entity "
-                        + client_entity_id.to_string(true));
+        messages.clear();
 
-                    delete json_ptr;
-                    client_error = true;
-                    request_service();
-                }
-            }
+        if (decode_error)
+        {
+            client_error = true;
+            request_service();
+        }
+
+        --decodes_pending;
+
+        if ((not decodes_pending) and disconnect_pending)
+        {
+            disconnect_pending = false;
+            raw_disconnected();
         }
+
+        driver_ptr->release(this);
     }
 
     // ----------------------------------------------------------------------
@@ -570,59 +549,6 @@ namespace websocket
         }
     }
 
-    // ----------------------------------------------------------------------
-    message::ClientMessage *WSClientConnection::restore_message(
-        json::JsonParsedObject *json_ptr)
-    {
-        message::ClientMessage *message_ptr = 0;
-
-        if (not json_ptr)
-        {
-            LOG(error, "websocket", "restore_message",
-                "json_ptr is null!");
-        }
-        else
-        {
-            const message::ClientMessageType message_type =
-                message::ClientMessage::get_message_type(json_ptr->get());
-
-            if (message_type == message::CLIENTMESSAGE_END_INVALID)
-            {
-                LOG(error, "websocket", "restore_message",
-                    "Invalid message to restore (unknown type).");
-            }
-            else
-            {
-                LOG(debug, "websocket", "restore_message",
-                    "Restoring message of type " +
-                    message::client_message_type_to_string(message_type));
-
-                message_ptr =
-                    message::MessageFactory::create_message(message_type);
-
-                if (not message_ptr)
-                {
-                    LOG(error, "websocket", "restore_message",
-                        "Message type is not registered: " +
-                        message::client_message_type_to_string(message_type));
-                }
-                else if (not message_ptr->restore(json_ptr->get()))
-                {
-                    LOG(error, "websocket", "restore_message",
-                        "Failed to restore message of type: " +
-                        message::client_message_type_to_string(message_type));
-
-                    delete message_ptr;
-                    message_ptr = 0;
-                }
-            }
-
-            delete json_ptr;
-        }
-
-        return message_ptr;
-    }
-
     // ----------------------------------------------------------------------
     void WSClientConnection::process_message(
         message::ClientMessage *message_ptr)
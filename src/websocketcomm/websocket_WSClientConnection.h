@@ -11,6 +11,7 @@
 
 #include "osinterface/osinterface_OsTypes.h"
 #include "utilities/json_JsonUtilities.h"
+#include "utilities/json_JsonParsePool.h"
 
 #include "dbtypes/dbtype_Id.h"
 
@@ -20,6 +21,8 @@
 
 #include "comminterface/comm_ClientConnection.h"
 
+#include "websocket_WSDecodeJob.h"
+
 namespace mutgos
 {
 namespace comm
@@ -230,7 +233,8 @@ namespace websocket
         /**
          * Called by the raw connection class instance when it has incoming
          * data from the client to be processed.  This will be one websocket
-         * message at a time.
+         * message at a time.  The data is decoded by the driver's
+         * DecodePool, and then passed to input_decoded().
          * @param data_ptr[in] A buffer with all the data for a websocket
          * message.  Ownership of the pointer transfer to this method,
          * which is responsible for cleaning it up after.
@@ -238,6 +242,18 @@ namespace websocket
          */
         void raw_data(char *data_ptr, const size_t data_size);
 
+        /**
+         * Called back by WSDecodeJob with the messages decoded from data
+         * given to raw_data(), in the order it was given.
+         * @param messages[in,out] The messages decoded.  Control of the
+         * pointers passes to this method, and the vector will be cleared.
+         * @param decode_error[in] True if any of the data could not be
+         * decoded.
+         */
+        void input_decoded(
+            WSDecodeJob::ClientMessages &messages,
+            const bool decode_error);
+
         /**
          * Called by the raw connection class instance when the timer
          * has expired.
@@ -272,17 +288,6 @@ namespace websocket
          */
         void disconnect_socket(void);
 
-        /**
-         * Deserializes the provided JSON into a ClientMessage.
-         * @param json_ptr[in] The JSON to parse.  The pointer will be owned by
-         * this method.
-         * @return A pointer to the deserialized message, if successful, or
-         * null if error or unrecognized message.  Caller must manage the
-         * pointer!
-         */
-        message::ClientMessage *restore_message(
-            json::JsonParsedObject *json_ptr);
-
         /**
          * Processes an incoming message from the client.
          * @param message_ptr[in] The message to process.  Control of the
@@ -339,6 +344,11 @@ namespace websocket
         bool client_error; ///< True if client has an error condition requiring disconnection.
         DisconnectState client_disconnect_state; ///< What phase of disconnect we're in
         bool requested_service; ///< True if services has been requested on the driver
+        bool disconnect_pending; ///< True if raw_disconnected() is waiting for decodes to finish
+
+        MG_UnsignedInt decode_shard; ///< The DecodePool shard our input is decoded on
+        MG_UnsignedInt decodes_pending; ///< Input submitted but not yet back from decoding
+        json::JsonParsePool decode_json_pool; ///< Incoming JSON is parsed into this, by the decode jobs
 
         MG_UnsignedInt outgoing_size; ///< Estimated bytes of pending outgoing data
         json::JSONRoot outgoing_json_node; ///< Temporary holding spot while building up outgoing data
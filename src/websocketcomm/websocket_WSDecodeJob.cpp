@@ -0,0 +1,202 @@
+/*
+ * websocket_WSDecodeJob.cpp
+ */
+
+#include <string>
+#include <vector>
+
+#include "osinterface/osinterface_OsTypes.h"
+#include "logging/log_Logger.h"
+
+#include "dbtypes/dbtype_Id.h"
+#include "utilities/json_JsonUtilities.h"
+#include "utilities/json_JsonParsePool.h"
+
+#include "clientmessages/message_ClientMessage.h"
+#include "clientmessages/message_MessageFactory.h"
+
+#include "websocket_WSDecodeJob.h"
+#include "websocket_WSClientConnection.h"
+
+namespace mutgos
+{
+namespace websocket
+{
+    // ----------------------------------------------------------------------
+    WSDecodeJob::WSDecodeJob(
+        WSClientConnection *connection_ptr,
+        json::JsonParsePool &pool,
+        char *data_ptr,
+        const std::string &source,
+        const dbtype::Id &entity_id)
+      : client_connection_ptr(connection_ptr),
+        json_pool(pool),
+        raw_data_ptr(data_ptr),
+        client_source(source),
+        client_entity_id(entity_id),
+        decode_error(false)
+    {
+    }
+
+    // ----------------------------------------------------------------------
+    WSDecodeJob::~WSDecodeJob()
+    {
+        delete[] raw_data_ptr;
+
+        for (ClientMessages::iterator message_iter = client_messages.begin();
+            message_iter != client_messages.end();
+            ++message_iter)
+        {
+            delete *message_iter;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void WSDecodeJob::decode(void)
+    {
+        if (raw_data_ptr)
+        {
+            // Scope for document, which must be gone before the pool is
+            // reset.
+            {
+                json::JSONRoot document(&json_pool.get_allocator());
+
+                if (not json::parse_json_insitu(raw_data_ptr, document))
+                {
+                    LOG(error, "websocket", "decode",
+                        "Client sent invalid/incomplete JSON data!  "
+                        "Source " + client_source + ", entity "
+                        + client_entity_id.to_string(true));
+
+                    decode_error = true;
+                }
+                else if (json::is_map(document))
+                {
+                    // Single message not sent as array.  Restore directly.
+                    client_messages.push_back(restore_message(document));
+                }
+                else if (json::is_array(document))
+                {
+                    // One or more messages sent as array.  Restore one at a
+                    // time, right from the array.
+                    //
+                    const MG_UnsignedInt message_count =
+                        json::array_size(document);
+                    const json::JSONNode *element_ptr = 0;
+
+                    for (MG_UnsignedInt index = 0;
+                        index < message_count;
+                        ++index)
+                    {
+                        json::array_get_value(document, index, element_ptr);
+
+                        if (not element_ptr)
+                        {
+                            LOG(error, "websocket", "decode",
+                                "Could not get element from JSON array.");
+                            decode_error = true;
+                        }
+                        else
+                        {
+                            restore_element(*element_ptr);
+                        }
+                    }
+                }
+                else
+                {
+                    LOG(error, "websocket", "decode",
+                        "Client sent unknown JSON data!  "
+                            "Source " + client_source + ", entity "
+                        + client_entity_id.to_string(true));
+
+                    decode_error = true;
+                }
+            }
+
+            // The messages copied what they needed out of the JSON.
+            //
+            json_pool.reset();
+            delete[] raw_data_ptr;
+            raw_data_ptr = 0;
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    void WSDecodeJob::decoded(void)
+    {
+        client_connection_ptr->input_decoded(client_messages, decode_error);
+    }
+
+    // ----------------------------------------------------------------------
+    void WSDecodeJob::restore_element(const json::JSONNode &element)
+    {
+        if (json::is_map(element))
+        {
+            client_messages.push_back(restore_message(element));
+        }
+        else
+        {
+            // Older clients send each message as a JSON string.  It shares
+            // the pool with the array it came from.
+            //
+            json::JSONRoot element_document(&json_pool.get_allocator());
+
+            if (not json::parse_json_insitu(element, element_document))
+            {
+                LOG(error, "websocket", "restore_element",
+                    "Client sent invalid/incomplete JSON data "
+                    "in array, or wrong type!  Source " + client_source
+                    + ", entity " + client_entity_id.to_string(true));
+
+                decode_error = true;
+            }
+            else
+            {
+                client_messages.push_back(restore_message(element_document));
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------
+    message::ClientMessage *WSDecodeJob::restore_message(
+        const json::JSONNode &node)
+    {
+        message::ClientMessage *message_ptr = 0;
+        const message::ClientMessageType message_type =
+            message::ClientMessage::get_message_type(node);
+
+        if (message_type == message::CLIENTMESSAGE_END_INVALID)
+        {
+            LOG(error, "websocket", "restore_message",
+                "Invalid message to restore (unknown type).");
+        }
+        else
+        {
+            LOG(debug, "websocket", "restore_message",
+                "Restoring message of type " +
+                message::client_message_type_to_string(message_type));
+
+            message_ptr =
+                message::MessageFactory::create_message(message_type);
+
+            if (not message_ptr)
+            {
+                LOG(error, "websocket", "restore_message",
+                    "Message type is not registered: " +
+                    message::client_message_type_to_string(message_type));
+            }
+            else if (not message_ptr->restore(node))
+            {
+                LOG(error, "websocket", "restore_message",
+                    "Failed to restore message of type: " +
+                    message::client_message_type_to_string(message_type));
+
+                delete message_ptr;
+                message_ptr = 0;
+            }
+        }
+
+        return message_ptr;
+    }
+}
+}
@@ -0,0 +1,124 @@
+/*
+ * websocket_WSDecodeJob.h
+ */
+
+#ifndef MUTGOS_WEBSOCKET_WSDECODEJOB_H
+#define MUTGOS_WEBSOCKET_WSDECODEJOB_H
+
+#include <string>
+#include <vector>
+
+#include "dbtypes/dbtype_Id.h"
+#include "utilities/json_JsonUtilities.h"
+#include "utilities/json_JsonParsePool.h"
+#include "clientmessages/message_ClientMessage.h"
+
+#include "comminterface/comm_DecodeJob.h"
+
+namespace mutgos
+{
+namespace websocket
+{
+    // Forward declarations
+    //
+    class WSClientConnection;
+
+    /**
+     * Decodes one websocket message from a client: parses the JSON and
+     * restores the ClientMessages in it.  The messages are then handed to
+     * the WSClientConnection to process.
+     *
+     * A message may be a single ClientMessage, or an array of them.  Array
+     * elements are restored straight from the parsed array.  Elements
+     * that are ClientMessages embedded as JSON strings (as older clients
+     * send them) are parsed again where they are, without copying.
+     */
+    class WSDecodeJob : public comm::DecodeJob
+    {
+    public:
+        typedef std::vector<message::ClientMessage *> ClientMessages;
+
+        /**
+         * Constructor.  The caller must hold a reference to the connection
+         * (see WebsocketDriver::add_reference()), which will be released
+         * once the connection has been called back.
+         * @param connection_ptr[in] The connection the data came from.
+         * @param pool[in] The connection's pool to parse the JSON into.
+         * Since a connection's jobs are decoded one at a time, only this
+         * job uses it during decode().
+         * @param data_ptr[in] The data for the websocket message, null
+         * terminated.  Ownership of the pointer passes to this class.
+         * @param source[in] Where the client is connecting from, for
+         * logging.
+         * @param entity_id[in] The entity the client is authenticated as,
+         * if any, for logging.
+         */
+        WSDecodeJob(
+            WSClientConnection *connection_ptr,
+            json::JsonParsePool &pool,
+            char *data_ptr,
+            const std::string &source,
+            const dbtype::Id &entity_id);
+
+        /**
+         * Destructor.  Cleans up anything not handed to the connection.
+         */
+        virtual ~WSDecodeJob();
+
+        /**
+         * Parses the data and restores the messages in it.
+         */
+        virtual void decode(void);
+
+        /**
+         * Hands the messages to the connection.
+         */
+        virtual void decoded(void);
+
+        /**
+         * @return The messages decoded so far.  They are still owned by
+         * this class.
+         */
+        const ClientMessages &get_messages(void) const
+          { return client_messages; }
+
+        /**
+         * @return True if any of the data could not be decoded.
+         */
+        bool get_decode_error(void) const
+          { return decode_error; }
+
+    private:
+        /**
+         * Restores one element of an array of messages, and adds it to
+         * client_messages.
+         * @param element[in] The array element.
+         */
+        void restore_element(const json::JSONNode &element);
+
+        /**
+         * Deserializes the provided JSON into a ClientMessage.
+         * @param node[in] The JSON to restore from.
+         * @return A pointer to the deserialized message, if successful, or
+         * null if error or unrecognized message.  Caller must manage the
+         * pointer!
+         */
+        message::ClientMessage *restore_message(const json::JSONNode &node);
+
+        // No copying
+        //
+        WSDecodeJob &operator=(const WSDecodeJob &rhs);
+        WSDecodeJob(const WSDecodeJob &rhs);
+
+        WSClientConnection * const client_connection_ptr; ///< Where the data came from
+        json::JsonParsePool &json_pool; ///< Where the JSON is parsed into
+        char *raw_data_ptr; ///< The data to decode, until decoded
+        const std::string client_source; ///< Where the client is connecting from
+        const dbtype::Id client_entity_id; ///< Entity associated with the client
+        ClientMessages client_messages; ///< Messages decoded, in order
+        bool decode_error; ///< True if any of the data could not be decoded
+    };
+}
+}
+
+#endif //MUTGOS_WEBSOCKET_WSDECODEJOB_H
@@ -8,10 +8,20 @@
 #include "logging/log_Logger.h"
 #include "text/text_StringConversion.h"
 
+#include "comminterface/comm_RouterSessionManager.h"
+
 #include "websocket_WebsocketDriver.h"
 #include "websocket_WSClientConnection.h"
 #include "websocket_ConnectionListener.h"
 
+namespace
+{
+    // TODO make data driven
+
+    /** Threads to decode input on, or 0 for one less than the cores */
+    const unsigned int DECODE_THREAD_COUNT = 0;
+}
+
 namespace mutgos
 {
 namespace websocket
@@ -20,7 +30,8 @@ namespace websocket
     WebsocketDriver::WebsocketDriver(
         mutgos::comm::RouterSessionManager *router)
       : my_router_ptr(router),
-        io_context{1},
+        io_context(router->get_io_context()),
+        decode_pool(router),
         started(false)
     {
         if (not my_router_ptr)
@@ -38,6 +49,12 @@ namespace websocket
                 "Destructed without calling stop()!");
         }
 
+        // Hand back any input still being decoded now, while the
+        // connections it references can still be released.
+        //
+        decode_pool.stop();
+        decode_pool.deliver_decoded();
+
         if (not client_connections.empty())
         {
             LOG(error, "websocket", "~WebsocketDriver",
@@ -62,6 +79,8 @@ namespace websocket
             const unsigned short port = 7000;
 
 
+            decode_pool.start(DECODE_THREAD_COUNT);
+
             started = std::make_shared<ConnectionListener>(
                 this,
                 io_context,
@@ -93,6 +112,11 @@ namespace websocket
                 connection_iter->first->stop();
             }
 
+            // Let input already read be decoded and delivered with the
+            // other work below.
+            //
+            decode_pool.stop();
+
             for (MG_UnsignedInt count = 0; count < 5; ++count)
             {
                 if (not do_work(router_ptr))
@@ -102,8 +126,6 @@ namespace websocket
                 }
             }
 
-            io_context.stop();
-
             started = false;
             LOG(info, "websocket", "stop", "Websocket Driver stopped");
         }
@@ -120,6 +142,12 @@ namespace websocket
             // First, run the IO Context to service anything.
             done = not io_context.poll();
 
+            // Next, hand back decoded input.
+            if (decode_pool.deliver_decoded())
+            {
+                done = false;
+            }
+
             // Then, service the pending actions.
             for (PendingActions::iterator actions_iter = pending_actions.begin();
                 actions_iter != pending_actions.end();
@@ -188,6 +216,7 @@ namespace websocket
         if (connection_ptr)
         {
             pending_actions.push_back(connection_ptr);
+            my_router_ptr->wakeup();
         }
     }
 }
@@ -13,6 +13,7 @@
 #include "osinterface/osinterface_OsTypes.h"
 
 #include "comminterface/comm_ConnectionDriver.h"
+#include "comminterface/comm_DecodePool.h"
 
 namespace mutgos
 {
@@ -127,6 +128,12 @@ namespace websocket
         comm::RouterSessionManager *get_router(void)
         { return my_router_ptr; }
 
+        /**
+         * @return The pool connections use to decode their input.
+         */
+        comm::DecodePool &get_decode_pool(void)
+        { return decode_pool; }
+
         /**
          * Called when a connection needs to be called back (do_work())after
          * unwinding its stack, at some unspecified time in the future.
@@ -145,7 +152,8 @@ namespace websocket
 
         comm::RouterSessionManager * const my_router_ptr; ///< Pointer to router.
 
-        boost::asio::io_context io_context; ///< The IO Context for the sockets.
+        boost::asio::io_context &io_context; ///< The router's IO Context, for the sockets.
+        comm::DecodePool decode_pool; ///< Decodes input off the router thread.
 
         bool started; ///< True if start() has been called successfully.
         PendingActions pending_actions; ///< connections with pending actions.